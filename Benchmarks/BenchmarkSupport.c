@@ -0,0 +1,664 @@
+/*###################################################################################
+#                                                                                   #
+#     BenchmarkSupport.c                                                            #
+#     Corpora, counters and reports of the benchmark runners                        #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     compile it with the runners, see Benchmarks in README              #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+#include "BenchmarkSupport.h"
+#include <libxml/xmlmemory.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#define BENCHMARK_REPORT_COLUMNS 10
+#define BENCHMARK_NAME_SIZE 96
+
+// A growing byte buffer, a failed allocation is remembered and reported when the buffer is finished
+typedef struct {
+    char * bytes;
+    size_t length;
+    size_t capacity;
+    int failed;
+} BenchmarkBuffer;
+
+// A line of a report file
+typedef struct {
+    char corpus[BENCHMARK_NAME_SIZE];
+    char benchmark[BENCHMARK_NAME_SIZE];
+    double values[BENCHMARK_REPORT_COLUMNS]; // calls, MB/s, p50, p90, p99, max, allocs, KB, xml allocs, peak xml KB
+} BenchmarkReportLine;
+
+static void bufferAppend(BenchmarkBuffer * buffer, const char * string, size_t length);
+static void bufferAppendString(BenchmarkBuffer * buffer, const char * string);
+static void bufferPrintf(BenchmarkBuffer * buffer, const char * format, ...) __attribute__((format(printf, 2, 3)));
+static int corpusAdd(BenchmarkCorpus * corpus, char * name, BenchmarkBuffer * buffer);
+static uint32_t nextRandom(uint32_t * state);
+static void appendWords(BenchmarkBuffer * buffer, uint32_t * state, size_t count, int inlineMarkup);
+static void generateSmallPage(BenchmarkBuffer * buffer, uint32_t * state, size_t number);
+static void generateLargeArticle(BenchmarkBuffer * buffer, uint32_t * state, size_t number);
+static void generateHugeTable(BenchmarkBuffer * buffer, uint32_t * state, size_t number);
+static void generateNestedMalformed(BenchmarkBuffer * buffer, uint32_t * state, size_t number);
+static void heapStatistics(int64_t * blocks, int64_t * bytes);
+static int readReport(const char * path, char * implementation, BenchmarkReportLine ** lines, size_t * count);
+
+#pragma mark - buffer
+
+static void bufferAppend(BenchmarkBuffer * buffer, const char * string, size_t length)
+{
+    if (buffer->failed) return;
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = (buffer->capacity) ? buffer->capacity : 4096;
+        while (capacity < buffer->length + length + 1) capacity *= 2;
+        char *bytes = realloc(buffer->bytes, capacity);
+        if (bytes == NULL) {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->bytes = bytes;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->bytes + buffer->length, string, length);
+    buffer->length += length;
+    buffer->bytes[buffer->length] = '\0';
+}
+
+static void bufferAppendString(BenchmarkBuffer * buffer, const char * string)
+{
+    bufferAppend(buffer, string, strlen(string));
+}
+
+static void bufferPrintf(BenchmarkBuffer * buffer, const char * format, ...)
+{
+    char line[512];
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(line, sizeof(line), format, arguments);
+    va_end(arguments);
+    if (length < 0) buffer->failed = 1;
+    else bufferAppend(buffer, line, ((size_t)length < sizeof(line)) ? (size_t)length : sizeof(line) - 1);
+}
+
+// Adds the bytes of the buffer as input to the corpus, the corpus takes ownership of the name and the bytes
+static int corpusAdd(BenchmarkCorpus * corpus, char * name, BenchmarkBuffer * buffer)
+{
+    BenchmarkInput *inputs = (name && ! buffer->failed) ? realloc(corpus->inputs, (corpus->count + 1) * sizeof(BenchmarkInput)) : NULL;
+    if (inputs == NULL) {
+        free(name);
+        free(buffer->bytes);
+        return -1;
+    }
+    inputs[corpus->count].name = name;
+    inputs[corpus->count].bytes = buffer->bytes;
+    inputs[corpus->count].length = buffer->length;
+    corpus->inputs = inputs;
+    corpus->count++;
+    corpus->totalLength += buffer->length;
+    return 0;
+}
+
+#pragma mark - corpora
+
+static const char * const words[] = {
+    "the", "of", "and", "a", "to", "in", "is", "you", "that", "it", "he", "was", "for", "on", "are", "as",
+    "with", "his", "they", "at", "be", "this", "have", "from", "or", "one", "had", "by", "word", "but", "not", "what",
+    "parser", "document", "node", "markup", "library", "element", "attribute", "table", "value", "query", "result", "index",
+    "caf\xC3\xA9", "na\xC3\xAFve", "\xC3\xBC" "ber", "stra\xC3\x9F" "e", "\xE2\x80\x94", "\xE6\x97\xA5\xE6\x9C\xAC", "&amp;", "&lt;tag&gt;"
+};
+#define BENCHMARK_WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+// xorshift32, the state must not be 0
+static uint32_t nextRandom(uint32_t * state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void appendWords(BenchmarkBuffer * buffer, uint32_t * state, size_t count, int inlineMarkup)
+{
+    for (size_t i = 0; i < count; i++) {
+        const char *word = words[nextRandom(state) % BENCHMARK_WORD_COUNT];
+        if (i) bufferAppend(buffer, " ", 1);
+        uint32_t markup = (inlineMarkup) ? nextRandom(state) % 40 : 39;
+        switch (markup) {
+            case 0: bufferPrintf(buffer, "<b>%s</b>", word); break;
+            case 1: bufferPrintf(buffer, "<i>%s</i>", word); break;
+            case 2: bufferPrintf(buffer, "<a href=\"/wiki/%s_%u\" title=\"%s\">%s</a>", words[i % 32], nextRandom(state) % 10000, word, word); break;
+            case 3: bufferPrintf(buffer, "<code class=\"inline\">%s()</code>", words[i % 32]); break;
+            case 4: bufferPrintf(buffer, "%s<sup><a href=\"#note-%u\">[%u]</a></sup>", word, (unsigned)i, (unsigned)i % 100); break;
+            default: bufferAppendString(buffer, word); break;
+        }
+    }
+}
+
+static void generateSmallPage(BenchmarkBuffer * buffer, uint32_t * state, size_t number)
+{
+    bufferPrintf(buffer, "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<meta charset=\"utf-8\">\n<title>Page %zu ", number);
+    appendWords(buffer, state, 4, 0);
+    bufferPrintf(buffer, "</title>\n<link rel=\"stylesheet\" href=\"/css/site.css\">\n<script type=\"text/javascript\">var page = %zu; if (page < 10 && page > 0) { track(page); }</script>\n</head>\n", number);
+    bufferAppendString(buffer, "<body class=\"page\">\n<header id=\"top\"><nav><ul class=\"menu\">\n");
+    for (unsigned i = 0; i < 8; i++) {
+        bufferPrintf(buffer, "<li class=\"menu-item%s\"><a href=\"/section/%u\">%s</a></li>\n", (i == number % 8) ? " active" : "", i, words[32 + i]);
+    }
+    bufferAppendString(buffer, "</ul></nav></header>\n<div id=\"content\">\n");
+    
+    size_t sections = 6 + nextRandom(state) % 15;
+    for (size_t i = 0; i < sections; i++) {
+        bufferPrintf(buffer, "<div class=\"section item-%zu\" data-id=\"%u\">\n<h2>", i, nextRandom(state) % 100000);
+        appendWords(buffer, state, 3 + nextRandom(state) % 5, 0);
+        bufferAppendString(buffer, "</h2>\n<p>");
+        appendWords(buffer, state, 20 + nextRandom(state) % 60, 1);
+        bufferPrintf(buffer, "</p>\n<img src=\"/img/%zu-%zu.jpg\" alt=\"%s\" width=\"320\" height=\"200\">\n", number, i, words[i % BENCHMARK_WORD_COUNT]);
+        bufferPrintf(buffer, "<p class=\"meta\"><span class=\"date\">2024-%02zu-%02zu</span> <a href=\"/article/%zu/%zu\" class=\"more\">more</a></p>\n</div>\n", 1 + i % 12, 1 + i % 28, number, i);
+    }
+    bufferAppendString(buffer, "</div>\n<form action=\"/search\" method=\"get\"><input type=\"text\" name=\"q\" value=\"\" placeholder=\"Search\">"
+                       "<select name=\"scope\"><option value=\"all\" selected>all</option><option value=\"site\">site</option></select>"
+                       "<input type=\"submit\" value=\"Go\"></form>\n<footer><p>&copy; 2024 ");
+    appendWords(buffer, state, 6, 0);
+    bufferAppendString(buffer, "</p></footer>\n</body>\n</html>\n");
+}
+
+static void generateLargeArticle(BenchmarkBuffer * buffer, uint32_t * state, size_t number)
+{
+    size_t targetLength = 512 * 1024 + nextRandom(state) % (512 * 1024);
+    bufferPrintf(buffer, "<!DOCTYPE html>\n<html>\n<head><meta charset=\"utf-8\"><title>Article %zu</title></head>\n<body>\n"
+                 "<div class=\"wrapper\"><h1 class=\"title\">", number);
+    appendWords(buffer, state, 8, 0);
+    bufferAppendString(buffer, "</h1>\n<article id=\"content\" class=\"article\">\n");
+    
+    for (size_t i = 0; buffer->length < targetLength && ! buffer->failed; i++) {
+        uint32_t block = nextRandom(state) % 20;
+        if (block == 0) {
+            bufferPrintf(buffer, "<h2 id=\"section-%zu\">", i);
+            appendWords(buffer, state, 5, 0);
+            bufferAppendString(buffer, "</h2>\n");
+        } else if (block == 1) {
+            bufferAppendString(buffer, "<blockquote><p>");
+            appendWords(buffer, state, 30, 1);
+            bufferAppendString(buffer, "</p></blockquote>\n");
+        } else if (block == 2) {
+            bufferPrintf(buffer, "<figure><img src=\"/media/%zu.png\" alt=\"figure %zu\"><figcaption>", i, i);
+            appendWords(buffer, state, 10, 0);
+            bufferAppendString(buffer, "</figcaption></figure>\n<!-- figure end -->\n");
+        } else if (block == 3) {
+            bufferAppendString(buffer, "<ul class=\"list\">");
+            for (unsigned j = 0; j < 5; j++) {
+                bufferAppendString(buffer, "<li>");
+                appendWords(buffer, state, 8, 1);
+                bufferAppendString(buffer, "</li>");
+            }
+            bufferAppendString(buffer, "</ul>\n");
+        } else {
+            bufferAppendString(buffer, "<p>");
+            appendWords(buffer, state, 40 + nextRandom(state) % 80, 1);
+            bufferAppendString(buffer, (block == 4) ? "<br>\n" : "</p>\n");
+        }
+    }
+    bufferAppendString(buffer, "</article>\n</div>\n</body>\n</html>\n");
+}
+
+static void generateHugeTable(BenchmarkBuffer * buffer, uint32_t * state, size_t number)
+{
+    size_t rows = 20000 + nextRandom(state) % 10000;
+    bufferPrintf(buffer, "<!DOCTYPE html>\n<html>\n<head><title>Table %zu</title></head>\n<body>\n<table id=\"data\" class=\"numbers\">\n"
+                 "<thead><tr><th>Item</th><th>Name</th><th>Price</th><th>Quantity</th><th>Total</th><th>Ratio</th><th>Date</th><th>Status</th></tr></thead>\n"
+                 "<tbody id=\"content\">\n", number);
+    for (size_t row = 0; row < rows && ! buffer->failed; row++) {
+        uint32_t price = nextRandom(state) % 10000000, quantity = nextRandom(state) % 5000;
+        bufferPrintf(buffer, "<tr class=\"%s\"><td><a href=\"/item/%zu\">%zu</a></td><td>%s %s</td><td>%u,%03u.%02u</td><td>%u</td>",
+                     (row % 2) ? "odd" : "even", row, row, words[32 + row % 12], words[row % 32], price / 100000, (price / 100) % 1000, price % 100, quantity);
+        if (row % 50 == 49) {
+            bufferAppendString(buffer, "<td colspan=\"2\">n/a</td>");
+        } else {
+            bufferPrintf(buffer, "<td>%llu.%02u</td><td>%u.%u%%</td>", (unsigned long long)price * quantity / 100, price % 100, quantity % 100, price % 10);
+        }
+        bufferPrintf(buffer, "<td>2024-%02zu-%02zu</td>", 1 + row % 12, 1 + row % 28);
+        if (row % 100 == 0) bufferAppendString(buffer, "<td rowspan=\"2\">review</td></tr>\n");
+        else if (row % 100 == 1) bufferAppendString(buffer, "</tr>\n");
+        else bufferAppendString(buffer, "<td>ok</td></tr>\n");
+    }
+    bufferAppendString(buffer, "</tbody>\n</table>\n</body>\n</html>\n");
+}
+
+// The nesting is deeper than the 256 levels libxml2 accepts without HTML_PARSE_HUGE, the parser must recover from both
+static void generateNestedMalformed(BenchmarkBuffer * buffer, uint32_t * state, size_t number)
+{
+    size_t depth = 1000 + nextRandom(state) % 2000;
+    bufferPrintf(buffer, "<html><head><title>Nested %zu<title></head><body><div id=\"content\">\n", number);
+    for (size_t level = 0; level < depth && ! buffer->failed; level++) {
+        const char *word = words[nextRandom(state) % BENCHMARK_WORD_COUNT];
+        switch (nextRandom(state) % 12) {
+            case 0: bufferPrintf(buffer, "<div class=level-%zu>%s\n", level, word); break;               // unquoted and unclosed
+            case 1: bufferPrintf(buffer, "<span title='%s'>%s", word, word); break;
+            case 2: bufferPrintf(buffer, "<b><i>%s</b></i>", word); break;                              // misnested
+            case 3: bufferPrintf(buffer, "<p>%s", word); break;                                         // unclosed paragraph
+            case 4: bufferPrintf(buffer, "<table><td>%s", word); break;                                 // cell without row
+            case 5: bufferPrintf(buffer, "<a href=/q?a=1&b=2&copy>%s</a>", word); break;                // bare ampersands
+            case 6: bufferPrintf(buffer, "&nosuch; &#xZZ; &#12345678; %s", word); break;               // broken entities
+            case 7: bufferPrintf(buffer, "<li>%s</td></tr>", word); break;                              // stray end tags
+            case 8: bufferPrintf(buffer, "<div class=\"a\" class=\"b\" id=x%zu id=y>%s", level, word); break; // duplicate attributes
+            case 9: bufferPrintf(buffer, "<!-- %s -- %s --><font color=red size=+1>%s", word, word, word); break;
+            case 10: bufferPrintf(buffer, "<section><article><aside>%s</section>", word); break;
+            default: bufferPrintf(buffer, "<em>%s<strong>%s</em>", word, word); break;
+        }
+    }
+    bufferAppendString(buffer, "\n<div class=\"end\">end"); // neither the open elements nor body and html are closed
+}
+
+const char * BenchmarkCorpusName(BenchmarkCorpusKind kind)
+{
+    switch (kind) {
+        case BenchmarkCorpusSmallPages: return "small-pages";
+        case BenchmarkCorpusLargeArticles: return "large-articles";
+        case BenchmarkCorpusHugeTables: return "huge-tables";
+        case BenchmarkCorpusNestedMalformed: return "nested-malformed";
+        default: return "directory";
+    }
+}
+
+int BenchmarkCorpusGenerate(BenchmarkCorpusKind kind, uint32_t seed, BenchmarkCorpus * corpus)
+{
+    static const size_t counts[BenchmarkCorpusCount] = { 300, 8, 2, 20 };
+    memset(corpus, 0, sizeof(BenchmarkCorpus));
+    corpus->kind = kind;
+    if (kind >= BenchmarkCorpusCount) return -1;
+    
+    uint32_t state = (seed) ? seed : 1;
+    for (size_t i = 0; i < counts[kind]; i++) {
+        BenchmarkBuffer buffer = { NULL, 0, 0, 0 };
+        switch (kind) {
+            case BenchmarkCorpusSmallPages: generateSmallPage(&buffer, &state, i); break;
+            case BenchmarkCorpusLargeArticles: generateLargeArticle(&buffer, &state, i); break;
+            case BenchmarkCorpusHugeTables: generateHugeTable(&buffer, &state, i); break;
+            default: generateNestedMalformed(&buffer, &state, i); break;
+        }
+        char name[BENCHMARK_NAME_SIZE];
+        snprintf(name, sizeof(name), "%s-%03zu.html", BenchmarkCorpusName(kind), i);
+        if (corpusAdd(corpus, strdup(name), &buffer) != 0) {
+            BenchmarkCorpusFree(corpus);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int compareNames(const void * name1, const void * name2)
+{
+    return strcmp(*(char * const *)name1, *(char * const *)name2);
+}
+
+int BenchmarkCorpusLoadDirectory(const char * path, BenchmarkCorpus * corpus)
+{
+    memset(corpus, 0, sizeof(BenchmarkCorpus));
+    corpus->kind = BenchmarkCorpusDirectory;
+    DIR *directory = opendir(path);
+    if (directory == NULL) return -1;
+    
+    char **names = NULL;
+    size_t count = 0;
+    int result = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) && result == 0) {
+        const char *extension = strrchr(entry->d_name, '.');
+        if (extension == NULL || (strcasecmp(extension, ".html") != 0 && strcasecmp(extension, ".htm") != 0)) continue;
+        char **grownNames = realloc(names, (count + 1) * sizeof(char *));
+        if (grownNames) names = grownNames;
+        if (grownNames == NULL || (names[count] = strdup(entry->d_name)) == NULL) result = -1;
+        else count++;
+    }
+    closedir(directory);
+    if (count) qsort(names, count, sizeof(char *), compareNames);
+    
+    for (size_t i = 0; i < count; i++) {
+        if (result == 0) {
+            char filePath[4096];
+            snprintf(filePath, sizeof(filePath), "%s/%s", path, names[i]);
+            BenchmarkBuffer buffer = { NULL, 0, 0, 0 };
+            FILE *file = fopen(filePath, "rb");
+            if (file) {
+                char chunk[65536];
+                size_t length;
+                while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) bufferAppend(&buffer, chunk, length);
+                if (ferror(file)) buffer.failed = 1;
+                fclose(file);
+            } else {
+                buffer.failed = 1;
+            }
+            if (buffer.length == 0) bufferAppend(&buffer, "", 0);
+            result = corpusAdd(corpus, names[i], &buffer);
+        } else {
+            free(names[i]);
+        }
+    }
+    free(names);
+    if (result != 0) BenchmarkCorpusFree(corpus);
+    return result;
+}
+
+int BenchmarkCorpusWrite(const BenchmarkCorpus * corpus, const char * path)
+{
+    for (size_t i = 0; i < corpus->count; i++) {
+        char filePath[4096];
+        snprintf(filePath, sizeof(filePath), "%s/%s", path, corpus->inputs[i].name);
+        FILE *file = fopen(filePath, "wb");
+        if (file == NULL) return -1;
+        size_t written = fwrite(corpus->inputs[i].bytes, 1, corpus->inputs[i].length, file);
+        if (fclose(file) != 0 || written != corpus->inputs[i].length) return -1;
+    }
+    return 0;
+}
+
+void BenchmarkCorpusFree(BenchmarkCorpus * corpus)
+{
+    for (size_t i = 0; i < corpus->count; i++) {
+        free(corpus->inputs[i].name);
+        free(corpus->inputs[i].bytes);
+    }
+    free(corpus->inputs);
+    corpus->inputs = NULL;
+    corpus->count = 0;
+    corpus->totalLength = 0;
+}
+
+#pragma mark - counters
+
+// The runners are single threaded, the counters of the libxml2 allocations are plain globals
+static uint64_t xmlAllocationCount = 0;
+static size_t xmlBytesInUse = 0;
+static size_t xmlPeakBytes = 0;
+
+static inline size_t allocationSize(void * pointer)
+{
+#ifdef __APPLE__
+    return malloc_size(pointer);
+#else
+    return malloc_usable_size(pointer);
+#endif
+}
+
+static inline void countAllocation(void * pointer)
+{
+    xmlAllocationCount++;
+    xmlBytesInUse += allocationSize(pointer);
+    if (xmlBytesInUse > xmlPeakBytes) xmlPeakBytes = xmlBytesInUse;
+}
+
+static void * countingMalloc(size_t size)
+{
+    void *pointer = malloc(size);
+    if (pointer) countAllocation(pointer);
+    return pointer;
+}
+
+static void * countingRealloc(void * pointer, size_t size)
+{
+    size_t previousSize = (pointer) ? allocationSize(pointer) : 0;
+    void *newPointer = realloc(pointer, size);
+    if (newPointer) {
+        xmlBytesInUse -= previousSize;
+        countAllocation(newPointer);
+    }
+    return newPointer;
+}
+
+static void countingFree(void * pointer)
+{
+    if (pointer == NULL) return;
+    xmlBytesInUse -= allocationSize(pointer);
+    free(pointer);
+}
+
+static char * countingStrdup(const char * string)
+{
+    size_t length = strlen(string) + 1;
+    char *copy = countingMalloc(length);
+    if (copy) memcpy(copy, string, length);
+    return copy;
+}
+
+int BenchmarkInstallAllocationCounters(void)
+{
+    return (xmlMemSetup(countingFree, countingMalloc, countingRealloc, countingStrdup) == 0) ? 0 : -1;
+}
+
+// The blocks and bytes in use by all malloc zones, the values are only compared with each other
+static void heapStatistics(int64_t * blocks, int64_t * bytes)
+{
+#if defined(__APPLE__)
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+    *blocks = (int64_t)statistics.blocks_in_use;
+    *bytes = (int64_t)statistics.size_in_use;
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    *blocks = 0;
+    *bytes = (int64_t)(info.uordblks + info.hblkhd);
+#else
+    *blocks = 0;
+    *bytes = 0;
+#endif
+}
+
+uint64_t BenchmarkNow(void)
+{
+#ifdef __APPLE__
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ULL + (uint64_t)time.tv_nsec;
+#endif
+}
+
+uint64_t BenchmarkPeakResidentMemory(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;        // bytes
+#else
+    return (uint64_t)usage.ru_maxrss * 1024; // kilobytes
+#endif
+}
+
+#pragma mark - sampler
+
+void BenchmarkSamplerBegin(BenchmarkSampler * sampler)
+{
+    heapStatistics(&sampler->startHeapBlocks, &sampler->startHeapBytes);
+    sampler->startXMLAllocations = xmlAllocationCount;
+    sampler->startXMLBytes = xmlBytesInUse;
+    xmlPeakBytes = xmlBytesInUse;
+    sampler->startTime = BenchmarkNow();
+}
+
+void BenchmarkSamplerEnd(BenchmarkSampler * sampler, size_t bytes)
+{
+    uint64_t duration = BenchmarkNow() - sampler->startTime;
+    int64_t heapBlocks, heapBytes;
+    heapStatistics(&heapBlocks, &heapBytes);
+    
+    if (sampler->count == sampler->capacity) {
+        size_t capacity = (sampler->capacity) ? sampler->capacity * 2 : 256;
+        uint64_t *samples = realloc(sampler->samples, capacity * sizeof(uint64_t));
+        if (samples == NULL) return; // the sample is dropped
+        sampler->samples = samples;
+        sampler->capacity = capacity;
+    }
+    sampler->samples[sampler->count++] = duration;
+    sampler->bytes += bytes;
+    sampler->xmlAllocations += xmlAllocationCount - sampler->startXMLAllocations;
+    sampler->heapBlocks += heapBlocks - sampler->startHeapBlocks;
+    sampler->heapBytes += heapBytes - sampler->startHeapBytes;
+    if (xmlPeakBytes - sampler->startXMLBytes > sampler->peakXMLBytes) sampler->peakXMLBytes = xmlPeakBytes - sampler->startXMLBytes;
+}
+
+void BenchmarkSamplerReset(BenchmarkSampler * sampler)
+{
+    free(sampler->samples);
+    memset(sampler, 0, sizeof(BenchmarkSampler));
+}
+
+#pragma mark - reports
+
+static int compareSamples(const void * sample1, const void * sample2)
+{
+    uint64_t value1 = *(const uint64_t *)sample1, value2 = *(const uint64_t *)sample2;
+    return (value1 > value2) - (value1 < value2);
+}
+
+// The nearest rank percentile of sorted samples in microseconds
+static double percentile(const uint64_t * samples, size_t count, double fraction)
+{
+    if (count == 0) return 0.0;
+    size_t rank = (size_t)(fraction * (double)(count - 1) + 0.5);
+    return (double)samples[(rank < count) ? rank : count - 1] / 1000.0;
+}
+
+void BenchmarkPrintHeader(FILE * table)
+{
+    fprintf(table, "%-18s %-28s %7s %9s %10s %10s %10s %10s %10s %10s %11s %10s\n", "corpus", "benchmark", "calls", "MB/s",
+            "p50 us", "p90 us", "p99 us", "max us", "allocs", "KB", "xml allocs", "peak KB");
+}
+
+void BenchmarkReport(FILE * table, FILE * report, const char * implementation, const char * corpus, const char * benchmark, BenchmarkSampler * sampler)
+{
+    double values[BENCHMARK_REPORT_COLUMNS] = { 0 };
+    size_t count = sampler->count;
+    if (count) {
+        qsort(sampler->samples, count, sizeof(uint64_t), compareSamples);
+        uint64_t totalTime = 0;
+        for (size_t i = 0; i < count; i++) totalTime += sampler->samples[i];
+        values[0] = (double)count;
+        values[1] = (sampler->bytes && totalTime) ? (double)sampler->bytes / 1e6 / ((double)totalTime / 1e9) : 0.0;
+        values[2] = percentile(sampler->samples, count, 0.50);
+        values[3] = percentile(sampler->samples, count, 0.90);
+        values[4] = percentile(sampler->samples, count, 0.99);
+        values[5] = (double)sampler->samples[count - 1] / 1000.0;
+        values[6] = (double)sampler->heapBlocks / (double)count;
+        values[7] = (double)sampler->heapBytes / 1024.0 / (double)count;
+        values[8] = (double)sampler->xmlAllocations / (double)count;
+        values[9] = (double)sampler->peakXMLBytes / 1024.0;
+    }
+    fprintf(table, "%-18s %-28s %7.0f %9.2f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %11.1f %10.1f\n", corpus, benchmark,
+            values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7], values[8], values[9]);
+    if (report) {
+        fprintf(report, "%s\t%s\t%s", implementation, corpus, benchmark);
+        for (size_t i = 0; i < BENCHMARK_REPORT_COLUMNS; i++) fprintf(report, "\t%.3f", values[i]);
+        fputc('\n', report);
+    }
+    BenchmarkSamplerReset(sampler);
+}
+
+static int readReport(const char * path, char * implementation, BenchmarkReportLine ** lines, size_t * count)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return -1;
+    
+    char line[1024];
+    int result = 0;
+    *lines = NULL;
+    *count = 0;
+    implementation[0] = '\0';
+    while (result == 0 && fgets(line, sizeof(line), file)) {
+        char *fields[3 + BENCHMARK_REPORT_COLUMNS];
+        size_t numberOfFields = 0;
+        char *cursor = line;
+        line[strcspn(line, "\r\n")] = '\0';
+        while (numberOfFields < 3 + BENCHMARK_REPORT_COLUMNS) {
+            fields[numberOfFields++] = cursor;
+            cursor = strchr(cursor, '\t');
+            if (cursor == NULL) break;
+            *cursor++ = '\0';
+        }
+        if (numberOfFields != 3 + BENCHMARK_REPORT_COLUMNS) continue; // not a report line
+        
+        BenchmarkReportLine *grownLines = realloc(*lines, (*count + 1) * sizeof(BenchmarkReportLine));
+        if (grownLines == NULL) {
+            result = -1;
+            break;
+        }
+        *lines = grownLines;
+        BenchmarkReportLine *reportLine = &grownLines[(*count)++];
+        snprintf(implementation, BENCHMARK_NAME_SIZE, "%s", fields[0]);
+        snprintf(reportLine->corpus, sizeof(reportLine->corpus), "%s", fields[1]);
+        snprintf(reportLine->benchmark, sizeof(reportLine->benchmark), "%s", fields[2]);
+        for (size_t i = 0; i < BENCHMARK_REPORT_COLUMNS; i++) reportLine->values[i] = strtod(fields[3 + i], NULL);
+    }
+    fclose(file);
+    if (result != 0) {
+        free(*lines);
+        *lines = NULL;
+        *count = 0;
+    }
+    return result;
+}
+
+int BenchmarkCompareReports(const char * path1, const char * path2, FILE * table)
+{
+    char implementation1[BENCHMARK_NAME_SIZE], implementation2[BENCHMARK_NAME_SIZE];
+    BenchmarkReportLine *lines1 = NULL, *lines2 = NULL;
+    size_t count1 = 0, count2 = 0;
+    if (readReport(path1, implementation1, &lines1, &count1) != 0) return -1;
+    if (readReport(path2, implementation2, &lines2, &count2) != 0) {
+        free(lines1);
+        return -1;
+    }
+    
+    char p50Header1[BENCHMARK_NAME_SIZE + 8], p50Header2[BENCHMARK_NAME_SIZE + 8];
+    snprintf(p50Header1, sizeof(p50Header1), "%s p50 us", implementation1);
+    snprintf(p50Header2, sizeof(p50Header2), "%s p50 us", implementation2);
+    fprintf(table, "%-18s %-28s %14s %14s %7s %9s %9s %10s %10s\n", "corpus", "benchmark", p50Header1, p50Header2, "ratio",
+            "MB/s 1", "MB/s 2", "allocs 1", "allocs 2");
+    for (size_t i = 0; i < count1; i++) {
+        const BenchmarkReportLine *line1 = &lines1[i], *line2 = NULL;
+        for (size_t j = 0; j < count2 && line2 == NULL; j++) {
+            if (strcmp(line1->corpus, lines2[j].corpus) == 0 && strcmp(line1->benchmark, lines2[j].benchmark) == 0) line2 = &lines2[j];
+        }
+        if (line2 == NULL) continue;
+        double ratio = (line1->values[2] > 0.0) ? line2->values[2] / line1->values[2] : 0.0;
+        fprintf(table, "%-18s %-28s %14.1f %14.1f %7.2f %9.2f %9.2f %10.1f %10.1f\n", line1->corpus, line1->benchmark,
+                line1->values[2], line2->values[2], ratio, line1->values[1], line2->values[1], line1->values[6], line2->values[6]);
+    }
+    free(lines1);
+    free(lines2);
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*###################################################################################
+#                                                                                   #
+#     BenchmarkSupport.h                                                            #
+#     Corpora, counters and reports of the benchmark runners                        #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #include BenchmarkSupport.h                                    #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+// The plain C part shared by the Objective-C and the Swift runner, so both measure the same inputs in the same way.
+// The corpora are generated deterministically, the same seed always yields the same bytes. The libxml2 allocations are
+// counted by wrapper functions installed with xmlMemSetup(), the runners must not use arenas which install their own functions.
+// The results are printed as a table and optionally written as tab separated report lines which can be compared afterwards
+
+#ifndef BENCHMARK_SUPPORT_H
+#define BENCHMARK_SUPPORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    BenchmarkCorpusSmallPages,       // a few hundred pages of 5 to 20 KB with navigation, sections and forms
+    BenchmarkCorpusLargeArticles,    // article pages of 0.5 to 1 MB with long paragraphs and inline markup
+    BenchmarkCorpusHugeTables,       // tables with tens of thousands of rows of numbers and spanned cells
+    BenchmarkCorpusNestedMalformed,  // deeply nested, misnested and unclosed elements, broken attributes and entities
+    BenchmarkCorpusDirectory,        // the .html files of a directory, e.g. saved real-world pages
+    BenchmarkCorpusCount = BenchmarkCorpusDirectory
+} BenchmarkCorpusKind;
+
+typedef struct {
+    char * name;
+    char * bytes;
+    size_t length;
+} BenchmarkInput;
+
+typedef struct {
+    BenchmarkCorpusKind kind;
+    BenchmarkInput * inputs;
+    size_t count;
+    size_t totalLength;
+} BenchmarkCorpus;
+
+// The measurement of one benchmark, the samples are the durations of the single calls in nanoseconds
+typedef struct {
+    uint64_t * samples;
+    size_t count;
+    size_t capacity;
+    uint64_t bytes;                 // the processed input bytes for the throughput of parse benchmarks
+    uint64_t xmlAllocations;        // the libxml2 allocations of all calls
+    int64_t heapBlocks;             // the heap blocks still allocated at the end of the calls, e.g. result arrays and wrappers
+    int64_t heapBytes;
+    size_t peakXMLBytes;            // the highest libxml2 memory in use during a call, e.g. the tree and the parser context
+    uint64_t startTime;
+    uint64_t startXMLAllocations;
+    int64_t startHeapBlocks;
+    int64_t startHeapBytes;
+    size_t startXMLBytes;
+} BenchmarkSampler;
+
+/*! Returns the name of a corpus used in the reports */
+const char * BenchmarkCorpusName(BenchmarkCorpusKind kind);
+
+/*! Generates a corpus
+ * \param kind The kind of the corpus, not BenchmarkCorpusDirectory
+ * \param seed The seed of the generator, the same seed yields the same corpus
+ * \param corpus The corpus to fill, release it with BenchmarkCorpusFree
+ * \returns 0 on success or -1 if memory could not be allocated
+ */
+int BenchmarkCorpusGenerate(BenchmarkCorpusKind kind, uint32_t seed, BenchmarkCorpus * corpus);
+
+/*! Loads the .html and .htm files of a directory in the order of their names
+ * \param path The path of the directory
+ * \param corpus The corpus to fill, release it with BenchmarkCorpusFree
+ * \returns 0 on success or -1 if the directory or a file could not be read
+ */
+int BenchmarkCorpusLoadDirectory(const char * path, BenchmarkCorpus * corpus);
+
+/*! Writes the inputs of a corpus as files into an existing directory
+ * \returns 0 on success or -1 if a file could not be written
+ */
+int BenchmarkCorpusWrite(const BenchmarkCorpus * corpus, const char * path);
+
+/*! Releases the inputs of a corpus */
+void BenchmarkCorpusFree(BenchmarkCorpus * corpus);
+
+/*! Installs the counting allocation functions in libxml2, it must be called before libxml2 is used
+ * \returns 0 on success or -1 if libxml2 refused the functions
+ */
+int BenchmarkInstallAllocationCounters(void);
+
+/*! Returns the monotonic time in nanoseconds */
+uint64_t BenchmarkNow(void);
+
+/*! Returns the peak resident memory of the process in bytes */
+uint64_t BenchmarkPeakResidentMemory(void);
+
+/*! Starts a call of a benchmark, the counters are read after the time is taken */
+void BenchmarkSamplerBegin(BenchmarkSampler * sampler);
+
+/*! Ends a call of a benchmark started by BenchmarkSamplerBegin
+ * \param bytes The input bytes processed by the call, 0 for queries
+ */
+void BenchmarkSamplerEnd(BenchmarkSampler * sampler, size_t bytes);
+
+/*! Releases the samples and resets the sampler for the next benchmark */
+void BenchmarkSamplerReset(BenchmarkSampler * sampler);
+
+/*! Prints the header of the result table */
+void BenchmarkPrintHeader(FILE * table);
+
+/*! Prints the result of a benchmark as table row and optionally as report line and resets the sampler
+ * \param table The stream of the table, e.g. stdout
+ * \param report The stream of the report lines or NULL
+ * \param implementation The name of the implementation, "objc" or "swift"
+ * \param corpus The name of the corpus
+ * \param benchmark The name of the benchmark, "parse" for the parse benchmark
+ */
+void BenchmarkReport(FILE * table, FILE * report, const char * implementation, const char * corpus, const char * benchmark, BenchmarkSampler * sampler);
+
+/*! Prints the results of two report files side by side, the ratio is the median latency of the second divided by the first
+ * \returns 0 on success or -1 if a report could not be read
+ */
+int BenchmarkCompareReports(const char * path1, const char * path2, FILE * table);
+
+#endif
@@ -0,0 +1,210 @@
+/*###################################################################################
+#                                                                                   #
+#     main.m                                                                        #
+#     Benchmark runner of the Objective-C version                                   #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     see Benchmarks in README                                           #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+#import <Foundation/Foundation.h>
+#import "HTMLDocument.h"
+#import "HTMLNode+XPath.h"
+#import "HTMLNode+CSS.h"
+#include "BenchmarkSupport.h"
+
+// The runner parses each input of the corpora and runs the queries on each parsed document, every call is one sample.
+// The first call of each input is a warm-up and not measured. The results of the queries are counted into a global
+// so the calls can't be optimized away. The Swift runner performs the same benchmarks in the same order
+
+typedef NSUInteger (^BenchmarkQueryBlock)(HTMLNode *body, HTMLNode *container, NSString *childTag);
+
+typedef struct {
+    unsigned long iterations;
+    uint32_t seed;
+    const char *corpusDirectory;
+    const char *writeDirectory;
+    const char *reportPath;
+    const char *onlyCorpus;
+} BenchmarkOptions;
+
+static volatile NSUInteger resultSink = 0;
+
+static NSData * dataOfInput(const BenchmarkInput * input)
+{
+    return [NSData dataWithBytesNoCopy:input->bytes length:input->length freeWhenDone:NO];
+}
+
+static void benchmarkParse(const BenchmarkCorpus * corpus, const BenchmarkOptions * options, FILE * report)
+{
+    BenchmarkSampler sampler = { 0 };
+    for (unsigned long pass = 0; pass <= options->iterations; pass++) {
+        for (size_t i = 0; i < corpus->count; i++) {
+            @autoreleasepool {
+                NSData *data = dataOfInput(&corpus->inputs[i]);
+                if (pass) BenchmarkSamplerBegin(&sampler);
+                HTMLDocument *document = [HTMLDocument documentWithData:data error:NULL];
+                if (pass) BenchmarkSamplerEnd(&sampler, corpus->inputs[i].length);
+                resultSink += (document != nil);
+            }
+        }
+    }
+    BenchmarkReport(stdout, report, "objc", BenchmarkCorpusName(corpus->kind), "parse", &sampler);
+}
+
+static void benchmarkQueries(const BenchmarkCorpus * corpus, const BenchmarkOptions * options, FILE * report)
+{
+    HTMLXPathQuery *xpathQuery = [HTMLXPathQuery queryWithString:@"//p | //td" error:NULL];
+    HTMLSelector *selector = [HTMLSelector selectorWithString:@"a[href]" error:NULL];
+    NSArray *names = @[@"childrenOfTag", @"textContentOfChildren", @"descendantsOfTag a", @"descendantsWithAttribute href",
+                       @"xpath //a[@href]", @"xpath compiled //p|//td", @"css a[href]", @"textContent body"];
+    NSArray<BenchmarkQueryBlock> *queries = @[
+        ^NSUInteger(HTMLNode *body, HTMLNode *container, NSString *childTag) { return [container childrenOfTag:childTag].count; },
+        ^NSUInteger(HTMLNode *body, HTMLNode *container, NSString *childTag) { return container.textContentOfChildren.count; },
+        ^NSUInteger(HTMLNode *body, HTMLNode *container, NSString *childTag) { return [body descendantsOfTag:@"a"].count; },
+        ^NSUInteger(HTMLNode *body, HTMLNode *container, NSString *childTag) { return [body descendantsWithAttribute:@"href"].count; },
+        ^NSUInteger(HTMLNode *body, HTMLNode *container, NSString *childTag) { return [body nodesForXPath:@"//a[@href]" error:NULL].count; },
+        ^NSUInteger(HTMLNode *body, HTMLNode *container, NSString *childTag) { return [body nodesForXPathQuery:xpathQuery error:NULL].count; },
+        ^NSUInteger(HTMLNode *body, HTMLNode *container, NSString *childTag) { return [body nodesMatchingSelector:selector].count; },
+        ^NSUInteger(HTMLNode *body, HTMLNode *container, NSString *childTag) { return body.textContent.length; }
+    ];
+    
+    BenchmarkSampler *samplers = calloc(queries.count, sizeof(BenchmarkSampler));
+    if (samplers == NULL) return;
+    for (size_t i = 0; i < corpus->count; i++) {
+        @autoreleasepool {
+            HTMLDocument *document = [HTMLDocument documentWithData:dataOfInput(&corpus->inputs[i]) error:NULL];
+            HTMLNode *body = document.body ?: document.rootNode;
+            if (body == nil) continue;
+            // the queries on the children run on the element whose children repeat, the content element of the generated pages
+            HTMLNode *container = [body descendantWithID:@"content"] ?: body;
+            NSString *childTag = @"div";
+            for (HTMLNode *child in container.children) {
+                if (child.isElementNode && child.tagName) {
+                    childTag = child.tagName;
+                    break;
+                }
+            }
+            
+            for (NSUInteger query = 0; query < queries.count; query++) {
+                BenchmarkQueryBlock block = queries[query];
+                for (unsigned long pass = 0; pass <= options->iterations; pass++) {
+                    @autoreleasepool {
+                        if (pass) BenchmarkSamplerBegin(&samplers[query]);
+                        NSUInteger count = block(body, container, childTag);
+                        if (pass) BenchmarkSamplerEnd(&samplers[query], 0);
+                        resultSink += count;
+                    }
+                }
+            }
+        }
+    }
+    for (NSUInteger query = 0; query < queries.count; query++) {
+        BenchmarkReport(stdout, report, "objc", BenchmarkCorpusName(corpus->kind), [names[query] UTF8String], &samplers[query]);
+    }
+    free(samplers);
+}
+
+static void benchmarkCorpus(BenchmarkCorpus * corpus, const BenchmarkOptions * options, FILE * report)
+{
+    const char *name = BenchmarkCorpusName(corpus->kind);
+    if (options->onlyCorpus && strcmp(options->onlyCorpus, name) != 0) return;
+    if (options->writeDirectory && BenchmarkCorpusWrite(corpus, options->writeDirectory) != 0) {
+        fprintf(stderr, "could not write the corpus %s to %s\n", name, options->writeDirectory);
+    }
+    fprintf(stdout, "# %s: %zu inputs, %.2f MB\n", name, corpus->count, (double)corpus->totalLength / 1e6);
+    benchmarkParse(corpus, options, report);
+    benchmarkQueries(corpus, options, report);
+}
+
+static void printUsage(const char * program)
+{
+    fprintf(stderr, "usage: %s [--iterations n] [--seed n] [--only corpus] [--corpus directory] [--write-corpus directory] [--report file]\n"
+                    "       %s --compare report1 report2\n", program, program);
+}
+
+int main(int argc, const char * argv[])
+{
+    BenchmarkOptions options = { 10, 0x9E3779B9u, NULL, NULL, NULL, NULL };
+    for (int i = 1; i < argc; i++) {
+        const char *argument = argv[i], *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(argument, "--compare") == 0 && i + 2 < argc) {
+            return (BenchmarkCompareReports(argv[i + 1], argv[i + 2], stdout) == 0) ? 0 : 1;
+        } else if (value && strcmp(argument, "--iterations") == 0) {
+            options.iterations = strtoul(value, NULL, 10);
+        } else if (value && strcmp(argument, "--seed") == 0) {
+            options.seed = (uint32_t)strtoul(value, NULL, 0);
+        } else if (value && strcmp(argument, "--only") == 0) {
+            options.onlyCorpus = value;
+        } else if (value && strcmp(argument, "--corpus") == 0) {
+            options.corpusDirectory = value;
+        } else if (value && strcmp(argument, "--write-corpus") == 0) {
+            options.writeDirectory = value;
+        } else if (value && strcmp(argument, "--report") == 0) {
+            options.reportPath = value;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (options.iterations == 0) options.iterations = 1;
+    
+    // the counters must be installed before libxml2 allocates anything
+    if (BenchmarkInstallAllocationCounters() != 0) {
+        fprintf(stderr, "could not install the allocation counters\n");
+        return 1;
+    }
+    FILE *report = (options.reportPath) ? fopen(options.reportPath, "w") : NULL;
+    if (options.reportPath && report == NULL) {
+        fprintf(stderr, "could not open the report %s\n", options.reportPath);
+        return 1;
+    }
+    
+    BenchmarkPrintHeader(stdout);
+    for (unsigned kind = 0; kind < BenchmarkCorpusCount; kind++) {
+        BenchmarkCorpus corpus;
+        if (BenchmarkCorpusGenerate((BenchmarkCorpusKind)kind, options.seed, &corpus) != 0) {
+            fprintf(stderr, "could not generate the corpus %s\n", BenchmarkCorpusName((BenchmarkCorpusKind)kind));
+            continue;
+        }
+        benchmarkCorpus(&corpus, &options, report);
+        BenchmarkCorpusFree(&corpus);
+    }
+    if (options.corpusDirectory) {
+        BenchmarkCorpus corpus;
+        if (BenchmarkCorpusLoadDirectory(options.corpusDirectory, &corpus) == 0) {
+            benchmarkCorpus(&corpus, &options, report);
+            BenchmarkCorpusFree(&corpus);
+        } else {
+            fprintf(stderr, "could not read the corpus directory %s\n", options.corpusDirectory);
+        }
+    }
+    fprintf(stdout, "# peak resident memory: %.1f MB\n", (double)BenchmarkPeakResidentMemory() / 1e6);
+    if (report) fclose(report);
+    return 0;
+}
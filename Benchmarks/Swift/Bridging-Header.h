@@ -0,0 +1,13 @@
+//
+//  The bridging header of the Swift benchmark runner, the libxml2 headers of the Swift version and the shared C part.
+//
+
+#import <libxml/HTMLtree.h>
+#import <libxml/HTMLparser.h>
+#import <libxml/parserInternals.h>
+#import <libxml/xmlreader.h>
+#import <libxml/xpath.h>
+#import <libxml/xpathInternals.h>
+#import <libxml/xmlerror.h>
+#import "../../Swift/HTMLAtomics.h"
+#import "../BenchmarkSupport.h"
@@ -0,0 +1,191 @@
+/*###################################################################################
+ #                                                                                   #
+ #    main.swift - Benchmark runner of the Swift version                             #
+ #                                                                                   #
+ #    Copyright © 2014-2017 by Stefan Klieme                                         #
+ #                                                                                   #
+ #    Swift wrapper for HTML parser of libxml2                                       #
+ #                                                                                   #
+ #    Version 1.1 - 13. Sep 2017                                                     #
+ #                                                                                   #
+ #    usage:     see Benchmarks in README                                            #
+ #                                                                                   #
+ #####################################################################################
+ #                                                                                   #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+ # this software and associated documentation files (the "Software"), to deal        #
+ # in the Software without restriction, including without limitation the rights      #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+ # of the Software, and to permit persons to whom the Software is furnished to do    #
+ # so, subject to the following conditions:                                          #
+ # The above copyright notice and this permission notice shall be included in        #
+ # all copies or substantial portions of the Software.                               #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+ #                                                                                   #
+ ###################################################################################*/
+
+import Foundation
+
+// The runner parses each input of the corpora and runs the queries on each parsed document, every call is one sample.
+// The first call of each input is a warm-up and not measured. The results of the queries are counted into a global
+// so the calls can't be optimized away. The Objective-C runner performs the same benchmarks in the same order
+
+struct BenchmarkOptions {
+    var iterations = 10
+    var seed : UInt32 = 0x9E3779B9
+    var corpusDirectory : String?
+    var writeDirectory : String?
+    var reportPath : String?
+    var onlyCorpus : String?
+}
+
+typealias BenchmarkQuery = (_ body: HTMLNode, _ container: HTMLNode, _ childTag: String) throws -> Int
+
+var resultSink = 0
+
+func dataOfInput(_ input: BenchmarkInput) -> Data {
+    return Data(bytesNoCopy: UnsafeMutableRawPointer(input.bytes), count: input.length, deallocator: .none)
+}
+
+func benchmarkParse(_ corpus: BenchmarkCorpus, options: BenchmarkOptions, report: UnsafeMutablePointer<FILE>?) {
+    var sampler = BenchmarkSampler()
+    for pass in 0...options.iterations {
+        for i in 0..<corpus.count {
+            autoreleasepool {
+                let data = dataOfInput(corpus.inputs[i])
+                if pass > 0 { BenchmarkSamplerBegin(&sampler) }
+                let document = try? HTMLDocument(data: data)
+                if pass > 0 { BenchmarkSamplerEnd(&sampler, corpus.inputs[i].length) }
+                resultSink += (document != nil) ? 1 : 0
+            }
+        }
+    }
+    BenchmarkReport(stdout, report, "swift", BenchmarkCorpusName(corpus.kind), "parse", &sampler)
+}
+
+func benchmarkQueries(_ corpus: BenchmarkCorpus, options: BenchmarkOptions, report: UnsafeMutablePointer<FILE>?) throws {
+    let xpathQuery = try HTMLXPathQuery("//p | //td")
+    let selector = try HTMLSelector("a[href]")
+    let queries : [(String, BenchmarkQuery)] = [
+        ("childrenOfTag", { body, container, childTag in container.children(ofTag: childTag).count }),
+        ("textContentOfChildren", { body, container, childTag in container.textContentOfChildren.count }),
+        ("descendantsOfTag a", { body, container, childTag in body.descendants(ofTag: "a").count }),
+        ("descendantsWithAttribute href", { body, container, childTag in body.descendants(withAttribute: "href").count }),
+        ("xpath //a[@href]", { body, container, childTag in try body.nodes(forXPath: "//a[@href]").count }),
+        ("xpath compiled //p|//td", { body, container, childTag in try body.nodes(forXPath: xpathQuery).count }),
+        ("css a[href]", { body, container, childTag in body.nodes(matching: selector).reduce(0) { count, _ in count + 1 } }),
+        ("textContent body", { body, container, childTag in body.textContent?.utf16.count ?? 0 })
+    ]
+    
+    var samplers = [BenchmarkSampler](repeating: BenchmarkSampler(), count: queries.count)
+    for i in 0..<corpus.count {
+        try autoreleasepool {
+            guard let document = try? HTMLDocument(data: dataOfInput(corpus.inputs[i])) else { return }
+            let body = document.body ?? document.rootNode
+            // the queries on the children run on the element whose children repeat, the content element of the generated pages
+            let container = body.descendant(withID: "content") ?? body
+            let childTag = container.children.first(where: { $0.isElementNode && $0.tagName != nil })?.tagName ?? "div"
+            
+            for (index, query) in queries.enumerated() {
+                for pass in 0...options.iterations {
+                    try autoreleasepool {
+                        if pass > 0 { BenchmarkSamplerBegin(&samplers[index]) }
+                        let count = try query.1(body, container, childTag)
+                        if pass > 0 { BenchmarkSamplerEnd(&samplers[index], 0) }
+                        resultSink += count
+                    }
+                }
+            }
+        }
+    }
+    for (index, query) in queries.enumerated() {
+        BenchmarkReport(stdout, report, "swift", BenchmarkCorpusName(corpus.kind), query.0, &samplers[index])
+    }
+}
+
+func benchmarkCorpus(_ corpus: BenchmarkCorpus, options: BenchmarkOptions, report: UnsafeMutablePointer<FILE>?) {
+    let name = String(cString: BenchmarkCorpusName(corpus.kind))
+    if let onlyCorpus = options.onlyCorpus, onlyCorpus != name { return }
+    if let writeDirectory = options.writeDirectory, withUnsafePointer(to: corpus, { BenchmarkCorpusWrite($0, writeDirectory) }) != 0 {
+        fputs("could not write the corpus \(name) to \(writeDirectory)\n", stderr)
+    }
+    print("# \(name): \(corpus.count) inputs, \(String(format: "%.2f", Double(corpus.totalLength) / 1e6)) MB")
+    fflush(stdout)
+    benchmarkParse(corpus, options: options, report: report)
+    do {
+        try benchmarkQueries(corpus, options: options, report: report)
+    } catch {
+        fputs("the queries failed: \(error)\n", stderr)
+    }
+}
+
+func printUsage(_ program: String) {
+    fputs("usage: \(program) [--iterations n] [--seed n] [--only corpus] [--corpus directory] [--write-corpus directory] [--report file]\n"
+        + "       \(program) --compare report1 report2\n", stderr)
+}
+
+var options = BenchmarkOptions()
+let arguments = CommandLine.arguments
+var argumentIndex = 1
+while argumentIndex < arguments.count {
+    let argument = arguments[argumentIndex]
+    let value = (argumentIndex + 1 < arguments.count) ? arguments[argumentIndex + 1] : nil
+    switch (argument, value) {
+    case ("--compare", _) where argumentIndex + 2 < arguments.count:
+        exit(BenchmarkCompareReports(arguments[argumentIndex + 1], arguments[argumentIndex + 2], stdout) == 0 ? 0 : 1)
+    case ("--iterations", let value?) where Int(value) != nil:
+        options.iterations = max(1, Int(value)!)
+    case ("--seed", let value?) where UInt32(value) != nil:
+        options.seed = UInt32(value)!
+    case ("--only", let value?):
+        options.onlyCorpus = value
+    case ("--corpus", let value?):
+        options.corpusDirectory = value
+    case ("--write-corpus", let value?):
+        options.writeDirectory = value
+    case ("--report", let value?):
+        options.reportPath = value
+    default:
+        printUsage(arguments[0])
+        exit(1)
+    }
+    argumentIndex += 2
+}
+
+// the counters must be installed before libxml2 allocates anything
+guard BenchmarkInstallAllocationCounters() == 0 else {
+    fputs("could not install the allocation counters\n", stderr)
+    exit(1)
+}
+let report = options.reportPath.flatMap { fopen($0, "w") }
+if let reportPath = options.reportPath, report == nil {
+    fputs("could not open the report \(reportPath)\n", stderr)
+    exit(1)
+}
+
+BenchmarkPrintHeader(stdout)
+for kind in 0..<BenchmarkCorpusCount.rawValue {
+    var corpus = BenchmarkCorpus()
+    guard BenchmarkCorpusGenerate(BenchmarkCorpusKind(rawValue: kind), options.seed, &corpus) == 0 else {
+        fputs("could not generate the corpus \(String(cString: BenchmarkCorpusName(BenchmarkCorpusKind(rawValue: kind))))\n", stderr)
+        continue
+    }
+    benchmarkCorpus(corpus, options: options, report: report)
+    BenchmarkCorpusFree(&corpus)
+}
+if let corpusDirectory = options.corpusDirectory {
+    var corpus = BenchmarkCorpus()
+    if BenchmarkCorpusLoadDirectory(corpusDirectory, &corpus) == 0 {
+        benchmarkCorpus(corpus, options: options, report: report)
+        BenchmarkCorpusFree(&corpus)
+    } else {
+        fputs("could not read the corpus directory \(corpusDirectory)\n", stderr)
+    }
+}
+print(String(format: "# peak resident memory: %.1f MB", Double(BenchmarkPeakResidentMemory()) / 1e6))
+if let report = report { fclose(report) }
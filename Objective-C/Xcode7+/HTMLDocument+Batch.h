@@ -0,0 +1,90 @@
+/*###################################################################################
+#                                                                                   #
+#     HTMLDocument+Batch.h                                                          #
+#     Category of HTMLDocument for parallel batch parsing                           #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #import HTMLDocument+Batch.h                                   #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+#import "HTMLParser.h"
+
+// The batch methods parse a collection of HTML data objects in parallel and pass each document to an extraction block.
+// A bounded number of workers pulls the next unprocessed data object from a shared counter, so slow documents don't stall
+// the other workers. Each worker reuses one HTMLParser (one libxml2 parser context and name dictionary) for all its documents,
+// and each document is freed when its extraction block returns unless the result retains nodes of it.
+// The libxml2 parser is initialized before the first worker starts. The error reports of the parser are suppressed by the default
+// parse options, the XPath and CSS queries of the extraction block report their errors per query and don't interfere between threads.
+
+/*! The block called on a worker thread for each parsed document
+ * \param document The parsed document, it's freed after the block returns. Nodes in the result keep their document alive
+ * \param index The index of the data object in the batch
+ * \returns The extracted result, or nil
+ */
+typedef id _Nullable (^HTMLDocumentExtractionBlock)(HTMLDocument * _Nonnull document, NSUInteger index);
+
+/*! The block called for the result of each data object of the batch
+ * \param index The index of the data object in the batch
+ * \param result The result of the extraction block, nil if the block returned nil or the data could not be parsed
+ * \param error The error of the parser if the data could not be parsed, otherwise nil
+ */
+typedef void (^HTMLDocumentBatchResultBlock)(NSUInteger index, id _Nullable result, NSError * _Nullable error);
+
+@interface HTMLDocument (Batch)
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Parses the data objects in parallel with the default parse options and returns the extracted results in the order of the batch
+ * \param dataBatch An array of data objects with HTML content in UTF-8 encoding
+ * \param extractionBlock The block called for each parsed document
+ * \returns An array with the result for each data object, NSNull for data that could not be parsed or nil results
+ */
++ (NSArray *)resultsForDataBatch:(NSArray<NSData *> *)dataBatch extractionBlock:(HTMLDocumentExtractionBlock)extractionBlock;
+
+/*! Parses the data objects in parallel and returns the extracted results in the order of the batch
+ * \param dataBatch An array of data objects with HTML content
+ * \param encoding The string encoding for the HTML content
+ * \param options The options passed to the libxml2 parser
+ * \param maximumConcurrency The maximum number of workers, 0 uses the number of active processors
+ * \param extractionBlock The block called for each parsed document
+ * \returns An array with the result for each data object, NSNull for data that could not be parsed or nil results
+ */
++ (NSArray *)resultsForDataBatch:(NSArray<NSData *> *)dataBatch encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options maximumConcurrency:(NSUInteger)maximumConcurrency extractionBlock:(HTMLDocumentExtractionBlock)extractionBlock;
+
+/*! Parses the data objects in parallel and passes each result to a block as soon as it's available. The method returns when all data objects are processed
+ * \param dataBatch An array of data objects with HTML content
+ * \param encoding The string encoding for the HTML content
+ * \param options The options passed to the libxml2 parser
+ * \param maximumConcurrency The maximum number of workers, 0 uses the number of active processors
+ * \param extractionBlock The block called for each parsed document
+ * \param resultBlock The block called for each data object in the order of completion, the calls are serialized but made on the worker threads
+ */
++ (void)processDataBatch:(NSArray<NSData *> *)dataBatch encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options maximumConcurrency:(NSUInteger)maximumConcurrency extractionBlock:(HTMLDocumentExtractionBlock)extractionBlock resultBlock:(HTMLDocumentBatchResultBlock)resultBlock;
+
+NS_ASSUME_NONNULL_END
+
+@end
@@ -0,0 +1,132 @@
+/*###################################################################################
+#                                                                                   #
+#     HTMLDocument+Batch.m                                                          #
+#     Category of HTMLDocument for parallel batch parsing                           #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #import HTMLDocument+Batch.h                                   #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+#import "HTMLDocument+Batch.h"
+#include <stdatomic.h>
+
+// the result block called by the workers, the calls are not serialized
+typedef void (^HTMLBatchWorkerResultBlock)(NSUInteger index, id result, NSError * error);
+
+static void initializeParser(void);
+static void performBatch(NSArray * dataBatch, NSStringEncoding encoding, HTMLDocumentParseOptions options, NSUInteger maximumConcurrency, HTMLDocumentExtractionBlock extractionBlock, HTMLBatchWorkerResultBlock resultBlock);
+
+#pragma mark - workers
+
+// xmlInitParser() must be called once before the parser is used on several threads
+static void initializeParser(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        xmlInitParser();
+    });
+}
+
+// Runs a bounded number of workers on the global concurrent queue and returns when the batch is processed.
+// The workers take the next index from a shared atomic counter, a worker which finishes early takes over the remaining data
+// instead of waiting for a fixed partition. Each worker parses with its own HTMLParser, the document and the autoreleased
+// objects of the extraction are freed per data object
+static void performBatch(NSArray * dataBatch, NSStringEncoding encoding, HTMLDocumentParseOptions options, NSUInteger maximumConcurrency, HTMLDocumentExtractionBlock extractionBlock, HTMLBatchWorkerResultBlock resultBlock)
+{
+    NSUInteger count = [dataBatch count];
+    if (count == 0) return;
+    
+    initializeParser();
+    
+    NSUInteger numberOfWorkers = (maximumConcurrency) ? maximumConcurrency : [[NSProcessInfo processInfo] activeProcessorCount];
+    if (numberOfWorkers > count) numberOfWorkers = count;
+    
+    atomic_size_t nextIndex = 0;
+    atomic_size_t *sharedIndex = &nextIndex; // dispatch_apply returns after all workers finished, the counter stays on this stack
+    
+    dispatch_apply(numberOfWorkers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        HTMLParser *parser = [[HTMLParser alloc] initWithOptions:options];
+        size_t index;
+        while ((index = atomic_fetch_add_explicit(sharedIndex, 1, memory_order_relaxed)) < count) {
+            @autoreleasepool {
+                NSError *error = nil;
+                NSData *data = dataBatch[index];
+                // without parser context the documents are parsed by the document initializer
+                HTMLDocument *document = (parser) ? [parser documentWithData:data encoding:encoding error:&error]
+                                                  : [HTMLDocument documentWithData:data encoding:encoding options:options error:&error];
+                id result = (document) ? extractionBlock(document, index) : nil;
+                resultBlock(index, result, error);
+            }
+        }
+        SAFE_ARC_RELEASE(parser);
+    });
+}
+
+@implementation HTMLDocument (Batch)
+
++ (NSArray *)resultsForDataBatch:(NSArray<NSData *> *)dataBatch extractionBlock:(HTMLDocumentExtractionBlock)extractionBlock
+{
+    return [self resultsForDataBatch:dataBatch encoding:NSUTF8StringEncoding options:HTMLDocumentParseOptionDefault maximumConcurrency:0 extractionBlock:extractionBlock];
+}
+
++ (NSArray *)resultsForDataBatch:(NSArray<NSData *> *)dataBatch encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options maximumConcurrency:(NSUInteger)maximumConcurrency extractionBlock:(HTMLDocumentExtractionBlock)extractionBlock
+{
+    NSUInteger count = [dataBatch count];
+    // each worker writes its results into distinct slots, no synchronization is needed
+    CFTypeRef *slots = calloc(count ? count : 1, sizeof(CFTypeRef));
+    if (slots == NULL) return @[];
+    
+    performBatch(dataBatch, encoding, options, maximumConcurrency, extractionBlock, ^(NSUInteger index, id result, NSError *error) {
+        if (result) slots[index] = CFBridgingRetain(result);
+    });
+    
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:count];
+    NSNull *null = [NSNull null];
+    for (NSUInteger i = 0; i < count; i++) {
+        if (slots[i]) {
+            [results addObject:(__bridge id)slots[i]];
+            CFRelease(slots[i]);
+        }
+        else
+            [results addObject:null];
+    }
+    free(slots);
+    return results;
+}
+
++ (void)processDataBatch:(NSArray<NSData *> *)dataBatch encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options maximumConcurrency:(NSUInteger)maximumConcurrency extractionBlock:(HTMLDocumentExtractionBlock)extractionBlock resultBlock:(HTMLDocumentBatchResultBlock)resultBlock
+{
+    NSLock *resultLock = [[NSLock alloc] init];
+    performBatch(dataBatch, encoding, options, maximumConcurrency, extractionBlock, ^(NSUInteger index, id result, NSError *error) {
+        [resultLock lock];
+        resultBlock(index, result, error);
+        [resultLock unlock];
+    });
+    SAFE_ARC_RELEASE(resultLock);
+}
+
+@end
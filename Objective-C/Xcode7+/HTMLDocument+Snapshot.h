@@ -0,0 +1,83 @@
+/*###################################################################################
+#                                                                                   #
+#     HTMLDocument+Snapshot.h                                                       #
+#     Category of HTMLDocument for binary snapshots of the tree                     #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #import HTMLDocument+Snapshot.h                                #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+#import "HTMLDocument.h"
+
+// A snapshot is a position independent binary form of the tree which is loaded much faster than the HTML is parsed again,
+// e.g. to cache parsed pages across process restarts and machines. All values are little-endian 32-bit integers:
+// a header, the flat array of the nodes in document order with the index of their parent, the flat array of the attributes
+// and the table of the NUL terminated UTF-8 strings referenced by offset, element and attribute names are stored once.
+// Elements, text, CDATA, comment and processing instruction nodes and the internal DTD are preserved, namespaces are stored
+// as qualified names, the id attributes are registered again like the parser does. The encoding of the snapshot is always UTF-8,
+// the tree isn't converted again when it's loaded
+
+// The version of the format written by snapshotDataWithError:, snapshots of other versions fail to load
+#define HTML_DOCUMENT_SNAPSHOT_VERSION 1
+
+@interface HTMLDocument (Snapshot)
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns a snapshot of the tree of the document
+ * \param error An error object if the tree contains nodes which can't be stored or the snapshot exceeds 4 GB
+ * \returns The snapshot data or nil
+ */
+- (nullable NSData *)snapshotDataWithError:(NSError **)error;
+
+/*! Returns a document loaded from a snapshot into an arena, see HTMLParser usesArena. The string table is copied at once,
+ *  the nodes point into the copy instead of owning their strings, so the tree must not be modified
+ * \param data The snapshot data, it's not referenced after the method returns
+ * \param error An error object that, on return, identifies an invalid snapshot or the reason why the document couldn't be initialized
+ * \returns An initialized document of the receiving class or nil
+ */
++ (nullable HTMLDocument *)documentWithSnapshotData:(NSData *)data error:(NSError **)error;
+
+/*! Returns a document loaded from a snapshot
+ * \param data The snapshot data, it's not referenced after the method returns
+ * \param usesArena YES to load the tree into an arena with one shared copy of the string table, NO for a regular libxml2 tree
+ *  whose nodes own their strings like a parsed tree
+ * \param error An error object that, on return, identifies an invalid snapshot or the reason why the document couldn't be initialized
+ * \returns An initialized document of the receiving class or nil
+ */
++ (nullable HTMLDocument *)documentWithSnapshotData:(NSData *)data usesArena:(BOOL)usesArena error:(NSError **)error;
+
+/*! Returns a document loaded from a snapshot file into an arena, the file is mapped into virtual memory if possible
+ * \param url The file URL of the snapshot
+ * \param error An error object that, on return, identifies a read error, an invalid snapshot or the reason why the document couldn't be initialized
+ * \returns An initialized document of the receiving class or nil
+ */
++ (nullable HTMLDocument *)documentWithContentsOfSnapshotURL:(NSURL *)url error:(NSError **)error;
+
+NS_ASSUME_NONNULL_END
+
+@end
@@ -0,0 +1,463 @@
+/*###################################################################################
+#                                                                                   #
+#     HTMLDocument+Snapshot.m                                                       #
+#     Category of HTMLDocument for binary snapshots of the tree                     #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #import HTMLDocument+Snapshot.h                                #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+#import "HTMLDocument+Snapshot.h"
+#import <libxml/parserInternals.h>
+
+#define SNAPSHOT_MAGIC "HTMLSNAP"
+#define SNAPSHOT_NONE UINT32_MAX
+#define SNAPSHOT_FLAG_XML 1           // the tree of an XMLDocument
+#define SNAPSHOT_NAME_BUFFER_SIZE 128
+#define SNAPSHOT_TYPE_BITS 8
+#define SNAPSHOT_MAX_ATTRIBUTES ((1U << (32 - SNAPSHOT_TYPE_BITS)) - 1)
+
+// The layout of a snapshot, all fields are little-endian and the structures have no padding
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t nodeCount;
+    uint32_t attributeCount;
+    uint32_t stringsLength;
+    uint32_t reserved;
+} HTMLSnapshotHeader;
+
+// The low byte of info is the node type, the upper bits are the number of attributes of an element, the presence of the content
+// of a processing instruction (bit 0) and the presence of the external ID (bit 0) and the system ID (bit 1) of a DTD.
+// The parent is the index of a preceding element or SNAPSHOT_NONE for the children of the document. The string is the name
+// of elements, processing instructions and DTDs, the content of the other nodes. The additional strings of processing
+// instructions and DTDs directly follow the name. The attributes of the elements are stored in the order of the elements
+typedef struct {
+    uint32_t info;
+    uint32_t parent;
+    uint32_t string;
+} HTMLSnapshotNode;
+
+// The value is SNAPSHOT_NONE for an attribute without value
+typedef struct {
+    uint32_t name;
+    uint32_t value;
+} HTMLSnapshotAttribute;
+
+// The sections of a snapshot while it's written, the names are stored once in the string table
+typedef struct {
+    NSMutableData * nodes;
+    NSMutableData * attributes;
+    NSMutableData * strings;
+    xmlHashTablePtr names;
+} HTMLSnapshotWriter;
+
+static NSError * snapshotError(NSInteger code);
+static BOOL snapshotAppendString(HTMLSnapshotWriter * writer, const xmlChar * string, uint32_t * offset);
+static BOOL snapshotAppendName(HTMLSnapshotWriter * writer, const xmlChar * name, xmlNs * ns, uint32_t * offset);
+static BOOL snapshotAppendNode(HTMLSnapshotWriter * writer, xmlNode * node, uint32_t parent);
+static NSData * snapshotOfDocument(xmlDoc * doc);
+static xmlDoc * documentOfSnapshot(const uint8_t * bytes, size_t length, BOOL sharesStrings);
+
+#pragma mark - errors
+
+static NSError * snapshotError(NSInteger code)
+{
+    NSString *errorString = (code == 8) ? @"The document could not be stored in a snapshot" : @"No valid snapshot data";
+    return [NSError errorWithDomain:@"com.klieme.HTMLDocument" code:code userInfo:@{NSLocalizedDescriptionKey: errorString}];
+}
+
+#pragma mark - writing
+
+static BOOL snapshotAppendString(HTMLSnapshotWriter * writer, const xmlChar * string, uint32_t * offset)
+{
+    if (string == NULL) {
+        *offset = SNAPSHOT_NONE;
+        return YES;
+    }
+    size_t length = strlen((const char *)string) + 1;
+    if (length >= SNAPSHOT_NONE - writer->strings.length) return NO;
+    *offset = (uint32_t)writer->strings.length;
+    [writer->strings appendBytes:string length:length];
+    return YES;
+}
+
+// element and attribute names are stored once, the hash table maps each name to its offset + 1
+static BOOL snapshotAppendName(HTMLSnapshotWriter * writer, const xmlChar * name, xmlNs * ns, uint32_t * offset)
+{
+    xmlChar buffer[SNAPSHOT_NAME_BUFFER_SIZE];
+    const xmlChar *qualifiedName = (ns && ns->prefix) ? xmlBuildQName(name, ns->prefix, buffer, sizeof(buffer)) : name;
+    if (qualifiedName == NULL) return NO;
+    
+    BOOL succeeded = YES;
+    uintptr_t payload = (uintptr_t)xmlHashLookup(writer->names, qualifiedName);
+    if (payload) {
+        *offset = (uint32_t)(payload - 1);
+    } else {
+        succeeded = snapshotAppendString(writer, qualifiedName, offset)
+                    && xmlHashAddEntry(writer->names, qualifiedName, (void *)((uintptr_t)*offset + 1)) == 0;
+    }
+    if (qualifiedName != name && qualifiedName != buffer) xmlFree((xmlChar *)qualifiedName);
+    return succeeded;
+}
+
+static BOOL snapshotAppendNode(HTMLSnapshotWriter * writer, xmlNode * node, uint32_t parent)
+{
+    HTMLSnapshotNode record = { node->type, parent, SNAPSHOT_NONE };
+    uint32_t count = 0, unused;
+    BOOL succeeded = YES;
+    
+    switch (node->type) {
+        case XML_ELEMENT_NODE:
+            succeeded = snapshotAppendName(writer, node->name, node->ns, &record.string);
+            for (xmlAttrPtr attr = node->properties; attr && succeeded; attr = attr->next) {
+                HTMLSnapshotAttribute attribute = { SNAPSHOT_NONE, SNAPSHOT_NONE };
+                succeeded = snapshotAppendName(writer, attr->name, attr->ns, &attribute.name);
+                if (succeeded && attr->children) {
+                    // the value of an HTML attribute is one text node, values of several nodes are concatenated
+                    xmlNode *child = attr->children;
+                    BOOL isSingleText = (child->next == NULL && child->type == XML_TEXT_NODE && child->content);
+                    xmlChar *value = (isSingleText) ? child->content : xmlNodeListGetString(attr->doc, child, 1);
+                    succeeded = snapshotAppendString(writer, (value) ? value : BAD_CAST "", &attribute.value);
+                    if (! isSingleText) xmlFree(value);
+                }
+                attribute.name = CFSwapInt32HostToLittle(attribute.name);
+                attribute.value = CFSwapInt32HostToLittle(attribute.value);
+                [writer->attributes appendBytes:&attribute length:sizeof(attribute)];
+                if (++count == SNAPSHOT_MAX_ATTRIBUTES) succeeded = NO;
+            }
+            break;
+            
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE:
+        case XML_COMMENT_NODE:
+            succeeded = snapshotAppendString(writer, (node->content) ? node->content : BAD_CAST "", &record.string);
+            break;
+            
+        case XML_PI_NODE:
+            count = (node->content) ? 1 : 0;
+            succeeded = snapshotAppendString(writer, node->name, &record.string)
+                        && snapshotAppendString(writer, node->content, &unused);
+            break;
+            
+        case XML_DTD_NODE: {
+            xmlDtd *dtd = (xmlDtd *)node;
+            count = ((dtd->ExternalID) ? 1 : 0) | ((dtd->SystemID) ? 2 : 0);
+            succeeded = snapshotAppendString(writer, (dtd->name) ? dtd->name : BAD_CAST "", &record.string)
+                        && snapshotAppendString(writer, dtd->ExternalID, &unused)
+                        && snapshotAppendString(writer, dtd->SystemID, &unused);
+            break;
+        }
+            
+        default:
+            return NO; // entity references, XInclude markers and declarations outside of the DTD
+    }
+    if (record.string == SNAPSHOT_NONE) return NO;
+    
+    record.info = CFSwapInt32HostToLittle(record.info | count << SNAPSHOT_TYPE_BITS);
+    record.parent = CFSwapInt32HostToLittle(record.parent);
+    record.string = CFSwapInt32HostToLittle(record.string);
+    [writer->nodes appendBytes:&record length:sizeof(record)];
+    return succeeded;
+}
+
+// The nodes are written in document order, the indexes of the open ancestors are kept on a stack
+static NSData * snapshotOfDocument(xmlDoc * doc)
+{
+    HTMLSnapshotWriter writer = { [NSMutableData data], [NSMutableData data], [NSMutableData data], xmlHashCreate(0) };
+    if (writer.names == NULL) return nil;
+    
+    uint32_t *parents = NULL;
+    size_t depth = 0, depthCapacity = 0;
+    uint32_t nodeCount = 0;
+    BOOL succeeded = YES;
+    
+    xmlNode *node = doc->children;
+    while (node && succeeded) {
+        if (nodeCount == SNAPSHOT_NONE - 1) {
+            succeeded = NO;
+            break;
+        }
+        succeeded = snapshotAppendNode(&writer, node, (depth) ? parents[depth - 1] : SNAPSHOT_NONE);
+        uint32_t index = nodeCount++;
+        
+        // the children of a DTD are its declarations, they are restored with the DTD
+        if (node->type == XML_ELEMENT_NODE && node->children) {
+            if (depth == depthCapacity) {
+                depthCapacity = (depthCapacity) ? depthCapacity * 2 : 64;
+                uint32_t *grownParents = realloc(parents, depthCapacity * sizeof(uint32_t));
+                if (grownParents == NULL) {
+                    succeeded = NO;
+                    break;
+                }
+                parents = grownParents;
+            }
+            parents[depth++] = index;
+            node = node->children;
+            continue;
+        }
+        while (node && node->next == NULL) {
+            node = node->parent;
+            if (node == NULL || node == (xmlNode *)doc) node = NULL;
+            else depth--;
+        }
+        if (node) node = node->next;
+    }
+    free(parents);
+    xmlHashFree(writer.names, NULL);
+    if (! succeeded || writer.attributes.length / sizeof(HTMLSnapshotAttribute) >= SNAPSHOT_NONE) return nil;
+    
+    HTMLSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = CFSwapInt32HostToLittle(HTML_DOCUMENT_SNAPSHOT_VERSION);
+    header.flags = CFSwapInt32HostToLittle((doc->type == XML_HTML_DOCUMENT_NODE) ? 0 : SNAPSHOT_FLAG_XML);
+    header.nodeCount = CFSwapInt32HostToLittle(nodeCount);
+    header.attributeCount = CFSwapInt32HostToLittle((uint32_t)(writer.attributes.length / sizeof(HTMLSnapshotAttribute)));
+    header.stringsLength = CFSwapInt32HostToLittle((uint32_t)writer.strings.length);
+    
+    NSMutableData *snapshot = [NSMutableData dataWithCapacity:sizeof(header) + writer.nodes.length + writer.attributes.length + writer.strings.length];
+    [snapshot appendBytes:&header length:sizeof(header)];
+    [snapshot appendData:writer.nodes];
+    [snapshot appendData:writer.attributes];
+    [snapshot appendData:writer.strings];
+    return snapshot;
+}
+
+#pragma mark - loading
+
+// Returns the string at an offset of the string table, a copy owned by the node or a pointer into the shared table
+static inline xmlChar * snapshotString(const xmlChar * strings, uint32_t offset, BOOL sharesStrings)
+{
+    if (offset == SNAPSHOT_NONE) return NULL;
+    return (sharesStrings) ? (xmlChar *)strings + offset : xmlStrdup(strings + offset);
+}
+
+static inline uint32_t snapshotValue(const void * bytes, size_t index)
+{
+    uint32_t value;
+    memcpy(&value, (const uint8_t *)bytes + index * sizeof(uint32_t), sizeof(value));
+    return CFSwapInt32LittleToHost(value);
+}
+
+static xmlNode * snapshotNewNode(xmlDoc * doc, xmlElementType type)
+{
+    xmlNode *node = xmlMalloc(sizeof(xmlNode));
+    if (node == NULL) return NULL;
+    memset(node, 0, sizeof(xmlNode));
+    node->type = type;
+    node->doc = doc;
+    return node;
+}
+
+static void snapshotAppendChild(xmlNode * parent, xmlNode * node)
+{
+    node->parent = parent;
+    node->prev = parent->last;
+    if (parent->last) parent->last->next = node;
+    else parent->children = node;
+    parent->last = node;
+}
+
+// Builds the tree of a validated snapshot with the allocation functions of libxml2, the nodes are linked directly
+// like the tree builder of the parser does. Returns NULL for invalid snapshots
+static xmlDoc * documentOfSnapshot(const uint8_t * bytes, size_t length, BOOL sharesStrings)
+{
+    if (bytes == NULL || length < sizeof(HTMLSnapshotHeader) || memcmp(bytes, SNAPSHOT_MAGIC, 8) != 0) return NULL;
+    const uint32_t *header = (const uint32_t *)(bytes + 8);
+    if (snapshotValue(header, 0) != HTML_DOCUMENT_SNAPSHOT_VERSION) return NULL;
+    uint32_t flags = snapshotValue(header, 1);
+    uint32_t nodeCount = snapshotValue(header, 2);
+    uint32_t attributeCount = snapshotValue(header, 3);
+    uint32_t stringsLength = snapshotValue(header, 4);
+    
+    uint64_t expectedLength = sizeof(HTMLSnapshotHeader) + (uint64_t)nodeCount * sizeof(HTMLSnapshotNode)
+                              + (uint64_t)attributeCount * sizeof(HTMLSnapshotAttribute) + stringsLength;
+    if (expectedLength != length || stringsLength == 0 || bytes[length - 1] != 0) return NULL;
+    const uint8_t *nodeRecords = bytes + sizeof(HTMLSnapshotHeader);
+    const uint8_t *attributeRecords = nodeRecords + (size_t)nodeCount * sizeof(HTMLSnapshotNode);
+    const xmlChar *strings = attributeRecords + (size_t)attributeCount * sizeof(HTMLSnapshotAttribute);
+    
+    xmlNode **nodes = malloc(((nodeCount) ? nodeCount : 1) * sizeof(xmlNode *));
+    if (nodes == NULL) return NULL;
+    xmlDoc *doc = (flags & SNAPSHOT_FLAG_XML) ? xmlNewDoc(BAD_CAST "1.0") : htmlNewDocNoDtD(NULL, NULL);
+    if (doc && sharesStrings) {
+        // one copy of the string table which is released with the arena
+        xmlChar *sharedStrings = xmlMalloc(stringsLength);
+        if (sharedStrings) memcpy(sharedStrings, strings, stringsLength);
+        strings = sharedStrings;
+    }
+    BOOL succeeded = (doc && strings);
+    
+    uint32_t nextAttribute = 0;
+    for (uint32_t i = 0; i < nodeCount && succeeded; i++) {
+        const void *record = nodeRecords + (size_t)i * sizeof(HTMLSnapshotNode);
+        uint32_t info = snapshotValue(record, 0), parentIndex = snapshotValue(record, 1), string = snapshotValue(record, 2);
+        uint32_t type = info & ((1U << SNAPSHOT_TYPE_BITS) - 1), count = info >> SNAPSHOT_TYPE_BITS;
+        
+        xmlNode *parent = (parentIndex == SNAPSHOT_NONE) ? (xmlNode *)doc : (parentIndex < i) ? nodes[parentIndex] : NULL;
+        succeeded = (parent && (parent == (xmlNode *)doc || parent->type == XML_ELEMENT_NODE) && string < stringsLength);
+        if (! succeeded) break;
+        // the offset of the string following the name of a processing instruction or a DTD
+        uint32_t next = string + (uint32_t)strlen((const char *)strings + string) + 1;
+        
+        xmlNode *node = NULL;
+        switch (type) {
+            case XML_ELEMENT_NODE: {
+                xmlAttrPtr lastAttr = NULL;
+                if (count > attributeCount - nextAttribute) break;
+                node = snapshotNewNode(doc, XML_ELEMENT_NODE);
+                if (node) node->name = snapshotString(strings, string, sharesStrings);
+                for (uint32_t j = 0; node && node->name && j < count; j++) {
+                    const void *attributeRecord = attributeRecords + (size_t)nextAttribute++ * sizeof(HTMLSnapshotAttribute);
+                    uint32_t attributeName = snapshotValue(attributeRecord, 0), value = snapshotValue(attributeRecord, 1);
+                    if (attributeName >= stringsLength || (value != SNAPSHOT_NONE && value >= stringsLength)) {
+                        succeeded = NO;
+                        break;
+                    }
+                    xmlAttrPtr attr = xmlMalloc(sizeof(xmlAttr));
+                    if (attr == NULL) {
+                        succeeded = NO;
+                        break;
+                    }
+                    // each part is linked as soon as it exists, so the tree of a failed allocation can be freed
+                    memset(attr, 0, sizeof(xmlAttr));
+                    attr->type = XML_ATTRIBUTE_NODE;
+                    attr->doc = doc;
+                    attr->parent = node;
+                    attr->prev = lastAttr;
+                    if (lastAttr) lastAttr->next = attr;
+                    else node->properties = attr;
+                    lastAttr = attr;
+                    attr->name = snapshotString(strings, attributeName, sharesStrings);
+                    
+                    xmlNode *text = (value != SNAPSHOT_NONE) ? snapshotNewNode(doc, XML_TEXT_NODE) : NULL;
+                    if (text) {
+                        text->name = xmlStringText;
+                        text->parent = (xmlNode *)attr;
+                        attr->children = attr->last = text;
+                        text->content = snapshotString(strings, value, sharesStrings);
+                    }
+                    if (attr->name == NULL || (value != SNAPSHOT_NONE && (text == NULL || text->content == NULL))) {
+                        succeeded = NO;
+                        break;
+                    }
+                    // like the HTML parser register the id attributes for xmlGetID and the id() function of XPath
+                    if (text && xmlStrEqual(attr->name, BAD_CAST "id")) xmlAddID(NULL, doc, text->content, attr);
+                }
+                break;
+            }
+                
+            case XML_TEXT_NODE:
+            case XML_COMMENT_NODE:
+            case XML_CDATA_SECTION_NODE:
+                node = snapshotNewNode(doc, type);
+                if (node == NULL) break;
+                // like the tree builder the names of text and comment nodes are static strings, CDATA sections have no name
+                node->name = (type == XML_TEXT_NODE) ? xmlStringText : (type == XML_COMMENT_NODE) ? xmlStringComment : NULL;
+                node->content = snapshotString(strings, string, sharesStrings);
+                succeeded = (node->content != NULL);
+                break;
+                
+            case XML_PI_NODE:
+                if (count > 1 || (count && next >= stringsLength)) break;
+                node = snapshotNewNode(doc, XML_PI_NODE);
+                if (node == NULL) break;
+                node->name = snapshotString(strings, string, sharesStrings);
+                node->content = (count) ? snapshotString(strings, next, sharesStrings) : NULL;
+                succeeded = (node->name && (count == 0 || node->content));
+                break;
+                
+            case XML_DTD_NODE: {
+                // the DTD links itself as first child of the document
+                if (parent != (xmlNode *)doc || doc->children || count > 3 || ((count & 1) && next >= stringsLength)) break;
+                uint32_t systemID = (count & 1) ? next + (uint32_t)strlen((const char *)strings + next) + 1 : next;
+                if ((count & 2) && systemID >= stringsLength) break;
+                node = (xmlNode *)xmlCreateIntSubset(doc, strings + string, (count & 1) ? strings + next : NULL, (count & 2) ? strings + systemID : NULL);
+                break;
+            }
+        }
+        if (node == NULL) {
+            succeeded = NO;
+            break;
+        }
+        if (type != XML_DTD_NODE) snapshotAppendChild(parent, node);
+        nodes[i] = node;
+        if (type == XML_ELEMENT_NODE && node->name == NULL) succeeded = NO;
+    }
+    if (nextAttribute != attributeCount) succeeded = NO;
+    free(nodes);
+    
+    if (! succeeded && doc && ! sharesStrings) xmlFreeDoc(doc);
+    return (succeeded) ? doc : NULL;
+}
+
+@implementation HTMLDocument (Snapshot)
+
+- (NSData *)snapshotDataWithError:(NSError **)error
+{
+    NSData *snapshot = (htmlDoc_) ? snapshotOfDocument(htmlDoc_) : nil;
+    if (snapshot == nil && error) *error = snapshotError(8);
+    return snapshot;
+}
+
++ (HTMLDocument *)documentWithSnapshotData:(NSData *)data error:(NSError **)error
+{
+    return [self documentWithSnapshotData:data usesArena:YES error:error];
+}
+
++ (HTMLDocument *)documentWithSnapshotData:(NSData *)data usesArena:(BOOL)usesArena error:(NSError **)error
+{
+    HTMLArena *arena = (usesArena) ? HTMLArenaCreate() : NULL;
+    if (usesArena && arena == NULL) {
+        if (error) *error = snapshotError(9);
+        return nil;
+    }
+    HTMLArena *previousArena = (arena) ? HTMLArenaMakeCurrent(arena) : NULL;
+    xmlDoc *doc = documentOfSnapshot([data bytes], [data length], usesArena);
+    if (arena) {
+        xmlResetLastError(); // the last error of the thread must not reference arena memory
+        HTMLArenaMakeCurrent(previousArena);
+    }
+    
+    if (doc == NULL) {
+        if (arena) HTMLArenaFree(arena);
+        if (error) *error = snapshotError(9);
+        return nil;
+    }
+    return SAFE_ARC_AUTORELEASE([[self alloc] initWithHTMLDoc:doc arena:arena error:error]);
+}
+
++ (HTMLDocument *)documentWithContentsOfSnapshotURL:(NSURL *)url error:(NSError **)error
+{
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:error];
+    if (data == nil) return nil;
+    return [self documentWithSnapshotData:data usesArena:YES error:error];
+}
+
+@end
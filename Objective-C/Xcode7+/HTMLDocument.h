@@ -34,12 +34,54 @@
 
 #import <Foundation/Foundation.h>
 #import <libxml/HTMLparser.h>
+#import <libxml/xpath.h>
 #import "HTMLNode.h"
 
+// Returns the IANA character set name of the string encoding which is passed to the libxml2 parser functions
+const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, size_t bufferSize);
+
+// Opaque bump allocator the libxml2 allocations of one document are taken from while it's current, see HTMLParser usesArena
+typedef struct HTMLArena HTMLArena;
+
+// Creates an empty arena. The first call installs arena aware allocation functions in libxml2 with xmlMemSetup(),
+// they forward to malloc() if no arena is current. Returns NULL if the functions could not be installed
+HTMLArena * HTMLArenaCreate(void);
+// Releases all memory of the arena at once, a document allocated in the arena must not be freed with xmlFreeDoc() afterwards
+void HTMLArenaFree(HTMLArena * arena);
+// Makes the arena (or NULL) the target of the libxml2 allocations on the current thread and returns the previous one
+HTMLArena * HTMLArenaMakeCurrent(HTMLArena * arena);
+
+// The way the contents of a file URL are passed to the parser
+typedef NS_ENUM(NSUInteger, HTMLDocumentLoadingMode) {
+    HTMLDocumentLoadingModeDefault = 0,     // the file is read into memory
+    HTMLDocumentLoadingModeMapped,          // the file is mapped into virtual memory if possible
+    HTMLDocumentLoadingModeFileDescriptor   // the parser reads the file descriptor in chunks
+};
+
+// The options passed to the libxml2 parser, the values match the HTML_PARSE_* and XML_PARSE_* constants
+typedef NS_OPTIONS(NSUInteger, HTMLDocumentParseOptions) {
+    HTMLDocumentParseOptionRecover      = 1 << 0,   // relaxed parsing
+    HTMLDocumentParseOptionNoError      = 1 << 5,   // suppress error reports
+    HTMLDocumentParseOptionNoWarning    = 1 << 6,   // suppress warning reports
+    HTMLDocumentParseOptionNoBlanks     = 1 << 8,   // remove ignorable whitespace-only text nodes
+    HTMLDocumentParseOptionNoNet        = 1 << 11,  // forbid network access
+    HTMLDocumentParseOptionNoImplied    = 1 << 13,  // do not add implied html, head or body elements, ignored by XMLDocument
+    HTMLDocumentParseOptionCompact      = 1 << 16,  // store small text nodes inline to save memory, the text nodes must not be modified
+    HTMLDocumentParseOptionDefault      = HTMLDocumentParseOptionRecover | HTMLDocumentParseOptionNoError | HTMLDocumentParseOptionNoWarning
+};
+
 @interface HTMLDocument : NSObject
 {    
     htmlDocPtr  htmlDoc_;
-    HTMLNode    *rootNode;
+    HTMLNodeIndex *nodeIndex_;
+    BOOL        indexingEnabled_;
+    BOOL        elementsOrdered_;
+    xmlXPathContext *xpathContext_;
+    NSLock      *xpathContextLock_;
+    NSLock      *documentOrderLock_;
+    HTMLArena   *arena_;
+    NSTimeInterval parseTime_;
+    NSUInteger  inputLength_;
 }
 
 NS_ASSUME_NONNULL_BEGIN
@@ -62,6 +104,15 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (nullable HTMLDocument *)documentWithData:(nullable NSData *)data error:(NSError **)error;
 
+/*! Returns an HTMLDocument object created from an NSData object with specified string encoding and parse options
+ * \param data A data object with HTML content
+ * \param encoding The string encoding for the HTML content
+ * \param options The options passed to the libxml2 parser
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
++ (nullable HTMLDocument *)documentWithData:(nullable NSData *)data encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error;
+
 /*! Returns an HTMLDocument object created from the HTML contents of a URL-referenced source with specified string encoding
  * \param url An NSURL object specifying a URL source
  * \param encoding The string encoding for the HTML content
@@ -77,6 +128,25 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (nullable HTMLDocument *)documentWithContentsOfURL:(NSURL *)url error:(NSError **)error;
 
+/*! Returns an HTMLDocument object created from the HTML contents of a URL-referenced source with specified string encoding and loading mode
+ * \param url An NSURL object specifying a URL source
+ * \param encoding The string encoding for the HTML content
+ * \param loadingMode The way the contents of a file URL are passed to the parser, other URLs are always loaded in the default mode
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
++ (nullable HTMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode error:(NSError **)error;
+
+/*! Returns an HTMLDocument object created from the HTML contents of a URL-referenced source with specified string encoding, loading mode and parse options
+ * \param url An NSURL object specifying a URL source
+ * \param encoding The string encoding for the HTML content
+ * \param loadingMode The way the contents of a file URL are passed to the parser, other URLs are always loaded in the default mode
+ * \param options The options passed to the libxml2 parser
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
++ (nullable HTMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode options:(HTMLDocumentParseOptions)options error:(NSError **)error;
+
 /*! Returns an HTMLDocument object created from a string containing HTML markup text with specified string encoding
  * \param url An NSURL object specifying a URL source
  * \param encoding The string encoding for the HTML content
@@ -100,7 +170,16 @@ NS_ASSUME_NONNULL_BEGIN
  * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
  * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
  */
-- (nullable INSTANCETYPE_OR_ID)initWithData:(nullable NSData *)data encoding:(NSStringEncoding )encoding error:(NSError **)error; // designated initializer
+- (nullable INSTANCETYPE_OR_ID)initWithData:(nullable NSData *)data encoding:(NSStringEncoding )encoding error:(NSError **)error;
+
+/*! Initializes and returns an HTMLDocument object created from an NSData object with specified string encoding and parse options
+ * \param data A data object with HTML or XML content
+ * \param encoding The string encoding for the HTML or XML content
+ * \param options The options passed to the libxml2 parser, HTMLDocumentParseOptionNoImplied fails for content without html root element
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithData:(nullable NSData *)data encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error; // designated initializer
 
 /*! Initializes and returns an HTMLDocument object created from an NSData object with assumed UTF-8 string encoding
  * \param data A data object with HTML or XML content
@@ -124,6 +203,25 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (nullable INSTANCETYPE_OR_ID)initWithContentsOfURL:(NSURL *)url error:(NSError **)error;
 
+/*! Initializes and returns an HTMLDocument object created from the HTML or XML contents of a URL-referenced source with specified string encoding and loading mode
+ * \param url An NSURL object specifying a URL source
+ * \param encoding The string encoding for the HTML or XML content
+ * \param loadingMode The way the contents of a file URL are passed to the parser, other URLs are always loaded in the default mode
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode error:(NSError **)error;
+
+/*! Initializes and returns an HTMLDocument object created from the HTML or XML contents of a URL-referenced source with specified string encoding, loading mode and parse options
+ * \param url An NSURL object specifying a URL source
+ * \param encoding The string encoding for the HTML or XML content
+ * \param loadingMode The way the contents of a file URL are passed to the parser, other URLs are always loaded in the default mode
+ * \param options The options passed to the libxml2 parser
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode options:(HTMLDocumentParseOptions)options error:(NSError **)error;
+
 /*! Initializes and returns an HTMLDocument object created from a string containing HTML or XML markup text with specified string encoding
  * \param url An NSURL object specifying a URL source
  * \param encoding The string encoding for the HTML or XML content
@@ -140,9 +238,25 @@ NS_ASSUME_NONNULL_BEGIN
 */
 - (nullable INSTANCETYPE_OR_ID)initWithHTMLString:(NSString *)string error:(NSError **)error;
 
+/*! Initializes and returns an HTMLDocument object for an already parsed libxml2 document. The receiver takes ownership of the document pointer and frees it also if initialization fails
+ * \param htmlDoc A document pointer created by one of the libxml2 parser functions
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithHTMLDoc:(nullable htmlDocPtr)htmlDoc error:(NSError **)error;
+
+/*! Initializes and returns an HTMLDocument object for a libxml2 document allocated in an arena. The receiver takes ownership of the arena
+ *  and releases it instead of freeing the tree node by node, also if initialization fails
+ * \param htmlDoc A document pointer created by one of the libxml2 parser functions while the arena was current
+ * \param arena The arena containing the document, or NULL for a document allocated with malloc()
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized HTMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithHTMLDoc:(nullable htmlDocPtr)htmlDoc arena:(nullable HTMLArena *)arena error:(NSError **)error;
 
-/*! The root node*/
-@property (readonly, nullable) HTMLNode *rootNode;
+
+/*! The root node, a new node object for each call. The nodes retain their document, the document doesn't retain any node*/
+@property (SAFE_ARC_READONLY_OBJ_PROP, nullable) HTMLNode *rootNode;
 
 /*! The head node*/
 @property (SAFE_ARC_READONLY_OBJ_PROP, nullable) HTMLNode *head;
@@ -153,15 +267,31 @@ NS_ASSUME_NONNULL_BEGIN
 /*! The value of the title tag in the head node*/
 @property (SAFE_ARC_READONLY_OBJ_PROP, nullable) NSString *title;
 
+/*! Enables an index of the element nodes by id, class token and tag name. The index is built lazily in one pass by the first query
+ *  and answers the descendant queries by id, class and tag name of all nodes in the document without walking the tree.
+ *  Disabling the index frees its memory, don't disable it while other threads query the document. The default is NO*/
+@property (getter=isIndexingEnabled) BOOL indexingEnabled;
+
+/*! The node index of the document, built on first access if indexing is enabled, otherwise NULL*/
+@property (readonly, nullable) HTMLNodeIndex *nodeIndex;
+
+/*! Numbers the elements in document order once with xmlXPathOrderDocElems, the numbers are stored in the unused content fields of the elements.
+ *  Afterwards the document order of two elements and the sorting of the node sets of XPath queries take O(1) per comparison.
+ *  Called on demand by the document order methods of HTMLNode, the numbers of elements added to the tree later are missing*/
+- (void)prepareDocumentOrder;
+
+/*! Calls the block with the XPath context of the document. The context is created on first use and reused by all XPath queries
+ *  of the nodes of the document, the calls are serialized. The context must not be used outside of the block
+ * \param block The block called with the context, or with NULL if the context couldn't be created
+ */
+- (void)performWithXPathContext:(void (^)(xmlXPathContext * _Nullable xpathContext))block;
+
 
 @end
 
 
 
 @interface XMLDocument : HTMLDocument
-{
-    xmlDocPtr  xmlDoc_;
-}
 
 
 /*! Returns an XMLDocument object created from an NSData object with specified string encoding
@@ -179,6 +309,15 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (nullable XMLDocument *)documentWithData:(nullable NSData *)data error:(NSError **)error;
 
+/*! Returns an XMLDocument object created from an NSData object with specified string encoding and parse options
+ * \param data A data object with XML content
+ * \param encoding The string encoding for the XML content
+ * \param options The options passed to the libxml2 parser
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized XMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
++ (nullable XMLDocument *)documentWithData:(nullable NSData *)data encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error;
+
 /*! Returns an XMLDocument object created from the XML contents of a URL-referenced source with specified string encoding
  * \param url An NSURL object specifying a URL source
  * \param encoding The string encoding for the XML content
@@ -194,6 +333,25 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (nullable XMLDocument *)documentWithContentsOfURL:(NSURL *)url error:(NSError **)error;
 
+/*! Returns an XMLDocument object created from the XML contents of a URL-referenced source with specified string encoding and loading mode
+ * \param url An NSURL object specifying a URL source
+ * \param encoding The string encoding for the XML content
+ * \param loadingMode The way the contents of a file URL are passed to the parser, other URLs are always loaded in the default mode
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized XMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
++ (nullable XMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode error:(NSError **)error;
+
+/*! Returns an XMLDocument object created from the XML contents of a URL-referenced source with specified string encoding, loading mode and parse options
+ * \param url An NSURL object specifying a URL source
+ * \param encoding The string encoding for the XML content
+ * \param loadingMode The way the contents of a file URL are passed to the parser, other URLs are always loaded in the default mode
+ * \param options The options passed to the libxml2 parser
+ * \param error An error object that, on return, identifies any parsing errors and warnings or connection problems
+ * \returns An initialized XMLDocument object, or nil if initialization fails because of parsing errors or other reasons
+ */
++ (nullable XMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode options:(HTMLDocumentParseOptions)options error:(NSError **)error;
+
 /*! Returns an XMLDocument object created from a string containing XML markup text with specified string encoding
  * \param url An NSURL object specifying a URL source
  * \param encoding The string encoding for the XML content
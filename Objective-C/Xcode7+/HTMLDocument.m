@@ -33,8 +33,12 @@
  ##################################################################################*/
 
 #import "HTMLDocument.h"
-
-const char *convertStringEncoding(NSStringEncoding encoding, char * buffer, size_t bufferSize);
+#import "HTMLInstrumentation.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, size_t bufferSize) {
     CFStringEncoding cfEncoding = CFStringConvertNSStringEncodingToEncoding(encoding);
@@ -48,10 +52,250 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
     return cEncoding;
 }
 
+#pragma mark - arena
+
+// The arena hands out the memory of its chunks in increasing order, free() is a no-op and realloc() grows the last allocation in place.
+// The chunks are aligned to ARENA_BLOCK_SIZE and registered in a bitmap of the address space, so the libxml2 free and realloc functions
+// recognize arena pointers by address alone. Pointers allocated with malloc() before the functions were installed remain valid.
+#define ARENA_BLOCK_SHIFT 18                                // 256 KB, the size and alignment of a chunk
+#define ARENA_BLOCK_SIZE ((size_t)1 << ARENA_BLOCK_SHIFT)
+#define ARENA_ADDRESS_BITS 48
+#define ARENA_LEAF_SHIFT 15                                 // the blocks per leaf of the bitmap
+#define ARENA_LEAF_WORDS (((size_t)1 << ARENA_LEAF_SHIFT) / 64)
+#define ARENA_NUMBER_OF_LEAVES ((size_t)1 << (ARENA_ADDRESS_BITS - ARENA_BLOCK_SHIFT - ARENA_LEAF_SHIFT))
+#define ARENA_ALIGNMENT 16
+#define ARENA_LARGE_ALLOCATION (ARENA_BLOCK_SIZE / 4)       // larger allocations get a chunk of their own
+#define ARENA_CACHED_CHUNKS 32                              // the freed chunks kept for the next arenas
+
+typedef struct HTMLArenaChunk {
+    struct HTMLArenaChunk * next;
+    size_t size;
+} HTMLArenaChunk;
+
+// each allocation is preceded by its size, realloc() copies the old contents
+typedef struct {
+    size_t size;
+    size_t padding;
+} HTMLArenaHeader;
+
+struct HTMLArena {
+    HTMLArenaChunk * chunks;    // the current chunk first
+    char * cursor;              // the next free byte of the current chunk
+    char * limit;               // the end of the current chunk
+};
+
+// the bitmap of the blocks which are arena chunks, the leaves are created on demand and never freed
+static _Atomic(_Atomic(uint64_t) *) arenaBlockMap[ARENA_NUMBER_OF_LEAVES];
+static __thread HTMLArena * currentArena = NULL;
+
+// the chunks of freed arenas stay registered in the bitmap and are reused without system calls
+static HTMLArenaChunk * cachedChunks = NULL;
+static size_t numberOfCachedChunks = 0;
+static pthread_mutex_t chunkCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static BOOL isArenaPointer(const void * pointer)
+{
+    uintptr_t block = (uintptr_t)pointer >> ARENA_BLOCK_SHIFT;
+    if (block >= ((uintptr_t)1 << (ARENA_ADDRESS_BITS - ARENA_BLOCK_SHIFT))) return NO;
+    
+    _Atomic(uint64_t) *leaf = atomic_load_explicit(&arenaBlockMap[block >> ARENA_LEAF_SHIFT], memory_order_acquire);
+    if (leaf == NULL) return NO;
+    
+    size_t bit = block & (((size_t)1 << ARENA_LEAF_SHIFT) - 1);
+    return (atomic_load_explicit(&leaf[bit / 64], memory_order_acquire) >> (bit % 64)) & 1;
+}
+
+static BOOL markArenaBlock(const void * chunk, BOOL isArena)
+{
+    uintptr_t block = (uintptr_t)chunk >> ARENA_BLOCK_SHIFT;
+    if (block >= ((uintptr_t)1 << (ARENA_ADDRESS_BITS - ARENA_BLOCK_SHIFT))) return NO;
+    
+    _Atomic(_Atomic(uint64_t) *) *slot = &arenaBlockMap[block >> ARENA_LEAF_SHIFT];
+    _Atomic(uint64_t) *leaf = atomic_load_explicit(slot, memory_order_acquire);
+    if (leaf == NULL) {
+        _Atomic(uint64_t) *newLeaf = calloc(ARENA_LEAF_WORDS, sizeof(uint64_t));
+        if (newLeaf == NULL) return NO;
+        if (atomic_compare_exchange_strong(slot, &leaf, newLeaf))
+            leaf = newLeaf;
+        else
+            free(newLeaf); // another thread created the leaf, its value is in leaf now
+    }
+    size_t bit = block & (((size_t)1 << ARENA_LEAF_SHIFT) - 1);
+    _Atomic(uint64_t) *word = &leaf[bit / 64];
+    if (isArena)
+        atomic_fetch_or_explicit(word, (uint64_t)1 << (bit % 64), memory_order_release);
+    else
+        atomic_fetch_and_explicit(word, ~((uint64_t)1 << (bit % 64)), memory_order_release);
+    return YES;
+}
+
+// Adds a chunk for small allocations which becomes the current chunk, or a chunk for one large allocation
+static HTMLArenaChunk * arenaAddChunk(HTMLArena * arena, size_t size, BOOL isLarge)
+{
+    size_t chunkSize = (size + sizeof(HTMLArenaChunk) + ARENA_BLOCK_SIZE - 1) & ~(ARENA_BLOCK_SIZE - 1);
+    if (chunkSize < size) return NULL;
+    
+    HTMLArenaChunk *chunk = NULL;
+    if (chunkSize == ARENA_BLOCK_SIZE) {
+        pthread_mutex_lock(&chunkCacheMutex);
+        chunk = cachedChunks;
+        if (chunk) {
+            cachedChunks = chunk->next;
+            numberOfCachedChunks--;
+        }
+        pthread_mutex_unlock(&chunkCacheMutex);
+    }
+    if (chunk == NULL) {
+        if (posix_memalign((void **)&chunk, ARENA_BLOCK_SIZE, chunkSize) != 0) return NULL;
+        if (! markArenaBlock(chunk, YES)) {
+            free(chunk);
+            return NULL;
+        }
+        chunk->size = chunkSize;
+    }
+    // a large chunk is inserted behind the current chunk which keeps its free space
+    if (isLarge && arena->chunks) {
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+    }
+    else if (isLarge) {
+        chunk->next = NULL;
+        arena->chunks = chunk;
+        arena->cursor = arena->limit = NULL; // no free space, the next small allocation adds a chunk
+    }
+    else {
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->cursor = (char *)chunk + sizeof(HTMLArenaChunk);
+        arena->limit = (char *)chunk + chunkSize;
+    }
+    return chunk;
+}
+
+static void * arenaAllocate(HTMLArena * arena, size_t size)
+{
+    size_t length = (sizeof(HTMLArenaHeader) + size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (length < size) return NULL;
+    
+    HTMLArenaHeader *header;
+    if (length >= ARENA_LARGE_ALLOCATION) {
+        HTMLArenaChunk *chunk = arenaAddChunk(arena, length, YES);
+        if (chunk == NULL) return NULL;
+        header = (HTMLArenaHeader *)((char *)chunk + sizeof(HTMLArenaChunk));
+    }
+    else {
+        if ((size_t)(arena->limit - arena->cursor) < length && arenaAddChunk(arena, 0, NO) == NULL) return NULL;
+        header = (HTMLArenaHeader *)arena->cursor;
+        arena->cursor += length;
+    }
+    header->size = size;
+    return header + 1;
+}
+
+// the allocation functions installed in libxml2, without current arena they forward to the malloc functions
+
+static void * arenaMalloc(size_t size)
+{
+    HTMLArena *arena = currentArena;
+    return (arena) ? arenaAllocate(arena, size) : malloc(size);
+}
+
+static void arenaFree(void * pointer)
+{
+    if (pointer && ! isArenaPointer(pointer)) free(pointer);
+}
+
+static void * arenaRealloc(void * pointer, size_t size)
+{
+    if (pointer == NULL) return arenaMalloc(size);
+    if (! isArenaPointer(pointer)) return realloc(pointer, size); // a malloc block stays a malloc block
+    
+    HTMLArenaHeader *header = (HTMLArenaHeader *)pointer - 1;
+    HTMLArena *arena = currentArena;
+    if (arena) {
+        // grow or shrink the last allocation of the current chunk in place
+        size_t oldLength = (sizeof(HTMLArenaHeader) + header->size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+        size_t newLength = (sizeof(HTMLArenaHeader) + size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+        if ((char *)header + oldLength == arena->cursor && newLength >= size && newLength < ARENA_LARGE_ALLOCATION
+            && (size_t)(arena->limit - (char *)header) >= newLength) {
+            arena->cursor = (char *)header + newLength;
+            header->size = size;
+            return pointer;
+        }
+    }
+    void *newPointer = arenaMalloc(size);
+    if (newPointer) memcpy(newPointer, pointer, (header->size < size) ? header->size : size);
+    return newPointer;
+}
+
+static char * arenaStrdup(const char * string)
+{
+    size_t length = strlen(string) + 1;
+    char *copy = arenaMalloc(length);
+    if (copy) memcpy(copy, string, length);
+    return copy;
+}
+
+HTMLArena * HTMLArenaCreate(void)
+{
+    static dispatch_once_t onceToken;
+    static BOOL installed = NO;
+    dispatch_once(&onceToken, ^{
+        // libxml2 calls the functions through global pointers, they must be set before the parser is initialized on several threads
+        installed = (xmlMemSetup(arenaFree, arenaMalloc, arenaRealloc, arenaStrdup) == 0);
+        xmlInitParser();
+    });
+    return (installed) ? calloc(1, sizeof(HTMLArena)) : NULL;
+}
+
+void HTMLArenaFree(HTMLArena * arena)
+{
+    if (arena == NULL) return;
+    
+    HTMLArenaChunk *chunk = arena->chunks;
+    while (chunk) {
+        HTMLArenaChunk *next = chunk->next;
+        BOOL isCached = NO;
+        if (chunk->size == ARENA_BLOCK_SIZE) {
+            pthread_mutex_lock(&chunkCacheMutex);
+            if (numberOfCachedChunks < ARENA_CACHED_CHUNKS) {
+                chunk->next = cachedChunks;
+                cachedChunks = chunk;
+                numberOfCachedChunks++;
+                isCached = YES;
+            }
+            pthread_mutex_unlock(&chunkCacheMutex);
+        }
+        if (! isCached) {
+            markArenaBlock(chunk, NO);
+            free(chunk);
+        }
+        chunk = next;
+    }
+    free(arena);
+}
+
+HTMLArena * HTMLArenaMakeCurrent(HTMLArena * arena)
+{
+    HTMLArena *previousArena = currentArena;
+    currentArena = arena;
+    return previousArena;
+}
+
+
+
+@interface HTMLDocument ()
+
+// parser hooks, XMLDocument overrides them to use the XML parser functions
+- (htmlDocPtr)parseBytes:(const char *)bytes length:(int)length encoding:(const char *)encoding options:(int)options;
+- (htmlDocPtr)parseFileDescriptor:(int)fd encoding:(const char *)encoding options:(int)options;
+- (BOOL)isValidRootNode:(xmlNodePtr)xmlDocRootNode;
+
+@end
+
 
 
 @implementation HTMLDocument
-@synthesize rootNode;
 
 #pragma mark - error handling
 
@@ -90,6 +334,11 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
     return SAFE_ARC_AUTORELEASE([[HTMLDocument alloc] initWithData:data error:error]);
 }
 
++ (HTMLDocument *)documentWithData:(NSData *)data encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLDocument alloc] initWithData:data encoding:encoding options:options error:error]);
+}
+
 + (HTMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding error:(NSError **)error
 {
     return SAFE_ARC_AUTORELEASE([[HTMLDocument alloc] initWithContentsOfURL:url encoding:encoding error:error]);
@@ -100,6 +349,16 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
     return SAFE_ARC_AUTORELEASE([[HTMLDocument alloc] initWithContentsOfURL:url error:error]);
 }
 
++ (HTMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLDocument alloc] initWithContentsOfURL:url encoding:encoding loadingMode:loadingMode error:error]);
+}
+
++ (HTMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode options:(HTMLDocumentParseOptions)options error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLDocument alloc] initWithContentsOfURL:url encoding:encoding loadingMode:loadingMode options:options error:error]);
+}
+
 + (HTMLDocument *)documentWithHTMLString:(NSString *)string encoding:(NSStringEncoding )encoding error:(NSError **)error
 {
     return SAFE_ARC_AUTORELEASE([[HTMLDocument alloc] initWithHTMLString:string encoding:encoding error:error]);
@@ -112,29 +371,54 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
 
 #pragma mark - instance init methods
 
-// designated initializer
 - (INSTANCETYPE_OR_ID)initWithData:(NSData *)data encoding:(NSStringEncoding )encoding error:(NSError **)error
+{
+    return [self initWithData:data encoding:encoding options:HTMLDocumentParseOptionDefault error:error];
+}
+
+// designated initializer
+- (INSTANCETYPE_OR_ID)initWithData:(NSData *)data encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error
+{
+    if (data == nil || [data length] == 0) {
+        if (error)
+            *error = [self errorForCode:1];
+        
+        SAFE_ARC_RELEASE(self);
+        return nil;
+    }
+    char encodingBuffer[32];
+    HTMLInstrumentationInterval parseInterval = HTMLInstrumentationBegin(HTMLInstrumentationParse);
+    htmlDocPtr htmlDoc = [self parseBytes:[data bytes] length:(int)[data length] encoding:convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer)) options:(int)options];
+    HTMLInstrumentationEnd(&parseInterval);
+    self = [self initWithHTMLDoc:htmlDoc error:error];
+    [self recordParseInterval:&parseInterval inputLength:[data length]];
+    return self;
+}
+
+- (INSTANCETYPE_OR_ID)initWithHTMLDoc:(htmlDocPtr)htmlDoc error:(NSError **)error
+{
+    return [self initWithHTMLDoc:htmlDoc arena:NULL error:error];
+}
+
+- (INSTANCETYPE_OR_ID)initWithHTMLDoc:(htmlDocPtr)htmlDoc arena:(HTMLArena *)arena error:(NSError **)error
 {
     self = [super init];
     if (self) {
         NSInteger errorCode = 0;
-		if (data && [data length]) {
-            int htmlParseOptions = HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING;
-            char encodingBuffer[32];
-            htmlDoc_ = htmlReadMemory([data bytes], (int)[data length], NULL,  convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer)), htmlParseOptions);
-            if (htmlDoc_) {
-                xmlNodePtr xmlDocRootNode = xmlDocGetRootElement(htmlDoc_);
-                if (xmlDocRootNode && xmlStrEqual(xmlDocRootNode->name, BAD_CAST "html")) {
-                    rootNode = [[HTMLNode alloc] initWithXMLNode:xmlDocRootNode];
-                }
-                else
-                    errorCode = 3;
+        htmlDoc_ = htmlDoc;
+        arena_ = arena;
+        if (htmlDoc_) {
+            xmlNodePtr xmlDocRootNode = xmlDocGetRootElement(htmlDoc_);
+            if (xmlDocRootNode && [self isValidRootNode:xmlDocRootNode]) {
+                htmlDoc_->_private = (__bridge void *)self; // back reference retained by the nodes
+                xpathContextLock_ = [[NSLock alloc] init];
+                documentOrderLock_ = [[NSLock alloc] init];
             }
             else
-                errorCode = 2;
-		}
-		else
-            errorCode = 1;
+                errorCode = 3;
+        }
+        else
+            errorCode = 2;
         
         if (errorCode) {
             if (error)
@@ -144,6 +428,10 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
             return nil;
         }
     }
+    else if (arena)
+        HTMLArenaFree(arena);
+    else
+        xmlFreeDoc(htmlDoc);
 	return self;
 }
 
@@ -154,11 +442,46 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
 
 - (INSTANCETYPE_OR_ID)initWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding error:(NSError **)error
 {
+    return [self initWithContentsOfURL:url encoding:encoding loadingMode:HTMLDocumentLoadingModeDefault error:error];
+}
+
+- (INSTANCETYPE_OR_ID)initWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode error:(NSError **)error
+{
+    return [self initWithContentsOfURL:url encoding:encoding loadingMode:loadingMode options:HTMLDocumentParseOptionDefault error:error];
+}
+
+- (INSTANCETYPE_OR_ID)initWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode options:(HTMLDocumentParseOptions)options error:(NSError **)error
+{
+    if (loadingMode == HTMLDocumentLoadingModeFileDescriptor && [url isFileURL]) {
+        int fd = open([url fileSystemRepresentation], O_RDONLY);
+        if (fd < 0) {
+            if (error)
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSURLErrorKey: url}];
+            
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        struct stat fileStatus = {0};
+        if (fstat(fd, &fileStatus) == 0 && fileStatus.st_size == 0) {
+            close(fd);
+            return [self initWithData:nil encoding:encoding options:options error:error];
+        }
+        char encodingBuffer[32];
+        HTMLInstrumentationInterval parseInterval = HTMLInstrumentationBegin(HTMLInstrumentationParse);
+        htmlDocPtr htmlDoc = [self parseFileDescriptor:fd encoding:convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer)) options:(int)options];
+        HTMLInstrumentationEnd(&parseInterval);
+        close(fd);
+        self = [self initWithHTMLDoc:htmlDoc error:error];
+        [self recordParseInterval:&parseInterval inputLength:(NSUInteger)fileStatus.st_size];
+        return self;
+    }
     
-    NSData *data = [NSData dataWithContentsOfURL:url options:0 error:error];
-    if (data && *error == nil) {
-        return [self initWithData:data encoding:encoding error:error];
+    NSDataReadingOptions readingOptions = (loadingMode == HTMLDocumentLoadingModeDefault) ? 0 : NSDataReadingMappedIfSafe;
+    NSData *data = [NSData dataWithContentsOfURL:url options:readingOptions error:error];
+    if (data) {
+        return [self initWithData:data encoding:encoding options:options error:error];
     }
+    SAFE_ARC_RELEASE(self);
 	return nil;
 }
 
@@ -180,15 +503,97 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
 }
 
 
+#pragma mark - parser hooks
+
+- (htmlDocPtr)parseBytes:(const char *)bytes length:(int)length encoding:(const char *)encoding options:(int)options
+{
+    return htmlReadMemory(bytes, length, NULL, encoding, options);
+}
+
+- (htmlDocPtr)parseFileDescriptor:(int)fd encoding:(const char *)encoding options:(int)options
+{
+    return htmlReadFd(fd, NULL, encoding, options);
+}
+
+- (BOOL)isValidRootNode:(xmlNodePtr)xmlDocRootNode
+{
+    return xmlStrEqual(xmlDocRootNode->name, BAD_CAST "html");
+}
+
+
 - (void)dealloc
 {
-    SAFE_ARC_RELEASE(rootNode);
-    xmlFreeDoc(htmlDoc_);
+    HTMLNodeIndexFree(nodeIndex_);
+    if (xpathContext_) xmlXPathFreeContext(xpathContext_);
+    SAFE_ARC_RELEASE(xpathContextLock_);
+    SAFE_ARC_RELEASE(documentOrderLock_);
+    // the tree of an arena is released with the arena in one step
+    if (arena_)
+        HTMLArenaFree(arena_);
+    else
+        xmlFreeDoc(htmlDoc_);
 	SAFE_ARC_SUPER_DEALLOC();
 }
 
+#pragma mark - node index
+
+- (BOOL)isIndexingEnabled
+{
+    @synchronized(self) {
+        return indexingEnabled_;
+    }
+}
+
+- (void)setIndexingEnabled:(BOOL)flag
+{
+    @synchronized(self) {
+        indexingEnabled_ = flag;
+        if (flag == NO) {
+            HTMLNodeIndexFree(nodeIndex_);
+            nodeIndex_ = NULL;
+        }
+    }
+}
+
+- (HTMLNodeIndex *)nodeIndex
+{
+    @synchronized(self) {
+        if (indexingEnabled_ && nodeIndex_ == NULL)
+            nodeIndex_ = HTMLNodeIndexCreate(htmlDoc_);
+        return nodeIndex_;
+    }
+}
+
+#pragma mark - document order
+
+- (void)prepareDocumentOrder
+{
+    [documentOrderLock_ lock];
+    if (!elementsOrdered_ && htmlDoc_) {
+        xmlXPathOrderDocElems(htmlDoc_);
+        elementsOrdered_ = YES;
+    }
+    [documentOrderLock_ unlock];
+}
+
+#pragma mark - XPath context
+
+- (void)performWithXPathContext:(void (^)(xmlXPathContext *xpathContext))block
+{
+    [xpathContextLock_ lock];
+    if (xpathContext_ == NULL) xpathContext_ = xmlXPathNewContext(htmlDoc_);
+    block(xpathContext_);
+    [xpathContextLock_ unlock];
+}
+
 #pragma mark - frequently used nodes
 
+- (HTMLNode *)rootNode
+{
+    // the root node is created on demand, a stored node would retain its own document
+    return [HTMLNode nodeWithXMLNode:xmlDocGetRootElement(htmlDoc_)];
+}
+
 - (HTMLNode *)head
 {
 	return [self.rootNode childOfTag:@"head"];
@@ -220,6 +625,11 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
     return SAFE_ARC_AUTORELEASE([[XMLDocument alloc] initWithData:data error:error]);
 }
 
++ (XMLDocument *)documentWithData:(NSData *)data encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[XMLDocument alloc] initWithData:data encoding:encoding options:options error:error]);
+}
+
 + (XMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding error:(NSError **)error
 {
     return SAFE_ARC_AUTORELEASE([[XMLDocument alloc] initWithContentsOfURL:url encoding:encoding error:error]);
@@ -230,6 +640,16 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
     return SAFE_ARC_AUTORELEASE([[XMLDocument alloc] initWithContentsOfURL:url error:error]);
 }
 
++ (XMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[XMLDocument alloc] initWithContentsOfURL:url encoding:encoding loadingMode:loadingMode error:error]);
+}
+
++ (XMLDocument *)documentWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding loadingMode:(HTMLDocumentLoadingMode)loadingMode options:(HTMLDocumentParseOptions)options error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[XMLDocument alloc] initWithContentsOfURL:url encoding:encoding loadingMode:loadingMode options:options error:error]);
+}
+
 + (XMLDocument *)documentWithHTMLString:(NSString *)string encoding:(NSStringEncoding )encoding error:(NSError **)error
 {
     return SAFE_ARC_AUTORELEASE([[XMLDocument alloc] initWithHTMLString:string encoding:encoding error:error]);
@@ -240,40 +660,24 @@ const char * convertStringEncoding(NSStringEncoding encoding, char * buffer, siz
     return SAFE_ARC_AUTORELEASE([[XMLDocument alloc] initWithHTMLString:string error:error]);
 }
 
-- (INSTANCETYPE_OR_ID)initWithData:(NSData *)data encoding:(NSStringEncoding )encoding error:(NSError **)error
+#pragma mark - parser hooks
+
+// the bit of HTML_PARSE_NOIMPLIED is XML_PARSE_NSCLEAN in the XML parser
+#define XML_PARSE_OPTIONS(options) ((options) & ~HTMLDocumentParseOptionNoImplied)
+
+- (htmlDocPtr)parseBytes:(const char *)bytes length:(int)length encoding:(const char *)encoding options:(int)options
 {
-    self = [super init];
-    if (self) {
-        NSInteger errorCode = 0;
-		if (data && [data length]) {
-            int xmlParseOptions = XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING;
-            char encodingBuffer[32];
-            xmlDoc_ = xmlReadMemory([data bytes], (int)[data length], NULL, convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer)), xmlParseOptions);
-            if (xmlDoc_) {
-                xmlNodePtr xmlDocRootNode = xmlDocGetRootElement(xmlDoc_);
-                if (xmlDocRootNode) {
-                    rootNode = [[HTMLNode alloc] initWithXMLNode:xmlDocRootNode];
-                }
-                else
-                    errorCode = 3;
-            }
-            else
-                errorCode = 2;
-		}
-		else
-            errorCode = 1;
-        
-        if (errorCode) {
-            if (error)
-                *error = [self errorForCode:errorCode];
-            
-            SAFE_ARC_RELEASE(self);
-            return nil;
-        }
-    }
-	return self;
+    return xmlReadMemory(bytes, length, NULL, encoding, XML_PARSE_OPTIONS(options));
 }
 
-@end
+- (htmlDocPtr)parseFileDescriptor:(int)fd encoding:(const char *)encoding options:(int)options
+{
+    return xmlReadFd(fd, NULL, encoding, XML_PARSE_OPTIONS(options));
+}
 
+- (BOOL)isValidRootNode:(xmlNodePtr)xmlDocRootNode
+{
+    return YES;
+}
 
+@end
@@ -0,0 +1,152 @@
+/*###################################################################################
+#                                                                                   #
+#     HTMLInstrumentation.h                                                         #
+#     Optional timing, counters and signposts of parsing and queries                #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #import HTMLInstrumentation.h                                  #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+#import "HTMLDocument.h"
+#include <stdatomic.h>
+
+// The instrumentation measures the parsing of documents and the queries of nodes in production code.
+// It's disabled by default, while it's disabled each hook costs one test of a flag. While it's enabled
+// the outermost call of each query is counted and timed, and os_signpost intervals of the subsystem
+// com.klieme.HTMLDocument are emitted around parsing and queries for Instruments
+
+// The kinds of queries counted separately
+typedef NS_ENUM(NSUInteger, HTMLQueryKind) {
+    HTMLQueryKindSearch,    // the tag, attribute, class name, enumeration and batch queries of HTMLNode
+    HTMLQueryKindXPath,     // the XPath queries of HTMLNode+XPath
+    HTMLQueryKindCSS,       // the selector queries of HTMLNode+CSS
+    HTMLQueryKindCount
+};
+
+// The totals of the queries of one kind since the instrumentation was enabled or reset
+typedef struct {
+    uint64_t calls;             // the number of queries
+    uint64_t nodesVisited;      // the nodes the queries compared, XPath queries are evaluated by libxml2 and visit none
+    uint64_t matches;           // the nodes returned or passed to an enumeration block
+    uint64_t wrappersAllocated; // the HTMLNode objects created by the queries
+    uint64_t duration;          // the time spent in the queries in nanoseconds, enumerations include their blocks and the queries within them
+} HTMLQueryCounters;
+
+// The measurements of one document
+typedef struct {
+    NSTimeInterval parseTime;       // the duration of the parser call, 0 if the document wasn't parsed while the instrumentation was enabled
+    NSUInteger inputLength;         // the length of the parsed bytes, 0 if unknown like parseTime
+    NSUInteger numberOfNodes;       // all nodes of the tree except attributes
+    NSUInteger numberOfElements;
+    NSUInteger numberOfAttributes;
+    NSUInteger estimatedTreeMemory; // the bytes of the node structures and their strings, names shared in the dictionary of the document aren't included
+} HTMLDocumentMetrics;
+
+// Enables or disables the instrumentation of all documents and queries, the counters are kept
+void HTMLInstrumentationSetEnabled(BOOL enabled);
+BOOL HTMLInstrumentationIsEnabled(void);
+// Returns the totals of one kind of queries, the counters are updated atomically by all threads
+HTMLQueryCounters HTMLInstrumentationQueryCounters(HTMLQueryKind kind);
+// Sets all query counters to zero
+void HTMLInstrumentationReset(void);
+
+@interface HTMLDocument (Instrumentation)
+
+/*! Returns the measurements of the document, the counts walk the whole tree on every call
+ * \returns The metrics of the document
+ */
+- (HTMLDocumentMetrics)metrics;
+
+@end
+
+#pragma mark - hooks of the library
+
+// The interval of one parse or query, the fields are only set if active
+typedef struct {
+    BOOL active;
+    BOOL outermost;             // NO for the nested calls of a recursive query which are measured by the outermost call
+    NSUInteger kind;            // a HTMLQueryKind or HTMLInstrumentationParse
+    uint64_t start;
+    uint64_t nodesVisited;
+    uint64_t matches;
+    uint64_t wrappers;
+    uint64_t signpostID;
+    NSTimeInterval duration;    // set by HTMLInstrumentationEnd()
+} HTMLInstrumentationInterval;
+
+// The per-thread counters of the current query
+typedef struct {
+    NSUInteger depth;
+    uint64_t nodesVisited;
+    uint64_t matches;
+    uint64_t wrappers;
+} HTMLInstrumentationThreadCounters;
+
+#define HTMLInstrumentationParse HTMLQueryKindCount
+
+// the flag is toggled while other threads parse and query, the hooks load it relaxed
+extern _Atomic(BOOL) HTMLInstrumentationActive;
+#define HTMLInstrumentationIsActive() atomic_load_explicit(&HTMLInstrumentationActive, memory_order_relaxed)
+extern __thread HTMLInstrumentationThreadCounters HTMLInstrumentationThread;
+
+void HTMLInstrumentationStart(HTMLInstrumentationInterval * interval, NSUInteger kind);
+void HTMLInstrumentationStop(HTMLInstrumentationInterval * interval);
+
+static inline HTMLInstrumentationInterval HTMLInstrumentationBegin(NSUInteger kind)
+{
+    HTMLInstrumentationInterval interval = {0};
+    if (__builtin_expect(HTMLInstrumentationIsActive(), NO)) HTMLInstrumentationStart(&interval, kind);
+    return interval;
+}
+
+static inline void HTMLInstrumentationEnd(HTMLInstrumentationInterval * interval)
+{
+    if (interval->active) HTMLInstrumentationStop(interval);
+}
+
+// Measures the enclosing function as a query of the kind, from here to each return
+#define HTML_INSTRUMENT_QUERY(kind) \
+    HTMLInstrumentationInterval htmlInstrumentationInterval __attribute__((cleanup(HTMLInstrumentationEnd), unused)) = HTMLInstrumentationBegin(kind)
+
+// Counts a node compared by the current query
+#define HTML_INSTRUMENT_VISIT() \
+    do { if (__builtin_expect(HTMLInstrumentationIsActive(), NO)) HTMLInstrumentationThread.nodesVisited++; } while (0)
+
+// Counts a match which is passed to the caller without creating an HTMLNode object
+#define HTML_INSTRUMENT_MATCH() \
+    do { if (__builtin_expect(HTMLInstrumentationIsActive(), NO)) HTMLInstrumentationThread.matches++; } while (0)
+
+// Counts a created HTMLNode object and a match if it wraps a node
+#define HTML_INSTRUMENT_WRAPPER(node) \
+    do { if (__builtin_expect(HTMLInstrumentationIsActive(), NO)) { HTMLInstrumentationThread.wrappers++; if (node) HTMLInstrumentationThread.matches++; } } while (0)
+
+@interface HTMLDocument (InstrumentationHooks)
+
+// Stores the parse measurement of an active interval in the document
+- (void)recordParseInterval:(const HTMLInstrumentationInterval *)interval inputLength:(NSUInteger)length;
+
+@end
@@ -0,0 +1,281 @@
+/*###################################################################################
+#                                                                                   #
+#     HTMLInstrumentation.m                                                         #
+#     Optional timing, counters and signposts of parsing and queries                #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #import HTMLInstrumentation.h                                  #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+#import "HTMLInstrumentation.h"
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+#if __has_include(<os/signpost.h>)
+#include <os/signpost.h>
+#define HTML_INSTRUMENTATION_SIGNPOSTS 1
+#endif
+
+// declared in HTMLNode.m
+xmlNode * nextNodeInSubtree(xmlNode * node, xmlNode * root);
+
+_Atomic(BOOL) HTMLInstrumentationActive = NO;
+__thread HTMLInstrumentationThreadCounters HTMLInstrumentationThread;
+
+typedef struct {
+    _Atomic(uint64_t) calls;
+    _Atomic(uint64_t) nodesVisited;
+    _Atomic(uint64_t) matches;
+    _Atomic(uint64_t) wrappersAllocated;
+    _Atomic(uint64_t) duration;
+} HTMLAtomicQueryCounters;
+
+static HTMLAtomicQueryCounters queryCounters[HTMLQueryKindCount];
+
+void HTMLInstrumentationSetEnabled(BOOL enabled)
+{
+    atomic_store_explicit(&HTMLInstrumentationActive, enabled, memory_order_relaxed);
+}
+
+BOOL HTMLInstrumentationIsEnabled(void)
+{
+    return HTMLInstrumentationIsActive();
+}
+
+HTMLQueryCounters HTMLInstrumentationQueryCounters(HTMLQueryKind kind)
+{
+    HTMLQueryCounters counters = {0};
+    if (kind >= HTMLQueryKindCount) return counters;
+    
+    HTMLAtomicQueryCounters *atomicCounters = &queryCounters[kind];
+    counters.calls = atomic_load_explicit(&atomicCounters->calls, memory_order_relaxed);
+    counters.nodesVisited = atomic_load_explicit(&atomicCounters->nodesVisited, memory_order_relaxed);
+    counters.matches = atomic_load_explicit(&atomicCounters->matches, memory_order_relaxed);
+    counters.wrappersAllocated = atomic_load_explicit(&atomicCounters->wrappersAllocated, memory_order_relaxed);
+    counters.duration = atomic_load_explicit(&atomicCounters->duration, memory_order_relaxed);
+    return counters;
+}
+
+void HTMLInstrumentationReset(void)
+{
+    for (NSUInteger kind = 0; kind < HTMLQueryKindCount; kind++) {
+        HTMLAtomicQueryCounters *atomicCounters = &queryCounters[kind];
+        atomic_store_explicit(&atomicCounters->calls, 0, memory_order_relaxed);
+        atomic_store_explicit(&atomicCounters->nodesVisited, 0, memory_order_relaxed);
+        atomic_store_explicit(&atomicCounters->matches, 0, memory_order_relaxed);
+        atomic_store_explicit(&atomicCounters->wrappersAllocated, 0, memory_order_relaxed);
+        atomic_store_explicit(&atomicCounters->duration, 0, memory_order_relaxed);
+    }
+}
+
+#pragma mark - intervals
+
+static uint64_t nanosecondsOfTicks(uint64_t ticks)
+{
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return ticks * timebase.numer / timebase.denom;
+}
+
+#if HTML_INSTRUMENTATION_SIGNPOSTS
+
+static os_log_t signpostLog(void) API_AVAILABLE(macos(10.14), ios(12.0), tvos(12.0), watchos(5.0));
+
+static os_log_t signpostLog(void)
+{
+    static os_log_t log;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        log = os_log_create("com.klieme.HTMLDocument", "PointsOfInterest");
+    });
+    return log;
+}
+
+// the names of the intervals must be string literals
+static void beginSignpost(HTMLInstrumentationInterval * interval)
+{
+    if (@available(macOS 10.14, iOS 12.0, tvOS 12.0, watchOS 5.0, *)) {
+        os_log_t log = signpostLog();
+        if (! os_signpost_enabled(log)) return;
+        
+        os_signpost_id_t signpostID = os_signpost_id_generate(log);
+        interval->signpostID = signpostID;
+        switch (interval->kind) {
+            case HTMLQueryKindSearch: os_signpost_interval_begin(log, signpostID, "Search"); break;
+            case HTMLQueryKindXPath: os_signpost_interval_begin(log, signpostID, "XPath"); break;
+            case HTMLQueryKindCSS: os_signpost_interval_begin(log, signpostID, "CSS"); break;
+            default: os_signpost_interval_begin(log, signpostID, "Parse"); break;
+        }
+    }
+}
+
+static void endSignpost(HTMLInstrumentationInterval * interval)
+{
+    if (interval->signpostID == 0) return;
+    if (@available(macOS 10.14, iOS 12.0, tvOS 12.0, watchOS 5.0, *)) {
+        os_log_t log = signpostLog();
+        os_signpost_id_t signpostID = interval->signpostID;
+        switch (interval->kind) {
+            case HTMLQueryKindSearch:
+                os_signpost_interval_end(log, signpostID, "Search", "visited %llu, matches %llu", interval->nodesVisited, interval->matches);
+                break;
+            case HTMLQueryKindXPath:
+                os_signpost_interval_end(log, signpostID, "XPath", "matches %llu", interval->matches);
+                break;
+            case HTMLQueryKindCSS:
+                os_signpost_interval_end(log, signpostID, "CSS", "visited %llu, matches %llu", interval->nodesVisited, interval->matches);
+                break;
+            default:
+                os_signpost_interval_end(log, signpostID, "Parse");
+                break;
+        }
+    }
+}
+
+#endif
+
+// The nested calls of a recursive query only track the depth, the thread counters of the outermost call are read at its end
+void HTMLInstrumentationStart(HTMLInstrumentationInterval * interval, NSUInteger kind)
+{
+    interval->active = YES;
+    interval->kind = kind;
+    if (kind == HTMLInstrumentationParse) {
+        interval->outermost = YES;
+    }
+    else {
+        interval->outermost = (HTMLInstrumentationThread.depth++ == 0);
+        if (! interval->outermost) return;
+        
+        interval->nodesVisited = HTMLInstrumentationThread.nodesVisited;
+        interval->matches = HTMLInstrumentationThread.matches;
+        interval->wrappers = HTMLInstrumentationThread.wrappers;
+    }
+#if HTML_INSTRUMENTATION_SIGNPOSTS
+    beginSignpost(interval);
+#endif
+    interval->start = mach_absolute_time();
+}
+
+void HTMLInstrumentationStop(HTMLInstrumentationInterval * interval)
+{
+    uint64_t duration = nanosecondsOfTicks(mach_absolute_time() - interval->start);
+    if (interval->kind == HTMLInstrumentationParse) {
+        interval->duration = (NSTimeInterval)duration / NSEC_PER_SEC;
+    }
+    else {
+        HTMLInstrumentationThread.depth--;
+        if (! interval->outermost) return;
+        
+        interval->nodesVisited = HTMLInstrumentationThread.nodesVisited - interval->nodesVisited;
+        interval->matches = HTMLInstrumentationThread.matches - interval->matches;
+        interval->wrappers = HTMLInstrumentationThread.wrappers - interval->wrappers;
+        interval->duration = (NSTimeInterval)duration / NSEC_PER_SEC;
+        
+        HTMLAtomicQueryCounters *atomicCounters = &queryCounters[interval->kind];
+        atomic_fetch_add_explicit(&atomicCounters->calls, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&atomicCounters->nodesVisited, interval->nodesVisited, memory_order_relaxed);
+        atomic_fetch_add_explicit(&atomicCounters->matches, interval->matches, memory_order_relaxed);
+        atomic_fetch_add_explicit(&atomicCounters->wrappersAllocated, interval->wrappers, memory_order_relaxed);
+        atomic_fetch_add_explicit(&atomicCounters->duration, duration, memory_order_relaxed);
+    }
+#if HTML_INSTRUMENTATION_SIGNPOSTS
+    endSignpost(interval);
+#endif
+}
+
+#pragma mark - document metrics
+
+// the bytes of a string owned by the node, names from the dictionary and inline content of compact text nodes are shared
+static size_t stringMemory(const xmlChar * string, xmlDictPtr dict)
+{
+    if (string == NULL || (dict && xmlDictOwns(dict, string) == 1)) return 0;
+    return (size_t)xmlStrlen(string) + 1;
+}
+
+@implementation HTMLDocument (Instrumentation)
+
+- (HTMLDocumentMetrics)metrics
+{
+    HTMLDocumentMetrics metrics = {0};
+    metrics.parseTime = parseTime_;
+    metrics.inputLength = inputLength_;
+    if (htmlDoc_ == NULL) return metrics;
+    
+    xmlDictPtr dict = htmlDoc_->dict;
+    size_t memory = sizeof(xmlDoc) + stringMemory(htmlDoc_->URL, NULL) + stringMemory(htmlDoc_->encoding, NULL);
+    
+    for (xmlNode *node = htmlDoc_->children; node; node = nextNodeInSubtree(node, (xmlNode *)htmlDoc_)) {
+        metrics.numberOfNodes++;
+        switch (node->type) {
+            case XML_ELEMENT_NODE:
+                metrics.numberOfElements++;
+                memory += sizeof(xmlNode) + stringMemory(node->name, dict);
+                for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+                    metrics.numberOfAttributes++;
+                    memory += sizeof(xmlAttr) + stringMemory(attr->name, dict);
+                    for (xmlNode *child = attr->children; child; child = child->next) {
+                        memory += sizeof(xmlNode) + stringMemory(child->content, dict);
+                    }
+                }
+                break;
+                
+            case XML_PI_NODE:
+                memory += stringMemory(node->name, dict);
+                // fall through
+            case XML_TEXT_NODE:
+            case XML_CDATA_SECTION_NODE:
+            case XML_COMMENT_NODE:
+                // the names of text and comment nodes are static strings
+                memory += sizeof(xmlNode);
+                if (node->content != (xmlChar *)&node->properties) memory += stringMemory(node->content, dict);
+                break;
+                
+            case XML_DTD_NODE:
+                memory += sizeof(xmlDtd);
+                break;
+                
+            default:
+                // the declarations of the DTD have structures of their own, the size of a node is an approximation
+                memory += sizeof(xmlNode);
+                break;
+        }
+    }
+    metrics.estimatedTreeMemory = memory;
+    return metrics;
+}
+
+@end
+
+@implementation HTMLDocument (InstrumentationHooks)
+
+- (void)recordParseInterval:(const HTMLInstrumentationInterval *)interval inputLength:(NSUInteger)length
+{
+    if (! interval->active) return;
+    parseTime_ = interval->duration;
+    inputLength_ = length;
+}
+
+@end
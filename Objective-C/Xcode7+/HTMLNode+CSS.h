@@ -0,0 +1,133 @@
+/*###################################################################################
+#                                                                                   #
+#     HTMLNode+CSS.h                                                                #
+#     Category of HTMLNode for CSS selector support                                 #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #import HTMLNode+CSS.h                                         #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+
+#import "HTMLNode.h"
+
+// HTMLSelector is a compiled CSS selector. The selector string is parsed once and the object can be reused
+// for any number of queries, it's immutable and may be shared between threads.
+// The nodes are matched from right to left directly on the libxml2 tree, no XPath expression is built or compiled.
+//
+// Supported syntax:
+//   type selectors and *, #id, .class
+//   [attr], [attr=value], [attr~=value], [attr|=value], [attr^=value], [attr$=value], [attr*=value]
+//   :nth-child(an+b | odd | even), :nth-last-child(...), :first-child, :last-child
+//   the combinators descendant (whitespace), child (>), adjacent sibling (+) and general sibling (~)
+//   comma separated selector lists
+// Tag and attribute names are compared case-insensitively, attribute values case-sensitively.
+
+@interface HTMLSelector : NSObject
+{
+    struct HTMLSelectorComplex * complexes_;
+    int numberOfComplexes_;
+    NSString * selectorString_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns a compiled selector
+ * \param string The CSS selector string
+ * \param error An error object that, on return, identifies the syntax error of the selector
+ * \returns A compiled selector, or nil if the string isn't a valid or supported selector
+ */
++ (nullable HTMLSelector *)selectorWithString:(NSString *)string error:(NSError **)error;
+
+/*! Initializes and returns a compiled selector
+ * \param string The CSS selector string
+ * \param error An error object that, on return, identifies the syntax error of the selector
+ * \returns A compiled selector, or nil if the string isn't a valid or supported selector
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithString:(NSString *)string error:(NSError **)error; // designated initializer
+
+/*! The selector string*/
+@property (readonly, copy) NSString *selectorString;
+
+/*! Returns whether a node matches the selector
+ * \param node The node to test
+ * \returns YES if the node is an element matching any selector of the list
+ */
+- (BOOL)matchesNode:(HTMLNode *)node;
+
+NS_ASSUME_NONNULL_END
+
+@end
+
+
+
+@interface HTMLNode (CSS)
+
+// CSS query methods, all methods consider the descendants of the receiver in document order
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns the first descendant node matching a compiled selector
+ * \param selector The compiled selector
+ * \returns The first found descendant node or nil if no node matches the selector
+ */
+- (nullable HTMLNode *)nodeMatchingSelector:(HTMLSelector *)selector;
+
+/*! Returns all descendant nodes matching a compiled selector
+ * \param selector The compiled selector
+ * \returns The array of all found descendant nodes or an empty array
+ */
+- (NSArray<HTMLNode *> *)nodesMatchingSelector:(HTMLSelector *)selector;
+
+/*! Calls the block for each descendant node matching a compiled selector, the matches are passed in the same reused node object
+ * \param selector The compiled selector
+ * \param block The block called for each matching node, set stop to YES to end the enumeration
+ */
+- (void)enumerateNodesMatchingSelector:(HTMLSelector *)selector usingBlock:(HTMLNodeEnumerationBlock)block;
+
+/*! Returns whether the receiver matches a compiled selector
+ * \param selector The compiled selector
+ * \returns YES if the receiver matches the selector
+ */
+- (BOOL)matchesSelector:(HTMLSelector *)selector;
+
+/*! Returns the first descendant node matching a CSS selector string, the string is compiled on each call
+ * \param selector The CSS selector string
+ * \param error An error object that, on return, identifies the syntax error of the selector
+ * \returns The first found descendant node or nil if no node matches the selector
+ */
+- (nullable HTMLNode *)nodeForCSSSelector:(NSString *)selector error:(NSError **)error;
+
+/*! Returns all descendant nodes matching a CSS selector string, the string is compiled on each call
+ * \param selector The CSS selector string
+ * \param error An error object that, on return, identifies the syntax error of the selector
+ * \returns The array of all found descendant nodes or an empty array
+ */
+- (NSArray<HTMLNode *> *)nodesForCSSSelector:(NSString *)selector error:(NSError **)error;
+
+NS_ASSUME_NONNULL_END
+
+@end
@@ -0,0 +1,734 @@
+/*###################################################################################
+#                                                                                   #
+#     HTMLNode+CSS.m                                                                #
+#     Category of HTMLNode for CSS selector support                                 #
+#                                                                                   #
+#     Copyright © 2014 by Stefan Klieme                                             #
+#                                                                                   #
+#     Objective-C wrapper for HTML parser of libxml2                                #
+#                                                                                   #
+#     Version 1.8 - 14. Dez 2015 for Xcode 7+                                       #
+#                                                                                   #
+#     usage:     add #import HTMLNode+CSS.h                                         #
+#                                                                                   #
+#                                                                                   #
+#####################################################################################
+#                                                                                   #
+# Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+# this software and associated documentation files (the "Software"), to deal        #
+# in the Software without restriction, including without limitation the rights      #
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+# of the Software, and to permit persons to whom the Software is furnished to do    #
+# so, subject to the following conditions:                                          #
+# The above copyright notice and this permission notice shall be included in        #
+# all copies or substantial portions of the Software.                               #
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+# IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+#                                                                                   #
+###################################################################################*/
+
+
+
+#import "HTMLNode+CSS.h"
+#import "HTMLInstrumentation.h"
+
+// declared in HTMLNode.m
+xmlNode * nextNodeInSubtree(xmlNode * node, xmlNode * root);
+
+#pragma mark - selector parser
+
+typedef NS_ENUM(NSUInteger, HTMLSelectorCombinator) {
+    HTMLSelectorCombinatorNone = 0,         // the leftmost compound selector
+    HTMLSelectorCombinatorDescendant,       // whitespace
+    HTMLSelectorCombinatorChild,            // >
+    HTMLSelectorCombinatorAdjacentSibling,  // +
+    HTMLSelectorCombinatorGeneralSibling    // ~
+};
+
+typedef NS_ENUM(NSUInteger, HTMLSelectorOperator) {
+    HTMLSelectorOperatorExists = 0, // [attr]
+    HTMLSelectorOperatorEquals,     // [attr=value], #id
+    HTMLSelectorOperatorIncludes,   // [attr~=value], .class
+    HTMLSelectorOperatorDashMatch,  // [attr|=value]
+    HTMLSelectorOperatorPrefix,     // [attr^=value]
+    HTMLSelectorOperatorSuffix,     // [attr$=value]
+    HTMLSelectorOperatorSubstring   // [attr*=value]
+};
+
+typedef struct {
+    xmlChar * name;
+    xmlChar * value;
+    int valueLength;
+    HTMLSelectorOperator operator;
+} HTMLSelectorAttribute;
+
+// one compound selector like div.item[title]:nth-child(2n+1)
+typedef struct {
+    xmlChar * tagName;                  // NULL matches any element
+    HTMLSelectorAttribute * attributes; // ids and classes are stored as attribute conditions
+    int attributeCount;
+    BOOL hasNth;
+    BOOL nthFromEnd;
+    int nthA, nthB;                     // position a*n+b among the element siblings
+    HTMLSelectorCombinator combinator;  // relation to the compound selector on the left
+} HTMLSelectorCompound;
+
+// one complex selector of a comma separated list, the compound selectors from left to right
+typedef struct HTMLSelectorComplex {
+    HTMLSelectorCompound * compounds;
+    int count;
+} HTMLSelectorComplex;
+
+typedef struct {
+    const char * cursor;
+    const char * start;
+    const char * errorMessage;
+} HTMLSelectorParser;
+
+#define SELECTOR_WHITESPACE " \t\n\f\r"
+
+static void freeSelectorComplexes(HTMLSelectorComplex * complexes, int count)
+{
+    if (complexes == NULL) return;
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < complexes[i].count; j++) {
+            HTMLSelectorCompound *compound = &complexes[i].compounds[j];
+            xmlFree(compound->tagName);
+            for (int k = 0; k < compound->attributeCount; k++) {
+                xmlFree(compound->attributes[k].name);
+                xmlFree(compound->attributes[k].value);
+            }
+            xmlFree(compound->attributes);
+        }
+        xmlFree(complexes[i].compounds);
+    }
+    xmlFree(complexes);
+}
+
+static void *growArray(void * array, int count, size_t elementSize)
+{
+    // the arrays grow by one element, selectors are short
+    void *newArray = xmlRealloc(array, (count + 1) * elementSize);
+    if (newArray) memset((char *)newArray + count * elementSize, 0, elementSize);
+    return newArray;
+}
+
+static BOOL isIdentifierCharacter(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c >= 0x80 || c == '\\';
+}
+
+static void skipWhitespace(HTMLSelectorParser * parser)
+{
+    parser->cursor += strspn(parser->cursor, SELECTOR_WHITESPACE);
+}
+
+// copies an identifier or a quoted string and resolves backslash escapes
+static xmlChar * parseIdentifierOrString(HTMLSelectorParser * parser, BOOL allowString)
+{
+    const char *cursor = parser->cursor;
+    char quote = 0;
+
+    if (allowString && (*cursor == '"' || *cursor == '\'')) quote = *cursor++;
+    else if (! isIdentifierCharacter(*cursor)) {
+        parser->errorMessage = "Identifier expected";
+        return NULL;
+    }
+
+    xmlChar *result = xmlMalloc(strlen(cursor) + 1);
+    if (result == NULL) {
+        parser->errorMessage = "Out of memory";
+        return NULL;
+    }
+    size_t length = 0;
+    while (*cursor) {
+        if (quote) {
+            if (*cursor == quote) break;
+        }
+        else if (! isIdentifierCharacter(*cursor)) break;
+
+        if (*cursor == '\\' && cursor[1]) cursor++;
+        result[length++] = *cursor++;
+    }
+    if (quote) {
+        if (*cursor != quote) {
+            xmlFree(result);
+            parser->errorMessage = "Unterminated string";
+            return NULL;
+        }
+        cursor++;
+    }
+    result[length] = 0;
+    parser->cursor = cursor;
+    return result;
+}
+
+static BOOL addAttributeCondition(HTMLSelectorCompound * compound, xmlChar * name, xmlChar * value, HTMLSelectorOperator operator)
+{
+    HTMLSelectorAttribute *attributes = growArray(compound->attributes, compound->attributeCount, sizeof(HTMLSelectorAttribute));
+    if (attributes == NULL) {
+        xmlFree(name);
+        xmlFree(value);
+        return NO;
+    }
+    compound->attributes = attributes;
+    HTMLSelectorAttribute *attribute = &attributes[compound->attributeCount++];
+    attribute->name = name;
+    attribute->value = value;
+    attribute->valueLength = (value) ? xmlStrlen(value) : 0;
+    attribute->operator = operator;
+    return YES;
+}
+
+static BOOL parseAttributeSelector(HTMLSelectorParser * parser, HTMLSelectorCompound * compound)
+{
+    parser->cursor++; // [
+    skipWhitespace(parser);
+    xmlChar *name = parseIdentifierOrString(parser, NO);
+    if (name == NULL) return NO;
+    skipWhitespace(parser);
+
+    HTMLSelectorOperator operator = HTMLSelectorOperatorExists;
+    switch (*parser->cursor) {
+        case '=': operator = HTMLSelectorOperatorEquals; break;
+        case '~': operator = HTMLSelectorOperatorIncludes; break;
+        case '|': operator = HTMLSelectorOperatorDashMatch; break;
+        case '^': operator = HTMLSelectorOperatorPrefix; break;
+        case '$': operator = HTMLSelectorOperatorSuffix; break;
+        case '*': operator = HTMLSelectorOperatorSubstring; break;
+        case ']': break;
+        default:
+            xmlFree(name);
+            parser->errorMessage = "Invalid attribute selector";
+            return NO;
+    }
+
+    xmlChar *value = NULL;
+    if (operator != HTMLSelectorOperatorExists) {
+        parser->cursor += (operator == HTMLSelectorOperatorEquals) ? 1 : 2;
+        if (operator != HTMLSelectorOperatorEquals && parser->cursor[-1] != '=') {
+            xmlFree(name);
+            parser->errorMessage = "Invalid attribute operator";
+            return NO;
+        }
+        skipWhitespace(parser);
+        value = parseIdentifierOrString(parser, YES);
+        if (value == NULL) {
+            xmlFree(name);
+            return NO;
+        }
+        skipWhitespace(parser);
+    }
+    if (*parser->cursor != ']') {
+        xmlFree(name);
+        xmlFree(value);
+        parser->errorMessage = "] expected";
+        return NO;
+    }
+    parser->cursor++;
+
+    if (! addAttributeCondition(compound, name, value, operator)) {
+        parser->errorMessage = "Out of memory";
+        return NO;
+    }
+    return YES;
+}
+
+static BOOL parseInteger(HTMLSelectorParser * parser, int * result)
+{
+    char *end;
+    long value = strtol(parser->cursor, &end, 10);
+    // the value is limited to int like the Swift version instead of being truncated
+    if (end == parser->cursor || value < 0 || value > INT_MAX) return NO;
+    parser->cursor = end;
+    *result = (int)value;
+    return YES;
+}
+
+// an+b, odd or even
+static BOOL parseNthExpression(HTMLSelectorParser * parser, HTMLSelectorCompound * compound)
+{
+    skipWhitespace(parser);
+    compound->hasNth = YES;
+
+    if (strncasecmp(parser->cursor, "odd", 3) == 0) {
+        compound->nthA = 2; compound->nthB = 1;
+        parser->cursor += 3;
+    }
+    else if (strncasecmp(parser->cursor, "even", 4) == 0) {
+        compound->nthA = 2; compound->nthB = 0;
+        parser->cursor += 4;
+    }
+    else {
+        int sign = 1, a = 0, b = 0;
+        if (*parser->cursor == '+' || *parser->cursor == '-') {
+            if (*parser->cursor == '-') sign = -1;
+            parser->cursor++;
+        }
+        BOOL hasNumber = (*parser->cursor >= '0' && *parser->cursor <= '9') && parseInteger(parser, &a);
+        if (*parser->cursor == 'n' || *parser->cursor == 'N') {
+            parser->cursor++;
+            a = sign * ((hasNumber) ? a : 1);
+            skipWhitespace(parser);
+            if (*parser->cursor == '+' || *parser->cursor == '-') {
+                int bSign = (*parser->cursor == '-') ? -1 : 1;
+                parser->cursor++;
+                skipWhitespace(parser);
+                if (! parseInteger(parser, &b)) {
+                    parser->errorMessage = "Invalid nth expression";
+                    return NO;
+                }
+                b *= bSign;
+            }
+        }
+        else if (hasNumber) {
+            b = sign * a;
+            a = 0;
+        }
+        else {
+            parser->errorMessage = "Invalid nth expression";
+            return NO;
+        }
+        compound->nthA = a; compound->nthB = b;
+    }
+    skipWhitespace(parser);
+    if (*parser->cursor != ')') {
+        parser->errorMessage = ") expected";
+        return NO;
+    }
+    parser->cursor++;
+    return YES;
+}
+
+static BOOL parsePseudoClass(HTMLSelectorParser * parser, HTMLSelectorCompound * compound)
+{
+    parser->cursor++; // :
+    if (compound->hasNth) {
+        parser->errorMessage = "Only one structural pseudo-class per compound selector is supported";
+        return NO;
+    }
+    if (strncasecmp(parser->cursor, "nth-child(", 10) == 0) {
+        parser->cursor += 10;
+        return parseNthExpression(parser, compound);
+    }
+    if (strncasecmp(parser->cursor, "nth-last-child(", 15) == 0) {
+        parser->cursor += 15;
+        compound->nthFromEnd = YES;
+        return parseNthExpression(parser, compound);
+    }
+
+    const char *name = parser->cursor;
+    while (isIdentifierCharacter(*parser->cursor)) parser->cursor++;
+    size_t length = parser->cursor - name;
+
+    if (length == 11 && strncasecmp(name, "first-child", length) == 0) {
+        compound->hasNth = YES; compound->nthA = 0; compound->nthB = 1;
+    }
+    else if (length == 10 && strncasecmp(name, "last-child", length) == 0) {
+        compound->hasNth = YES; compound->nthFromEnd = YES; compound->nthA = 0; compound->nthB = 1;
+    }
+    else {
+        parser->cursor = name;
+        parser->errorMessage = "Unsupported pseudo-class";
+        return NO;
+    }
+    return YES;
+}
+
+static BOOL parseCompound(HTMLSelectorParser * parser, HTMLSelectorCompound * compound)
+{
+    const char *start = parser->cursor;
+
+    if (*parser->cursor == '*') parser->cursor++;
+    else if (isIdentifierCharacter(*parser->cursor)) {
+        compound->tagName = parseIdentifierOrString(parser, NO);
+        if (compound->tagName == NULL) return NO;
+    }
+
+    while (*parser->cursor) {
+        char c = *parser->cursor;
+        if (c == '#' || c == '.') {
+            parser->cursor++;
+            xmlChar *value = parseIdentifierOrString(parser, NO);
+            if (value == NULL) return NO;
+            xmlChar *name = xmlStrdup(BAD_CAST ((c == '#') ? "id" : "class"));
+            if (! addAttributeCondition(compound, name, value, (c == '#') ? HTMLSelectorOperatorEquals : HTMLSelectorOperatorIncludes)) {
+                parser->errorMessage = "Out of memory";
+                return NO;
+            }
+        }
+        else if (c == '[') {
+            if (! parseAttributeSelector(parser, compound)) return NO;
+        }
+        else if (c == ':') {
+            if (! parsePseudoClass(parser, compound)) return NO;
+        }
+        else break;
+    }
+
+    if (parser->cursor == start) {
+        parser->errorMessage = "Selector expected";
+        return NO;
+    }
+    return YES;
+}
+
+// Parses a comma separated list of complex selectors, returns NULL and sets the error message of the parser on failure
+static HTMLSelectorComplex * parseSelectorList(HTMLSelectorParser * parser, int * count)
+{
+    HTMLSelectorComplex *complexes = NULL;
+    *count = 0;
+
+    skipWhitespace(parser);
+    while (YES) {
+        complexes = growArray(complexes, *count, sizeof(HTMLSelectorComplex));
+        if (complexes == NULL) {
+            parser->errorMessage = "Out of memory";
+            return NULL;
+        }
+        HTMLSelectorComplex *complex = &complexes[(*count)++];
+        HTMLSelectorCombinator combinator = HTMLSelectorCombinatorNone;
+
+        while (YES) {
+            HTMLSelectorCompound *compounds = growArray(complex->compounds, complex->count, sizeof(HTMLSelectorCompound));
+            if (compounds == NULL) {
+                parser->errorMessage = "Out of memory";
+                break;
+            }
+            complex->compounds = compounds;
+            HTMLSelectorCompound *compound = &compounds[complex->count++];
+            compound->combinator = combinator;
+            if (! parseCompound(parser, compound)) break;
+
+            const char *end = parser->cursor;
+            skipWhitespace(parser);
+            char c = *parser->cursor;
+            if (c == 0 || c == ',') break;
+
+            if (c == '>' || c == '+' || c == '~') {
+                combinator = (c == '>') ? HTMLSelectorCombinatorChild : (c == '+') ? HTMLSelectorCombinatorAdjacentSibling : HTMLSelectorCombinatorGeneralSibling;
+                parser->cursor++;
+                skipWhitespace(parser);
+            }
+            else if (parser->cursor > end)
+                combinator = HTMLSelectorCombinatorDescendant;
+            else {
+                parser->errorMessage = "Unexpected character";
+                break;
+            }
+        }
+        if (parser->errorMessage) break;
+
+        if (*parser->cursor == 0) return complexes;
+        parser->cursor++; // ,
+        skipWhitespace(parser);
+    }
+    freeSelectorComplexes(complexes, *count);
+    *count = 0;
+    return NULL;
+}
+
+#pragma mark - matching
+
+static const xmlChar * attributeValueOfNode(xmlNode * node, const xmlChar * name, BOOL * found)
+{
+    for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+        if (xmlStrcasecmp(attr->name, name) == 0) {
+            *found = YES;
+            return (attr->children && attr->children->content) ? attr->children->content : BAD_CAST "";
+        }
+    }
+    *found = NO;
+    return NULL;
+}
+
+static BOOL attributeConditionMatches(const HTMLSelectorAttribute * attribute, xmlNode * node)
+{
+    BOOL found;
+    const xmlChar *value = attributeValueOfNode(node, attribute->name, &found);
+    if (! found) return NO;
+
+    switch (attribute->operator) {
+        case HTMLSelectorOperatorExists:
+            return YES;
+
+        case HTMLSelectorOperatorEquals:
+            return xmlStrEqual(value, attribute->value);
+
+        case HTMLSelectorOperatorIncludes: {
+            if (attribute->valueLength == 0) return NO;
+            const char *token = (const char *)value;
+            while (*(token += strspn(token, SELECTOR_WHITESPACE))) {
+                size_t length = strcspn(token, SELECTOR_WHITESPACE);
+                if (length == (size_t)attribute->valueLength && memcmp(token, attribute->value, length) == 0) return YES;
+                token += length;
+            }
+            return NO;
+        }
+
+        case HTMLSelectorOperatorDashMatch:
+            return xmlStrncmp(value, attribute->value, attribute->valueLength) == 0
+                && (value[attribute->valueLength] == 0 || value[attribute->valueLength] == '-');
+
+        case HTMLSelectorOperatorPrefix:
+            return attribute->valueLength && xmlStrncmp(value, attribute->value, attribute->valueLength) == 0;
+
+        case HTMLSelectorOperatorSuffix: {
+            int length = xmlStrlen(value);
+            return attribute->valueLength && length >= attribute->valueLength && xmlStrEqual(value + length - attribute->valueLength, attribute->value);
+        }
+
+        case HTMLSelectorOperatorSubstring:
+            return attribute->valueLength && xmlStrstr(value, attribute->value) != NULL;
+    }
+    return NO;
+}
+
+static xmlNode * previousElementSibling(xmlNode * node)
+{
+    for (node = node->prev; node; node = node->prev) {
+        if (node->type == XML_ELEMENT_NODE) return node;
+    }
+    return NULL;
+}
+
+static xmlNode * parentElement(xmlNode * node)
+{
+    xmlNode *parent = node->parent;
+    return (parent && parent->type == XML_ELEMENT_NODE) ? parent : NULL;
+}
+
+static BOOL compoundMatches(const HTMLSelectorCompound * compound, xmlNode * node)
+{
+    if (node->type != XML_ELEMENT_NODE) return NO;
+    if (compound->tagName && xmlStrcasecmp(node->name, compound->tagName) != 0) return NO;
+
+    for (int i = 0; i < compound->attributeCount; i++) {
+        if (! attributeConditionMatches(&compound->attributes[i], node)) return NO;
+    }
+
+    if (compound->hasNth) {
+        int position = 1;
+        for (xmlNode *sibling = (compound->nthFromEnd) ? node->next : node->prev; sibling; sibling = (compound->nthFromEnd) ? sibling->next : sibling->prev) {
+            if (sibling->type == XML_ELEMENT_NODE) position++;
+        }
+        if (compound->nthA == 0) return position == compound->nthB;
+        int steps = position - compound->nthB;
+        return (steps % compound->nthA == 0) && (steps / compound->nthA >= 0);
+    }
+    return YES;
+}
+
+// Matches the compound selector at index and the ones on its left, from right to left
+static BOOL complexMatchesAtIndex(const HTMLSelectorComplex * complex, int index, xmlNode * node)
+{
+    const HTMLSelectorCompound *compound = &complex->compounds[index];
+    if (! compoundMatches(compound, node)) return NO;
+    if (index == 0) return YES;
+
+    switch (compound->combinator) {
+        case HTMLSelectorCombinatorChild: {
+            xmlNode *parent = parentElement(node);
+            return parent && complexMatchesAtIndex(complex, index - 1, parent);
+        }
+
+        case HTMLSelectorCombinatorDescendant:
+            for (xmlNode *ancestor = parentElement(node); ancestor; ancestor = parentElement(ancestor)) {
+                if (complexMatchesAtIndex(complex, index - 1, ancestor)) return YES;
+            }
+            return NO;
+
+        case HTMLSelectorCombinatorAdjacentSibling: {
+            xmlNode *sibling = previousElementSibling(node);
+            return sibling && complexMatchesAtIndex(complex, index - 1, sibling);
+        }
+
+        case HTMLSelectorCombinatorGeneralSibling:
+            for (xmlNode *sibling = previousElementSibling(node); sibling; sibling = previousElementSibling(sibling)) {
+                if (complexMatchesAtIndex(complex, index - 1, sibling)) return YES;
+            }
+            return NO;
+
+        case HTMLSelectorCombinatorNone:
+            break;
+    }
+    return NO;
+}
+
+static BOOL selectorListMatches(const HTMLSelectorComplex * complexes, int count, xmlNode * node)
+{
+    if (node->type != XML_ELEMENT_NODE) return NO;
+
+    for (int i = 0; i < count; i++) {
+        if (complexMatchesAtIndex(&complexes[i], complexes[i].count - 1, node)) return YES;
+    }
+    return NO;
+}
+
+@interface HTMLSelector ()
+
+- (BOOL)matchesXMLNode:(xmlNode *)node;
+
+@end
+
+
+
+@implementation HTMLSelector
+@synthesize selectorString = selectorString_;
+
+#pragma mark - error handling
+
+- (NSError *)errorForCode:(NSInteger )errorCode reason:(NSString *)reason
+{
+    NSString *errorString = @"";
+    switch (errorCode) {
+        case 1:
+            errorString = @"Invalid selector";
+            break;
+            
+        case 2:
+            errorString = @"Selector must not be nil value";
+            break;
+    }
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithObject:errorString forKey:NSLocalizedDescriptionKey];
+    if (reason) userInfo[NSLocalizedFailureReasonErrorKey] = reason;
+    return [NSError errorWithDomain:[@"com.klieme." stringByAppendingString: NSStringFromClass([self class])]
+                               code:errorCode
+                           userInfo:userInfo];
+}
+
+#pragma mark - class method
+
++ (HTMLSelector *)selectorWithString:(NSString *)string error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLSelector alloc] initWithString:string error:error]);
+}
+
+#pragma mark - init method
+
+- (INSTANCETYPE_OR_ID)initWithString:(NSString *)string error:(NSError **)error
+{
+    self = [super init];
+    if (self) {
+        if (string == nil) {
+            if (error) *error = [self errorForCode:2 reason:nil];
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        const char *cString = [string UTF8String];
+        HTMLSelectorParser parser = {cString, cString, NULL};
+        complexes_ = parseSelectorList(&parser, &numberOfComplexes_);
+        if (complexes_ == NULL) {
+            if (error) {
+                NSString *reason = [NSString stringWithFormat:@"%s at position %ld of '%@'", parser.errorMessage, (long)(parser.cursor - parser.start), string];
+                *error = [self errorForCode:1 reason:reason];
+            }
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        selectorString_ = [string copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    freeSelectorComplexes(complexes_, numberOfComplexes_);
+    SAFE_ARC_RELEASE(selectorString_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+#pragma mark - matching
+
+- (BOOL)matchesXMLNode:(xmlNode *)node
+{
+    return node && selectorListMatches(complexes_, numberOfComplexes_, node);
+}
+
+- (BOOL)matchesNode:(HTMLNode *)node
+{
+    return [node matchesSelector:self];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %@>", NSStringFromClass([self class]), selectorString_];
+}
+
+@end
+
+
+
+@implementation HTMLNode (CSS)
+
+- (HTMLNode *)nodeMatchingSelector:(HTMLSelector *)selector
+{
+    if (selector == nil || xmlNode_ == NULL) return nil;
+    
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindCSS);
+    for (xmlNode *currentNode = xmlNode_->children; currentNode; currentNode = nextNodeInSubtree(currentNode, xmlNode_)) {
+        HTML_INSTRUMENT_VISIT();
+        if ([selector matchesXMLNode:currentNode]) return [HTMLNode nodeWithXMLNode:currentNode];
+    }
+    return nil;
+}
+
+- (NSArray<HTMLNode *> *)nodesMatchingSelector:(HTMLSelector *)selector
+{
+    NSMutableArray *array = [NSMutableArray array];
+    if (selector == nil || xmlNode_ == NULL) return array;
+    
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindCSS);
+    for (xmlNode *currentNode = xmlNode_->children; currentNode; currentNode = nextNodeInSubtree(currentNode, xmlNode_)) {
+        HTML_INSTRUMENT_VISIT();
+        if ([selector matchesXMLNode:currentNode]) {
+            HTMLNode *matchingNode = [[HTMLNode alloc] initWithXMLNode:currentNode];
+            [array addObject:matchingNode];
+            SAFE_ARC_RELEASE(matchingNode);
+        }
+    }
+    return array;
+}
+
+- (void)enumerateNodesMatchingSelector:(HTMLSelector *)selector usingBlock:(HTMLNodeEnumerationBlock)block
+{
+    if (selector == nil || xmlNode_ == NULL || xmlNode_->children == NULL) return;
+    
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindCSS);
+    HTMLNode *flyweightNode = [[HTMLNode alloc] initWithXMLNode:NULL];
+    BOOL stop = NO;
+    
+    for (xmlNode *currentNode = xmlNode_->children; currentNode; currentNode = nextNodeInSubtree(currentNode, xmlNode_)) {
+        HTML_INSTRUMENT_VISIT();
+        if ([selector matchesXMLNode:currentNode]) {
+            HTML_INSTRUMENT_MATCH();
+            flyweightNode->xmlNode_ = currentNode;
+            block(flyweightNode, &stop);
+            if (stop) break;
+        }
+    }
+    flyweightNode->xmlNode_ = NULL;
+    SAFE_ARC_RELEASE(flyweightNode);
+}
+
+- (BOOL)matchesSelector:(HTMLSelector *)selector
+{
+    return [selector matchesXMLNode:xmlNode_];
+}
+
+- (HTMLNode *)nodeForCSSSelector:(NSString *)selector error:(NSError **)error
+{
+    return [self nodeMatchingSelector:[HTMLSelector selectorWithString:selector error:error]];
+}
+
+- (NSArray<HTMLNode *> *)nodesForCSSSelector:(NSString *)selector error:(NSError **)error
+{
+    return [self nodesMatchingSelector:[HTMLSelector selectorWithString:selector error:error]];
+}
+
+@end
@@ -32,6 +32,7 @@
 ###################################################################################*/
 
 #import "HTMLNode.h"
+#import <libxml/xpath.h>
 
 #if !defined(__clang__) || __clang_major__ < 3
 
@@ -46,6 +47,46 @@
 #endif
 
 
+// HTMLXPathQuery is a compiled XPath expression. The expression is compiled once and the object can be reused
+// for any number of queries of any document, it's immutable.
+// The query string methods of the category compile each string once per thread and keep the 64 most recently used
+// expressions in a cache of the current thread. The XPath context is reused per document, see HTMLDocument.
+// The specific query methods pass the attribute values as XPath variable $value, the expressions don't depend on the values.
+
+@interface HTMLXPathQuery : NSObject
+{
+    xmlXPathCompExprPtr compiledExpression_;
+    NSString * queryString_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns a compiled XPath query
+ * \param query The XPath query string
+ * \param error An error object that, on return, identifies the compilation error
+ * \returns A compiled query, or nil if the expression can't be compiled
+ */
++ (nullable HTMLXPathQuery *)queryWithString:(NSString *)query error:(NSError **)error;
+
+/*! Initializes and returns a compiled XPath query
+ * \param query The XPath query string
+ * \param error An error object that, on return, identifies the compilation error
+ * \returns A compiled query, or nil if the expression can't be compiled
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithString:(NSString *)query error:(NSError **)error; // designated initializer
+
+/*! The XPath query string*/
+@property (readonly, copy) NSString *queryString;
+
+/*! The compiled expression, owned by the receiver*/
+@property (readonly) xmlXPathCompExprPtr compiledExpression;
+
+NS_ASSUME_NONNULL_END
+
+@end
+
+
+
 @interface HTMLNode (XPath)
 
 // Xpath query methods
@@ -78,6 +119,20 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSArray<HTMLNode *> *)nodesForXPath:(NSString *)query;
 
+/*! Returns the first descendant node for a compiled XPath query
+ * \param query The compiled XPath query
+ * \param error An error object that, on return, identifies any Xpath errors.
+ * \returns The first found descendant node or nil if no node matches the parameters
+ */
+- (nullable HTMLNode *)nodeForXPathQuery:(HTMLXPathQuery *)query error:(NSError **)error;
+
+/*! Returns all descendant nodes for a compiled XPath query
+ * \param query The compiled XPath query
+ * \param error An error object that, on return, identifies any Xpath errors.
+ * \returns The array of all found descendant nodes or an empty array
+ */
+- (NSArray<HTMLNode *> *)nodesForXPathQuery:(HTMLXPathQuery *)query error:(NSError **)error;
+
 // Note: In the HTMLNode main class all appropriate query methods begin with descendant instead of node 
 
 /*! Returns the first descendant node for a specified tag name
@@ -310,13 +365,18 @@ NS_ASSUME_NONNULL_BEGIN
 - (NSArray<HTMLNode *> *)nodesWithClass:(NSString *)classValue;
 
 
-// Compare two nodes w.r.t document order with XPath
+// Node objects are equal if they represent the same xmlNode, so they can be de-duplicated in an NSSet
 /*! Returns a Boolean value that indicates whether the receiver is equal to another given object
  * \param node The node with which to compare the receiver
- * \returns YES if the receiver is equal to the node, otherwise NO. In effect returns NO if receiver is nil
+ * \returns YES if the receiver represents the same xmlNode as the node, otherwise NO. In effect returns NO if receiver is nil
  */
 - (BOOL)isEqual:(nullable HTMLNode *)node;
 
+/*! Returns a hash value derived from the xmlNode pointer, equal nodes have the same hash value
+ * \returns The hash value
+ */
+- (NSUInteger)hash;
+
 
 - (void)setErrorWithMessage:(NSString *)message andCode:(NSInteger)code;
 
@@ -33,61 +33,169 @@
 
 
 #import "HTMLNode+XPath.h"
+#import "HTMLDocument.h"
+#import "HTMLInstrumentation.h"
 #import <libxml/xpath.h>
 #import <libxml/xpathInternals.h>
 
+#define XPATH_QUERY_CACHE_SIZE 64
+#define XPATH_ERROR_MESSAGE_SIZE 256
+
+// The first XPath error of one compilation or evaluation, the error hook of the XPath context writes it to the caller's stack
+typedef struct {
+    int code;
+    char message[XPATH_ERROR_MESSAGE_SIZE];
+} HTMLXPathErrorState;
+
+// the predicates with attribute values refer to the variable $value, the formatted strings don't depend on the values
 static NSString *kXPathPredicateNode = @"/descendant::%@";
 static NSString *kXPathPredicateNodeWithAttribute = @"//%@[@%@]";
 static NSString *kXPathPredicateAttribute = @"//*[@%@]";
-static NSString *kXPathPredicateAttributeIsEqual = @"//*[@%@ ='%@']";
-static NSString *kXPathPredicateAttributeBeginsWith = @"//*[starts-with(@%@,'%@')]";
-static NSString *kXPathPredicateAttributeEndsWith = @"//*['%@' = substring(@%@, string-length(@%@)- string-length('%@') +1)]";
-static NSString *kXPathPredicateAttributeContains = @"//*[contains(@%@,'%@')]";
-
-static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleNode, BOOL considerError, HTMLNode *htmlNode);
-static void XPathErrorCallback(void *node, xmlErrorPtr err);
+static NSString *kXPathPredicateAttributeIsEqual = @"//*[@%@ = $value]";
+static NSString *kXPathPredicateAttributeBeginsWith = @"//*[starts-with(@%@, $value)]";
+static NSString *kXPathPredicateAttributeEndsWith = @"//*[$value = substring(@%@, string-length(@%@) - string-length($value) + 1)]";
+static NSString *kXPathPredicateAttributeContains = @"//*[contains(@%@, $value)]";
+
+// the messages of the XPath errors 1200 - 1222 as defined in xpath.c of libxml2
+static const char *kXPathErrorMessages[] = {
+    "Ok", "Number encoding", "Unfinished literal", "Start of literal", "Expected $ for variable reference",
+    "Undefined variable", "Invalid predicate", "Invalid expression", "Missing closing curly brace", "Unregistered function",
+    "Invalid operand", "Invalid type", "Invalid number of arguments", "Invalid context size", "Invalid context position",
+    "Memory allocation error", "Syntax error", "Resource error", "Sub resource error", "Undefined namespace prefix",
+    "Encoding error", "Char out of XML range", "Invalid or incomplete context"
+};
+
+static NSString *kXPathQueryCacheKey = @"com.klieme.HTMLXPathQueryCache";
+static NSString *kXPathQueryCacheOrderKey = @"com.klieme.HTMLXPathQueryCacheOrder";
+
+static id performXPathQuery(xmlNode * node, NSString * query, NSString * value, BOOL returnSingleNode, BOOL considerError, HTMLNode *htmlNode);
+static id evaluateXPathExpression(xmlNode * node, xmlXPathCompExprPtr expression, NSString * value, BOOL returnSingleNode, BOOL considerError, HTMLNode *htmlNode);
+static HTMLXPathQuery * cachedXPathQuery(NSString * query, NSError ** error);
+static void XPathErrorCallback(void *userData, xmlErrorPtr err);
+static NSError * XPathErrorWithCode(NSInteger code, NSString * description, const HTMLXPathErrorState * state);
 
 #pragma mark - static C functions
 
-// xpath error callback
-static void XPathErrorCallback(void *node, xmlErrorPtr err)
+// xpath error callback, installed as error hook of the XPath context with the HTMLXPathErrorState of the caller as user data.
+// Unlike the global structured error function the hook belongs to one context, parallel queries don't interfere
+static void XPathErrorCallback(void *userData, xmlErrorPtr err)
 {
-    NSInteger errorCode = (NSInteger )err->code;
+    HTMLXPathErrorState *state = userData;
+    if (state == NULL || state->code) return; // keep the first error
+    
+    int errorCode = err->code;
     if ((errorCode > 1199) && (errorCode < 1223)) { // filter XPath errors 1200 - 1222
-        char *errMessage = err->message;
-        NSString *errorMessage = (errMessage) ? [NSString stringWithUTF8String:errMessage] : @"unknown error";
-#if __has_feature(objc_arc)
-        [(__bridge_transfer HTMLNode *)node setErrorWithMessage:errorMessage andCode:errorCode];
-#else
-        [(HTMLNode *)node setErrorWithMessage:errorMessage andCode:errorCode];
-#endif
+        // the errors passed to the hook of a context have no message, the code and position describe the error
+        if (err->message)
+            strlcpy(state->message, err->message, sizeof(state->message));
+        else if (err->str1)
+            snprintf(state->message, sizeof(state->message), "%s at position %d", kXPathErrorMessages[errorCode - 1200], err->int1);
+        else
+            strlcpy(state->message, kXPathErrorMessages[errorCode - 1200], sizeof(state->message));
+        size_t length = strlen(state->message);
+        while (length && state->message[length - 1] == '\n') state->message[--length] = 0;
+        state->code = errorCode;
+    }
+}
+
+// Returns an error object with the message of a captured libxml2 error as failure reason
+static NSError * XPathErrorWithCode(NSInteger code, NSString * description, const HTMLXPathErrorState * state)
+{
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey];
+    if (state && state->code) {
+        NSString *reason = [NSString stringWithUTF8String:state->message];
+        if (reason) userInfo[NSLocalizedFailureReasonErrorKey] = reason;
+        userInfo[@"XPathErrorCode"] = @(state->code);
+    }
+    return [NSError errorWithDomain:@"com.klieme.HTMLDocument" code:code userInfo:userInfo];
+}
+
+// Returns the compiled query for a query string from the cache of the current thread.
+// On a miss the string is compiled and replaces the least recently used query if the cache is full
+static HTMLXPathQuery * cachedXPathQuery(NSString * query, NSError ** error)
+{
+    NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+    NSMutableDictionary *cache = threadDictionary[kXPathQueryCacheKey];
+    NSMutableArray *order = threadDictionary[kXPathQueryCacheOrderKey]; // the query strings, most recently used last
+    if (cache == nil) {
+        cache = [NSMutableDictionary dictionaryWithCapacity:XPATH_QUERY_CACHE_SIZE];
+        order = [NSMutableArray arrayWithCapacity:XPATH_QUERY_CACHE_SIZE];
+        threadDictionary[kXPathQueryCacheKey] = cache;
+        threadDictionary[kXPathQueryCacheOrderKey] = order;
+    }
+    
+    HTMLXPathQuery *compiledQuery = cache[query];
+    if (compiledQuery) {
+        if (! [[order lastObject] isEqualToString:query]) {
+            [order removeObject:query];
+            [order addObject:query];
+        }
+        return compiledQuery;
+    }
+    
+    compiledQuery = [HTMLXPathQuery queryWithString:query error:error];
+    if (compiledQuery == nil) return nil;
+    
+    if ([order count] == XPATH_QUERY_CACHE_SIZE) {
+        [cache removeObjectForKey:order[0]];
+        [order removeObjectAtIndex:0];
     }
+    NSString *key = compiledQuery.queryString; // immutable copy of the query string
+    cache[key] = compiledQuery;
+    [order addObject:key];
+    return compiledQuery;
 }
 
 
 // performXPathQuery() returns one HTMLNode object or an array of HTMLNode objects
 // if the query matches any nodes, otherwise nil.
 
-static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleNode, BOOL considerError, HTMLNode *htmlNode)
+static id performXPathQuery(xmlNode * node, NSString * query, NSString * value, BOOL returnSingleNode, BOOL considerError, HTMLNode *htmlNode)
 {
     if (query == nil) {
         if (considerError) [htmlNode setErrorWithMessage:@"query string must not be nil value" andCode:6];
         return nil;
     }
-    xmlXPathContextPtr xpathContext;
-    xmlXPathObjectPtr xpathObject;
-    id result = (returnSingleNode) ? nil : [NSMutableArray array];
     
-    xpathContext = xmlXPathNewContext((xmlDocPtr)node);
-    if (xpathContext) {
-        if (considerError)
-#if __has_feature(objc_arc)
-        { xmlSetStructuredErrorFunc((__bridge_retained void *)htmlNode, XPathErrorCallback); }
-#else
-        { xmlSetStructuredErrorFunc((void *)htmlNode, XPathErrorCallback); }
-#endif
+    NSError *compilationError = nil;
+    HTMLXPathQuery *compiledQuery = cachedXPathQuery(query, (considerError) ? &compilationError : NULL);
+    if (compiledQuery == nil) {
+        if (considerError) htmlNode.xpathError = compilationError;
+        return (returnSingleNode) ? nil : [NSMutableArray array];
+    }
+    return evaluateXPathExpression(node, compiledQuery.compiledExpression, value, returnSingleNode, considerError, htmlNode);
+}
+
+// Evaluates a compiled expression in the XPath context of the document of the node,
+// nodes of documents not owned by an HTMLDocument object use a temporary context
+
+static id evaluateXPathExpression(xmlNode * node, xmlXPathCompExprPtr expression, NSString * value, BOOL returnSingleNode, BOOL considerError, HTMLNode *htmlNode)
+{
+    __block id result = (returnSingleNode) ? nil : [NSMutableArray array];
+    if (node == NULL) return result;
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindXPath);
+    __block HTMLXPathErrorState errorState = {0};
+    
+    void (^evaluate)(xmlXPathContext *) = ^(xmlXPathContext *xpathContext) {
+        if (xpathContext == NULL) {
+            if (considerError) [htmlNode setErrorWithMessage:@"Could not create XPath context" andCode:4];
+            return;
+        }
+        // the node is passed as document, absolute paths start at the node
+        xpathContext->doc = (xmlDocPtr)node;
+        xpathContext->node = NULL;
+        xpathContext->contextSize = -1;
+        xpathContext->proximityPosition = -1;
+        xpathContext->error = XPathErrorCallback;
+        xpathContext->userData = &errorState;
+        if (value) xmlXPathRegisterVariable(xpathContext, BAD_CAST "value", xmlXPathNewString(BAD_CAST [value UTF8String]));
         
-        xpathObject = xmlXPathEvalExpression((xmlChar *)[query UTF8String], xpathContext);
+        xmlXPathObjectPtr xpathObject = xmlXPathCompiledEval(expression, xpathContext);
+        
+        if (value) xmlXPathRegisterVariable(xpathContext, BAD_CAST "value", NULL);
+        xpathContext->doc = node->doc;
+        xpathContext->error = NULL;
+        xpathContext->userData = NULL;
         
         if (xpathObject) {
             xmlNodeSetPtr nodes = xpathObject->nodesetval;
@@ -95,8 +203,6 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
                 if (returnSingleNode) {
                     result = [HTMLNode nodeWithXMLNode:nodes->nodeTab[0]];
                 } else {
-    
-                    
                     for (int i = 0; i < nodes->nodeNr; i++) {
                         HTMLNode *matchedNode = [[HTMLNode alloc] initWithXMLNode:nodes->nodeTab[i]];
                         [result addObject:matchedNode];
@@ -109,18 +215,96 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
             xmlXPathFreeObject(xpathObject);
         }
         else {
-            if (considerError) [htmlNode setErrorWithMessage:@"Could not evaluate XPath expression" andCode:5];
+            if (considerError) htmlNode.xpathError = XPathErrorWithCode(5, @"Could not evaluate XPath expression", &errorState);
         }
-        xmlXPathFreeContext(xpathContext);
-    }
-    else
-        if (considerError) [htmlNode setErrorWithMessage:@"Could not create XPath context" andCode:4];
+    };
     
+    HTMLDocument *document = (node->doc) ? (__bridge HTMLDocument *)node->doc->_private : nil;
+    if (document) {
+        [document performWithXPathContext:evaluate];
+    }
+    else {
+        xmlXPathContextPtr xpathContext = xmlXPathNewContext(node->doc);
+        evaluate(xpathContext);
+        if (xpathContext) xmlXPathFreeContext(xpathContext);
+    }
     return result;
 }
 
 #pragma mark
 
+@implementation HTMLXPathQuery
+
+#pragma mark - class method
+
++ (HTMLXPathQuery *)queryWithString:(NSString *)query error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLXPathQuery alloc] initWithString:query error:error]);
+}
+
+#pragma mark - init method
+
+- (INSTANCETYPE_OR_ID)initWithString:(NSString *)query error:(NSError **)error
+{
+    self = [super init];
+    if (self) {
+        HTMLXPathErrorState errorState = {0};
+        if (query) {
+            // a temporary context reports the errors of the compilation to the hook
+            xmlXPathContextPtr xpathContext = xmlXPathNewContext(NULL);
+            if (xpathContext) {
+                xpathContext->error = XPathErrorCallback;
+                xpathContext->userData = &errorState;
+                compiledExpression_ = xmlXPathCtxtCompile(xpathContext, BAD_CAST [query UTF8String]);
+                xmlXPathFreeContext(xpathContext);
+            }
+        }
+        if (compiledExpression_ == NULL) {
+            if (error) *error = [self errorForCode:(query) ? 7 : 6 state:&errorState];
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        queryString_ = [query copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (compiledExpression_) xmlXPathFreeCompExpr(compiledExpression_);
+    SAFE_ARC_RELEASE(queryString_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+#pragma mark - accessors
+
+- (NSString *)queryString
+{
+    return queryString_;
+}
+
+- (xmlXPathCompExprPtr)compiledExpression
+{
+    return compiledExpression_;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %@>", NSStringFromClass([self class]), queryString_];
+}
+
+#pragma mark - error handling
+
+- (NSError *)errorForCode:(NSInteger)errorCode state:(const HTMLXPathErrorState *)state
+{
+    NSString *errorString = (errorCode == 6) ? @"query string must not be nil value" : @"Could not compile XPath expression";
+    return XPathErrorWithCode(errorCode, errorString, state);
+}
+
+@end
+
+
+
 @implementation HTMLNode (XPath)
 
 #pragma mark - private getter
@@ -137,7 +321,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 - (HTMLNode *)nodeForXPath:(NSString *)query error:(NSError **)error
 {
     self.xpathError = nil;
-    HTMLNode *result = (HTMLNode *)performXPathQuery(xmlNode_, query, YES, error != nil, self);
+    HTMLNode *result = (HTMLNode *)performXPathQuery(xmlNode_, query, nil, YES, error != nil, self);
     if (error) *error = xpathError;
     return result;
 }
@@ -153,7 +337,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 - (NSArray<HTMLNode *> *)nodesForXPath:(NSString *)query error:(NSError **)error
 {
     self.xpathError = nil;
-    NSArray<HTMLNode *> *result = (NSArray<HTMLNode *> *)performXPathQuery(xmlNode_, query, NO, error != nil, self);
+    NSArray<HTMLNode *> *result = (NSArray<HTMLNode *> *)performXPathQuery(xmlNode_, query, nil, NO, error != nil, self);
     if (error) *error = xpathError;
     return result;
 }
@@ -163,6 +347,46 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
     return [self nodesForXPath:query error:nil];
 }
 
+// perform compiled XPath query
+
+- (HTMLNode *)nodeForXPathQuery:(HTMLXPathQuery *)query error:(NSError **)error
+{
+    self.xpathError = nil;
+    HTMLNode *result = nil;
+    if (query == nil) [self setErrorWithMessage:@"query must not be nil value" andCode:6];
+    else result = (HTMLNode *)evaluateXPathExpression(xmlNode_, query.compiledExpression, nil, YES, error != nil, self);
+    if (error) *error = xpathError;
+    return result;
+}
+
+- (NSArray<HTMLNode *> *)nodesForXPathQuery:(HTMLXPathQuery *)query error:(NSError **)error
+{
+    self.xpathError = nil;
+    NSArray<HTMLNode *> *result = @[];
+    if (query == nil) [self setErrorWithMessage:@"query must not be nil value" andCode:6];
+    else result = (NSArray<HTMLNode *> *)evaluateXPathExpression(xmlNode_, query.compiledExpression, nil, NO, error != nil, self);
+    if (error) *error = xpathError;
+    return result;
+}
+
+// perform a specific XPath query with the attribute value passed as variable $value
+
+- (HTMLNode *)nodeForXPath:(NSString *)query value:(NSString *)value error:(NSError **)error
+{
+    self.xpathError = nil;
+    HTMLNode *result = (HTMLNode *)performXPathQuery(xmlNode_, query, value, YES, error != nil, self);
+    if (error) *error = xpathError;
+    return result;
+}
+
+- (NSArray<HTMLNode *> *)nodesForXPath:(NSString *)query value:(NSString *)value error:(NSError **)error
+{
+    self.xpathError = nil;
+    NSArray<HTMLNode *> *result = (NSArray<HTMLNode *> *)performXPathQuery(xmlNode_, query, value, NO, error != nil, self);
+    if (error) *error = xpathError;
+    return result;
+}
+
 #pragma mark - specific XPath Query methods
 
 - (HTMLNode *)nodeOfTag:(NSString *)tagName error:(NSError **)error
@@ -227,7 +451,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 - (HTMLNode *)nodeWithAttribute:(NSString *)attributeName valueMatches:(NSString *)value error:(NSError **)error
 {
-    return [self nodeForXPath:[NSString stringWithFormat:kXPathPredicateAttributeIsEqual, attributeName, value] error:error];
+    return [self nodeForXPath:[NSString stringWithFormat:kXPathPredicateAttributeIsEqual, attributeName] value:value error:error];
 }
 
 - (HTMLNode *)nodeWithAttribute:(NSString *)attributeName valueMatches:(NSString *)value
@@ -237,7 +461,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 - (NSArray<HTMLNode *> *)nodesWithAttribute:(NSString *)attributeName valueMatches:(NSString *)value error:(NSError **)error
 {
-    return [self nodesForXPath:[NSString stringWithFormat:kXPathPredicateAttributeIsEqual, attributeName, value] error:error];
+    return [self nodesForXPath:[NSString stringWithFormat:kXPathPredicateAttributeIsEqual, attributeName] value:value error:error];
 }
 
 - (NSArray<HTMLNode *> *)nodesWithAttribute:(NSString *)attributeName valueMatches:(NSString *)value
@@ -247,7 +471,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 - (HTMLNode *)nodeWithAttribute:(NSString *)attributeName valueBeginsWith:(NSString *)value error:(NSError **)error
 {
-    return [self nodeForXPath:[NSString stringWithFormat:kXPathPredicateAttributeBeginsWith, attributeName, value] error:error];
+    return [self nodeForXPath:[NSString stringWithFormat:kXPathPredicateAttributeBeginsWith, attributeName] value:value error:error];
 }
 
 - (HTMLNode *)nodeWithAttribute:(NSString *)attributeName valueBeginsWith:(NSString *)value
@@ -257,7 +481,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 - (NSArray<HTMLNode *> *)nodesWithAttribute:(NSString *)attributeName valueBeginsWith:(NSString *)value error:(NSError **)error
 {
-    return [self nodesForXPath:[NSString stringWithFormat:kXPathPredicateAttributeBeginsWith, attributeName, value] error:error];
+    return [self nodesForXPath:[NSString stringWithFormat:kXPathPredicateAttributeBeginsWith, attributeName] value:value error:error];
 }
 
 - (NSArray<HTMLNode *> *)nodesWithAttribute:(NSString *)attributeName valueBeginsWith:(NSString *)value
@@ -267,7 +491,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 - (HTMLNode *)nodeWithAttribute:(NSString *)attributeName valueEndsWith:(NSString *)value error:(NSError **)error
 {
-    return [self nodeForXPath:[NSString stringWithFormat:kXPathPredicateAttributeEndsWith, value, attributeName, attributeName, value] error:error];
+    return [self nodeForXPath:[NSString stringWithFormat:kXPathPredicateAttributeEndsWith, attributeName, attributeName] value:value error:error];
 }
 
 - (HTMLNode *)nodeWithAttribute:(NSString *)attributeName valueEndsWith:(NSString *)value
@@ -277,7 +501,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 - (NSArray<HTMLNode *> *)nodesWithAttribute:(NSString *)attributeName valueEndsWith:(NSString *)value error:(NSError **)error
 {
-    return [self nodesForXPath:[NSString stringWithFormat:kXPathPredicateAttributeEndsWith, value, attributeName, attributeName, value] error:error];
+    return [self nodesForXPath:[NSString stringWithFormat:kXPathPredicateAttributeEndsWith, attributeName, attributeName] value:value error:error];
 }
 
 - (NSArray<HTMLNode *> *)nodesWithAttribute:(NSString *)attributeName valueEndsWith:(NSString *)value
@@ -287,7 +511,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 - (HTMLNode *)nodeWithAttribute:(NSString *)attributeName valueContains:(NSString *)value error:(NSError **)error
 {
-    return [self nodeForXPath:[NSString stringWithFormat:kXPathPredicateAttributeContains, attributeName, value] error:error];
+    return [self nodeForXPath:[NSString stringWithFormat:kXPathPredicateAttributeContains, attributeName] value:value error:error];
 }
 
 - (HTMLNode *)nodeWithAttribute:(NSString *)attributeName valueContains:(NSString *)value
@@ -297,7 +521,7 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 - (NSArray<HTMLNode *> *)nodesWithAttribute:(NSString *)attributeName valueContains:(NSString *)value error:(NSError **)error
 {
-    return [self nodesForXPath:[NSString stringWithFormat:kXPathPredicateAttributeContains, attributeName, value] error:error];
+    return [self nodesForXPath:[NSString stringWithFormat:kXPathPredicateAttributeContains, attributeName] value:value error:error];
 }
 
 - (NSArray<HTMLNode *> *)nodesWithAttribute:(NSString *)attributeName valueContains:(NSString *)value
@@ -327,12 +551,19 @@ static id performXPathQuery(xmlNode * node, NSString * query, BOOL returnSingleN
 
 #pragma mark - Overriding Equality
 
-//compare HTMLNode objects with XPath
+// HTMLNode objects are equal if they wrap the same xmlNode, the hash is derived from the pointer as well
 - (BOOL)isEqual:(HTMLNode *)node
 {
     if (node == self) return YES;
-    if (!node || ![node isKindOfClass: [self class]]) return NO;
-    return xmlXPathCmpNodes([self xmlNode], [node xmlNode]) == 0;
+    if (!node || ![node isKindOfClass:[HTMLNode class]]) return NO;
+    return [self xmlNode] == [node xmlNode];
+}
+
+- (NSUInteger)hash
+{
+    // the low bits of the aligned pointer are always zero
+    uintptr_t address = (uintptr_t)[self xmlNode];
+    return (NSUInteger)(address >> 4 ^ address >> 12);
 }
 
 #pragma mark - error handling
@@ -62,9 +62,193 @@
 #define INSTANCETYPE_OR_ID id
 #endif
 
-@interface HTMLNode : NSObject {
+@class HTMLNode, HTMLDocument;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// The node passed to the block is a reused object pointing to the current match, it's valid only during the call.
+// Send -copy to keep a match beyond the call
+typedef void (^HTMLNodeEnumerationBlock)(HTMLNode *node, BOOL *stop);
+
+// The name and the value passed to the block point into the document, they are valid as long as the document exists
+typedef void (^HTMLAttributeEnumerationBlock)(const char *attributeName, const char *attributeValue, BOOL *stop);
+
+NS_ASSUME_NONNULL_END
+
+// Opaque index of the element nodes of a document by id, class token and tag name, see HTMLDocument indexingEnabled
+typedef struct HTMLNodeIndex HTMLNodeIndex;
+
+// Creates the index of a document in one pass over the tree, the preorder numbers of the elements are stored in their _private fields
+HTMLNodeIndex * HTMLNodeIndexCreate(xmlDoc * doc);
+void HTMLNodeIndexFree(HTMLNodeIndex * nodeIndex);
+
+// The nodes visited by the enumeration methods
+typedef NS_ENUM(NSUInteger, HTMLNodeScope) {
+    HTMLNodeScopeChildren = 0,  // the first level of children
+    HTMLNodeScopeDescendants,   // all descendants in document order
+    HTMLNodeScopeSiblings       // the following siblings
+};
+
+// The comparison of the attribute value of a batch query
+typedef NS_ENUM(NSUInteger, HTMLNodeQueryMatch) {
+    HTMLNodeQueryMatchExists = 0,   // the attribute exists, the value is ignored
+    HTMLNodeQueryMatchEquals,       // the value matches exactly
+    HTMLNodeQueryMatchContains,     // the value contains the string
+    HTMLNodeQueryMatchBeginsWith,   // the value begins with the string
+    HTMLNodeQueryMatchEndsWith      // the value ends with the string
+};
+
+// One query of a batch evaluated by descendantsForQueries:, a node matches if it has the tag name and the attribute.
+// A nil tag name matches any node, a nil attribute name any tag name
+@interface HTMLNodeQuery : NSObject
+{
+    NSString * tagName_;
+    NSString * attributeName_;
+    NSString * value_;
+    HTMLNodeQueryMatch match_;
+    BOOL firstOnly_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns a query for a tag name and an attribute
+ * \param tagName The name of the tag or nil for any tag
+ * \param attributeName The name of the attribute or nil for no attribute condition
+ * \param match The comparison of the attribute value
+ * \param value The attribute value compared with the value of the attribute, ignored by HTMLNodeQueryMatchExists
+ * \param firstOnly YES to find only the first matching node
+ * \returns An initialized query
+ */
++ (HTMLNodeQuery *)queryWithTag:(nullable NSString *)tagName attribute:(nullable NSString *)attributeName match:(HTMLNodeQueryMatch)match value:(nullable NSString *)value firstOnly:(BOOL)firstOnly;
+
+/*! Returns a query for a tag name
+ * \param tagName The name of the tag
+ * \param firstOnly YES to find only the first matching node
+ * \returns An initialized query
+ */
++ (HTMLNodeQuery *)queryWithTag:(NSString *)tagName firstOnly:(BOOL)firstOnly;
+
+/*! Initializes and returns a query for a tag name and an attribute
+ * \param tagName The name of the tag or nil for any tag
+ * \param attributeName The name of the attribute or nil for no attribute condition
+ * \param match The comparison of the attribute value
+ * \param value The attribute value compared with the value of the attribute, ignored by HTMLNodeQueryMatchExists
+ * \param firstOnly YES to find only the first matching node
+ * \returns An initialized query
+ */
+- (INSTANCETYPE_OR_ID)initWithTag:(nullable NSString *)tagName attribute:(nullable NSString *)attributeName match:(HTMLNodeQueryMatch)match value:(nullable NSString *)value firstOnly:(BOOL)firstOnly; // designated initializer
+
+/*! The name of the tag or nil for any tag*/
+@property (readonly, copy, nullable) NSString *tagName;
+
+/*! The name of the attribute or nil for no attribute condition*/
+@property (readonly, copy, nullable) NSString *attributeName;
+
+/*! The attribute value compared with the value of the attribute*/
+@property (readonly, copy, nullable) NSString *value;
+
+/*! The comparison of the attribute value*/
+@property (readonly) HTMLNodeQueryMatch match;
+
+/*! YES if only the first matching node is found*/
+@property (readonly, getter=isFirstOnly) BOOL firstOnly;
+
+NS_ASSUME_NONNULL_END
+
+@end
+
+// The text of one cell of an HTMLTable, a range of the text buffer of the table
+typedef struct {
+    size_t offset;
+    size_t length;
+} HTMLTableCell;
+
+// The contents of a table element extracted in one pass: the text of each td and th cell is trimmed, collapsed and
+// stored in one buffer, the slots of the rows and columns reference the cells. A cell spanning several rows or columns
+// occupies all its slots, a rowspan is clipped at the last row of the table. The table doesn't reference the document
+@interface HTMLTable : NSObject
+{
+    xmlChar * bytes_;
+    HTMLTableCell * cells_;
+    size_t * slots_;
+    NSUInteger numberOfRows_;
+    NSUInteger numberOfColumns_;
+    NSUInteger numberOfHeaderRows_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Initializes and returns a table with the contents of a table element.
+ *  The rows are the tr children of the table and of its thead, tbody and tfoot sections, nested tables aren't considered
+ * \param tableNode The xmlNode pointer of the table element
+ * \returns An initialized table or nil if the node is not a table element or the contents couldn't be allocated
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithTableNode:(xmlNode *)tableNode; // designated initializer
+
+/*! The number of rows*/
+@property (readonly) NSUInteger numberOfRows;
+
+/*! The number of columns, the maximum number of slots of a row including the spans*/
+@property (readonly) NSUInteger numberOfColumns;
+
+/*! The number of leading rows in the thead section*/
+@property (readonly) NSUInteger numberOfHeaderRows;
+
+/*! Returns the text of the cell at a slot
+ * \param row The index of the row
+ * \param column The index of the column
+ * \returns The trimmed and collapsed text of the cell or nil if the slot is out of range or no cell occupies it
+ */
+- (nullable NSString *)stringAtRow:(NSUInteger)row column:(NSUInteger)column;
+
+/*! Returns the UTF-8 text of the cell at a slot without creating a string
+ * \param row The index of the row
+ * \param column The index of the column
+ * \param length The length of the text in bytes without the terminating 0 or NULL
+ * \returns The NUL terminated text pointing into the buffer of the table, it's valid as long as the table exists, or NULL if the slot is out of range or no cell occupies it
+ */
+- (nullable const char *)UTF8StringAtRow:(NSUInteger)row column:(NSUInteger)column length:(nullable NSUInteger *)length NS_RETURNS_INNER_POINTER;
+
+/*! Returns the texts of all slots of a row
+ * \param row The index of the row
+ * \returns An array of numberOfColumns strings, slots without cell or with undecodable text are empty strings, or an empty array if the row is out of range
+ */
+- (NSArray<NSString *> *)stringsInRow:(NSUInteger)row;
+
+/*! Returns the texts of all slots of a column
+ * \param column The index of the column
+ * \returns An array of numberOfRows strings, slots without cell or with undecodable text are empty strings, or an empty array if the column is out of range
+ */
+- (NSArray<NSString *> *)stringsInColumn:(NSUInteger)column;
+
+/*! Parses the double value of the cell at a slot directly from the UTF-8 text without locale and without creating a string
+ * \param value The parsed value, unchanged if the text is not a number
+ * \param row The index of the row
+ * \param column The index of the column
+ * \param decimalSeparator The ASCII decimal separator e.g. '.' or ','
+ * \param groupingSeparator The ASCII grouping separator ignored in the integer digits or 0 for none
+ * \returns YES if the slot has a cell whose text is a number, otherwise NO
+ */
+- (BOOL)getDoubleValue:(nullable double *)value atRow:(NSUInteger)row column:(NSUInteger)column decimalSeparator:(char)decimalSeparator groupingSeparator:(char)groupingSeparator;
+
+/*! Parses the double values of a column from a row to the last row like getDoubleValue:atRow:column:decimalSeparator:groupingSeparator:
+ * \param values A C array of at least numberOfRows - row doubles, slots which are not a number are set to NAN
+ * \param column The index of the column
+ * \param row The index of the first row e.g. numberOfHeaderRows
+ * \param decimalSeparator The ASCII decimal separator e.g. '.' or ','
+ * \param groupingSeparator The ASCII grouping separator ignored in the integer digits or 0 for none
+ * \returns The number of parsed numbers, 0 and no value is set if the column or the row is out of range
+ */
+- (NSUInteger)getDoubleValues:(double *)values inColumn:(NSUInteger)column fromRow:(NSUInteger)row decimalSeparator:(char)decimalSeparator groupingSeparator:(char)groupingSeparator;
+
+NS_ASSUME_NONNULL_END
+
+@end
+
+@interface HTMLNode : NSObject <NSCopying> {
     NSError * xpathError;
     xmlNode * xmlNode_;
+    HTMLDocument * document_;
 }
 
 NS_ASSUME_NONNULL_BEGIN
@@ -72,6 +256,10 @@ NS_ASSUME_NONNULL_BEGIN
 /*! An XPath error*/
 @property (SAFE_ARC_PROP_RETAIN, nullable)  NSError *xpathError;
 
+/*! The document of the node. The node retains it, the tree is freed when the document and the last of its nodes are released.
+ *  nil for nodes of a tree without HTMLDocument object and for the reused node objects passed to the enumeration blocks*/
+@property (SAFE_ARC_PROP_RETAIN, readonly, nullable) HTMLDocument *document;
+
 #pragma mark - init methods
 #pragma mark class
 // Returns a HTMLNode object initialized with a xml node pointer of xmllib
@@ -144,6 +332,30 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (SAFE_ARC_READONLY_OBJ_PROP, nullable) NSDictionary *attributes;
 
+/*! The UTF-8 attribute value of a node matching a given name without copy
+ * \param attributeName A name of an attribute
+ * \returns The null-terminated attribute value pointing into the document, it's valid as long as the document exists.
+ *  Returns NULL if the attribute could not be found or if its value consists of several nodes (entity references in XML documents)
+ */
+- (nullable const char *)UTF8ValueForAttribute:(const char *)attributeName NS_RETURNS_INNER_POINTER;
+
+/*! Compares the attribute value of a node matching a given name in place
+ * \param attributeName A name of an attribute
+ * \param value The null-terminated UTF-8 value
+ * \returns YES if the attribute exists and its value matches the value exactly, otherwise NO
+ */
+- (BOOL)attribute:(const char *)attributeName matchesUTF8Value:(const char *)value;
+
+/*! Enumerates the attributes of the node in document order without creating a dictionary or any objects
+ * \param block The block to apply to the UTF-8 name and value of each attribute, attributes consisting of several nodes are skipped
+ */
+- (void)enumerateAttributesUsingBlock:(HTMLAttributeEnumerationBlock)block;
+
+/*! Enumerates the attributes of the node in document order without creating a dictionary, common attribute names are passed as interned strings without allocation
+ * \param block The block to apply to the name and value of each attribute
+ */
+- (void)enumerateAttributeNamesAndValuesUsingBlock:(void (^)(NSString *attributeName, NSString *attributeValue, BOOL *stop))block;
+
 /*! The tag name
  * \returns The tag name or nil if the node is document node
  */
@@ -193,6 +405,22 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (double )contentDoubleValueForLocaleIdentifier:(NSString *)identifier consideringPlusSign:(BOOL)flag;
 
+/*! Parses the double value of the string value directly from the UTF-8 bytes without locale and without creating a string object
+ * \param value On return the double value if the string value is a number
+ * \param decimalSeparator The ASCII decimal separator e.g. '.' or ','
+ * \param groupingSeparator The ASCII grouping separator ignored in the integer digits or 0 for none
+ * \returns YES if the string value trimmed by whitespace and newline characters is a number, otherwise NO
+ */
+- (BOOL)getDoubleValue:(nullable double *)value decimalSeparator:(char)decimalSeparator groupingSeparator:(char)groupingSeparator;
+
+/*! Parses the double value of the text content directly from the UTF-8 bytes without locale and without creating a string object
+ * \param value On return the double value if the text content is a number
+ * \param decimalSeparator The ASCII decimal separator e.g. '.' or ','
+ * \param groupingSeparator The ASCII grouping separator ignored in the integer digits or 0 for none
+ * \returns YES if the text content trimmed by whitespace and newline characters is a number, otherwise NO
+ */
+- (BOOL)getContentDoubleValue:(nullable double *)value decimalSeparator:(char)decimalSeparator groupingSeparator:(char)groupingSeparator;
+
 /*! Returns the date value of the string value for a specified date format and time zone
  * \param dateFormat A date format string. The date format must conform to http://unicode.org/reports/tr35/tr35-10.html#Date_Format_Patterns
  * \param timeZone A time zone
@@ -282,11 +510,49 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (SAFE_ARC_READONLY_OBJ_PROP) NSArray<NSString *> *textContentOfDescendants;
 
+/*! The text content of each text node of descendant-or-self in an array, the text nodes are visited once
+ * \returns An array of the content of all text nodes - each array item is trimmed by whitespace and newline characters, whitespace only text nodes are omitted - or an empty array
+ */
+@property (SAFE_ARC_READONLY_OBJ_PROP) NSArray<NSString *> *textContentOfTextNodes;
+
+/*! The text content of the text nodes of descendant-or-self, each trimmed by whitespace and newline characters and joined in one buffer
+ * \param separator The string inserted between the contents of two text nodes, whitespace only text nodes are omitted
+ * \param collapse YES to collapse all multiple occurrences of whitespace and newline characters within each text node into a single space
+ * \returns The joined text content or nil
+ */
+- (nullable NSString *)textContentJoinedBySeparator:(NSString *)separator collapsingWhitespace:(BOOL)collapse;
+
 /*! The raw html text dump of descendant-or-self
  * \returns The raw html text dump of the node and all its descendants or nil
  */
 @property (SAFE_ARC_READONLY_OBJ_PROP, nullable) NSString *HTMLContent;
 
+/*! Appends the UTF-8 encoded html of descendant-or-self to a data object, the same serialization as HTMLContent without intermediate string
+ * \param data The data object, it can be reused for several nodes by setting its length to 0
+ * \param error An error object with the reason if the html could not be written
+ * \returns YES if the html has been written, otherwise NO
+ */
+- (BOOL)writeHTMLToData:(NSMutableData *)data error:(NSError **)error;
+
+/*! Writes the UTF-8 encoded html of descendant-or-self to an opened output stream, the same serialization as HTMLContent without intermediate string
+ * \param stream The opened output stream, it's not closed
+ * \param error The error of the stream or an error object with the reason if the html could not be written
+ * \returns YES if the html has been written, otherwise NO
+ */
+- (BOOL)writeHTMLToStream:(NSOutputStream *)stream error:(NSError **)error;
+
+/*! Writes the UTF-8 encoded html of descendant-or-self to a file descriptor, the same serialization as HTMLContent without intermediate string
+ * \param fileDescriptor The file descriptor opened for writing, it's not closed
+ * \param error An error object in the POSIX domain or with the reason if the html could not be written
+ * \returns YES if the html has been written, otherwise NO
+ */
+- (BOOL)writeHTMLToFileDescriptor:(int)fileDescriptor error:(NSError **)error;
+
+/*! The contents of the table element in one pass without node objects, see HTMLTable
+ * \returns The table of the rows and columns or nil if the node is not a table element
+ */
+@property (SAFE_ARC_READONLY_OBJ_PROP, nullable) HTMLTable *tableContent;
+
 
 #pragma mark - Query method declarations
 
@@ -533,6 +799,52 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSArray<HTMLNode *> *)siblingsWithClass:(NSString *)classValue;
 
+// The class names methods match the whitespace separated tokens of the class attribute like getElementsByClassName:
+// a node matches if its class attribute contains all passed names in any order, "btn" doesn't match "btn-primary".
+// The attribute values are scanned in place without creating strings, up to 64 names can be passed
+
+/*! Returns the first descendant node having all specified class names
+ * \param classNames A whitespace separated list of class names
+ * \returns The first found descendant node or nil
+ */
+- (nullable HTMLNode *)descendantWithClassNames:(NSString *)classNames;
+
+/*! Returns the first child node having all specified class names
+ * \param classNames A whitespace separated list of class names
+ * \returns The first found child node or nil
+ */
+- (nullable HTMLNode *)childWithClassNames:(NSString *)classNames;
+
+/*! Returns the first sibling node having all specified class names
+ * \param classNames A whitespace separated list of class names
+ * \returns The first found sibling node or nil
+ */
+- (nullable HTMLNode *)siblingWithClassNames:(NSString *)classNames;
+
+/*! Returns all descendant nodes having all specified class names
+ * \param classNames A whitespace separated list of class names
+ * \returns The array of all found descendant nodes or an empty array
+ */
+- (NSArray<HTMLNode *> *)descendantsWithClassNames:(NSString *)classNames;
+
+/*! Returns all child nodes having all specified class names
+ * \param classNames A whitespace separated list of class names
+ * \returns The array of all found child nodes or an empty array
+ */
+- (NSArray<HTMLNode *> *)childrenWithClassNames:(NSString *)classNames;
+
+/*! Returns all sibling nodes having all specified class names
+ * \param classNames A whitespace separated list of class names
+ * \returns The array of all found sibling nodes or an empty array
+ */
+- (NSArray<HTMLNode *> *)siblingsWithClassNames:(NSString *)classNames;
+
+/*! Returns whether the class attribute of the current node contains all specified class names
+ * \param classNames A whitespace separated list of class names
+ * \returns YES if the node has all class names
+ */
+- (BOOL)hasClassNames:(NSString *)classNames;
+
 /*! Returns the first descendant node with the specifed id value
  * \param classValue The name of the class
  * \returns The first found descendant node or nil
@@ -672,6 +984,72 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSArray<HTMLNode *> *)siblingsOfTag:(NSString *)tagName;
 
+#pragma mark - Enumeration method declarations
+
+// Note: The enumeration methods don't create a node object per visited node, each match is passed in the same reused node object
+
+/*! Calls the block for each node in the specified scope
+ * \param scope The nodes to visit
+ * \param block The block called for each node, set stop to YES to end the enumeration
+ */
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope usingBlock:(HTMLNodeEnumerationBlock)block;
+
+/*! Calls the block for each node in the specified scope with the specified tag name
+ * \param scope The nodes to visit
+ * \param tagName The name of the tag
+ * \param block The block called for each matching node, set stop to YES to end the enumeration
+ */
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope ofTag:(NSString *)tagName usingBlock:(HTMLNodeEnumerationBlock)block;
+
+/*! Calls the block for each node in the specified scope with the specified attribute name
+ * \param scope The nodes to visit
+ * \param attributeName The name of the attribute
+ * \param block The block called for each matching node, set stop to YES to end the enumeration
+ */
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope withAttribute:(NSString *)attributeName usingBlock:(HTMLNodeEnumerationBlock)block;
+
+/*! Calls the block for each node in the specified scope with the specified attribute name and value matching exactly
+ * \param scope The nodes to visit
+ * \param attributeName The name of the attribute
+ * \param attributeValue The value of the attribute
+ * \param block The block called for each matching node, set stop to YES to end the enumeration
+ */
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope withAttribute:(NSString *)attributeName valueMatches:(NSString *)attributeValue usingBlock:(HTMLNodeEnumerationBlock)block;
+
+/*! Calls the block for each node in the specified scope having all specified class names
+ * \param scope The nodes to visit
+ * \param classNames A whitespace separated list of class names
+ * \param block The block called for each matching node, set stop to YES to end the enumeration
+ */
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope withClassNames:(NSString *)classNames usingBlock:(HTMLNodeEnumerationBlock)block;
+
+#pragma mark - Batch query method declaration
+
+/*! Evaluates several queries in one pass over the descendants of the current node.
+ *  The pass ends early as soon as all queries have found their first match, if all queries are first-only
+ * \param queries The queries
+ * \returns An array of the same count as queries with the array of the found nodes in document order for each query,
+ *  the array of a first-only query contains at most one node
+ */
+- (NSArray<NSArray<HTMLNode *> *> *)descendantsForQueries:(NSArray<HTMLNodeQuery *> *)queries;
+
+#pragma mark - Document order method declarations
+
+/*! Compares the position of the current node with another node in document order. The elements are numbered once per document
+ *  by HTMLDocument prepareDocumentOrder, so the comparison of two elements takes O(1), other nodes are compared by their ancestors
+ * \param node The node with which to compare the current node, a nil node precedes all nodes
+ * \returns NSOrderedAscending if the current node precedes the node, NSOrderedDescending if it follows the node and NSOrderedSame for the same node.
+ *  Nodes of different documents are ordered by their documents, nodes of unlinked subtrees by their subtrees
+ */
+- (NSComparisonResult)compareDocumentOrder:(nullable HTMLNode *)node;
+
+/*! Sorts nodes in document order, e.g. to merge the results of several queries
+ * \param nodes The nodes of one or more documents
+ * \param removeDuplicates YES to keep only one node object of the nodes occurring several times
+ * \returns The sorted array of the nodes
+ */
++ (NSArray<HTMLNode *> *)nodesSortedInDocumentOrder:(NSArray<HTMLNode *> *)nodes removingDuplicates:(BOOL)removeDuplicates;
+
 NS_ASSUME_NONNULL_END
 
 @end
@@ -59,6 +59,32 @@ NS_ASSUME_NONNULL_END
 
 @end
 
+NSString * collapsedString(const xmlChar * bytes, size_t length);
+
+static NSString * const kNumberFormatterCacheKey = @"com.klieme.HTMLNodeNumberFormatters";
+static NSString * const kDateFormatterCacheKey = @"com.klieme.HTMLNodeDateFormatters";
+#define FORMATTER_CACHE_SIZE 16
+
+// Returns a formatter from the cache of the current thread, the formatters are configured once and used only by
+// the thread which created them, so no locking is needed. The cache is emptied when it's full
+static id cachedFormatter(NSString * cacheKey, NSString * key, id (^createFormatter)(void))
+{
+    NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+    NSMutableDictionary *cache = threadDictionary[cacheKey];
+    if (cache == nil) {
+        cache = [NSMutableDictionary dictionaryWithCapacity:FORMATTER_CACHE_SIZE];
+        threadDictionary[cacheKey] = cache;
+    }
+    
+    id formatter = cache[key];
+    if (formatter == nil) {
+        if ([cache count] == FORMATTER_CACHE_SIZE) [cache removeAllObjects];
+        formatter = createFormatter();
+        cache[key] = formatter;
+    }
+    return formatter;
+}
+
 @implementation NSString (SKHTMLNode)
 
 // method to collapse all multiple occurrences of characters of a given character set
@@ -77,9 +103,13 @@ NS_ASSUME_NONNULL_END
     return result;
 }
 
+// collapses directly in the UTF-8 bytes of the string with the same whitespace and newline characters as the character set
 - (NSString *)collapseWhitespaceAndNewLine
 {
-    return [self collapseCharactersinSet:[NSCharacterSet whitespaceAndNewlineCharacterSet] usingSeparator:@" "];
+    const char *bytes = [self UTF8String];
+    if (bytes == NULL) return [self collapseCharactersinSet:[NSCharacterSet whitespaceAndNewlineCharacterSet] usingSeparator:@" "];
+    NSString *result = collapsedString(BAD_CAST bytes, strlen(bytes));
+    return result ? result : @"";
 }
 
 // ISO 639 identifier e.g. en_US or fr_CH
@@ -88,38 +118,40 @@ NS_ASSUME_NONNULL_END
     return [self doubleValueForLocaleIdentifier:identifier consideringPlusSign:NO];
 }
 
+// the formatters are cached per thread by locale identifier and plus sign
 - (double )doubleValueForLocaleIdentifier:(NSString *)identifier consideringPlusSign:(BOOL)flag
 {
-    NSNumberFormatter * numberFormatter = [[NSNumberFormatter alloc] init];
-    NSLocale *locale = [[NSLocale alloc] initWithLocaleIdentifier:identifier];
-    [numberFormatter setLocale:locale];
-#if ! __has_feature(objc_arc)
-    [locale release];
-#endif
-    if (flag && [self hasPrefix:@"+"]) [numberFormatter setPositivePrefix:@"+"];
-    [numberFormatter setNumberStyle:NSNumberFormatterDecimalStyle];
-    NSNumber *number = [numberFormatter numberFromString:self];
+    BOOL plusSign = flag && [self hasPrefix:@"+"];
+    NSString *key = (identifier) ? identifier : @"";
+    if (plusSign) key = [key stringByAppendingString:@"+"];
     
+    NSNumberFormatter *numberFormatter = cachedFormatter(kNumberFormatterCacheKey, key, ^id {
+        NSNumberFormatter * formatter = [[NSNumberFormatter alloc] init];
+        NSLocale *locale = [[NSLocale alloc] initWithLocaleIdentifier:identifier];
+        [formatter setLocale:locale];
 #if ! __has_feature(objc_arc)
-    [numberFormatter release];
+        [locale release];
 #endif
+        if (plusSign) [formatter setPositivePrefix:@"+"];
+        [formatter setNumberStyle:NSNumberFormatterDecimalStyle];
+        return SAFE_ARC_AUTORELEASE(formatter);
+    });
+    NSNumber *number = [numberFormatter numberFromString:self];
     return [number doubleValue];
-    
 }
 
 // date format e.g. @"yyyy-MM-dd 'at' HH:mm" --> 2001-01-02 at 13:00
+// the formatters are cached per thread by date format and time zone
 - (NSDate *)dateValueWithFormat:(NSString *)dateFormat timeZone:(NSTimeZone *)timeZone
 {
-    NSDate *formattedDate;
-    NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-    [dateFormatter setDateFormat:dateFormat];
-    [dateFormatter setTimeZone:timeZone];
-    formattedDate = [dateFormatter dateFromString:self];
-    
-#if ! __has_feature(objc_arc)
-    [dateFormatter release];
-#endif
-    return formattedDate;
+    NSString *key = [NSString stringWithFormat:@"%@\n%@", dateFormat, [timeZone name]];
+    NSDateFormatter *dateFormatter = cachedFormatter(kDateFormatterCacheKey, key, ^id {
+        NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+        [formatter setDateFormat:dateFormat];
+        [formatter setTimeZone:timeZone];
+        return SAFE_ARC_AUTORELEASE(formatter);
+    });
+    return [dateFormatter dateFromString:self];
 }
 
 @end
@@ -128,15 +160,103 @@ NS_ASSUME_NONNULL_END
 /*****************************************************************************************************/
 
 #import "HTMLNode.h"
+#import "HTMLDocument.h"
+#import "HTMLInstrumentation.h"
+#import <xlocale.h>
+#include <unistd.h>
 
 #define DUMP_BUFFER_SIZE 1024
-#define XML_CHECK_CONTENT(n) (n->children && n->children->content) ? YES : NO
+// the content field of an element holds its document order number after xmlXPathOrderDocElems
+#define XML_CHECK_CONTENT(n) (n->children && n->children->type != XML_ELEMENT_NODE && n->children->content) ? YES : NO
+#define CLASS_WHITESPACE " \t\n\f\r"
+#define MAX_CLASS_NAMES 64
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGH_BITS 0x8080808080808080ULL
+#define NUMBER_BUFFER_SIZE 64
+
+// The nodes of one key of the node index in document order
+typedef struct {
+    xmlNode ** nodes;
+    size_t count;
+    size_t capacity;
+} HTMLNodeList;
+
+struct HTMLNodeIndex {
+    xmlHashTablePtr ids;        // id value -> HTMLNodeList
+    xmlHashTablePtr classes;    // class token -> HTMLNodeList
+    xmlHashTablePtr tags;       // tag name -> HTMLNodeList
+};
+
+// A growing byte buffer shared by all text nodes of one traversal
+typedef struct {
+    xmlChar * bytes;
+    size_t length;
+    size_t capacity;
+} HTMLTextBuffer;
+
+// The file descriptor of writeHTMLToFileDescriptor:error: and the error number of a failed write
+typedef struct {
+    int fileDescriptor;
+    int errorNumber;
+} HTMLFileDescriptorSink;
+
+// An element of textContentOfDescendants whose content is still collected in the text buffer
+typedef struct {
+    size_t start;
+    NSUInteger index;
+} HTMLOpenElement;
+
+// The slots occupied by a cell of an HTMLTable during the extraction
+typedef struct {
+    size_t row;
+    size_t column;
+    size_t rowSpan;
+    size_t columnSpan;
+} HTMLTablePlacement;
+
+// The required names of a class names query, the tokens point into the query string
+typedef struct {
+    const char * tokens[MAX_CLASS_NAMES];
+    size_t lengths[MAX_CLASS_NAMES];
+    int count;
+} HTMLClassNames;
+
+typedef NS_ENUM(NSUInteger, HTMLNodeIndexTable) {
+    HTMLNodeIndexTableIDs = 0,
+    HTMLNodeIndexTableClasses,
+    HTMLNodeIndexTableTags
+};
+
+typedef BOOL (*HTMLNodeMatchFunction)(xmlNode * node, const xmlChar * name, const xmlChar * value);
 
 // C functions for less overhead in recursion
 
 void textContentOfChildren(xmlNode * node, NSMutableArray * array, BOOL recursive);
 NSString * textContent(xmlNode *node);
 void arrayOfTextContent(xmlNode * node, NSMutableArray * array, BOOL recursive);
+BOOL textBufferAppend(HTMLTextBuffer * buffer, const xmlChar * bytes, size_t length);
+BOOL textBufferAppendCollapsingWhitespace(HTMLTextBuffer * buffer, const xmlChar * bytes, size_t length, BOOL * pendingSpace);
+size_t whitespaceLength(const xmlChar * bytes, size_t length);
+void trimWhitespace(const xmlChar * bytes, size_t * start, size_t * end);
+NSString * trimmedTextContent(const xmlChar * bytes, size_t length);
+BOOL textBufferReserve(HTMLTextBuffer * buffer, size_t length);
+size_t nonWhitespaceLength(const xmlChar * bytes, size_t length);
+size_t collapseWhitespace(const xmlChar * bytes, size_t length, xmlChar * destination, size_t written, BOOL * pendingSpace);
+NSString * trimmedString(const xmlChar * bytes, size_t length);
+locale_t numericCLocale(void);
+BOOL parseDouble(const xmlChar * bytes, size_t length, char decimalSeparator, char groupingSeparator, double * value);
+int dataWriteCallback(void * context, const char * buffer, int length);
+xmlAttrPtr attributeNamed(xmlNode * node, const xmlChar * attrName);
+const xmlChar * borrowedAttributeValue(xmlAttrPtr attr);
+NSString * attributeValueString(xmlAttrPtr attr);
+NSString * attributeNameString(const xmlChar * attrName);
+int streamWriteCallback(void * context, const char * buffer, int length);
+int fileDescriptorWriteCallback(void * context, const char * buffer, int length);
+BOOL writeHTMLContent(xmlNode * node, xmlOutputWriteCallback writeCallback, void * context);
+xmlNode * nextTextNodeInSubtree(xmlNode * node, xmlNode * root);
+void textContentOfDescendants(xmlNode * root, NSMutableArray * array);
+void textContentOfTextNodes(xmlNode * root, NSMutableArray * array);
+NSString * joinedTextContent(xmlNode * root, const xmlChar * separator, BOOL collapse);
 HTMLNode * childWithAttribute(const xmlChar * attrName, xmlNode * node, BOOL recursive);
 HTMLNode * childWithAttributeValueMatches(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, BOOL recursive);
 HTMLNode * childWithAttributeValueContains(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, BOOL recursive);
@@ -147,16 +267,41 @@ void childrenWithAttributeValueMatches(const xmlChar * attrName, const xmlChar *
 void childrenWithAttributeValueContains(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, NSMutableArray * array, BOOL recursive);
 void childrenWithAttributeValueBeginsWith(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, NSMutableArray * array, BOOL recursive);
 void childrenWithAttributeValueEndsWith(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, NSMutableArray * array, BOOL recursive);
+xmlNode * nextTableRow(xmlNode * row, xmlNode * table);
+long spanAttribute(xmlNode * cell, const xmlChar * attrName);
+BOOL textBufferAppendCell(HTMLTextBuffer * buffer, xmlNode * cell, HTMLTableCell * tableCell);
+NSComparisonResult compareDocumentOrder(xmlNode * node1, xmlNode * node2);
+xmlNode * rootOfTree(xmlNode * node);
 HTMLNode * childOfTagValueMatches(const xmlChar * tagName, const xmlChar * value, xmlNode * node, BOOL recursive);
 HTMLNode * childOfTagValueContains(const xmlChar * tagName, const xmlChar * value, xmlNode * node, BOOL recursive);
 void childrenOfTagValueMatches(const xmlChar * tagName, const xmlChar * value, xmlNode * node, NSMutableArray * array, BOOL recursive);
 void childrenOfTagValueContains(const xmlChar * tagName, const xmlChar * value, xmlNode * node, NSMutableArray * array, BOOL recursive);
 HTMLNode * childOfTag(const xmlChar * tagName, xmlNode * node, BOOL recursive);
 void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * array, BOOL recursive);
+xmlNode * nextNodeInSubtree(xmlNode * node, xmlNode * root);
+BOOL nodeHasAttributeValueMatches(xmlNode * node, const xmlChar * attrName, const xmlChar * attrValue);
+BOOL parseClassNames(const xmlChar * classNames, HTMLClassNames * names);
+BOOL nodeHasClassNames(xmlNode * node, const xmlChar * unused, const xmlChar * names);
+HTMLNode * childrenWithClassNames(const HTMLClassNames * names, xmlNode * node, xmlNode * root, NSMutableArray * array, BOOL recursive);
+BOOL lookUpNodeIndex(HTMLNodeIndexTable table, const xmlChar * key, xmlNode * node, HTMLNodeMatchFunction match, const xmlChar * name, const xmlChar * value, NSMutableArray * array, HTMLNode ** firstNode);
+
+// The C representation of an HTMLNodeQuery during a batch traversal, the strings are owned by the query objects
+typedef struct {
+    const xmlChar * tagName;
+    const xmlChar * attributeName;
+    const xmlChar * value;
+    int valueLength;
+    HTMLNodeQueryMatch match;
+    BOOL firstOnly;
+    BOOL done;
+} HTMLBatchQuery;
+
+BOOL nodeMatchesBatchQuery(xmlNode * node, const HTMLBatchQuery * query);
 
 
 @implementation HTMLNode
 @synthesize xpathError;
+@synthesize document = document_;
 
 #pragma mark - class method
 
@@ -173,7 +318,15 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
 {
     self = [super init];
     if (self) 	{
+        HTML_INSTRUMENT_WRAPPER(xmlNode);
         xmlNode_ = xmlNode;
+        // the node keeps the document object and with it the tree alive
+        if (xmlNode && xmlNode->doc && xmlNode->doc->_private) {
+            document_ = (__bridge HTMLDocument *)xmlNode->doc->_private;
+#if ! __has_feature(objc_arc)
+            [document_ retain];
+#endif
+        }
     }
     return self;
 }
@@ -182,9 +335,15 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
 #if ! __has_feature(objc_arc)
     self.xpathError = nil;
 #endif
+    SAFE_ARC_RELEASE(document_);
     SAFE_ARC_SUPER_DEALLOC();
 }
 
+- (id)copyWithZone:(NSZone *)zone
+{
+    return [[HTMLNode allocWithZone:zone] initWithXMLNode:xmlNode_];
+}
+
 #pragma mark - navigating methods
 
 - (HTMLNode *)parent
@@ -214,8 +373,9 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
 
 - (HTMLNode *)childAtIndex:(NSUInteger)index
 {
-    NSArray *childrenArray = self.children;
-    return (index < [childrenArray count]) ? [childrenArray objectAtIndex:index] : nil;
+    xmlNode *currentNode = xmlNode_->children;
+    while (currentNode && index--) currentNode = currentNode->next;
+    return (currentNode) ? [HTMLNode nodeWithXMLNode:currentNode] : nil;
 }
 
 - (NSArray<HTMLNode *> *)children
@@ -239,16 +399,64 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
 
 #pragma mark - attributes and values of current node (self)
 
-- (NSString *)attributeForName:(NSString *)name
+// The attributes are read in place like xmlHasProp, only the returned strings are allocated
+
+// The common attribute names as interned strings, they are used as keys and names without allocation
+static const char * const kCommonAttributeNames[] = {
+    "class", "id", "href", "src", "style", "title", "alt", "name", "type", "value", "rel", "target",
+    "width", "height", "content", "lang", "role", "action", "method", "for", "colspan", "rowspan", "srcset", "property"
+};
+static NSString * const kCommonAttributeKeys[] = {
+    @"class", @"id", @"href", @"src", @"style", @"title", @"alt", @"name", @"type", @"value", @"rel", @"target",
+    @"width", @"height", @"content", @"lang", @"role", @"action", @"method", @"for", @"colspan", @"rowspan", @"srcset", @"property"
+};
+
+xmlAttrPtr attributeNamed(xmlNode * node, const xmlChar * attrName)
 {
-    NSString *result = nil;
+    if (node->type != XML_ELEMENT_NODE || attrName == NULL) return NULL;
     
-    xmlChar *attributeValue = xmlGetProp(xmlNode_, BAD_CAST [name UTF8String]);
-    if (attributeValue) {
-        result = [NSString stringWithUTF8String:(const char *)attributeValue];
-        xmlFree(attributeValue);
+    for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+        if (xmlStrEqual(attr->name, attrName)) return attr;
     }
-    return result;
+    return NULL;
+}
+
+// Returns the value of an attribute without copy, the value of an HTML attribute is one text node and an empty attribute has none.
+// Returns NULL if the value consists of several nodes, e.g. entity references in XML documents
+const xmlChar * borrowedAttributeValue(xmlAttrPtr attr)
+{
+    xmlNode *child = attr->children;
+    if (child == NULL) return BAD_CAST "";
+    if (child->next == NULL && child->type == XML_TEXT_NODE && child->content) return child->content;
+    return NULL;
+}
+
+NSString * attributeValueString(xmlAttrPtr attr)
+{
+    const xmlChar *value = borrowedAttributeValue(attr);
+    if (value) return [NSString stringWithUTF8String:(const char *)value];
+    
+    xmlChar *listValue = xmlNodeListGetString(attr->doc, attr->children, 1);
+    if (listValue == NULL) return @"";
+    NSString *string = [NSString stringWithUTF8String:(const char *)listValue];
+    xmlFree(listValue);
+    return string;
+}
+
+NSString * attributeNameString(const xmlChar * attrName)
+{
+    for (size_t i = 0; i < sizeof(kCommonAttributeNames) / sizeof(kCommonAttributeNames[0]); i++) {
+        if (attrName[0] == (xmlChar)kCommonAttributeNames[i][0] && strcmp((const char *)attrName, kCommonAttributeNames[i]) == 0) {
+            return kCommonAttributeKeys[i];
+        }
+    }
+    return [NSString stringWithUTF8String:(const char *)attrName];
+}
+
+- (NSString *)attributeForName:(NSString *)name
+{
+    xmlAttrPtr attr = attributeNamed(xmlNode_, BAD_CAST [name UTF8String]);
+    return (attr) ? attributeValueString(attr) : nil;
 }
 
 - (NSDictionary *)attributes
@@ -257,16 +465,59 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
     if (self.isDocumentNode) return nil;
     
     NSMutableDictionary *result = [NSMutableDictionary dictionary];
-    NSString *value;
     
     for (xmlAttrPtr attr = xmlNode_->properties; attr ; attr = attr->next) {
-        value = [NSString stringWithUTF8String:(const char *)attr->children->content];
-        [result setObject:value forKey:[NSString stringWithUTF8String:(const char *)attr->name]];
+        NSString *value = attributeValueString(attr);
+        NSString *key = attributeNameString(attr->name);
+        if (value && key) [result setObject:value forKey:key];
     }
     
     return result;
 }
 
+- (const char *)UTF8ValueForAttribute:(const char *)attributeName
+{
+    xmlAttrPtr attr = attributeNamed(xmlNode_, BAD_CAST attributeName);
+    return (attr) ? (const char *)borrowedAttributeValue(attr) : NULL;
+}
+
+- (BOOL)attribute:(const char *)attributeName matchesUTF8Value:(const char *)value
+{
+    xmlAttrPtr attr = attributeNamed(xmlNode_, BAD_CAST attributeName);
+    if (attr == NULL) return NO;
+    
+    const xmlChar *attributeValue = borrowedAttributeValue(attr);
+    if (attributeValue) return xmlStrEqual(attributeValue, BAD_CAST value);
+    
+    xmlChar *listValue = xmlNodeListGetString(attr->doc, attr->children, 1);
+    BOOL result = xmlStrEqual(listValue, BAD_CAST value);
+    xmlFree(listValue);
+    return result;
+}
+
+- (void)enumerateAttributesUsingBlock:(HTMLAttributeEnumerationBlock)block
+{
+    if (xmlNode_->type != XML_ELEMENT_NODE) return;
+    
+    BOOL stop = NO;
+    for (xmlAttrPtr attr = xmlNode_->properties; attr && !stop; attr = attr->next) {
+        const xmlChar *value = borrowedAttributeValue(attr);
+        if (value) block((const char *)attr->name, (const char *)value, &stop);
+    }
+}
+
+- (void)enumerateAttributeNamesAndValuesUsingBlock:(void (^)(NSString *attributeName, NSString *attributeValue, BOOL *stop))block
+{
+    if (xmlNode_->type != XML_ELEMENT_NODE) return;
+    
+    BOOL stop = NO;
+    for (xmlAttrPtr attr = xmlNode_->properties; attr && !stop; attr = attr->next) {
+        NSString *value = attributeValueString(attr);
+        NSString *name = attributeNameString(attr->name);
+        if (value && name) block(name, value, &stop);
+    }
+}
+
 
 - (NSString *)tagName
 {
@@ -302,15 +553,87 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
     return 0;
 }
 
+// the numeric values without locale are parsed in the C locale independent of the locale of the process
 - (double )doubleValue
 {
     if (XML_CHECK_CONTENT(xmlNode_)) {
-        return atof((const char*)xmlNode_->children->content);
+        return strtod_l((const char*)xmlNode_->children->content, NULL, numericCLocale());
     }
     
     return 0.0;
 }
 
+locale_t numericCLocale(void)
+{
+    static locale_t locale;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
+    });
+    return locale;
+}
+
+// Parses a number in the UTF-8 bytes without locale and without string object: an optional sign, the digits
+// with optional grouping separators, the decimal separator, the fraction digits and an optional exponent.
+// Leading and trailing whitespace is ignored, any other character fails
+BOOL parseDouble(const xmlChar * bytes, size_t length, char decimalSeparator, char groupingSeparator, double * value)
+{
+    size_t start = 0, end = length;
+    trimWhitespace(bytes, &start, &end);
+    
+    // the normalized number in the C locale
+    char number[NUMBER_BUFFER_SIZE];
+    size_t count = 0;
+    BOOL hasDigits = NO, hasDecimalSeparator = NO, hasExponent = NO;
+    
+    for (size_t i = start; i < end; i++) {
+        char c = (char)bytes[i];
+        if (count == NUMBER_BUFFER_SIZE - 1) return NO;
+        
+        if (c >= '0' && c <= '9') {
+            hasDigits = YES;
+        } else if (c == '+' || c == '-') {
+            if (count > 0 && number[count - 1] != 'e') return NO;
+        } else if (c == decimalSeparator && !hasDecimalSeparator && !hasExponent) {
+            hasDecimalSeparator = YES;
+            c = '.';
+        } else if (groupingSeparator && c == groupingSeparator && hasDigits && !hasDecimalSeparator && !hasExponent) {
+            continue;
+        } else if ((c == 'e' || c == 'E') && hasDigits && !hasExponent) {
+            hasExponent = YES;
+            c = 'e';
+        } else {
+            return NO;
+        }
+        number[count++] = c;
+    }
+    if (! hasDigits) return NO;
+    number[count] = 0;
+    
+    char *parsedEnd;
+    double result = strtod_l(number, &parsedEnd, numericCLocale());
+    if (*parsedEnd != 0) return NO;
+    if (value) *value = result;
+    return YES;
+}
+
+- (BOOL)getDoubleValue:(double *)value decimalSeparator:(char)decimalSeparator groupingSeparator:(char)groupingSeparator
+{
+    xmlNode *child = xmlNode_->children;
+    if (child == NULL || child->type == XML_ELEMENT_NODE || child->content == NULL) return NO;
+    return parseDouble(child->content, (size_t)xmlStrlen(child->content), decimalSeparator, groupingSeparator, value);
+}
+
+- (BOOL)getContentDoubleValue:(double *)value decimalSeparator:(char)decimalSeparator groupingSeparator:(char)groupingSeparator
+{
+    xmlChar *contents = xmlNodeGetContent(xmlNode_);
+    if (contents == NULL) return NO;
+    
+    BOOL result = parseDouble(contents, (size_t)xmlStrlen(contents), decimalSeparator, groupingSeparator, value);
+    xmlFree(contents);
+    return result;
+}
+
 // ISO 639 identifier e.g. en_US or fr_CH
 - (double )doubleValueForLocaleIdentifier:(NSString *)identifier
 {
@@ -366,14 +689,23 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
     return nil;
 }
 
+// the string values are trimmed and collapsed in the UTF-8 bytes of the text node
 - (NSString *)stringValue
 {
-    return [self.rawStringValue stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+    xmlNode *child = xmlNode_->children;
+    if (child && child->type != XML_ELEMENT_NODE && child->content) {
+        return trimmedString(child->content, (size_t)xmlStrlen(child->content));
+    }
+    return nil;
 }
 
 - (NSString *)stringValueCollapsingWhitespace;
 {
-    return [self.stringValue collapseWhitespaceAndNewLine];
+    xmlNode *child = xmlNode_->children;
+    if (child && child->type != XML_ELEMENT_NODE && child->content) {
+        return collapsedString(child->content, (size_t)xmlStrlen(child->content));
+    }
+    return nil;
 }
 
 - (NSString *)HTMLString
@@ -430,7 +762,7 @@ void textContentOfChildren(xmlNode * node, NSMutableArray * array, BOOL recursiv
 - (NSArray<NSString *> *)textContentOfDescendants
 {
     NSMutableArray *array = [NSMutableArray array];
-    textContentOfChildren(xmlNode_->children, array, YES);
+    textContentOfDescendants(xmlNode_, array);
     return array;
 }
 
@@ -476,6 +808,283 @@ NSString * textContent(xmlNode *node)
     return nil;
 }
 
+// Text extraction in one pass: the text nodes are visited once and appended to one buffer,
+// no subtree is concatenated twice and no intermediate string is created per node
+
+BOOL textBufferReserve(HTMLTextBuffer * buffer, size_t length)
+{
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = MAX(MAX(buffer->capacity * 2, buffer->length + length + 1), DUMP_BUFFER_SIZE);
+        xmlChar *grownBytes = xmlRealloc(buffer->bytes, capacity);
+        if (grownBytes == NULL) return NO;
+        buffer->bytes = grownBytes;
+        buffer->capacity = capacity;
+    }
+    return YES;
+}
+
+BOOL textBufferAppend(HTMLTextBuffer * buffer, const xmlChar * bytes, size_t length)
+{
+    if (! textBufferReserve(buffer, length)) return NO;
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+    buffer->bytes[buffer->length] = 0;
+    return YES;
+}
+
+// Returns the UTF-8 length of the whitespace or newline character at bytes or 0, the characters are those of
+// whitespaceAndNewlineCharacterSet: tab, U+000A–U+000D, U+0085, U+2028, U+2029 and the space separators (Zs)
+size_t whitespaceLength(const xmlChar * bytes, size_t length)
+{
+    if (length == 0) return 0;
+    xmlChar c = bytes[0];
+    if (c == ' ' || (c >= '\t' && c <= '\r')) return 1;
+    if (c < 0xC2) return 0;
+    if (c == 0xC2) return (length >= 2 && (bytes[1] == 0x85 || bytes[1] == 0xA0)) ? 2 : 0;
+    if (length < 3) return 0;
+    switch (c) {
+        case 0xE1: return (bytes[1] == 0x9A && bytes[2] == 0x80) ? 3 : 0;                   // U+1680
+        case 0xE2:
+            if (bytes[1] == 0x80) {
+                return ((bytes[2] >= 0x80 && bytes[2] <= 0x8A) ||                           // U+2000–U+200A
+                        bytes[2] == 0xA8 || bytes[2] == 0xA9 || bytes[2] == 0xAF) ? 3 : 0;  // U+2028, U+2029, U+202F
+            }
+            return (bytes[1] == 0x81 && bytes[2] == 0x9F) ? 3 : 0;                          // U+205F
+        case 0xE3: return (bytes[1] == 0x80 && bytes[2] == 0x80) ? 3 : 0;                   // U+3000
+        default: return 0;
+    }
+}
+
+// Narrows the range start..<end of bytes by leading and trailing whitespace and newline characters
+void trimWhitespace(const xmlChar * bytes, size_t * start, size_t * end)
+{
+    size_t length;
+    while (*start < *end && (length = whitespaceLength(bytes + *start, *end - *start))) *start += length;
+    
+    while (*end > *start) {
+        // a whitespace character is at most 3 bytes long and its lead byte can't be a continuation byte
+        for (length = 1; length <= 3 && length <= *end - *start; length++) {
+            if (whitespaceLength(bytes + *end - length, length) == length) break;
+        }
+        if (length > 3 || length > *end - *start) break;
+        *end -= length;
+    }
+}
+
+// Returns the length of the leading run of bytes without whitespace and newline characters.
+// The bytes are scanned 8 at a time as long as they are all printable ASCII characters (0x21–0x7F),
+// the high bit of a byte of (word - 0x21…) | word is set for bytes below 0x21 or above 0x7F
+size_t nonWhitespaceLength(const xmlChar * bytes, size_t length)
+{
+    size_t i = 0;
+    while (i < length) {
+        if (i + 8 <= length) {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            if ((((word - SWAR_ONES * 0x21) | word) & SWAR_HIGH_BITS) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        xmlChar c = bytes[i];
+        if ((c <= 0x20 || c >= 0x80) && whitespaceLength(bytes + i, length - i)) break;
+        i++;
+    }
+    return i;
+}
+
+// Copies the bytes to destination + written collapsing all runs of whitespace and newline characters into a single space
+// and returns the new number of written bytes. A pending space is written only before the next non-whitespace character,
+// so the result is trimmed. The destination must have room for length + 1 more bytes
+size_t collapseWhitespace(const xmlChar * bytes, size_t length, xmlChar * destination, size_t written, BOOL * pendingSpace)
+{
+    size_t i = 0;
+    while (i < length) {
+        size_t whitespace = whitespaceLength(bytes + i, length - i);
+        if (whitespace) {
+            if (written) *pendingSpace = YES;
+            i += whitespace;
+            continue;
+        }
+        size_t run = nonWhitespaceLength(bytes + i, length - i);
+        if (*pendingSpace) destination[written++] = ' ';
+        *pendingSpace = NO;
+        memcpy(destination + written, bytes + i, run);
+        written += run;
+        i += run;
+    }
+    return written;
+}
+
+BOOL textBufferAppendCollapsingWhitespace(HTMLTextBuffer * buffer, const xmlChar * bytes, size_t length, BOOL * pendingSpace)
+{
+    if (! textBufferReserve(buffer, length + 1)) return NO;
+    buffer->length = collapseWhitespace(bytes, length, buffer->bytes, buffer->length, pendingSpace);
+    buffer->bytes[buffer->length] = 0;
+    return YES;
+}
+
+// Returns the string of the trimmed bytes, the only allocation is the string
+NSString * trimmedString(const xmlChar * bytes, size_t length)
+{
+    size_t start = 0, end = length;
+    trimWhitespace(bytes, &start, &end);
+    if (start == end) return @"";
+    return SAFE_ARC_AUTORELEASE([[NSString alloc] initWithBytes:bytes + start length:end - start encoding:NSUTF8StringEncoding]);
+}
+
+// Returns the string of the trimmed and collapsed bytes, the collapsed bytes are passed to the string without copying
+NSString * collapsedString(const xmlChar * bytes, size_t length)
+{
+    if (length == 0) return @"";
+    
+    xmlChar *collapsedBytes = malloc(length + 1);
+    if (collapsedBytes == NULL) return nil;
+    BOOL pendingSpace = NO;
+    size_t collapsedLength = collapseWhitespace(bytes, length, collapsedBytes, 0, &pendingSpace);
+    if (collapsedLength == 0) {
+        free(collapsedBytes);
+        return @"";
+    }
+    NSString *string = [[NSString alloc] initWithBytesNoCopy:collapsedBytes length:collapsedLength encoding:NSUTF8StringEncoding freeWhenDone:YES];
+    // the bytes aren't freed if the string can't be created
+    if (string == nil) free(collapsedBytes);
+    return SAFE_ARC_AUTORELEASE(string);
+}
+
+// Returns the trimmed content, an empty string for empty content and nil for whitespace only
+NSString * trimmedTextContent(const xmlChar * bytes, size_t length)
+{
+    if (length == 0) return @"";
+    
+    size_t start = 0, end = length;
+    trimWhitespace(bytes, &start, &end);
+    if (start == end) return nil;
+    return SAFE_ARC_AUTORELEASE([[NSString alloc] initWithBytes:bytes + start length:end - start encoding:NSUTF8StringEncoding]);
+}
+
+// Returns the next text or CDATA node of the subtree of root in document order,
+// like xmlNodeGetContent only the children of elements are considered
+xmlNode * nextTextNodeInSubtree(xmlNode * node, xmlNode * root)
+{
+    do {
+        if (node->children && (node->type == XML_ELEMENT_NODE || node == root)) {
+            node = node->children;
+        } else {
+            while (node != root && node->next == NULL) node = node->parent;
+            node = (node != root) ? node->next : NULL;
+        }
+    } while (node && node->type != XML_TEXT_NODE && node->type != XML_CDATA_SECTION_NODE);
+    return node;
+}
+
+// The trimmed content of each descendant in document order, the content of an element is the range
+// of the text buffer between its start and its end, so the walk is linear in the size of the subtree
+void textContentOfDescendants(xmlNode * root, NSMutableArray * array)
+{
+    HTMLTextBuffer buffer = { NULL, 0, 0 };
+    HTMLOpenElement *openElements = NULL;
+    size_t depth = 0, depthCapacity = 0;
+    BOOL succeeded = YES;
+    
+    xmlNode *node = root->children;
+    while (node && succeeded) {
+        if (node->type == XML_ELEMENT_NODE) {
+            if (depth == depthCapacity) {
+                depthCapacity = depthCapacity ? depthCapacity * 2 : 32;
+                HTMLOpenElement *grownElements = xmlRealloc(openElements, depthCapacity * sizeof(HTMLOpenElement));
+                if (grownElements == NULL) break;
+                openElements = grownElements;
+            }
+            openElements[depth++] = (HTMLOpenElement){ buffer.length, array.count };
+            [array addObject:[NSNull null]];
+            if (node->children) {
+                node = node->children;
+                continue;
+            }
+        } else if (node->content && (node->type == XML_TEXT_NODE || node->type == XML_CDATA_SECTION_NODE
+                                     || node->type == XML_COMMENT_NODE || node->type == XML_PI_NODE)) {
+            size_t length = (size_t)xmlStrlen(node->content);
+            // comments and processing instructions aren't part of the content of their ancestors
+            if (node->type == XML_TEXT_NODE || node->type == XML_CDATA_SECTION_NODE) {
+                succeeded = textBufferAppend(&buffer, node->content, length);
+            }
+            NSString *content = trimmedTextContent(node->content, length);
+            if (content) [array addObject:content];
+        }
+        
+        // the end of the node and of all ancestors whose last descendant it is
+        for (;;) {
+            if (node->type == XML_ELEMENT_NODE) {
+                HTMLOpenElement element = openElements[--depth];
+                NSString *content = trimmedTextContent(buffer.bytes + element.start, buffer.length - element.start);
+                if (content) [array replaceObjectAtIndex:element.index withObject:content];
+            }
+            if (node->next) {
+                node = node->next;
+                break;
+            }
+            node = node->parent;
+            if (node == NULL || node == root) {
+                node = NULL;
+                break;
+            }
+        }
+    }
+    // whitespace only elements and the elements still open after an allocation failure
+    [array removeObjectIdenticalTo:[NSNull null]];
+    xmlFree(openElements);
+    xmlFree(buffer.bytes);
+}
+
+// The trimmed content of each text node of descendant-or-self, whitespace only text nodes are omitted
+void textContentOfTextNodes(xmlNode * root, NSMutableArray * array)
+{
+    BOOL isText = (root->type == XML_TEXT_NODE || root->type == XML_CDATA_SECTION_NODE);
+    for (xmlNode *node = isText ? root : nextTextNodeInSubtree(root, root); node; node = nextTextNodeInSubtree(node, root)) {
+        if (node->content == NULL || node->content[0] == 0) continue;
+        NSString *content = trimmedTextContent(node->content, (size_t)xmlStrlen(node->content));
+        if (content) [array addObject:content];
+    }
+}
+
+// The text nodes of descendant-or-self joined into one string: without separator the text is concatenated
+// and collapsed as a whole, with separator each text node is trimmed, optionally collapsed and whitespace only nodes are omitted
+NSString * joinedTextContent(xmlNode * root, const xmlChar * separator, BOOL collapse)
+{
+    HTMLTextBuffer buffer = { NULL, 0, 0 };
+    size_t separatorLength = separator ? (size_t)xmlStrlen(separator) : 0;
+    BOOL pendingSpace = NO, succeeded = YES;
+    
+    BOOL isText = (root->type == XML_TEXT_NODE || root->type == XML_CDATA_SECTION_NODE);
+    for (xmlNode *node = isText ? root : nextTextNodeInSubtree(root, root); node && succeeded; node = nextTextNodeInSubtree(node, root)) {
+        if (node->content == NULL) continue;
+        size_t start = 0, end = (size_t)xmlStrlen(node->content);
+        
+        if (separator == NULL) {
+            succeeded = collapse ? textBufferAppendCollapsingWhitespace(&buffer, node->content, end, &pendingSpace)
+                                 : textBufferAppend(&buffer, node->content, end);
+            continue;
+        }
+        trimWhitespace(node->content, &start, &end);
+        if (start == end) continue;
+        if (buffer.length) succeeded = textBufferAppend(&buffer, separator, separatorLength);
+        if (! succeeded) break;
+        pendingSpace = NO;
+        succeeded = collapse ? textBufferAppendCollapsingWhitespace(&buffer, node->content + start, end - start, &pendingSpace)
+                             : textBufferAppend(&buffer, node->content + start, end - start);
+    }
+    
+    NSString *result = nil;
+    if (succeeded) {
+        result = (buffer.length == 0) ? @"" : SAFE_ARC_AUTORELEASE([[NSString alloc] initWithBytes:buffer.bytes
+                                                                                           length:buffer.length
+                                                                                         encoding:NSUTF8StringEncoding]);
+    }
+    xmlFree(buffer.bytes);
+    return result;
+}
+
 - (NSString *)rawTextContent
 {
     return textContent(xmlNode_);
@@ -483,12 +1092,41 @@ NSString * textContent(xmlNode *node)
 
 - (NSString *)textContent
 {
-    return [textContent(xmlNode_) stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+    xmlChar *contents = xmlNodeGetContent(xmlNode_);
+    if (contents == NULL) return nil;
+    
+    NSString *string = trimmedString(contents, (size_t)xmlStrlen(contents));
+    xmlFree(contents);
+    return string;
 }
 
 - (NSString *)textContentCollapsingWhitespace;
 {
-    return [self.textContent collapseWhitespaceAndNewLine];
+    switch (xmlNode_->type) {
+        case XML_ELEMENT_NODE:
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE:
+        case XML_DOCUMENT_NODE:
+        case XML_HTML_DOCUMENT_NODE:
+        case XML_DOCUMENT_FRAG_NODE:
+            return joinedTextContent(xmlNode_, NULL, YES);
+            
+        default:
+            return [self.textContent collapseWhitespaceAndNewLine];
+    }
+}
+
+- (NSArray<NSString *> *)textContentOfTextNodes
+{
+    NSMutableArray *array = [NSMutableArray array];
+    textContentOfTextNodes(xmlNode_, array);
+    return array;
+}
+
+- (NSString *)textContentJoinedBySeparator:(NSString *)separator collapsingWhitespace:(BOOL)collapse
+{
+    if (separator == nil) return nil;
+    return joinedTextContent(xmlNode_, BAD_CAST [separator UTF8String], collapse);
 }
 
 
@@ -513,14 +1151,96 @@ NSString * textContent(xmlNode *node)
     return result;
 }
 
+// The HTML content is serialized straight into the sink of the caller without intermediate buffer or string,
+// libxml2 passes the output in chunks of its output buffer to the write callback
+
+int dataWriteCallback(void * context, const char * buffer, int length)
+{
+    [(__bridge NSMutableData *)context appendBytes:buffer length:(NSUInteger)length];
+    return length;
+}
+
+int streamWriteCallback(void * context, const char * buffer, int length)
+{
+    NSOutputStream *stream = (__bridge NSOutputStream *)context;
+    for (int written = 0; written < length; ) {
+        NSInteger result = [stream write:(const uint8_t *)buffer + written maxLength:(NSUInteger)(length - written)];
+        if (result <= 0) return -1;
+        written += (int)result;
+    }
+    return length;
+}
+
+int fileDescriptorWriteCallback(void * context, const char * buffer, int length)
+{
+    HTMLFileDescriptorSink *sink = context;
+    for (int written = 0; written < length; ) {
+        ssize_t result = write(sink->fileDescriptor, buffer + written, (size_t)(length - written));
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            sink->errorNumber = errno;
+            return -1;
+        }
+        written += (int)result;
+    }
+    return length;
+}
+
+BOOL writeHTMLContent(xmlNode * node, xmlOutputWriteCallback writeCallback, void * context)
+{
+    xmlOutputBufferPtr outputBuffer = xmlOutputBufferCreateIO(writeCallback, NULL, context, NULL);
+    if (outputBuffer == NULL) return NO;
+    
+    htmlNodeDumpOutput(outputBuffer, node->doc, node, (node->doc) ? (const char *)node->doc->encoding : NULL);
+    // flushes the remaining output and returns the error of a failed write
+    return xmlOutputBufferClose(outputBuffer) >= 0;
+}
+
+- (NSError *)writeError
+{
+    return [NSError errorWithDomain:@"com.klieme.HTMLNode"
+                               code:1
+                           userInfo:@{NSLocalizedDescriptionKey: @"HTML content could not be written"}];
+}
+
+- (BOOL)writeHTMLToData:(NSMutableData *)data error:(NSError **)error
+{
+    if (writeHTMLContent(xmlNode_, dataWriteCallback, (__bridge void *)data)) return YES;
+    if (error) *error = [self writeError];
+    return NO;
+}
+
+- (BOOL)writeHTMLToStream:(NSOutputStream *)stream error:(NSError **)error
+{
+    if (writeHTMLContent(xmlNode_, streamWriteCallback, (__bridge void *)stream)) return YES;
+    if (error) *error = (stream.streamError) ? stream.streamError : [self writeError];
+    return NO;
+}
+
+- (BOOL)writeHTMLToFileDescriptor:(int)fileDescriptor error:(NSError **)error
+{
+    HTMLFileDescriptorSink sink = { fileDescriptor, 0 };
+    if (writeHTMLContent(xmlNode_, fileDescriptorWriteCallback, &sink)) return YES;
+    if (error) *error = (sink.errorNumber) ? [NSError errorWithDomain:NSPOSIXErrorDomain code:sink.errorNumber userInfo:nil] : [self writeError];
+    return NO;
+}
+
+
+- (HTMLTable *)tableContent
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLTable alloc] initWithTableNode:xmlNode_]);
+}
+
 
 #pragma mark - query methods
 
 HTMLNode * childWithAttribute(const xmlChar * attrName, xmlNode * node, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     xmlNode *currentNode = NULL;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -542,9 +1262,11 @@ HTMLNode * childWithAttribute(const xmlChar * attrName, xmlNode * node, BOOL rec
 
 HTMLNode * childWithAttributeValueMatches(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     xmlNode *currentNode = NULL;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -567,9 +1289,11 @@ HTMLNode * childWithAttributeValueMatches(const xmlChar * attrName, const xmlCha
 
 HTMLNode * childWithAttributeValueContains(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     xmlNode *currentNode = NULL;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -591,9 +1315,11 @@ HTMLNode * childWithAttributeValueContains(const xmlChar * attrName, const xmlCh
 
 HTMLNode * childWithAttributeValueBeginsWith(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     xmlNode *currentNode = NULL;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -616,9 +1342,11 @@ HTMLNode * childWithAttributeValueBeginsWith(const xmlChar * attrName, const xml
 
 HTMLNode * childWithAttributeValueEndsWith(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     xmlNode *currentNode = NULL;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -645,11 +1373,13 @@ HTMLNode * childWithAttributeValueEndsWith(const xmlChar * attrName, const xmlCh
 
 void childrenWithAttribute(const xmlChar * attrName, xmlNode * node, NSMutableArray * array, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     if (attrName == NULL) return;
     
     xmlNode *currentNode;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -667,11 +1397,13 @@ void childrenWithAttribute(const xmlChar * attrName, xmlNode * node, NSMutableAr
 
 void childrenWithAttributeValueMatches(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, NSMutableArray * array, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     if (attrName == NULL) return;
     
     xmlNode *currentNode;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -691,11 +1423,13 @@ void childrenWithAttributeValueMatches(const xmlChar * attrName, const xmlChar *
 
 void childrenWithAttributeValueContains(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, NSMutableArray * array, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     if (attrName == NULL) return;
     
     xmlNode *currentNode;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -715,11 +1449,13 @@ void childrenWithAttributeValueContains(const xmlChar * attrName, const xmlChar
 
 void childrenWithAttributeValueBeginsWith(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, NSMutableArray * array, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     if (attrName == NULL) return;
     
     xmlNode *currentNode;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -739,11 +1475,13 @@ void childrenWithAttributeValueBeginsWith(const xmlChar * attrName, const xmlCha
 
 void childrenWithAttributeValueEndsWith(const xmlChar * attrName, const xmlChar * attrValue, xmlNode * node, NSMutableArray * array, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     if (attrName == NULL) return;
     
     xmlNode *currentNode;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         
         for (xmlAttrPtr attr = currentNode->properties; attr; attr = attr->next) {
             if (xmlStrEqual(attr->name, attrName)) {
@@ -947,6 +1685,9 @@ void childrenWithAttributeValueEndsWith(const xmlChar * attrName, const xmlChar
 
 - (HTMLNode *)descendantWithClass:(NSString *)classValue
 {
+    HTMLNode *firstNode = nil;
+    if (lookUpNodeIndex(HTMLNodeIndexTableClasses, BAD_CAST [classValue UTF8String], xmlNode_, nodeHasAttributeValueMatches, BAD_CAST "class", BAD_CAST [classValue UTF8String], nil, &firstNode))
+        return firstNode;
     return childWithAttributeValueMatches(BAD_CAST "class", BAD_CAST [classValue UTF8String], xmlNode_->children, YES);
 }
 
@@ -962,6 +1703,9 @@ void childrenWithAttributeValueEndsWith(const xmlChar * attrName, const xmlChar
 
 - (NSArray<HTMLNode *> *)descendantsWithClass:(NSString *)classValue
 {
+    NSMutableArray *array = [NSMutableArray array];
+    if (lookUpNodeIndex(HTMLNodeIndexTableClasses, BAD_CAST [classValue UTF8String], xmlNode_, nodeHasAttributeValueMatches, BAD_CAST "class", BAD_CAST [classValue UTF8String], array, NULL))
+        return array;
     return [self descendantsWithAttribute:kClassKey valueMatches:classValue];
 }
 
@@ -975,8 +1719,152 @@ void childrenWithAttributeValueEndsWith(const xmlChar * attrName, const xmlChar
     return [self siblingsWithAttribute:kClassKey valueMatches:classValue];
 }
 
+// Splits a whitespace separated list of class names in place, duplicate names are dropped.
+// Returns NO for an empty list or more than MAX_CLASS_NAMES names
+BOOL parseClassNames(const xmlChar * classNames, HTMLClassNames * names)
+{
+    names->count = 0;
+    if (classNames == NULL) return NO;
+    
+    const char *token = (const char *)classNames;
+    while (*(token += strspn(token, CLASS_WHITESPACE))) {
+        size_t length = strcspn(token, CLASS_WHITESPACE);
+        BOOL duplicate = NO;
+        for (int i = 0; i < names->count && ! duplicate; i++) {
+            duplicate = names->lengths[i] == length && memcmp(names->tokens[i], token, length) == 0;
+        }
+        if (! duplicate) {
+            if (names->count == MAX_CLASS_NAMES) return NO;
+            names->tokens[names->count] = token;
+            names->lengths[names->count++] = length;
+        }
+        token += length;
+    }
+    return names->count > 0;
+}
+
+// Scans the tokens of a class attribute value once and ticks the required names off in a bit mask
+BOOL classValueHasClassNames(const xmlChar * classValue, const HTMLClassNames * names)
+{
+    uint64_t required = (names->count == MAX_CLASS_NAMES) ? UINT64_MAX : (UINT64_C(1) << names->count) - 1;
+    uint64_t found = 0;
+    
+    const char *token = (const char *)classValue;
+    while (*(token += strspn(token, CLASS_WHITESPACE))) {
+        size_t length = strcspn(token, CLASS_WHITESPACE);
+        for (int i = 0; i < names->count; i++) {
+            uint64_t bit = UINT64_C(1) << i;
+            if (names->lengths[i] == length && (found & bit) == 0 && memcmp(names->tokens[i], token, length) == 0) {
+                found |= bit;
+                if (found == required) return YES;
+                break;
+            }
+        }
+        token += length;
+    }
+    return NO;
+}
+
+// The match function of the class names queries, names is a pointer to the parsed HTMLClassNames
+BOOL nodeHasClassNames(xmlNode * node, const xmlChar * unused, const xmlChar * names)
+{
+    if (node->type != XML_ELEMENT_NODE) return NO;
+    
+    for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+        if (xmlStrEqual(attr->name, BAD_CAST "class")) {
+            xmlNode * child = attr->children;
+            return child && child->content && classValueHasClassNames(child->content, (const HTMLClassNames *)names);
+        }
+    }
+    return NO;
+}
+
+// Returns the first matching node if array is nil, otherwise all matching nodes are added to array.
+// The walk starts at node and visits the following siblings, or the rest of the subtree of root if recursive
+HTMLNode * childrenWithClassNames(const HTMLClassNames * names, xmlNode * node, xmlNode * root, NSMutableArray * array, BOOL recursive)
+{
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
+    for (xmlNode *currentNode = node; currentNode; currentNode = (recursive) ? nextNodeInSubtree(currentNode, root) : currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
+        if (! nodeHasClassNames(currentNode, NULL, (const xmlChar *)names)) continue;
+        
+        if (array == nil) return [HTMLNode nodeWithXMLNode:currentNode];
+        HTMLNode *matchingNode = [[HTMLNode alloc] initWithXMLNode:currentNode];
+        [array addObject:matchingNode];
+        SAFE_ARC_RELEASE(matchingNode);
+    }
+    return nil;
+}
+
+- (HTMLNode *)descendantWithClassNames:(NSString *)classNames
+{
+    HTMLClassNames names;
+    const xmlChar *classNamesString = BAD_CAST [classNames UTF8String];
+    if (! parseClassNames(classNamesString, &names)) return nil;
+    
+    // the index returns the candidates having the first name
+    HTMLNode *firstNode = nil;
+    if (lookUpNodeIndex(HTMLNodeIndexTableClasses, classNamesString, xmlNode_, nodeHasClassNames, NULL, (const xmlChar *)&names, nil, &firstNode))
+        return firstNode;
+    return childrenWithClassNames(&names, xmlNode_->children, xmlNode_, nil, YES);
+}
+
+- (HTMLNode *)childWithClassNames:(NSString *)classNames
+{
+    HTMLClassNames names;
+    if (! parseClassNames(BAD_CAST [classNames UTF8String], &names)) return nil;
+    return childrenWithClassNames(&names, xmlNode_->children, xmlNode_, nil, NO);
+}
+
+- (HTMLNode *)siblingWithClassNames:(NSString *)classNames
+{
+    HTMLClassNames names;
+    if (! parseClassNames(BAD_CAST [classNames UTF8String], &names)) return nil;
+    return childrenWithClassNames(&names, xmlNode_->next, xmlNode_, nil, NO);
+}
+
+- (NSArray<HTMLNode *> *)descendantsWithClassNames:(NSString *)classNames
+{
+    NSMutableArray *array = [NSMutableArray array];
+    HTMLClassNames names;
+    const xmlChar *classNamesString = BAD_CAST [classNames UTF8String];
+    if (! parseClassNames(classNamesString, &names)) return array;
+    
+    if (! lookUpNodeIndex(HTMLNodeIndexTableClasses, classNamesString, xmlNode_, nodeHasClassNames, NULL, (const xmlChar *)&names, array, NULL))
+        childrenWithClassNames(&names, xmlNode_->children, xmlNode_, array, YES);
+    return array;
+}
+
+- (NSArray<HTMLNode *> *)childrenWithClassNames:(NSString *)classNames
+{
+    NSMutableArray *array = [NSMutableArray array];
+    HTMLClassNames names;
+    if (parseClassNames(BAD_CAST [classNames UTF8String], &names))
+        childrenWithClassNames(&names, xmlNode_->children, xmlNode_, array, NO);
+    return array;
+}
+
+- (NSArray<HTMLNode *> *)siblingsWithClassNames:(NSString *)classNames
+{
+    NSMutableArray *array = [NSMutableArray array];
+    HTMLClassNames names;
+    if (parseClassNames(BAD_CAST [classNames UTF8String], &names))
+        childrenWithClassNames(&names, xmlNode_->next, xmlNode_, array, NO);
+    return array;
+}
+
+- (BOOL)hasClassNames:(NSString *)classNames
+{
+    HTMLClassNames names;
+    if (xmlNode_ == NULL || ! parseClassNames(BAD_CAST [classNames UTF8String], &names)) return NO;
+    return nodeHasClassNames(xmlNode_, NULL, (const xmlChar *)&names);
+}
+
 - (HTMLNode *)descendantWithID:(NSString *)IDValue
 {
+    HTMLNode *firstNode = nil;
+    if (lookUpNodeIndex(HTMLNodeIndexTableIDs, BAD_CAST [IDValue UTF8String], xmlNode_, NULL, NULL, NULL, nil, &firstNode))
+        return firstNode;
     return childWithAttributeValueMatches(BAD_CAST "id", BAD_CAST [IDValue UTF8String], xmlNode_->children, YES);
 }
 
@@ -992,13 +1880,15 @@ void childrenWithAttributeValueEndsWith(const xmlChar * attrName, const xmlChar
 
 HTMLNode * childOfTagValueMatches(const xmlChar * tagName, const xmlChar * value, xmlNode * node, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     xmlNode *currentNode, *childNode;
     const xmlChar *childName;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) 	{
+        HTML_INSTRUMENT_VISIT();
         if (xmlStrEqual(currentNode->name, tagName)) {
             childNode = currentNode->children;
-            childName = (childNode) ? childNode->content : NULL;
+            childName = (childNode && childNode->type != XML_ELEMENT_NODE) ? childNode->content : NULL;
             if (childName && xmlStrEqual(childName, value)) {
                 return [HTMLNode nodeWithXMLNode:currentNode];
             }
@@ -1016,13 +1906,15 @@ HTMLNode * childOfTagValueMatches(const xmlChar * tagName, const xmlChar * value
 
 HTMLNode * childOfTagValueContains(const xmlChar * tagName, const xmlChar * value, xmlNode * node, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     xmlNode *currentNode, *childNode;
     const xmlChar *childName;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) 	{
+        HTML_INSTRUMENT_VISIT();
         if (xmlStrEqual(currentNode->name, tagName)) {
             childNode = currentNode->children;
-            childName = (childNode) ? childNode->content : NULL;
+            childName = (childNode && childNode->type != XML_ELEMENT_NODE) ? childNode->content : NULL;
             if (childName && xmlStrstr(childName, value) != NULL) {
                 return [HTMLNode nodeWithXMLNode:currentNode];
             }
@@ -1071,15 +1963,17 @@ HTMLNode * childOfTagValueContains(const xmlChar * tagName, const xmlChar * valu
 
 void childrenOfTagValueMatches(const xmlChar * tagName, const xmlChar * value, xmlNode * node, NSMutableArray * array, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     if (tagName == NULL) return;
     
     xmlNode *currentNode, *childNode;
     const xmlChar *childName;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) 	{
+        HTML_INSTRUMENT_VISIT();
         if (xmlStrEqual(currentNode->name, tagName)) {
             childNode = currentNode->children;
-            childName = (childNode) ? childNode->content : NULL;
+            childName = (childNode && childNode->type != XML_ELEMENT_NODE) ? childNode->content : NULL;
             if (childName && xmlStrEqual(childName, value)) {
                 HTMLNode * matchingNode = [[HTMLNode alloc] initWithXMLNode:currentNode];
                 [array addObject:matchingNode];
@@ -1092,15 +1986,17 @@ void childrenOfTagValueMatches(const xmlChar * tagName, const xmlChar * value, x
 
 void childrenOfTagValueContains(const xmlChar * tagName, const xmlChar * value, xmlNode * node, NSMutableArray * array, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     if (tagName == NULL) return;
     
     xmlNode *currentNode, *childNode;
     const xmlChar *childName;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) 	{
+        HTML_INSTRUMENT_VISIT();
         if (xmlStrEqual(currentNode->name, tagName)) {
             childNode = currentNode->children;
-            childName = (childNode) ? childNode->content : NULL;
+            childName = (childNode && childNode->type != XML_ELEMENT_NODE) ? childNode->content : NULL;
             if (childName && xmlStrstr(childName, value) != NULL) {
                 HTMLNode * matchingNode = [[HTMLNode alloc] initWithXMLNode:currentNode];
                 [array addObject:matchingNode];
@@ -1158,9 +2054,11 @@ void childrenOfTagValueContains(const xmlChar * tagName, const xmlChar * value,
 
 HTMLNode * childOfTag(const xmlChar * tagName, xmlNode * node, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     xmlNode *currentNode;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) 	{
+        HTML_INSTRUMENT_VISIT();
         if (currentNode->name && xmlStrEqual(currentNode->name, tagName)) {
             return [HTMLNode nodeWithXMLNode:currentNode];
         }
@@ -1177,6 +2075,9 @@ HTMLNode * childOfTag(const xmlChar * tagName, xmlNode * node, BOOL recursive)
 
 - (HTMLNode *)descendantOfTag:(NSString *)tagName
 {
+    HTMLNode *firstNode = nil;
+    if (lookUpNodeIndex(HTMLNodeIndexTableTags, BAD_CAST [tagName UTF8String], xmlNode_, NULL, NULL, NULL, nil, &firstNode))
+        return firstNode;
     return (tagName) ? childOfTag(BAD_CAST [tagName UTF8String], xmlNode_->children, YES) : nil;
 }
 
@@ -1193,11 +2094,13 @@ HTMLNode * childOfTag(const xmlChar * tagName, xmlNode * node, BOOL recursive)
 
 void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * array, BOOL recursive)
 {
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
     if (tagName == NULL) return;
     
     xmlNode *currentNode;
     
     for (currentNode = node; currentNode; currentNode = currentNode->next) {
+        HTML_INSTRUMENT_VISIT();
         if (currentNode->name && xmlStrEqual(currentNode->name, tagName)) {
             HTMLNode * matchingNode = [[HTMLNode alloc] initWithXMLNode:currentNode];
             [array addObject:matchingNode];
@@ -1211,6 +2114,8 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
 - (NSArray<HTMLNode *> *)descendantsOfTag:(NSString *)tagName
 {
     NSMutableArray *array = [NSMutableArray array];
+    if (lookUpNodeIndex(HTMLNodeIndexTableTags, BAD_CAST [tagName UTF8String], xmlNode_, NULL, NULL, NULL, array, NULL))
+        return array;
     childrenOfTag(BAD_CAST [tagName UTF8String], xmlNode_->children, array, YES);
     return array;
 }
@@ -1229,6 +2134,429 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
     return array;
 }
 
+#pragma mark - enumeration methods
+
+// Returns the next node of the subtree of root in document order, the traversal needs no recursion
+xmlNode * nextNodeInSubtree(xmlNode * node, xmlNode * root)
+{
+    // the children of entity references are the entity declarations outside of the subtree
+    if (node->children && node->type != XML_ENTITY_REF_NODE) return node->children;
+    
+    for (; node && node != root; node = node->parent) {
+        if (node->next) return node->next;
+    }
+    return NULL;
+}
+
+BOOL nodeIsOfTag(xmlNode * node, const xmlChar * tagName, const xmlChar * unused)
+{
+    return node->name && xmlStrEqual(node->name, tagName);
+}
+
+BOOL nodeHasAttribute(xmlNode * node, const xmlChar * attrName, const xmlChar * unused)
+{
+    if (node->type != XML_ELEMENT_NODE) return NO;
+    
+    for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+        if (xmlStrEqual(attr->name, attrName)) return YES;
+    }
+    return NO;
+}
+
+BOOL nodeHasAttributeValueMatches(xmlNode * node, const xmlChar * attrName, const xmlChar * attrValue)
+{
+    if (node->type != XML_ELEMENT_NODE) return NO;
+    
+    for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+        if (xmlStrEqual(attr->name, attrName)) {
+            xmlNode * child = attr->children;
+            return child && xmlStrEqual(child->content, attrValue);
+        }
+    }
+    return NO;
+}
+
+// Passes each matching node to the block in one reused node object
+void enumerateNodes(xmlNode * node, HTMLNodeScope scope, HTMLNodeMatchFunction match, const xmlChar * name, const xmlChar * value, HTMLNodeEnumerationBlock block)
+{
+    xmlNode *currentNode = (scope == HTMLNodeScopeSiblings) ? node->next : node->children;
+    if (currentNode == NULL) return;
+    
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
+    HTMLNode *flyweightNode = [[HTMLNode alloc] initWithXMLNode:NULL];
+    BOOL stop = NO;
+    
+    while (currentNode) {
+        HTML_INSTRUMENT_VISIT();
+        if (match == NULL || match(currentNode, name, value)) {
+            HTML_INSTRUMENT_MATCH();
+            flyweightNode->xmlNode_ = currentNode;
+            block(flyweightNode, &stop);
+            if (stop) break;
+        }
+        currentNode = (scope == HTMLNodeScopeDescendants) ? nextNodeInSubtree(currentNode, node) : currentNode->next;
+    }
+    flyweightNode->xmlNode_ = NULL;
+    SAFE_ARC_RELEASE(flyweightNode);
+}
+
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope usingBlock:(HTMLNodeEnumerationBlock)block
+{
+    enumerateNodes(xmlNode_, scope, NULL, NULL, NULL, block);
+}
+
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope ofTag:(NSString *)tagName usingBlock:(HTMLNodeEnumerationBlock)block
+{
+    if (tagName == nil) return;
+    enumerateNodes(xmlNode_, scope, nodeIsOfTag, BAD_CAST [tagName UTF8String], NULL, block);
+}
+
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope withAttribute:(NSString *)attributeName usingBlock:(HTMLNodeEnumerationBlock)block
+{
+    if (attributeName == nil) return;
+    enumerateNodes(xmlNode_, scope, nodeHasAttribute, BAD_CAST [attributeName UTF8String], NULL, block);
+}
+
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope withAttribute:(NSString *)attributeName valueMatches:(NSString *)attributeValue usingBlock:(HTMLNodeEnumerationBlock)block
+{
+    if (attributeName == nil || attributeValue == nil) return;
+    enumerateNodes(xmlNode_, scope, nodeHasAttributeValueMatches, BAD_CAST [attributeName UTF8String], BAD_CAST [attributeValue UTF8String], block);
+}
+
+- (void)enumerateNodesInScope:(HTMLNodeScope)scope withClassNames:(NSString *)classNames usingBlock:(HTMLNodeEnumerationBlock)block
+{
+    HTMLClassNames names;
+    if (! parseClassNames(BAD_CAST [classNames UTF8String], &names)) return;
+    enumerateNodes(xmlNode_, scope, nodeHasClassNames, NULL, (const xmlChar *)&names, block);
+}
+
+#pragma mark - document order
+
+// the topmost ancestor of a node, the document or the root of an unlinked subtree
+xmlNode * rootOfTree(xmlNode * node)
+{
+    while (node->parent) node = node->parent;
+    return node;
+}
+
+// The document order of two nodes, xmlXPathCmpNodes compares two numbered elements without walking their ancestors.
+// Nodes of different documents are ordered by the address of their documents, the trees of unlinked subtrees by the address
+// of their roots, so the order stays total. A NULL node precedes all nodes
+NSComparisonResult compareDocumentOrder(xmlNode * node1, xmlNode * node2)
+{
+    if (node1 == node2) return NSOrderedSame;
+    if (node1 == NULL) return NSOrderedAscending;
+    if (node2 == NULL) return NSOrderedDescending;
+    if (node1->doc != node2->doc) return ((uintptr_t)node1->doc < (uintptr_t)node2->doc) ? NSOrderedAscending : NSOrderedDescending;
+    
+    switch (xmlXPathCmpNodes(node1, node2)) {
+        case 1: return NSOrderedAscending;
+        case -1: return NSOrderedDescending;
+        default: {
+            // nodes of different trees
+            xmlNode *root1 = rootOfTree(node1), *root2 = rootOfTree(node2);
+            if (root1 != root2) return ((uintptr_t)root1 < (uintptr_t)root2) ? NSOrderedAscending : NSOrderedDescending;
+            return ((uintptr_t)node1 < (uintptr_t)node2) ? NSOrderedAscending : NSOrderedDescending;
+        }
+    }
+}
+
+- (NSComparisonResult)compareDocumentOrder:(HTMLNode *)node
+{
+    xmlNode *otherNode = (node) ? node->xmlNode_ : NULL;
+    if (xmlNode_ && otherNode && xmlNode_->doc && xmlNode_->doc == otherNode->doc && xmlNode_->doc->_private) {
+        [(__bridge HTMLDocument *)xmlNode_->doc->_private prepareDocumentOrder];
+    }
+    return compareDocumentOrder(xmlNode_, otherNode);
+}
+
++ (NSArray *)nodesSortedInDocumentOrder:(NSArray *)nodes removingDuplicates:(BOOL)removeDuplicates
+{
+    // each document is numbered once before the sort
+    xmlDoc *previousDoc = NULL;
+    for (HTMLNode *node in nodes) {
+        xmlDoc *doc = (node->xmlNode_) ? node->xmlNode_->doc : NULL;
+        if (doc == NULL || doc == previousDoc) continue;
+        if (doc->_private) [(__bridge HTMLDocument *)doc->_private prepareDocumentOrder];
+        previousDoc = doc;
+    }
+    
+    NSArray *sortedNodes = [nodes sortedArrayUsingComparator:^NSComparisonResult(HTMLNode *node1, HTMLNode *node2) {
+        return compareDocumentOrder(node1->xmlNode_, node2->xmlNode_);
+    }];
+    if (! removeDuplicates || sortedNodes.count < 2) return sortedNodes;
+    
+    NSMutableArray *uniqueNodes = [NSMutableArray arrayWithCapacity:sortedNodes.count];
+    xmlNode *previousNode = NULL;
+    for (HTMLNode *node in sortedNodes) {
+        if (node->xmlNode_ == previousNode) continue;
+        [uniqueNodes addObject:node];
+        previousNode = node->xmlNode_;
+    }
+    return uniqueNodes;
+}
+
+#pragma mark - node index
+
+// The index stores the preorder number of each element in its _private field,
+// so the nodes of a subtree are a contiguous range of each list sorted in document order
+
+void nodeListDeallocator(void * payload, const xmlChar * name)
+{
+    HTMLNodeList *list = payload;
+    xmlFree(list->nodes);
+    xmlFree(list);
+}
+
+void nodeIndexAddNode(xmlHashTablePtr table, const xmlChar * key, xmlNode * node)
+{
+    HTMLNodeList *list = xmlHashLookup(table, key);
+    if (list == NULL) {
+        list = xmlMalloc(sizeof(HTMLNodeList));
+        if (list == NULL) return;
+        list->nodes = NULL;
+        list->count = list->capacity = 0;
+        if (xmlHashAddEntry(table, key, list) != 0) {
+            xmlFree(list);
+            return;
+        }
+    }
+    if (list->count && list->nodes[list->count - 1] == node) return; // duplicate class token
+    
+    if (list->count == list->capacity) {
+        size_t capacity = (list->capacity) ? list->capacity * 2 : 4;
+        xmlNode **nodes = xmlRealloc(list->nodes, capacity * sizeof(xmlNode *));
+        if (nodes == NULL) return;
+        list->nodes = nodes;
+        list->capacity = capacity;
+    }
+    list->nodes[list->count++] = node;
+}
+
+void nodeIndexAddClassTokens(xmlHashTablePtr table, const xmlChar * classValue, xmlNode * node)
+{
+    const char *token = (const char *)classValue;
+    while (*(token += strspn(token, CLASS_WHITESPACE))) {
+        size_t length = strcspn(token, CLASS_WHITESPACE);
+        xmlChar *key = xmlStrndup(BAD_CAST token, (int)length);
+        if (key) {
+            nodeIndexAddNode(table, key, node);
+            xmlFree(key);
+        }
+        token += length;
+    }
+}
+
+HTMLNodeIndex * HTMLNodeIndexCreate(xmlDoc * doc)
+{
+    if (doc == NULL) return NULL;
+    
+    HTMLNodeIndex *nodeIndex = xmlMalloc(sizeof(HTMLNodeIndex));
+    if (nodeIndex == NULL) return NULL;
+    nodeIndex->ids = xmlHashCreate(0);
+    nodeIndex->classes = xmlHashCreate(0);
+    nodeIndex->tags = xmlHashCreate(0);
+    if (nodeIndex->ids == NULL || nodeIndex->classes == NULL || nodeIndex->tags == NULL) {
+        HTMLNodeIndexFree(nodeIndex);
+        return NULL;
+    }
+    
+    intptr_t number = 0;
+    for (xmlNode *node = doc->children; node; node = nextNodeInSubtree(node, (xmlNode *)doc)) {
+        if (node->type != XML_ELEMENT_NODE) continue;
+        
+        node->_private = (void *)++number;
+        if (node->name) nodeIndexAddNode(nodeIndex->tags, node->name, node);
+        
+        for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+            const xmlChar *attrValue = (attr->children) ? attr->children->content : NULL;
+            if (attrValue == NULL) continue;
+            
+            if (xmlStrEqual(attr->name, BAD_CAST "id"))
+                nodeIndexAddNode(nodeIndex->ids, attrValue, node);
+            else if (xmlStrEqual(attr->name, BAD_CAST "class"))
+                nodeIndexAddClassTokens(nodeIndex->classes, attrValue, node);
+        }
+    }
+    return nodeIndex;
+}
+
+void HTMLNodeIndexFree(HTMLNodeIndex * nodeIndex)
+{
+    if (nodeIndex == NULL) return;
+    
+    if (nodeIndex->ids) xmlHashFree(nodeIndex->ids, nodeListDeallocator);
+    if (nodeIndex->classes) xmlHashFree(nodeIndex->classes, nodeListDeallocator);
+    if (nodeIndex->tags) xmlHashFree(nodeIndex->tags, nodeListDeallocator);
+    xmlFree(nodeIndex);
+}
+
+// Returns the last element in document order within the subtree of node, or node itself
+xmlNode * lastElementInSubtree(xmlNode * node)
+{
+    xmlNode *child = node->last;
+    while (child) {
+        if (child->type == XML_ELEMENT_NODE) {
+            node = child;
+            child = node->last;
+        }
+        else
+            child = child->prev;
+    }
+    return node;
+}
+
+// Looks up the nodes with a key of the document index within the subtree of node, optionally filtered by a match function.
+// The first match is returned in firstNode if array is nil, otherwise all matches are added to array.
+// Returns NO if the document isn't indexed or can't answer the query, then the caller walks the tree
+BOOL lookUpNodeIndex(HTMLNodeIndexTable table, const xmlChar * key, xmlNode * node, HTMLNodeMatchFunction match, const xmlChar * name, const xmlChar * value, NSMutableArray * array, HTMLNode ** firstNode)
+{
+    if (key == NULL || node->type != XML_ELEMENT_NODE || node->doc == NULL || node->doc->_private == NULL) return NO;
+    
+    HTMLNodeIndex *nodeIndex = [(__bridge HTMLDocument *)node->doc->_private nodeIndex];
+    if (nodeIndex == NULL) return NO;
+    
+    // measured only if the index answers the query, otherwise the caller's walk is measured
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
+    HTMLNodeList *list = NULL;
+    switch (table) {
+        case HTMLNodeIndexTableIDs:
+            list = xmlHashLookup(nodeIndex->ids, key);
+            break;
+            
+        case HTMLNodeIndexTableClasses: {
+            // any class token narrows the candidates, the match function compares the whole value
+            const char *token = (const char *)key + strspn((const char *)key, CLASS_WHITESPACE);
+            size_t length = strcspn(token, CLASS_WHITESPACE);
+            if (length == 0) return NO;
+            xmlChar *classToken = xmlStrndup(BAD_CAST token, (int)length);
+            if (classToken == NULL) return NO;
+            list = xmlHashLookup(nodeIndex->classes, classToken);
+            xmlFree(classToken);
+            break;
+        }
+            
+        case HTMLNodeIndexTableTags:
+            // only elements are indexed
+            if (xmlStrEqual(key, xmlStringText) || xmlStrEqual(key, xmlStringTextNoenc) || xmlStrEqual(key, xmlStringComment)) return NO;
+            list = xmlHashLookup(nodeIndex->tags, key);
+            break;
+    }
+    if (list == NULL) return YES;
+    
+    intptr_t first = (intptr_t)node->_private + 1;
+    intptr_t last = (intptr_t)lastElementInSubtree(node)->_private;
+    
+    // binary search of the first node of the subtree
+    size_t lower = 0, upper = list->count;
+    while (lower < upper) {
+        size_t middle = lower + (upper - lower) / 2;
+        if ((intptr_t)list->nodes[middle]->_private < first) lower = middle + 1;
+        else upper = middle;
+    }
+    
+    for (size_t i = lower; i < list->count && (intptr_t)list->nodes[i]->_private <= last; i++) {
+        HTML_INSTRUMENT_VISIT();
+        xmlNode *currentNode = list->nodes[i];
+        if (match && !match(currentNode, name, value)) continue;
+        
+        if (array == nil) {
+            *firstNode = [HTMLNode nodeWithXMLNode:currentNode];
+            return YES;
+        }
+        HTMLNode *matchingNode = [[HTMLNode alloc] initWithXMLNode:currentNode];
+        [array addObject:matchingNode];
+        SAFE_ARC_RELEASE(matchingNode);
+    }
+    return YES;
+}
+
+#pragma mark - batch query method
+
+BOOL nodeMatchesBatchQuery(xmlNode * node, const HTMLBatchQuery * query)
+{
+    if (query->tagName && !(node->name && xmlStrEqual(node->name, query->tagName))) return NO;
+    if (query->attributeName == NULL) return YES;
+    if (node->type != XML_ELEMENT_NODE) return NO;
+    
+    for (xmlAttrPtr attr = node->properties; attr; attr = attr->next) {
+        if (! xmlStrEqual(attr->name, query->attributeName)) continue;
+        if (query->match == HTMLNodeQueryMatchExists) return YES;
+        
+        xmlNode * child = attr->children;
+        if (child == NULL || child->content == NULL) return NO;
+        const xmlChar * content = child->content;
+        switch (query->match) {
+            case HTMLNodeQueryMatchEquals:
+                return xmlStrEqual(content, query->value);
+                
+            case HTMLNodeQueryMatchContains:
+                return xmlStrstr(content, query->value) != NULL;
+                
+            case HTMLNodeQueryMatchBeginsWith:
+                return xmlStrncmp(content, query->value, query->valueLength) == 0;
+                
+            case HTMLNodeQueryMatchEndsWith: {
+                int contentLength = xmlStrlen(content);
+                return contentLength >= query->valueLength
+                    && memcmp(content + contentLength - query->valueLength, query->value, (size_t)query->valueLength) == 0;
+            }
+                
+            default:
+                return YES;
+        }
+    }
+    return NO;
+}
+
+- (NSArray *)descendantsForQueries:(NSArray *)queries
+{
+    NSUInteger count = queries.count;
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:count];
+    if (count == 0) return results;
+    
+    HTMLBatchQuery *batch = xmlMalloc(count * sizeof(HTMLBatchQuery));
+    if (batch == NULL) return results;
+    
+    // the traversal can stop early only if every query is first-only
+    NSUInteger pending = 0;
+    BOOL unbounded = NO;
+    for (NSUInteger i = 0; i < count; i++) {
+        HTMLNodeQuery *query = queries[i];
+        HTMLBatchQuery *batchQuery = &batch[i];
+        batchQuery->tagName = BAD_CAST [query.tagName UTF8String];
+        batchQuery->attributeName = BAD_CAST [query.attributeName UTF8String];
+        batchQuery->value = BAD_CAST (query.value ? [query.value UTF8String] : "");
+        batchQuery->valueLength = xmlStrlen(batchQuery->value);
+        batchQuery->match = query.match;
+        batchQuery->firstOnly = query.firstOnly;
+        batchQuery->done = NO;
+        if (batchQuery->firstOnly) pending++; else unbounded = YES;
+        [results addObject:[NSMutableArray array]];
+    }
+    
+    HTML_INSTRUMENT_QUERY(HTMLQueryKindSearch);
+    xmlNode *currentNode = xmlNode_ ? xmlNode_->children : NULL;
+    while (currentNode && (unbounded || pending > 0)) {
+        HTML_INSTRUMENT_VISIT();
+        for (NSUInteger i = 0; i < count; i++) {
+            HTMLBatchQuery *batchQuery = &batch[i];
+            if (batchQuery->done || !nodeMatchesBatchQuery(currentNode, batchQuery)) continue;
+            
+            HTMLNode *matchingNode = [[HTMLNode alloc] initWithXMLNode:currentNode];
+            [results[i] addObject:matchingNode];
+            SAFE_ARC_RELEASE(matchingNode);
+            if (batchQuery->firstOnly) {
+                batchQuery->done = YES;
+                pending--;
+            }
+        }
+        currentNode = nextNodeInSubtree(currentNode, xmlNode_);
+    }
+    xmlFree(batch);
+    return results;
+}
+
 #pragma mark - description
 // includes type, name , number of children, attributes and the first 80 characters of raw content
 - (NSString *)description
@@ -1239,3 +2567,297 @@ void childrenOfTag(const xmlChar * tagName, xmlNode * node, NSMutableArray * arr
 }
 
 @end
+
+@implementation HTMLNodeQuery
+@synthesize tagName = tagName_;
+@synthesize attributeName = attributeName_;
+@synthesize value = value_;
+@synthesize match = match_;
+@synthesize firstOnly = firstOnly_;
+
++ (HTMLNodeQuery *)queryWithTag:(NSString *)tagName attribute:(NSString *)attributeName match:(HTMLNodeQueryMatch)match value:(NSString *)value firstOnly:(BOOL)firstOnly
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLNodeQuery alloc] initWithTag:tagName attribute:attributeName match:match value:value firstOnly:firstOnly]);
+}
+
++ (HTMLNodeQuery *)queryWithTag:(NSString *)tagName firstOnly:(BOOL)firstOnly
+{
+    return [self queryWithTag:tagName attribute:nil match:HTMLNodeQueryMatchExists value:nil firstOnly:firstOnly];
+}
+
+- (INSTANCETYPE_OR_ID)initWithTag:(NSString *)tagName attribute:(NSString *)attributeName match:(HTMLNodeQueryMatch)match value:(NSString *)value firstOnly:(BOOL)firstOnly
+{
+    self = [super init];
+    if (self) {
+        tagName_ = [tagName copy];
+        attributeName_ = [attributeName copy];
+        value_ = [value copy];
+        match_ = match;
+        firstOnly_ = firstOnly;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    SAFE_ARC_RELEASE(tagName_);
+    SAFE_ARC_RELEASE(attributeName_);
+    SAFE_ARC_RELEASE(value_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+@end
+
+// Table extraction in one pass: the rows and cells are visited once, the texts of the cells are collapsed into
+// one buffer and the slots are filled after the last row, when the number of rows and columns is known
+
+#define TABLE_NO_CELL SIZE_MAX
+#define TABLE_MAX_COLUMN_SPAN 1000
+#define TABLE_MAX_ROW_SPAN 65534
+
+// Returns the row following row (or the first row for NULL) in document order, the rows are the tr children
+// of the table and of its thead, tbody and tfoot sections
+xmlNode * nextTableRow(xmlNode * row, xmlNode * table)
+{
+    xmlNode *parent = row ? row->parent : table;
+    xmlNode *node = row ? row->next : table->children;
+    for (;;) {
+        while (node == NULL) {
+            if (parent == table) return NULL;
+            node = parent->next;
+            parent = table;
+        }
+        if (node->type == XML_ELEMENT_NODE) {
+            if (xmlStrEqual(node->name, BAD_CAST "tr")) return node;
+            if (parent == table && node->children && (xmlStrEqual(node->name, BAD_CAST "tbody")
+                                                      || xmlStrEqual(node->name, BAD_CAST "thead")
+                                                      || xmlStrEqual(node->name, BAD_CAST "tfoot"))) {
+                parent = node;
+                node = node->children;
+                continue;
+            }
+        }
+        node = node->next;
+    }
+}
+
+// Returns the leading non-negative integer of a colspan or rowspan attribute or -1 if it's missing or invalid
+long spanAttribute(xmlNode * cell, const xmlChar * attrName)
+{
+    xmlAttrPtr attr = attributeNamed(cell, attrName);
+    const xmlChar *value = attr ? borrowedAttributeValue(attr) : NULL;
+    if (value == NULL) return -1;
+    
+    char *end;
+    long span = strtol((const char *)value, &end, 10);
+    return (end == (const char *)value || span < 0) ? -1 : span;
+}
+
+// Appends the trimmed and collapsed text of a cell and a terminating 0, the whitespace is collapsed from the start
+// of the cell on so the text doesn't begin with the space between the previous cell and this one
+BOOL textBufferAppendCell(HTMLTextBuffer * buffer, xmlNode * cell, HTMLTableCell * tableCell)
+{
+    size_t start = buffer->length;
+    BOOL pendingSpace = NO;
+    for (xmlNode *node = nextTextNodeInSubtree(cell, cell); node; node = nextTextNodeInSubtree(node, cell)) {
+        if (node->content == NULL) continue;
+        size_t length = (size_t)xmlStrlen(node->content);
+        if (! textBufferReserve(buffer, length + 1)) return NO;
+        buffer->length = start + collapseWhitespace(node->content, length, buffer->bytes + start, buffer->length - start, &pendingSpace);
+    }
+    if (! textBufferReserve(buffer, 1)) return NO;
+    tableCell->offset = start;
+    tableCell->length = buffer->length - start;
+    buffer->bytes[buffer->length++] = 0;
+    return YES;
+}
+
+@implementation HTMLTable
+@synthesize numberOfRows = numberOfRows_;
+@synthesize numberOfColumns = numberOfColumns_;
+@synthesize numberOfHeaderRows = numberOfHeaderRows_;
+
+- (INSTANCETYPE_OR_ID)initWithTableNode:(xmlNode *)tableNode
+{
+    if (tableNode == NULL || tableNode->type != XML_ELEMENT_NODE || ! xmlStrEqual(tableNode->name, BAD_CAST "table")) {
+        SAFE_ARC_RELEASE(self);
+        return nil;
+    }
+    self = [super init];
+    if (self) {
+        HTMLTextBuffer buffer = { NULL, 0, 0 };
+        HTMLTablePlacement *placements = NULL;
+        size_t cellCount = 0, cellCapacity = 0;
+        // the number of following rows still occupied by a rowspan of each column
+        size_t *pendingRows = NULL;
+        size_t rowCount = 0, columnCount = 0, columnCapacity = 0;
+        BOOL headerRows = YES, succeeded = YES;
+        
+        for (xmlNode *row = nextTableRow(NULL, tableNode); row && succeeded; row = nextTableRow(row, tableNode)) {
+            size_t column = 0;
+            for (xmlNode *cell = row->children; cell && succeeded; cell = cell->next) {
+                if (cell->type != XML_ELEMENT_NODE || ! (xmlStrEqual(cell->name, BAD_CAST "td") || xmlStrEqual(cell->name, BAD_CAST "th"))) continue;
+                
+                while (column < columnCapacity && pendingRows[column]) column++;
+                long columnSpan = spanAttribute(cell, BAD_CAST "colspan");
+                long rowSpan = spanAttribute(cell, BAD_CAST "rowspan");
+                size_t columnSpanValue = (columnSpan < 1) ? 1 : (size_t)MIN(columnSpan, TABLE_MAX_COLUMN_SPAN);
+                // rowspan="0" spans the remaining rows
+                size_t rowSpanValue = (rowSpan < 0) ? 1 : (rowSpan == 0) ? TABLE_NO_CELL : (size_t)MIN(rowSpan, TABLE_MAX_ROW_SPAN);
+                
+                if (cellCount == cellCapacity) {
+                    cellCapacity = cellCapacity ? cellCapacity * 2 : 64;
+                    HTMLTableCell *grownCells = xmlRealloc(cells_, cellCapacity * sizeof(HTMLTableCell));
+                    HTMLTablePlacement *grownPlacements = grownCells ? xmlRealloc(placements, cellCapacity * sizeof(HTMLTablePlacement)) : NULL;
+                    if (grownCells) cells_ = grownCells;
+                    if (grownPlacements) placements = grownPlacements;
+                    if (grownPlacements == NULL) {
+                        succeeded = NO;
+                        break;
+                    }
+                }
+                if (column + columnSpanValue > columnCapacity) {
+                    size_t capacity = MAX(MAX(columnCapacity * 2, column + columnSpanValue), 16);
+                    size_t *grownRows = xmlRealloc(pendingRows, capacity * sizeof(size_t));
+                    if (grownRows == NULL) {
+                        succeeded = NO;
+                        break;
+                    }
+                    memset(grownRows + columnCapacity, 0, (capacity - columnCapacity) * sizeof(size_t));
+                    pendingRows = grownRows;
+                    columnCapacity = capacity;
+                }
+                
+                succeeded = textBufferAppendCell(&buffer, cell, &cells_[cellCount]);
+                placements[cellCount++] = (HTMLTablePlacement){ rowCount, column, rowSpanValue, columnSpanValue };
+                for (size_t i = column; i < column + columnSpanValue; i++) pendingRows[i] = rowSpanValue;
+                column += columnSpanValue;
+            }
+            
+            // the slots of the following row which are still occupied
+            for (size_t i = 0; i < columnCapacity; i++) {
+                if (pendingRows[i] == 0) continue;
+                columnCount = MAX(columnCount, i + 1);
+                if (pendingRows[i] != TABLE_NO_CELL) pendingRows[i]--;
+            }
+            if (headerRows && row->parent && xmlStrEqual(row->parent->name, BAD_CAST "thead")) {
+                numberOfHeaderRows_++;
+            } else {
+                headerRows = NO;
+            }
+            rowCount++;
+        }
+        
+        if (succeeded && rowCount && columnCount) {
+            if (columnCount > SIZE_MAX / sizeof(size_t) / rowCount) {
+                succeeded = NO;
+            } else {
+                slots_ = xmlMalloc(rowCount * columnCount * sizeof(size_t));
+                succeeded = (slots_ != NULL);
+            }
+        }
+        if (succeeded && slots_) {
+            memset(slots_, 0xFF, rowCount * columnCount * sizeof(size_t));
+            // a slot belongs to the first cell occupying it, later overlapping cells don't replace it
+            for (size_t i = 0; i < cellCount; i++) {
+                HTMLTablePlacement placement = placements[i];
+                size_t lastRow = (placement.rowSpan > rowCount - placement.row) ? rowCount : placement.row + placement.rowSpan;
+                for (size_t r = placement.row; r < lastRow; r++) {
+                    for (size_t c = placement.column; c < placement.column + placement.columnSpan; c++) {
+                        if (slots_[r * columnCount + c] == TABLE_NO_CELL) slots_[r * columnCount + c] = i;
+                    }
+                }
+            }
+        }
+        xmlFree(placements);
+        xmlFree(pendingRows);
+        bytes_ = buffer.bytes;
+        if (! succeeded) {
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        numberOfRows_ = rowCount;
+        numberOfColumns_ = columnCount;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    xmlFree(bytes_);
+    xmlFree(cells_);
+    xmlFree(slots_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+// Returns the cell of a slot or NULL
+- (HTMLTableCell *)cellAtRow:(NSUInteger)row column:(NSUInteger)column
+{
+    if (row >= numberOfRows_ || column >= numberOfColumns_) return NULL;
+    size_t index = slots_[row * numberOfColumns_ + column];
+    return (index == TABLE_NO_CELL) ? NULL : &cells_[index];
+}
+
+- (NSString *)stringOfCell:(HTMLTableCell *)cell
+{
+    if (cell == NULL || cell->length == 0) return @"";
+    return SAFE_ARC_AUTORELEASE([[NSString alloc] initWithBytes:bytes_ + cell->offset length:cell->length encoding:NSUTF8StringEncoding]);
+}
+
+- (NSString *)stringAtRow:(NSUInteger)row column:(NSUInteger)column
+{
+    HTMLTableCell *cell = [self cellAtRow:row column:column];
+    return (cell) ? [self stringOfCell:cell] : nil;
+}
+
+- (const char *)UTF8StringAtRow:(NSUInteger)row column:(NSUInteger)column length:(NSUInteger *)length
+{
+    HTMLTableCell *cell = [self cellAtRow:row column:column];
+    if (cell == NULL) return NULL;
+    if (length) *length = cell->length;
+    return (const char *)(bytes_ + cell->offset);
+}
+
+- (NSArray *)stringsInRow:(NSUInteger)row
+{
+    if (row >= numberOfRows_) return @[];
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:numberOfColumns_];
+    for (NSUInteger column = 0; column < numberOfColumns_; column++) {
+        NSString *string = [self stringOfCell:[self cellAtRow:row column:column]];
+        [array addObject:(string) ? string : @""]; // keep the positions of the slots if a cell isn't valid UTF-8
+    }
+    return array;
+}
+
+- (NSArray *)stringsInColumn:(NSUInteger)column
+{
+    if (column >= numberOfColumns_) return @[];
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:numberOfRows_];
+    for (NSUInteger row = 0; row < numberOfRows_; row++) {
+        NSString *string = [self stringOfCell:[self cellAtRow:row column:column]];
+        [array addObject:(string) ? string : @""]; // keep the positions of the slots if a cell isn't valid UTF-8
+    }
+    return array;
+}
+
+- (BOOL)getDoubleValue:(double *)value atRow:(NSUInteger)row column:(NSUInteger)column decimalSeparator:(char)decimalSeparator groupingSeparator:(char)groupingSeparator
+{
+    HTMLTableCell *cell = [self cellAtRow:row column:column];
+    if (cell == NULL) return NO;
+    return parseDouble(bytes_ + cell->offset, cell->length, decimalSeparator, groupingSeparator, value);
+}
+
+- (NSUInteger)getDoubleValues:(double *)values inColumn:(NSUInteger)column fromRow:(NSUInteger)row decimalSeparator:(char)decimalSeparator groupingSeparator:(char)groupingSeparator
+{
+    if (column >= numberOfColumns_ || row >= numberOfRows_) return 0;
+    NSUInteger count = 0;
+    for (NSUInteger i = row; i < numberOfRows_; i++) {
+        HTMLTableCell *cell = [self cellAtRow:i column:column];
+        double value = NAN;
+        if (cell && parseDouble(bytes_ + cell->offset, cell->length, decimalSeparator, groupingSeparator, &value)) count++;
+        values[i - row] = value;
+    }
+    return count;
+}
+
+@end
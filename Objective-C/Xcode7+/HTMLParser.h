@@ -0,0 +1,321 @@
+/*###################################################################################
+ #                                                                                  #
+ #     HTMLParser.h                                                                 #
+ #                                                                                  #
+ #     Copyright © 2014 by Stefan Klieme                                            #
+ #                                                                                  #
+ #     Objective-C wrapper for HTML parser of libxml2                               #
+ #                                                                                  #
+ #     Version 1.8 - 14. Dez 2015 for Xcode 7+                                      #
+ #                                                                                  #
+ #     usage:     add libxml2.dylib to frameworks                                   #
+ #                add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths #
+ #                add -lxml2 to target -> other linker flags                        #
+ #                                                                                  #
+ #                                                                                  #
+ ####################################################################################
+ #                                                                                  #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of  #
+ # this software and associated documentation files (the "Software"), to deal       #
+ # in the Software without restriction, including without limitation the rights     #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies #
+ # of the Software, and to permit persons to whom the Software is furnished to do   #
+ # so, subject to the following conditions:                                         #
+ # The above copyright notice and this permission notice shall be included in       #
+ # all copies or substantial portions of the Software.                              #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR       #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,         #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE      #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,#
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR     #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.    #
+ #                                                                                  #
+ ##################################################################################*/
+
+#import <Foundation/Foundation.h>
+#import <libxml/HTMLparser.h>
+#import "HTMLDocument.h"
+
+// The SAX handler wrapper which discards subtrees while the tree is built
+struct HTMLTagFilter;
+
+// The compiled rules and the parsing state of an HTMLStreamExtractor
+struct HTMLExtractionState;
+
+// HTMLPushParser builds an HTMLDocument incrementally from data chunks,
+// e.g. passed in the NSURLSession delegate method -URLSession:dataTask:didReceiveData:
+
+@interface HTMLPushParser : NSObject
+{
+    htmlParserCtxtPtr parserContext_;
+    NSUInteger numberOfBytes_;
+    NSSet *discardedTagNames_;
+    BOOL keepsDiscardedElements_;
+    struct HTMLTagFilter *tagFilter_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns an HTMLPushParser object with specified string encoding
+ * \param encoding The string encoding for the HTML content
+ * \returns An initialized HTMLPushParser object
+ */
++ (HTMLPushParser *)pushParserWithEncoding:(NSStringEncoding )encoding;
+
+/*! Returns an HTMLPushParser object with specified string encoding and parse options
+ * \param encoding The string encoding for the HTML content
+ * \param options The options passed to the libxml2 parser
+ * \returns An initialized HTMLPushParser object
+ */
++ (HTMLPushParser *)pushParserWithEncoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options;
+
+/*! Initializes and returns an HTMLPushParser object with specified string encoding and parse options
+ * \param encoding The string encoding for the HTML content
+ * \param options The options passed to the libxml2 parser
+ * \returns An initialized HTMLPushParser object, or nil if the parser context could not be created
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithEncoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options; // designated initializer
+
+/*! Initializes and returns an HTMLPushParser object with specified string encoding
+ * \param encoding The string encoding for the HTML content
+ * \returns An initialized HTMLPushParser object, or nil if the parser context could not be created
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithEncoding:(NSStringEncoding )encoding;
+
+/*! Initializes and returns an HTMLPushParser object with assumed UTF-8 string encoding
+ * \returns An initialized HTMLPushParser object, or nil if the parser context could not be created
+ */
+- (nullable INSTANCETYPE_OR_ID)init;
+
+/*! Parses the next chunk of HTML content
+ * \param data A data object with the next part of the HTML content
+ * \param error An error object that, on return, identifies any parsing errors
+ * \returns YES if the chunk has been parsed, NO if the parser has already been finished
+ */
+- (BOOL)appendData:(NSData *)data error:(NSError **)error;
+
+/*! Parses the next chunk of HTML content
+ * \param bytes A buffer with the next part of the HTML content
+ * \param length The number of bytes in the buffer
+ * \param error An error object that, on return, identifies any parsing errors
+ * \returns YES if the chunk has been parsed, NO if the parser has already been finished
+ */
+- (BOOL)appendBytes:(const void *)bytes length:(NSUInteger)length error:(NSError **)error;
+
+/*! Terminates parsing and returns the document. The parser cannot be used any more afterwards
+ * \param error An error object that, on return, identifies any parsing errors
+ * \returns An initialized HTMLDocument object, or nil if no valid HTML content has been appended
+ */
+- (nullable HTMLDocument *)finishWithError:(NSError **)error;
+
+/*! The number of bytes appended so far*/
+@property (readonly) NSUInteger numberOfBytes;
+
+/*! Is the parser finished*/
+@property (readonly, getter=isFinished) BOOL finished;
+
+/*! The names of the tags whose subtrees are discarded while parsing, e.g. script, style, noscript or svg. Must be set before the first chunk is appended*/
+@property (copy, nullable) NSSet<NSString *> *discardedTagNames;
+
+/*! Keep the discarded tags as empty elements (with attributes) instead of removing them completely, default is NO*/
+@property BOOL keepsDiscardedElements;
+
+NS_ASSUME_NONNULL_END
+
+@end
+
+
+
+// HTMLParser keeps one libxml2 parser context and its name dictionary alive across many documents.
+// An HTMLParser object must not be used on several threads simultaneously, use +currentThreadParser instead
+
+@interface HTMLParser : NSObject
+{
+    htmlParserCtxtPtr parserContext_;
+    HTMLDocumentParseOptions options_;
+    NSUInteger numberOfDocuments_;
+    NSSet *discardedTagNames_;
+    BOOL keepsDiscardedElements_;
+    struct HTMLTagFilter *tagFilter_;
+    BOOL usesArena_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns the HTMLParser object of the current thread, it's created on first access
+ * \returns The HTMLParser object of the current thread
+ */
++ (HTMLParser *)currentThreadParser;
+
+/*! Initializes and returns an HTMLParser object with specified parse options
+ * \param options The options passed to the libxml2 parser
+ * \returns An initialized HTMLParser object, or nil if the parser context could not be created
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithOptions:(HTMLDocumentParseOptions)options; // designated initializer
+
+/*! Initializes and returns an HTMLParser object with the default parse options
+ * \returns An initialized HTMLParser object, or nil if the parser context could not be created
+ */
+- (nullable INSTANCETYPE_OR_ID)init;
+
+/*! Parses an NSData object with specified string encoding reusing the parser context
+ * \param data A data object with HTML content
+ * \param encoding The string encoding for the HTML content
+ * \param error An error object that, on return, identifies any parsing errors
+ * \returns An initialized HTMLDocument object, or nil if parsing fails
+ */
+- (nullable HTMLDocument *)documentWithData:(nullable NSData *)data encoding:(NSStringEncoding )encoding error:(NSError **)error;
+
+/*! Parses an NSData object with assumed UTF-8 string encoding reusing the parser context
+ * \param data A data object with HTML content
+ * \param error An error object that, on return, identifies any parsing errors
+ * \returns An initialized HTMLDocument object, or nil if parsing fails
+ */
+- (nullable HTMLDocument *)documentWithData:(nullable NSData *)data error:(NSError **)error;
+
+/*! Parses a buffer with specified string encoding reusing the parser context
+ * \param bytes A buffer with HTML content
+ * \param length The number of bytes in the buffer
+ * \param encoding The string encoding for the HTML content
+ * \param error An error object that, on return, identifies any parsing errors
+ * \returns An initialized HTMLDocument object, or nil if parsing fails
+ */
+- (nullable HTMLDocument *)documentWithBytes:(const void *)bytes length:(NSUInteger)length encoding:(NSStringEncoding )encoding error:(NSError **)error;
+
+/*! The options passed to the libxml2 parser*/
+@property HTMLDocumentParseOptions options;
+
+/*! Allocate each document in an arena which is released in one step with the document instead of freeing the tree node by node.
+ *  Enabling the arenas installs arena aware allocation functions in libxml2 for the whole process, they forward to malloc() outside of the parser calls.
+ *  The parser context isn't reused for arena documents, default is NO*/
+@property BOOL usesArena;
+
+/*! The number of documents parsed so far*/
+@property (readonly) NSUInteger numberOfDocuments;
+
+/*! The names of the tags whose subtrees are discarded while parsing, e.g. script, style, noscript or svg*/
+@property (copy, nullable) NSSet<NSString *> *discardedTagNames;
+
+/*! Keep the discarded tags as empty elements (with attributes) instead of removing them completely, default is NO*/
+@property BOOL keepsDiscardedElements;
+
+NS_ASSUME_NONNULL_END
+
+@end
+
+
+
+
+// HTMLExtractionRule describes a value reported by HTMLStreamExtractor,
+// e.g. tag a, attribute href or tag meta with name=description, attribute content
+
+@interface HTMLExtractionRule : NSObject
+{
+    NSString *tagName_;
+    NSString *attributeName_;
+    NSString *matchAttributeName_;
+    NSString *matchAttributeValue_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns an HTMLExtractionRule object reporting an attribute value or the text content of a tag
+ * \param tagName The name of the tag
+ * \param attributeName The name of the reported attribute, if nil the text content of the tag is reported
+ * \returns An initialized HTMLExtractionRule object
+ */
++ (HTMLExtractionRule *)ruleWithTagName:(NSString *)tagName attributeName:(nullable NSString *)attributeName;
+
+/*! Returns an HTMLExtractionRule object reporting an attribute value or the text content of a tag with a matching attribute
+ * \param tagName The name of the tag
+ * \param attributeName The name of the reported attribute, if nil the text content of the tag is reported
+ * \param matchAttributeName The name of an attribute the tag must have
+ * \param matchAttributeValue The value the matching attribute must have (case insensitive), if nil any value matches
+ * \returns An initialized HTMLExtractionRule object
+ */
++ (HTMLExtractionRule *)ruleWithTagName:(NSString *)tagName attributeName:(nullable NSString *)attributeName matchingAttribute:(nullable NSString *)matchAttributeName value:(nullable NSString *)matchAttributeValue;
+
+/*! Initializes and returns an HTMLExtractionRule object reporting an attribute value or the text content of a tag with a matching attribute
+ * \param tagName The name of the tag
+ * \param attributeName The name of the reported attribute, if nil the text content of the tag is reported
+ * \param matchAttributeName The name of an attribute the tag must have
+ * \param matchAttributeValue The value the matching attribute must have (case insensitive), if nil any value matches
+ * \returns An initialized HTMLExtractionRule object
+ */
+- (INSTANCETYPE_OR_ID)initWithTagName:(NSString *)tagName attributeName:(nullable NSString *)attributeName matchingAttribute:(nullable NSString *)matchAttributeName value:(nullable NSString *)matchAttributeValue; // designated initializer
+
+/*! The name of the tag*/
+@property (readonly, copy) NSString *tagName;
+
+/*! The name of the reported attribute, nil for the text content*/
+@property (readonly, copy, nullable) NSString *attributeName;
+
+/*! The name of an attribute the tag must have*/
+@property (readonly, copy, nullable) NSString *matchAttributeName;
+
+/*! The value the matching attribute must have*/
+@property (readonly, copy, nullable) NSString *matchAttributeValue;
+
+NS_ASSUME_NONNULL_END
+
+@end
+
+
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void (^HTMLExtractionBlock)(HTMLExtractionRule *rule, NSString *value, BOOL *stop);
+
+NS_ASSUME_NONNULL_END
+
+// HTMLStreamExtractor reports the values described by extraction rules while the HTML content is parsed with SAX callbacks.
+// No tree is built, the memory usage is independent of the size of the document.
+// Text content is reported trimmed, while a text rule is active other text rules are not evaluated.
+// An HTMLStreamExtractor object must not be used on several threads simultaneously
+
+@interface HTMLStreamExtractor : NSObject
+{
+    NSArray *rules_;
+    struct HTMLExtractionState *state_;
+    HTMLExtractionBlock block_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns an HTMLStreamExtractor object with specified rules
+ * \param rules An array of HTMLExtractionRule objects
+ * \returns An initialized HTMLStreamExtractor object
+ */
++ (HTMLStreamExtractor *)extractorWithRules:(NSArray<HTMLExtractionRule *> *)rules;
+
+/*! Initializes and returns an HTMLStreamExtractor object with specified rules
+ * \param rules An array of HTMLExtractionRule objects
+ * \returns An initialized HTMLStreamExtractor object
+ */
+- (INSTANCETYPE_OR_ID)initWithRules:(NSArray<HTMLExtractionRule *> *)rules; // designated initializer
+
+/*! Parses an NSData object with specified string encoding and reports the values matching the rules
+ * \param data A data object with HTML content
+ * \param encoding The string encoding for the HTML content
+ * \param block The block called for each match, set stop to YES to abort parsing
+ * \param error An error object that, on return, identifies any parsing errors
+ * \returns YES if the data has been parsed or parsing has been stopped, NO if an error occured
+ */
+- (BOOL)extractFromData:(nullable NSData *)data encoding:(NSStringEncoding )encoding usingBlock:(HTMLExtractionBlock)block error:(NSError **)error;
+
+/*! Parses the HTML contents of a URL-referenced source with specified string encoding and reports the values matching the rules.
+ * The contents of file URLs are read in chunks
+ * \param url An NSURL object specifying a URL source
+ * \param encoding The string encoding for the HTML content
+ * \param block The block called for each match, set stop to YES to abort parsing
+ * \param error An error object that, on return, identifies any parsing errors or connection problems
+ * \returns YES if the contents have been parsed or parsing has been stopped, NO if an error occured
+ */
+- (BOOL)extractFromContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding usingBlock:(HTMLExtractionBlock)block error:(NSError **)error;
+
+/*! The extraction rules*/
+@property (readonly, copy) NSArray<HTMLExtractionRule *> *rules;
+
+NS_ASSUME_NONNULL_END
+
+@end
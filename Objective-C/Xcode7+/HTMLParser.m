@@ -0,0 +1,841 @@
+/*###################################################################################
+ #                                                                                  #
+ #     HTMLParser.m                                                                 #
+ #                                                                                  #
+ #     Copyright © 2014 by Stefan Klieme                                            #
+ #                                                                                  #
+ #     Objective-C wrapper for HTML parser of libxml2                               #
+ #                                                                                  #
+ #     Version 1.8 - 14. Dez 2015 for Xcode 7+                                      #
+ #                                                                                  #
+ #     usage:     add libxml2.dylib to frameworks                                   #
+ #                add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths #
+ #                add -lxml2 to target -> other linker flags                        #
+ #                                                                                  #
+ #                                                                                  #
+ ####################################################################################
+ #                                                                                  #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of  #
+ # this software and associated documentation files (the "Software"), to deal       #
+ # in the Software without restriction, including without limitation the rights     #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies #
+ # of the Software, and to permit persons to whom the Software is furnished to do   #
+ # so, subject to the following conditions:                                         #
+ # The above copyright notice and this permission notice shall be included in       #
+ # all copies or substantial portions of the Software.                              #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR       #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,         #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE      #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,#
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR     #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.    #
+ #                                                                                  #
+ ##################################################################################*/
+
+#import "HTMLParser.h"
+#import "HTMLInstrumentation.h"
+#import <libxml/parserInternals.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// the encoding cannot be passed as name to the push parser, switch the input explicitly
+// and record the name for the document like htmlReadMemory() does
+static void switchPushParserEncoding(htmlParserCtxtPtr context, NSStringEncoding encoding)
+{
+    char encodingBuffer[32];
+    const char *cEncoding = convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer));
+    xmlCharEncodingHandlerPtr encodingHandler = (cEncoding) ? xmlFindCharEncodingHandler(cEncoding) : NULL;
+    if (encodingHandler && xmlSwitchToEncoding(context, encodingHandler) == 0) {
+        xmlFree((xmlChar *)context->input->encoding);
+        context->input->encoding = xmlStrdup(BAD_CAST cEncoding);
+    }
+}
+
+#pragma mark - tag filter
+
+// The filter replaces the SAX callbacks of a parser context and forwards only the events outside of discarded subtrees
+// to the original tree building callbacks. The state is stored in the _private field of the context
+
+struct HTMLTagFilter {
+    xmlChar **tagNames;
+    NSUInteger numberOfTagNames;
+    BOOL keepsElements;
+    NSUInteger depth; // > 0 inside a discarded subtree
+    void *savedPrivate;
+    startElementSAXFunc startElement;
+    endElementSAXFunc endElement;
+    charactersSAXFunc characters;
+    ignorableWhitespaceSAXFunc ignorableWhitespace;
+    cdataBlockSAXFunc cdataBlock;
+    commentSAXFunc comment;
+    processingInstructionSAXFunc processingInstruction;
+};
+
+static struct HTMLTagFilter *HTMLTagFilterCreate(NSSet *tagNames)
+{
+    if ([tagNames count] == 0) return NULL;
+    
+    struct HTMLTagFilter *filter = calloc(1, sizeof(struct HTMLTagFilter));
+    filter->tagNames = calloc([tagNames count], sizeof(xmlChar *));
+    for (NSString *tagName in tagNames) {
+        // the HTML parser reports tag names in lowercase
+        filter->tagNames[filter->numberOfTagNames++] = xmlStrdup(BAD_CAST [[tagName lowercaseString] UTF8String]);
+    }
+    return filter;
+}
+
+static void HTMLTagFilterFree(struct HTMLTagFilter *filter)
+{
+    if (filter == NULL) return;
+    
+    for (NSUInteger i = 0; i < filter->numberOfTagNames; i++)
+        xmlFree(filter->tagNames[i]);
+    free(filter->tagNames);
+    free(filter);
+}
+
+static BOOL HTMLTagFilterMatches(struct HTMLTagFilter *filter, const xmlChar *name)
+{
+    for (NSUInteger i = 0; i < filter->numberOfTagNames; i++) {
+        if (xmlStrEqual(name, filter->tagNames[i])) return YES;
+    }
+    return NO;
+}
+
+static void filterStartElement(void *ctx, const xmlChar *name, const xmlChar **atts)
+{
+    struct HTMLTagFilter *filter = ((xmlParserCtxtPtr)ctx)->_private;
+    if (filter->depth) {
+        filter->depth++;
+        return;
+    }
+    if (HTMLTagFilterMatches(filter, name)) {
+        filter->depth = 1;
+        if (filter->keepsElements == NO) return;
+    }
+    filter->startElement(ctx, name, atts);
+}
+
+static void filterEndElement(void *ctx, const xmlChar *name)
+{
+    struct HTMLTagFilter *filter = ((xmlParserCtxtPtr)ctx)->_private;
+    if (filter->depth) {
+        filter->depth--;
+        if (filter->depth || filter->keepsElements == NO) return;
+    }
+    filter->endElement(ctx, name);
+}
+
+static void filterCharacters(void *ctx, const xmlChar *ch, int len)
+{
+    struct HTMLTagFilter *filter = ((xmlParserCtxtPtr)ctx)->_private;
+    if (filter->depth == 0 && filter->characters) filter->characters(ctx, ch, len);
+}
+
+static void filterIgnorableWhitespace(void *ctx, const xmlChar *ch, int len)
+{
+    struct HTMLTagFilter *filter = ((xmlParserCtxtPtr)ctx)->_private;
+    if (filter->depth == 0 && filter->ignorableWhitespace) filter->ignorableWhitespace(ctx, ch, len);
+}
+
+static void filterCdataBlock(void *ctx, const xmlChar *value, int len)
+{
+    struct HTMLTagFilter *filter = ((xmlParserCtxtPtr)ctx)->_private;
+    if (filter->depth == 0 && filter->cdataBlock) filter->cdataBlock(ctx, value, len);
+}
+
+static void filterComment(void *ctx, const xmlChar *value)
+{
+    struct HTMLTagFilter *filter = ((xmlParserCtxtPtr)ctx)->_private;
+    if (filter->depth == 0 && filter->comment) filter->comment(ctx, value);
+}
+
+static void filterProcessingInstruction(void *ctx, const xmlChar *target, const xmlChar *data)
+{
+    struct HTMLTagFilter *filter = ((xmlParserCtxtPtr)ctx)->_private;
+    if (filter->depth == 0 && filter->processingInstruction) filter->processingInstruction(ctx, target, data);
+}
+
+// installs the filter callbacks, the context must have been created with the default SAX handler (user data is the context)
+static void HTMLTagFilterAttach(struct HTMLTagFilter *filter, htmlParserCtxtPtr context, BOOL keepsElements)
+{
+    xmlSAXHandlerPtr sax = context->sax;
+    filter->keepsElements = keepsElements;
+    filter->depth = 0;
+    filter->savedPrivate = context->_private;
+    filter->startElement = sax->startElement;
+    filter->endElement = sax->endElement;
+    filter->characters = sax->characters;
+    filter->ignorableWhitespace = sax->ignorableWhitespace;
+    filter->cdataBlock = sax->cdataBlock;
+    filter->comment = sax->comment;
+    filter->processingInstruction = sax->processingInstruction;
+    
+    sax->startElement = filterStartElement;
+    sax->endElement = filterEndElement;
+    sax->characters = filterCharacters;
+    sax->ignorableWhitespace = filterIgnorableWhitespace;
+    sax->cdataBlock = filterCdataBlock;
+    sax->comment = filterComment;
+    sax->processingInstruction = filterProcessingInstruction;
+    context->_private = filter;
+}
+
+// restores the original callbacks
+static void HTMLTagFilterDetach(struct HTMLTagFilter *filter, htmlParserCtxtPtr context)
+{
+    xmlSAXHandlerPtr sax = context->sax;
+    sax->startElement = filter->startElement;
+    sax->endElement = filter->endElement;
+    sax->characters = filter->characters;
+    sax->cdataBlock = filter->cdataBlock;
+    sax->comment = filter->comment;
+    sax->processingInstruction = filter->processingInstruction;
+    // htmlCtxtUseOptions has replaced the callback already for HTML_PARSE_NOBLANKS
+    if (context->keepBlanks)
+        sax->ignorableWhitespace = filter->ignorableWhitespace;
+    context->_private = filter->savedPrivate;
+}
+
+
+
+@implementation HTMLPushParser
+@synthesize numberOfBytes = numberOfBytes_;
+@synthesize discardedTagNames = discardedTagNames_;
+@synthesize keepsDiscardedElements = keepsDiscardedElements_;
+
+#pragma mark - error handling
+
+- (NSError *)errorForCode:(NSInteger )errorCode
+{
+    NSString *errorString = @"";
+    switch (errorCode) {
+        case 1:
+            errorString = @"No valid data";
+            break;
+            
+        case 2:
+            errorString = @"XML data could not be parsed";
+            break;
+            
+        case 4:
+            errorString = @"Parser has already been finished";
+            break;
+    }
+    return [NSError errorWithDomain:[@"com.klieme." stringByAppendingString: NSStringFromClass([self class])]
+                               code:errorCode
+                           userInfo:@{NSLocalizedDescriptionKey: errorString}];
+}
+
+#pragma mark - class method
+
++ (HTMLPushParser *)pushParserWithEncoding:(NSStringEncoding )encoding
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLPushParser alloc] initWithEncoding:encoding]);
+}
+
++ (HTMLPushParser *)pushParserWithEncoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLPushParser alloc] initWithEncoding:encoding options:options]);
+}
+
+#pragma mark - init methods
+
+// designated initializer
+- (INSTANCETYPE_OR_ID)initWithEncoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options
+{
+    self = [super init];
+    if (self) {
+        parserContext_ = htmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL, XML_CHAR_ENCODING_NONE);
+        if (parserContext_ == NULL) {
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        htmlCtxtUseOptions(parserContext_, (int)options);
+        
+        switchPushParserEncoding(parserContext_, encoding);
+    }
+    return self;
+}
+
+- (INSTANCETYPE_OR_ID)initWithEncoding:(NSStringEncoding )encoding
+{
+    return [self initWithEncoding:encoding options:HTMLDocumentParseOptionDefault];
+}
+
+- (INSTANCETYPE_OR_ID)init
+{
+    return [self initWithEncoding:NSUTF8StringEncoding];
+}
+
+- (void)dealloc
+{
+    if (parserContext_) {
+        xmlFreeDoc(parserContext_->myDoc);
+        htmlFreeParserCtxt(parserContext_);
+    }
+    HTMLTagFilterFree(tagFilter_);
+    SAFE_ARC_RELEASE(discardedTagNames_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+#pragma mark - parsing
+
+- (BOOL)appendData:(NSData *)data error:(NSError **)error
+{
+    return [self appendBytes:[data bytes] length:[data length] error:error];
+}
+
+- (BOOL)appendBytes:(const void *)bytes length:(NSUInteger)length error:(NSError **)error
+{
+    if (parserContext_ == NULL) {
+        if (error) *error = [self errorForCode:4];
+        return NO;
+    }
+    if (bytes == NULL || length == 0) return YES;
+    
+    if (numberOfBytes_ == 0 && tagFilter_ == NULL) {
+        tagFilter_ = HTMLTagFilterCreate(discardedTagNames_);
+        if (tagFilter_) HTMLTagFilterAttach(tagFilter_, parserContext_, keepsDiscardedElements_);
+    }
+    
+    // htmlParseChunk takes an int size, pass oversized buffers in slices
+    const char *chunk = (const char *)bytes;
+    while (length) {
+        int chunkSize = (length > INT_MAX) ? INT_MAX : (int)length;
+        htmlParseChunk(parserContext_, chunk, chunkSize, 0);
+        chunk += chunkSize;
+        length -= chunkSize;
+        numberOfBytes_ += chunkSize;
+    }
+    return YES;
+}
+
+- (HTMLDocument *)finishWithError:(NSError **)error
+{
+    if (parserContext_ == NULL) {
+        if (error) *error = [self errorForCode:4];
+        return nil;
+    }
+    
+    htmlParseChunk(parserContext_, NULL, 0, 1);
+    htmlDocPtr htmlDoc = parserContext_->myDoc;
+    parserContext_->myDoc = NULL;
+    htmlFreeParserCtxt(parserContext_);
+    parserContext_ = NULL;
+    
+    if (numberOfBytes_ == 0) {
+        xmlFreeDoc(htmlDoc);
+        if (error) *error = [self errorForCode:1];
+        return nil;
+    }
+    return SAFE_ARC_AUTORELEASE([[HTMLDocument alloc] initWithHTMLDoc:htmlDoc error:error]);
+}
+
+- (BOOL)isFinished
+{
+    return parserContext_ == NULL;
+}
+
+@end
+
+
+
+// the dictionary of a long-lived context collects every tag and attribute name ever seen,
+// the context is recreated when it exceeds this number of entries
+static const size_t kHTMLParserMaximumDictionarySize = 1 << 16;
+
+static NSString * const kHTMLParserThreadDictionaryKey = @"com.klieme.HTMLParser";
+
+@implementation HTMLParser
+@synthesize options = options_;
+@synthesize numberOfDocuments = numberOfDocuments_;
+@synthesize discardedTagNames = discardedTagNames_;
+@synthesize keepsDiscardedElements = keepsDiscardedElements_;
+@synthesize usesArena = usesArena_;
+
+#pragma mark - error handling
+
+- (NSError *)errorForCode:(NSInteger )errorCode
+{
+    NSString *errorString = @"";
+    switch (errorCode) {
+        case 1:
+            errorString = @"No valid data";
+            break;
+            
+        case 5:
+            errorString = @"Parser context could not be created";
+            break;
+    }
+    return [NSError errorWithDomain:[@"com.klieme." stringByAppendingString: NSStringFromClass([self class])]
+                               code:errorCode
+                           userInfo:@{NSLocalizedDescriptionKey: errorString}];
+}
+
+#pragma mark - class method
+
++ (HTMLParser *)currentThreadParser
+{
+    NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+    HTMLParser *parser = threadDictionary[kHTMLParserThreadDictionaryKey];
+    if (parser == nil) {
+        parser = [[HTMLParser alloc] init];
+        threadDictionary[kHTMLParserThreadDictionaryKey] = parser;
+        SAFE_ARC_RELEASE(parser);
+    }
+    return parser;
+}
+
+#pragma mark - init methods
+
+// designated initializer
+- (INSTANCETYPE_OR_ID)initWithOptions:(HTMLDocumentParseOptions)options
+{
+    self = [super init];
+    if (self) {
+        parserContext_ = htmlNewParserCtxt();
+        if (parserContext_ == NULL) {
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        options_ = options;
+    }
+    return self;
+}
+
+- (INSTANCETYPE_OR_ID)init
+{
+    return [self initWithOptions:HTMLDocumentParseOptionDefault];
+}
+
+- (void)dealloc
+{
+    if (parserContext_) htmlFreeParserCtxt(parserContext_);
+    HTMLTagFilterFree(tagFilter_);
+    SAFE_ARC_RELEASE(discardedTagNames_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+#pragma mark - tag filter
+
+- (void)setDiscardedTagNames:(NSSet *)discardedTagNames
+{
+    if (discardedTagNames_ == discardedTagNames) return;
+    
+    SAFE_ARC_RELEASE(discardedTagNames_);
+    discardedTagNames_ = [discardedTagNames copy];
+    HTMLTagFilterFree(tagFilter_);
+    tagFilter_ = HTMLTagFilterCreate(discardedTagNames_);
+}
+
+#pragma mark - parsing
+
+- (HTMLDocument *)documentWithData:(NSData *)data encoding:(NSStringEncoding )encoding error:(NSError **)error
+{
+    return [self documentWithBytes:[data bytes] length:[data length] encoding:encoding error:error];
+}
+
+- (HTMLDocument *)documentWithData:(NSData *)data error:(NSError **)error
+{
+    return [self documentWithData:data encoding:NSUTF8StringEncoding error:error];
+}
+
+- (HTMLDocument *)documentWithBytes:(const void *)bytes length:(NSUInteger)length encoding:(NSStringEncoding )encoding error:(NSError **)error
+{
+    if (bytes == NULL || length == 0 || length > INT_MAX) {
+        if (error) *error = [self errorForCode:1];
+        return nil;
+    }
+    if (usesArena_) return [self arenaDocumentWithBytes:bytes length:length encoding:encoding error:error];
+    
+    if (parserContext_ == NULL || xmlDictSize(parserContext_->dict) > kHTMLParserMaximumDictionarySize) {
+        if (parserContext_) htmlFreeParserCtxt(parserContext_);
+        parserContext_ = htmlNewParserCtxt();
+        if (parserContext_ == NULL) {
+            if (error) *error = [self errorForCode:5];
+            return nil;
+        }
+    }
+    
+    // htmlCtxtReadMemory resets the context but keeps its dictionary and input buffers
+    char encodingBuffer[32];
+    if (tagFilter_) HTMLTagFilterAttach(tagFilter_, parserContext_, keepsDiscardedElements_);
+    HTMLInstrumentationInterval parseInterval = HTMLInstrumentationBegin(HTMLInstrumentationParse);
+    htmlDocPtr htmlDoc = htmlCtxtReadMemory(parserContext_, bytes, (int)length, NULL, convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer)), (int)options_);
+    HTMLInstrumentationEnd(&parseInterval);
+    if (tagFilter_) HTMLTagFilterDetach(tagFilter_, parserContext_);
+    numberOfDocuments_++;
+    HTMLDocument *document = [[HTMLDocument alloc] initWithHTMLDoc:htmlDoc error:error];
+    [document recordParseInterval:&parseInterval inputLength:length];
+    return SAFE_ARC_AUTORELEASE(document);
+}
+
+// A temporary parser context is created in the arena, its dictionary belongs to the document and must not outlive the arena.
+// The context isn't reused, the arena makes creating and releasing it cheap
+- (HTMLDocument *)arenaDocumentWithBytes:(const void *)bytes length:(NSUInteger)length encoding:(NSStringEncoding )encoding error:(NSError **)error
+{
+    HTMLArena *arena = HTMLArenaCreate();
+    if (arena == NULL) {
+        if (error) *error = [self errorForCode:5];
+        return nil;
+    }
+    HTMLArena *previousArena = HTMLArenaMakeCurrent(arena);
+    htmlDocPtr htmlDoc = NULL;
+    HTMLInstrumentationInterval parseInterval = HTMLInstrumentationBegin(HTMLInstrumentationParse);
+    htmlParserCtxtPtr arenaContext = htmlNewParserCtxt();
+    if (arenaContext) {
+        char encodingBuffer[32];
+        if (tagFilter_) HTMLTagFilterAttach(tagFilter_, arenaContext, keepsDiscardedElements_);
+        htmlDoc = htmlCtxtReadMemory(arenaContext, bytes, (int)length, NULL, convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer)), (int)options_);
+        if (tagFilter_) HTMLTagFilterDetach(tagFilter_, arenaContext);
+        htmlFreeParserCtxt(arenaContext);
+    }
+    xmlResetLastError(); // the last error of the thread must not reference arena memory
+    HTMLArenaMakeCurrent(previousArena);
+    HTMLInstrumentationEnd(&parseInterval);
+    
+    if (arenaContext == NULL) {
+        HTMLArenaFree(arena);
+        if (error) *error = [self errorForCode:5];
+        return nil;
+    }
+    numberOfDocuments_++;
+    HTMLDocument *document = [[HTMLDocument alloc] initWithHTMLDoc:htmlDoc arena:arena error:error];
+    [document recordParseInterval:&parseInterval inputLength:length];
+    return SAFE_ARC_AUTORELEASE(document);
+}
+
+@end
+
+
+
+
+@implementation HTMLExtractionRule
+@synthesize tagName = tagName_;
+@synthesize attributeName = attributeName_;
+@synthesize matchAttributeName = matchAttributeName_;
+@synthesize matchAttributeValue = matchAttributeValue_;
+
++ (HTMLExtractionRule *)ruleWithTagName:(NSString *)tagName attributeName:(NSString *)attributeName
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLExtractionRule alloc] initWithTagName:tagName attributeName:attributeName matchingAttribute:nil value:nil]);
+}
+
++ (HTMLExtractionRule *)ruleWithTagName:(NSString *)tagName attributeName:(NSString *)attributeName matchingAttribute:(NSString *)matchAttributeName value:(NSString *)matchAttributeValue
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLExtractionRule alloc] initWithTagName:tagName attributeName:attributeName matchingAttribute:matchAttributeName value:matchAttributeValue]);
+}
+
+// designated initializer
+- (INSTANCETYPE_OR_ID)initWithTagName:(NSString *)tagName attributeName:(NSString *)attributeName matchingAttribute:(NSString *)matchAttributeName value:(NSString *)matchAttributeValue
+{
+    self = [super init];
+    if (self) {
+        // the HTML parser reports tag and attribute names in lowercase
+        tagName_ = [[tagName lowercaseString] copy];
+        attributeName_ = [[attributeName lowercaseString] copy];
+        matchAttributeName_ = [[matchAttributeName lowercaseString] copy];
+        matchAttributeValue_ = [matchAttributeValue copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    SAFE_ARC_RELEASE(tagName_);
+    SAFE_ARC_RELEASE(attributeName_);
+    SAFE_ARC_RELEASE(matchAttributeName_);
+    SAFE_ARC_RELEASE(matchAttributeValue_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+- (NSString *)description
+{
+    if (matchAttributeName_)
+        return [NSString stringWithFormat:@"<%@ %@=%@> %@", tagName_, matchAttributeName_, matchAttributeValue_ ?: @"*", attributeName_ ?: @"text"];
+    return [NSString stringWithFormat:@"<%@> %@", tagName_, attributeName_ ?: @"text"];
+}
+
+@end
+
+
+
+#pragma mark - extraction state
+
+typedef struct {
+    xmlChar *tagName;
+    xmlChar *attributeName; // NULL reports the text content
+    xmlChar *matchAttributeName;
+    xmlChar *matchAttributeValue;
+} HTMLCompiledRule;
+
+struct HTMLExtractionState {
+    HTMLCompiledRule *rules;
+    NSUInteger numberOfRules;
+    htmlParserCtxtPtr context;
+    void *extractor; // unretained HTMLStreamExtractor
+    NSInteger textRule; // index of the rule collecting text, -1 if none
+    NSUInteger textDepth;
+    xmlBufferPtr textBuffer;
+    BOOL stopped;
+};
+
+static xmlChar *copyXMLString(NSString *string)
+{
+    return (string) ? xmlStrdup(BAD_CAST [string UTF8String]) : NULL;
+}
+
+static const xmlChar *attributeValue(const xmlChar **atts, const xmlChar *name)
+{
+    if (atts == NULL) return NULL;
+    for (NSUInteger i = 0; atts[i]; i += 2) {
+        // attributes without value are reported with an empty value
+        if (xmlStrEqual(atts[i], name)) return (atts[i + 1]) ? atts[i + 1] : BAD_CAST "";
+    }
+    return NULL;
+}
+
+static BOOL compiledRuleMatches(HTMLCompiledRule *rule, const xmlChar *name, const xmlChar **atts)
+{
+    if (xmlStrEqual(rule->tagName, name) == 0) return NO;
+    if (rule->matchAttributeName) {
+        const xmlChar *value = attributeValue(atts, rule->matchAttributeName);
+        if (value == NULL) return NO;
+        if (rule->matchAttributeValue && xmlStrcasecmp(value, rule->matchAttributeValue)) return NO;
+    }
+    return YES;
+}
+
+@interface HTMLStreamExtractor ()
+- (void)reportValue:(const xmlChar *)value length:(int)length forRuleAtIndex:(NSUInteger)index;
+@end
+
+static void extractorStartElement(void *ctx, const xmlChar *name, const xmlChar **atts)
+{
+    struct HTMLExtractionState *state = ctx;
+    if (state->stopped) return;
+    
+    if (state->textRule >= 0) {
+        if (xmlStrEqual(name, state->rules[state->textRule].tagName)) state->textDepth++;
+    }
+    for (NSUInteger i = 0; i < state->numberOfRules && state->stopped == NO; i++) {
+        HTMLCompiledRule *rule = &state->rules[i];
+        if (compiledRuleMatches(rule, name, atts) == NO) continue;
+        
+        if (rule->attributeName) {
+            const xmlChar *value = attributeValue(atts, rule->attributeName);
+            if (value)
+                [(__bridge HTMLStreamExtractor *)state->extractor reportValue:value length:xmlStrlen(value) forRuleAtIndex:i];
+        }
+        else if (state->textRule < 0) {
+            state->textRule = i;
+            state->textDepth = 1;
+            xmlBufferEmpty(state->textBuffer);
+        }
+    }
+}
+
+static void extractorEndElement(void *ctx, const xmlChar *name)
+{
+    struct HTMLExtractionState *state = ctx;
+    if (state->stopped || state->textRule < 0) return;
+    
+    if (xmlStrEqual(name, state->rules[state->textRule].tagName) && --state->textDepth == 0) {
+        NSUInteger index = state->textRule;
+        state->textRule = -1;
+        [(__bridge HTMLStreamExtractor *)state->extractor reportValue:xmlBufferContent(state->textBuffer) length:xmlBufferLength(state->textBuffer) forRuleAtIndex:index];
+    }
+}
+
+static void extractorCharacters(void *ctx, const xmlChar *ch, int len)
+{
+    struct HTMLExtractionState *state = ctx;
+    if (state->textRule >= 0 && state->stopped == NO) xmlBufferAdd(state->textBuffer, ch, len);
+}
+
+
+
+@implementation HTMLStreamExtractor
+@synthesize rules = rules_;
+
+#pragma mark - error handling
+
+- (NSError *)errorForCode:(NSInteger )errorCode
+{
+    NSString *errorString = @"";
+    switch (errorCode) {
+        case 1:
+            errorString = @"No valid data";
+            break;
+            
+        case 5:
+            errorString = @"Parser context could not be created";
+            break;
+    }
+    return [NSError errorWithDomain:[@"com.klieme." stringByAppendingString: NSStringFromClass([self class])]
+                               code:errorCode
+                           userInfo:@{NSLocalizedDescriptionKey: errorString}];
+}
+
+#pragma mark - class method
+
++ (HTMLStreamExtractor *)extractorWithRules:(NSArray *)rules
+{
+    return SAFE_ARC_AUTORELEASE([[HTMLStreamExtractor alloc] initWithRules:rules]);
+}
+
+#pragma mark - init methods
+
+// designated initializer
+- (INSTANCETYPE_OR_ID)initWithRules:(NSArray *)rules
+{
+    self = [super init];
+    if (self) {
+        rules_ = [rules copy];
+        state_ = calloc(1, sizeof(struct HTMLExtractionState));
+        state_->rules = calloc([rules_ count], sizeof(HTMLCompiledRule));
+        for (HTMLExtractionRule *rule in rules_) {
+            HTMLCompiledRule *compiledRule = &state_->rules[state_->numberOfRules++];
+            compiledRule->tagName = copyXMLString(rule.tagName);
+            compiledRule->attributeName = copyXMLString(rule.attributeName);
+            compiledRule->matchAttributeName = copyXMLString(rule.matchAttributeName);
+            compiledRule->matchAttributeValue = copyXMLString(rule.matchAttributeValue);
+        }
+        state_->textBuffer = xmlBufferCreate();
+        state_->extractor = (__bridge void *)self;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < state_->numberOfRules; i++) {
+        HTMLCompiledRule *rule = &state_->rules[i];
+        xmlFree(rule->tagName);
+        xmlFree(rule->attributeName);
+        xmlFree(rule->matchAttributeName);
+        xmlFree(rule->matchAttributeValue);
+    }
+    free(state_->rules);
+    xmlBufferFree(state_->textBuffer);
+    free(state_);
+    SAFE_ARC_RELEASE(rules_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+#pragma mark - extraction
+
+- (void)reportValue:(const xmlChar *)value length:(int)length forRuleAtIndex:(NSUInteger)index
+{
+    NSString *string = SAFE_ARC_AUTORELEASE([[NSString alloc] initWithBytes:value length:length encoding:NSUTF8StringEncoding]);
+    if (state_->rules[index].attributeName == NULL)
+        string = [string stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+    
+    BOOL stop = NO;
+    block_(rules_[index], string ?: @"", &stop);
+    if (stop) {
+        state_->stopped = YES;
+        xmlStopParser(state_->context);
+    }
+}
+
+- (BOOL)beginWithEncoding:(NSStringEncoding )encoding block:(HTMLExtractionBlock)block error:(NSError **)error
+{
+    htmlSAXHandler saxHandler;
+    memset(&saxHandler, 0, sizeof(saxHandler));
+    saxHandler.startElement = extractorStartElement;
+    saxHandler.endElement = extractorEndElement;
+    saxHandler.characters = extractorCharacters;
+    
+    state_->context = htmlCreatePushParserCtxt(&saxHandler, state_, NULL, 0, NULL, XML_CHAR_ENCODING_NONE);
+    if (state_->context == NULL) {
+        if (error) *error = [self errorForCode:5];
+        return NO;
+    }
+    htmlCtxtUseOptions(state_->context, HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING | HTML_PARSE_NONET);
+    switchPushParserEncoding(state_->context, encoding);
+    state_->textRule = -1;
+    state_->textDepth = 0;
+    state_->stopped = NO;
+    block_ = [block copy];
+    return YES;
+}
+
+// returns NO if parsing has been stopped
+- (BOOL)pushBytes:(const char *)bytes length:(NSUInteger)length
+{
+    while (length && state_->stopped == NO) {
+        int chunkSize = (length > INT_MAX) ? INT_MAX : (int)length;
+        htmlParseChunk(state_->context, bytes, chunkSize, 0);
+        bytes += chunkSize;
+        length -= chunkSize;
+    }
+    return state_->stopped == NO;
+}
+
+- (void)end
+{
+    if (state_->stopped == NO) htmlParseChunk(state_->context, NULL, 0, 1);
+    htmlFreeParserCtxt(state_->context);
+    state_->context = NULL;
+    SAFE_ARC_RELEASE(block_);
+    block_ = nil;
+}
+
+- (BOOL)extractFromData:(NSData *)data encoding:(NSStringEncoding )encoding usingBlock:(HTMLExtractionBlock)block error:(NSError **)error
+{
+    if ([data length] == 0) {
+        if (error) *error = [self errorForCode:1];
+        return NO;
+    }
+    if ([self beginWithEncoding:encoding block:block error:error] == NO) return NO;
+    
+    [self pushBytes:[data bytes] length:[data length]];
+    [self end];
+    return YES;
+}
+
+- (BOOL)extractFromContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding usingBlock:(HTMLExtractionBlock)block error:(NSError **)error
+{
+    if ([url isFileURL] == NO) {
+        NSData *data = [NSData dataWithContentsOfURL:url options:0 error:error];
+        return (data) ? [self extractFromData:data encoding:encoding usingBlock:block error:error] : NO;
+    }
+    
+    int fd = open([url fileSystemRepresentation], O_RDONLY);
+    if (fd < 0) {
+        if (error)
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSURLErrorKey: url}];
+        return NO;
+    }
+    if ([self beginWithEncoding:encoding block:block error:error] == NO) {
+        close(fd);
+        return NO;
+    }
+    
+    char buffer[65536];
+    ssize_t bytesRead;
+    NSUInteger numberOfBytes = 0;
+    NSInteger readError = 0;
+    while ((bytesRead = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            readError = errno;
+            break;
+        }
+        numberOfBytes += bytesRead;
+        if ([self pushBytes:buffer length:bytesRead] == NO) break;
+    }
+    close(fd);
+    [self end];
+    
+    if (readError || numberOfBytes == 0) {
+        if (error)
+            *error = (readError) ? [NSError errorWithDomain:NSPOSIXErrorDomain code:readError userInfo:@{NSURLErrorKey: url}] : [self errorForCode:1];
+        return NO;
+    }
+    return YES;
+}
+
+@end
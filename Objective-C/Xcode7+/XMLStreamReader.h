@@ -0,0 +1,111 @@
+/*###################################################################################
+ #                                                                                  #
+ #     XMLStreamReader.h                                                            #
+ #                                                                                  #
+ #     Copyright © 2014 by Stefan Klieme                                            #
+ #                                                                                  #
+ #     Objective-C wrapper for HTML parser of libxml2                               #
+ #                                                                                  #
+ #     Version 1.8 - 14. Dez 2015 for Xcode 7+                                      #
+ #                                                                                  #
+ #     usage:     add libxml2.dylib to frameworks                                   #
+ #                add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths #
+ #                add -lxml2 to target -> other linker flags                        #
+ #                                                                                  #
+ #                                                                                  #
+ ####################################################################################
+ #                                                                                  #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of  #
+ # this software and associated documentation files (the "Software"), to deal       #
+ # in the Software without restriction, including without limitation the rights     #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies #
+ # of the Software, and to permit persons to whom the Software is furnished to do   #
+ # so, subject to the following conditions:                                         #
+ # The above copyright notice and this permission notice shall be included in       #
+ # all copies or substantial portions of the Software.                              #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR       #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,         #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE      #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,#
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR     #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.    #
+ #                                                                                  #
+ ##################################################################################*/
+
+#import <Foundation/Foundation.h>
+#import <libxml/xmlreader.h>
+#import "HTMLDocument.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void (^XMLStreamReaderBlock)(HTMLNode *record, BOOL *stop);
+
+NS_ASSUME_NONNULL_END
+
+// XMLStreamReader reads huge XML documents with a pull parser and expands one record subtree at a time,
+// e.g. each <item> of a product feed. The record is freed before the reader moves on,
+// so the memory usage is independent of the size of the document.
+// All HTMLNode query methods work on the record, but the node and its descendants are valid only inside the block.
+
+@interface XMLStreamReader : NSObject
+{
+    xmlTextReaderPtr reader_;
+    NSData *data_;
+    int fileDescriptor_;
+    NSUInteger numberOfRecords_;
+}
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*! Returns an XMLStreamReader object reading an NSData object with specified string encoding
+ * \param data A data object with XML content
+ * \param encoding The string encoding for the XML content
+ * \param error An error object that, on return, identifies any problems
+ * \returns An initialized XMLStreamReader object, or nil if initialization fails
+ */
++ (nullable XMLStreamReader *)readerWithData:(nullable NSData *)data encoding:(NSStringEncoding )encoding error:(NSError **)error;
+
+/*! Returns an XMLStreamReader object reading a file with specified string encoding
+ * \param url An NSURL object specifying a file URL
+ * \param encoding The string encoding for the XML content
+ * \param error An error object that, on return, identifies any problems
+ * \returns An initialized XMLStreamReader object, or nil if initialization fails
+ */
++ (nullable XMLStreamReader *)readerWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding error:(NSError **)error;
+
+/*! Initializes and returns an XMLStreamReader object reading an NSData object with specified string encoding and parse options. The data object is retained while reading
+ * \param data A data object with XML content
+ * \param encoding The string encoding for the XML content
+ * \param options The options passed to the libxml2 parser, HTMLDocumentParseOptionNoImplied is ignored
+ * \param error An error object that, on return, identifies any problems
+ * \returns An initialized XMLStreamReader object, or nil if initialization fails
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithData:(nullable NSData *)data encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error;
+
+/*! Initializes and returns an XMLStreamReader object reading a file through its file descriptor with specified string encoding and parse options
+ * \param url An NSURL object specifying a file URL
+ * \param encoding The string encoding for the XML content
+ * \param options The options passed to the libxml2 parser, HTMLDocumentParseOptionNoImplied is ignored
+ * \param error An error object that, on return, identifies any problems
+ * \returns An initialized XMLStreamReader object, or nil if initialization fails
+ */
+- (nullable INSTANCETYPE_OR_ID)initWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error;
+
+/*! Reads the document and calls the block for each element with the specified name. Elements nested in a record are not reported separately.
+ * A reader can enumerate the document only once
+ * \param tagName The qualified or local name of the record elements
+ * \param block The block called for each record, set stop to YES to abort reading
+ * \param error An error object that, on return, identifies any parsing errors
+ * \returns YES if the document has been read completely or reading has been stopped, NO if an error occured
+ */
+- (BOOL)enumerateRecordsWithTagName:(NSString *)tagName usingBlock:(XMLStreamReaderBlock)block error:(NSError **)error;
+
+/*! The number of records reported so far*/
+@property (readonly) NSUInteger numberOfRecords;
+
+/*! Has the document been read*/
+@property (readonly, getter=isFinished) BOOL finished;
+
+NS_ASSUME_NONNULL_END
+
+@end
@@ -0,0 +1,207 @@
+/*###################################################################################
+ #                                                                                  #
+ #     XMLStreamReader.m                                                            #
+ #                                                                                  #
+ #     Copyright © 2014 by Stefan Klieme                                            #
+ #                                                                                  #
+ #     Objective-C wrapper for HTML parser of libxml2                               #
+ #                                                                                  #
+ #     Version 1.8 - 14. Dez 2015 for Xcode 7+                                      #
+ #                                                                                  #
+ #     usage:     add libxml2.dylib to frameworks                                   #
+ #                add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths #
+ #                add -lxml2 to target -> other linker flags                        #
+ #                                                                                  #
+ #                                                                                  #
+ ####################################################################################
+ #                                                                                  #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of  #
+ # this software and associated documentation files (the "Software"), to deal       #
+ # in the Software without restriction, including without limitation the rights     #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies #
+ # of the Software, and to permit persons to whom the Software is furnished to do   #
+ # so, subject to the following conditions:                                         #
+ # The above copyright notice and this permission notice shall be included in       #
+ # all copies or substantial portions of the Software.                              #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR       #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,         #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE      #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,#
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR     #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.    #
+ #                                                                                  #
+ ##################################################################################*/
+
+#import "XMLStreamReader.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// the bit of HTML_PARSE_NOIMPLIED is XML_PARSE_NSCLEAN in the XML parser
+#define XML_PARSE_OPTIONS(options) ((int)(options) & ~HTMLDocumentParseOptionNoImplied)
+
+@implementation XMLStreamReader
+@synthesize numberOfRecords = numberOfRecords_;
+
+#pragma mark - error handling
+
+- (NSError *)errorForCode:(NSInteger )errorCode
+{
+    NSString *errorString = @"";
+    switch (errorCode) {
+        case 1:
+            errorString = @"No valid data";
+            break;
+            
+        case 2:
+            errorString = @"XML data could not be parsed";
+            break;
+            
+        case 4:
+            errorString = @"Reader has already been finished";
+            break;
+            
+        case 5:
+            errorString = @"Reader could not be created";
+            break;
+    }
+    return [NSError errorWithDomain:[@"com.klieme." stringByAppendingString: NSStringFromClass([self class])]
+                               code:errorCode
+                           userInfo:@{NSLocalizedDescriptionKey: errorString}];
+}
+
+#pragma mark - class methods
+
++ (XMLStreamReader *)readerWithData:(NSData *)data encoding:(NSStringEncoding )encoding error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[XMLStreamReader alloc] initWithData:data encoding:encoding options:HTMLDocumentParseOptionDefault error:error]);
+}
+
++ (XMLStreamReader *)readerWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding error:(NSError **)error
+{
+    return SAFE_ARC_AUTORELEASE([[XMLStreamReader alloc] initWithContentsOfURL:url encoding:encoding options:HTMLDocumentParseOptionDefault error:error]);
+}
+
+#pragma mark - init methods
+
+- (INSTANCETYPE_OR_ID)initWithData:(NSData *)data encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error
+{
+    self = [super init];
+    if (self) {
+        fileDescriptor_ = -1;
+        if ([data length] == 0 || [data length] > INT_MAX) {
+            if (error) *error = [self errorForCode:1];
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        // the reader parses the bytes in place
+        data_ = [data copy];
+        char encodingBuffer[32];
+        reader_ = xmlReaderForMemory([data_ bytes], (int)[data_ length], NULL, convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer)), XML_PARSE_OPTIONS(options));
+        if (reader_ == NULL) {
+            if (error) *error = [self errorForCode:5];
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (INSTANCETYPE_OR_ID)initWithContentsOfURL:(NSURL *)url encoding:(NSStringEncoding )encoding options:(HTMLDocumentParseOptions)options error:(NSError **)error
+{
+    // -dealloc closes the descriptor, it must not be the zero of the allocation if the initializer fails early
+    fileDescriptor_ = -1;
+    if ([url isFileURL] == NO) {
+        NSData *data = [NSData dataWithContentsOfURL:url options:0 error:error];
+        if (data) return [self initWithData:data encoding:encoding options:options error:error];
+        
+        SAFE_ARC_RELEASE(self);
+        return nil;
+    }
+    
+    self = [super init];
+    if (self) {
+        fileDescriptor_ = open([url fileSystemRepresentation], O_RDONLY);
+        if (fileDescriptor_ < 0) {
+            if (error)
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSURLErrorKey: url}];
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+        char encodingBuffer[32];
+        reader_ = xmlReaderForFd(fileDescriptor_, NULL, convertStringEncoding(encoding, encodingBuffer, sizeof(encodingBuffer)), XML_PARSE_OPTIONS(options));
+        if (reader_ == NULL) {
+            if (error) *error = [self errorForCode:5];
+            SAFE_ARC_RELEASE(self);
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    // the reader does not close the file descriptor
+    if (reader_) xmlFreeTextReader(reader_);
+    if (fileDescriptor_ >= 0) close(fileDescriptor_);
+    SAFE_ARC_RELEASE(data_);
+    SAFE_ARC_SUPER_DEALLOC();
+}
+
+#pragma mark - reading
+
+- (void)finish
+{
+    xmlFreeTextReader(reader_);
+    reader_ = NULL;
+    if (fileDescriptor_ >= 0) close(fileDescriptor_);
+    fileDescriptor_ = -1;
+}
+
+- (BOOL)enumerateRecordsWithTagName:(NSString *)tagName usingBlock:(XMLStreamReaderBlock)block error:(NSError **)error
+{
+    if (reader_ == NULL) {
+        if (error) *error = [self errorForCode:4];
+        return NO;
+    }
+    
+    const xmlChar *recordName = BAD_CAST [tagName UTF8String];
+    BOOL qualifiedName = ([tagName rangeOfString:@":"].location != NSNotFound);
+    BOOL stop = NO;
+    int result = xmlTextReaderRead(reader_);
+    while (result == 1) {
+        if (xmlTextReaderNodeType(reader_) == XML_READER_TYPE_ELEMENT
+            && xmlStrEqual((qualifiedName) ? xmlTextReaderConstName(reader_) : xmlTextReaderConstLocalName(reader_), recordName)) {
+            xmlNodePtr recordNode = xmlTextReaderExpand(reader_);
+            if (recordNode == NULL) {
+                result = -1;
+                break;
+            }
+            @autoreleasepool {
+                HTMLNode *record = [[HTMLNode alloc] initWithXMLNode:recordNode];
+                block(record, &stop);
+                SAFE_ARC_RELEASE(record);
+            }
+            numberOfRecords_++;
+            if (stop) break;
+            
+            // skips the subtree, the reader frees the expanded nodes when it moves on
+            result = xmlTextReaderNext(reader_);
+        }
+        else
+            result = xmlTextReaderRead(reader_);
+    }
+    [self finish];
+    
+    if (result < 0) {
+        if (error) *error = [self errorForCode:2];
+        return NO;
+    }
+    return YES;
+}
+
+- (BOOL)isFinished
+{
+    return reader_ == NULL;
+}
+
+@end
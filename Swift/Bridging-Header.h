@@ -4,6 +4,9 @@
 
 #import <libxml/HTMLtree.h>
 #import <libxml/HTMLparser.h>
+#import <libxml/parserInternals.h>
+#import <libxml/xmlreader.h>
 #import <libxml/xpath.h>
 #import <libxml/xpathInternals.h>
 #import <libxml/xmlerror.h>
+#import "HTMLAtomics.h"
@@ -0,0 +1,45 @@
+//
+//  HTMLAtomics.h
+//  The C11 atomic accesses of the arena bitmap and the instrumentation flag for the Swift version, imported by Bridging-Header.h
+//
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Loads the leaf pointer stored at slot, the leaf is published after its words are zeroed
+static inline uint64_t * HTMLAtomicLoadLeaf(void * slot)
+{
+    return atomic_load_explicit((_Atomic(uint64_t *) *)slot, memory_order_acquire);
+}
+
+static inline void HTMLAtomicStoreLeaf(void * slot, uint64_t * leaf)
+{
+    atomic_store_explicit((_Atomic(uint64_t *) *)slot, leaf, memory_order_release);
+}
+
+static inline uint64_t HTMLAtomicLoadWord(uint64_t * word)
+{
+    return atomic_load_explicit((_Atomic(uint64_t) *)word, memory_order_acquire);
+}
+
+static inline void HTMLAtomicSetBits(uint64_t * word, uint64_t bits)
+{
+    atomic_fetch_or_explicit((_Atomic(uint64_t) *)word, bits, memory_order_release);
+}
+
+static inline void HTMLAtomicClearBits(uint64_t * word, uint64_t bits)
+{
+    atomic_fetch_and_explicit((_Atomic(uint64_t) *)word, ~bits, memory_order_release);
+}
+
+// The flag only switches the hooks, the counters it enables are guarded by their lock
+static inline bool HTMLAtomicLoadFlag(bool * flag)
+{
+    return atomic_load_explicit((_Atomic(bool) *)flag, memory_order_relaxed);
+}
+
+static inline void HTMLAtomicStoreFlag(bool * flag, bool value)
+{
+    atomic_store_explicit((_Atomic(bool) *)flag, value, memory_order_relaxed);
+}
@@ -0,0 +1,216 @@
+/*###################################################################################
+ #                                                                                   #
+ #    HTMLDocument+Async.swift - Extension for HTMLDocument and HTMLNode             #
+ #                                                                                   #
+ #    Copyright © 2014-2017 by Stefan Klieme                                         #
+ #                                                                                   #
+ #    Swift wrapper for HTML parser of libxml2                                       #
+ #                                                                                   #
+ #    Version 1.1 - 13. Sep 2017                                                     #
+ #                                                                                   #
+ #    usage:     add libxml2.dylib to frameworks (depends on autoload settings)      #
+ #               add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths   #
+ #               add -lxml2 to target -> other linker flags                          #
+ #               add Bridging-Header.h to your project and rename it as              #
+ #                  [Modulename]-Bridging-Header.h                                   #
+ #                  where [Modulename] is the module name in your project            #
+ #                  or copy&paste the #import lines into your bridging header        #
+ #                                                                                   #
+ #####################################################################################
+ #                                                                                   #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+ # this software and associated documentation files (the "Software"), to deal        #
+ # in the Software without restriction, including without limitation the rights      #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+ # of the Software, and to permit persons to whom the Software is furnished to do    #
+ # so, subject to the following conditions:                                          #
+ # The above copyright notice and this permission notice shall be included in        #
+ # all copies or substantial portions of the Software.                               #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+ #                                                                                   #
+ ###################################################################################*/
+
+import Foundation
+
+#if compiler(>=5.7)
+
+// The cancellation state of one async call, set by the cancellation handler of the task
+// and checked on the parsing queue where the state of the task itself isn't available
+private final class HTMLCancellationState : @unchecked Sendable {
+    private var cancelled = false
+    private let lock = NSLock()
+    
+    var isCancelled : Bool {
+        lock.lock()
+        defer { lock.unlock() }
+        return cancelled
+    }
+    
+    func cancel() {
+        lock.lock()
+        cancelled = true
+        lock.unlock()
+    }
+    
+    func check() throws {
+        if isCancelled { throw CancellationError() }
+    }
+}
+
+// The document is a read-only tree, the node index and the XPath context are created lazily behind locks
+extension HTMLDocument : @unchecked Sendable {}
+
+// A node is an immutable reference into the tree of its document
+extension HTMLNode : @unchecked Sendable {}
+
+extension HTMLDocument {
+    
+    /// The concurrent queue the async methods parse and query on, so multi-MB documents don't block the caller's executor
+    /// or the threads of the cooperative pool.
+    
+    static let asyncQueue = DispatchQueue(label: "com.klieme.HTMLDocument.async", qos: .userInitiated, attributes: .concurrent)
+    
+    /// The number of bytes passed to the parser between two cancellation checks.
+    
+    static let asyncChunkSize = 256 * 1024
+    
+    // Runs the closure on the async queue and resumes the caller with its result. Cancelling the task sets the state
+    // which the closure checks between its steps, a cancelled task throws CancellationError.
+    
+    fileprivate static func performAsync<T>(_ body: @escaping (_ cancellation: () throws -> Void) throws -> T) async throws -> T
+    {
+        try Task.checkCancellation()
+        let state = HTMLCancellationState()
+        return try await withTaskCancellationHandler {
+            try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<T, Error>) in
+                asyncQueue.async {
+                    continuation.resume(with: Result {
+                        try state.check()
+                        return try body(state.check)
+                    })
+                }
+            }
+        } onCancel: {
+            state.cancel()
+        }
+    }
+    
+    /// Parses a Data object with specified string encoding and parse options on the async queue.
+    /// The data is passed to the push parser in chunks of `asyncChunkSize` bytes, the task is checked for cancellation between the chunks.
+    /// - Parameters:
+    ///   - data: A data object with HTML content.
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
+    /// - Returns: An initialized HTMLDocument object, if parsing fails an error is thrown, CancellationError if the task has been cancelled.
+    
+    static func parse(_ data: Data, encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default) async throws -> HTMLDocument
+    {
+        guard !data.isEmpty else { throw HTMLDocumentError.dataEmpty }
+        
+        return try await performAsync { checkCancellation in
+            guard let parser = HTMLPushParser(encoding: encoding, options: options) else { throw HTMLDocumentError.couldNotParse }
+            var offset = data.startIndex
+            while offset < data.endIndex {
+                let chunkEnd = data.index(offset, offsetBy: asyncChunkSize, limitedBy: data.endIndex) ?? data.endIndex
+                try parser.append(data[offset..<chunkEnd]) // the slice shares the storage of the data object
+                offset = chunkEnd
+                try checkCancellation()
+            }
+            return try parser.finish()
+        }
+    }
+    
+    /// Parses a string containing HTML markup text on the async queue.
+    /// - Parameters:
+    ///   - string: A string containing the HTML source.
+    /// - Returns: An initialized HTMLDocument object, if parsing fails an error is thrown, CancellationError if the task has been cancelled.
+    
+    static func parse(string: String) async throws -> HTMLDocument
+    {
+        return try await parse(Data(string.utf8))
+    }
+    
+    /// Reads and parses the HTML contents of a file URL on the async queue, the file is mapped into virtual memory if possible.
+    /// - Parameters:
+    ///   - url: A file URL specifying the HTML source.
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
+    /// - Returns: An initialized HTMLDocument object, if reading or parsing fails an error is thrown, CancellationError if the task has been cancelled.
+    
+    static func parse(contentsOf url: URL, encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default) async throws -> HTMLDocument
+    {
+        let data = try await performAsync { _ in try Data(contentsOf: url, options: .mappedIfSafe) }
+        return try await parse(data, encoding: encoding, options: options)
+    }
+}
+
+// The async queries have names of their own: overloads of the synchronous names would be preferred in async contexts
+// and require await at the existing call sites
+
+extension HTMLNode {
+    
+    /// Returns the first descendant node for a XPath query, the query is evaluated on the async queue.
+    /// - Parameters:
+    ///   - query: The XPath query string.
+    /// - Returns: The first found descendant node or nil if no node matches the parameters, a XPathError is thrown on failure.
+    
+    func asyncNode(forXPath query : String) async throws -> HTMLNode?
+    {
+        return try await HTMLDocument.performAsync { _ in try self.node(forXPath: query) }
+    }
+    
+    /// Returns all descendant nodes for a XPath query, the query is evaluated on the async queue.
+    /// - Parameters:
+    ///   - query: The XPath query string.
+    /// - Returns: The array of all found descendant nodes or an empty array, a XPathError is thrown on failure.
+    
+    func asyncNodes(forXPath query : String) async throws -> [HTMLNode]
+    {
+        return try await HTMLDocument.performAsync { _ in try self.nodes(forXPath: query) }
+    }
+    
+    /// Returns the first descendant node for a compiled XPath query, the query is evaluated on the async queue.
+    /// - Parameters:
+    ///   - query: The compiled XPath query.
+    /// - Returns: The first found descendant node or nil if no node matches the parameters, a XPathError is thrown on failure.
+    
+    func asyncNode(forXPath query : HTMLXPathQuery) async throws -> HTMLNode?
+    {
+        return try await HTMLDocument.performAsync { _ in try self.node(forXPath: query) }
+    }
+    
+    /// Returns all descendant nodes for a compiled XPath query, the query is evaluated on the async queue.
+    /// - Parameters:
+    ///   - query: The compiled XPath query.
+    /// - Returns: The array of all found descendant nodes or an empty array, a XPathError is thrown on failure.
+    
+    func asyncNodes(forXPath query : HTMLXPathQuery) async throws -> [HTMLNode]
+    {
+        return try await HTMLDocument.performAsync { _ in try self.nodes(forXPath: query) }
+    }
+    
+    /// Returns all descendant nodes matching a compiled CSS selector, the nodes are collected on the async queue.
+    /// The task is checked for cancellation between the matches.
+    /// - Parameters:
+    ///   - selector: The compiled selector.
+    /// - Returns: The array of all matching descendant nodes in document order or an empty array, CancellationError if the task has been cancelled.
+    
+    func asyncNodes(matching selector: HTMLSelector) async throws -> [HTMLNode]
+    {
+        return try await HTMLDocument.performAsync { checkCancellation in
+            var result = [HTMLNode]()
+            for (offset, node) in self.nodes(matching: selector).enumerated() {
+                if offset & 0xFF == 0xFF { try checkCancellation() }
+                result.append(node)
+            }
+            return result
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*###################################################################################
+ #                                                                                   #
+ #    HTMLDocument+Batch.swift - Extension for HTMLDocument                          #
+ #                                                                                   #
+ #    Copyright © 2014-2017 by Stefan Klieme                                         #
+ #                                                                                   #
+ #    Swift wrapper for HTML parser of libxml2                                       #
+ #                                                                                   #
+ #    Version 1.1 - 13. Sep 2017                                                     #
+ #                                                                                   #
+ #    usage:     add libxml2.dylib to frameworks (depends on autoload settings)      #
+ #               add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths   #
+ #               add -lxml2 to target -> other linker flags                          #
+ #               add Bridging-Header.h to your project and rename it as              #
+ #                  [Modulename]-Bridging-Header.h                                   #
+ #                  where [Modulename] is the module name in your project            #
+ #                  or copy&paste the #import lines into your bridging header        #
+ #                                                                                   #
+ #####################################################################################
+ #                                                                                   #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+ # this software and associated documentation files (the "Software"), to deal        #
+ # in the Software without restriction, including without limitation the rights      #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+ # of the Software, and to permit persons to whom the Software is furnished to do    #
+ # so, subject to the following conditions:                                          #
+ # The above copyright notice and this permission notice shall be included in        #
+ # all copies or substantial portions of the Software.                               #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+ #                                                                                   #
+ ###################################################################################*/
+
+import Foundation
+
+// xmlInitParser() must be called once before the parser is used on several threads,
+// the initializer of a global constant runs exactly once
+private let parserInitialization : Void = xmlInitParser()
+
+// The shared counter the workers take the next index from
+private final class HTMLBatchCounter {
+    private var next = 0
+    private let lock = NSLock()
+    
+    func nextIndex() -> Int {
+        lock.lock()
+        defer { lock.unlock() }
+        let index = next
+        next += 1
+        return index
+    }
+}
+
+extension HTMLDocument {
+    
+    /// Parses the data objects in parallel and passes each result to a closure as soon as it's available. The method returns when all data objects are processed.
+    /// A bounded number of workers takes the next unprocessed data object from a shared counter, so slow documents don't stall the other workers.
+    /// Each worker reuses one HTMLParser for all its documents, each document is freed when its extraction closure returns unless the result contains nodes of it.
+    /// - Parameters:
+    ///   - batch: An array of data objects with HTML content.
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
+    ///   - maximumConcurrency: The maximum number of workers (optional, default is 0 which uses the number of active processors).
+    ///   - extraction: The closure called on a worker thread for each parsed document. Nodes in the result keep their document alive.
+    ///   - resultHandler: The closure called with the index and the result for each data object in the order of completion, the calls are serialized but made on the worker threads.
+    
+    static func process<T>(_ batch: [Data], encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default, maximumConcurrency: Int = 0,
+                           extraction: (HTMLDocument, Int) throws -> T, resultHandler: (Int, Result<T, Error>) -> Void)
+    {
+        let resultLock = NSLock()
+        performBatch(batch, encoding: encoding, options: options, maximumConcurrency: maximumConcurrency, extraction: extraction) { index, result in
+            resultLock.lock()
+            resultHandler(index, result)
+            resultLock.unlock()
+        }
+    }
+    
+    /// Parses the data objects in parallel and returns the results in the order of the batch.
+    /// - Parameters:
+    ///   - batch: An array of data objects with HTML content.
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
+    ///   - maximumConcurrency: The maximum number of workers (optional, default is 0 which uses the number of active processors).
+    ///   - extraction: The closure called on a worker thread for each parsed document. Nodes in the result keep their document alive.
+    /// - Returns: The result for each data object, the value of the extraction closure or the error of the parser or the closure.
+    
+    static func results<T>(for batch: [Data], encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default, maximumConcurrency: Int = 0,
+                           extraction: (HTMLDocument, Int) throws -> T) -> [Result<T, Error>]
+    {
+        // each worker writes its results into distinct slots, no synchronization is needed
+        let slots = UnsafeMutableBufferPointer<Result<T, Error>?>.allocate(capacity: batch.count)
+        slots.initialize(repeating: nil)
+        defer {
+            _ = slots.deinitialize()
+            slots.deallocate()
+        }
+        performBatch(batch, encoding: encoding, options: options, maximumConcurrency: maximumConcurrency, extraction: extraction) { index, result in
+            slots[index] = result
+        }
+        return slots.map { $0! }
+    }
+    
+    // Runs the workers with DispatchQueue.concurrentPerform and returns when the batch is processed, the result handler calls are not serialized
+    
+    private static func performBatch<T>(_ batch: [Data], encoding: String.Encoding, options: HTMLParseOptions, maximumConcurrency: Int,
+                                        extraction: (HTMLDocument, Int) throws -> T, resultHandler: (Int, Result<T, Error>) -> Void)
+    {
+        guard !batch.isEmpty else { return }
+        
+        _ = parserInitialization
+        
+        let numberOfWorkers = min(maximumConcurrency > 0 ? maximumConcurrency : ProcessInfo.processInfo.activeProcessorCount, batch.count)
+        let counter = HTMLBatchCounter()
+        
+        DispatchQueue.concurrentPerform(iterations: numberOfWorkers) { _ in
+            let parser = HTMLParser(options: options)
+            var index = counter.nextIndex()
+            while index < batch.count {
+                autoreleasepool {
+                    let result = Result<T, Error> { try extraction(try parser.document(with: batch[index], encoding: encoding), index) }
+                    resultHandler(index, result)
+                }
+                index = counter.nextIndex()
+            }
+        }
+    }
+}
@@ -0,0 +1,430 @@
+/*###################################################################################
+ #                                                                                   #
+ #    HTMLDocument+Snapshot.swift - Extension for HTMLDocument                       #
+ #                                                                                   #
+ #    Copyright © 2014-2017 by Stefan Klieme                                         #
+ #                                                                                   #
+ #    Swift wrapper for HTML parser of libxml2                                       #
+ #                                                                                   #
+ #    Version 1.1 - 13. Sep 2017                                                     #
+ #                                                                                   #
+ #    usage:     add libxml2.dylib to frameworks (depends on autoload settings)      #
+ #               add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths   #
+ #               add -lxml2 to target -> other linker flags                          #
+ #               add Bridging-Header.h to your project and rename it as              #
+ #                  [Modulename]-Bridging-Header.h                                   #
+ #                  where [Modulename] is the module name in your project            #
+ #                  or copy&paste the #import lines into your bridging header        #
+ #                                                                                   #
+ #####################################################################################
+ #                                                                                   #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+ # this software and associated documentation files (the "Software"), to deal        #
+ # in the Software without restriction, including without limitation the rights      #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+ # of the Software, and to permit persons to whom the Software is furnished to do    #
+ # so, subject to the following conditions:                                          #
+ # The above copyright notice and this permission notice shall be included in        #
+ # all copies or substantial portions of the Software.                               #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+ #                                                                                   #
+ ###################################################################################*/
+
+import Foundation
+
+enum HTMLSnapshotError: Error {
+    case unsupportedContent // the tree contains nodes which can't be stored or the snapshot exceeds 4 GB
+    case invalidSnapshot
+}
+
+// A snapshot is a position independent binary form of the tree which is loaded much faster than the HTML is parsed again.
+// All values are little-endian 32-bit integers: a header, the flat array of the nodes in document order with the index of
+// their parent, the flat array of the attributes and the table of the NUL terminated UTF-8 strings referenced by offset.
+// The format is the same as of the Objective-C version, snapshots can be exchanged between both.
+//
+// header    : "HTMLSNAP", version, flags, node count, attribute count, length of the string table, reserved
+// node      : info (type in the low byte, the count in the upper bits), parent index, string offset
+// attribute : name offset, value offset
+//
+// The count is the number of attributes of an element, the presence of the content of a processing instruction (bit 0)
+// and the presence of the external ID (bit 0) and the system ID (bit 1) of a DTD. The string is the name of elements,
+// processing instructions and DTDs, the content of the other nodes. The additional strings of processing instructions
+// and DTDs directly follow the name. Element and attribute names are stored once
+
+/// The version of the format written by snapshotData(), snapshots of other versions fail to load.
+
+let htmlDocumentSnapshotVersion : UInt32 = 1
+
+private let snapshotMagic = ("HTMLSNAP" as StaticString).utf8Start
+private let snapshotMagicLength = 8
+private let snapshotNone = UInt32.max
+private let snapshotFlagXML : UInt32 = 1         // the tree of an XMLDocument
+private let snapshotHeaderSize = 32
+private let snapshotNodeSize = 12
+private let snapshotAttributeSize = 8
+private let snapshotTypeBits : UInt32 = 8
+private let snapshotMaxAttributes : UInt32 = (1 << (32 - snapshotTypeBits)) - 1
+private let snapshotNameBufferSize = 128
+private let snapshotEmptyString : UnsafePointer<xmlChar> = ("" as StaticString).utf8Start
+
+// MARK: - writing
+
+// The sections of a snapshot while it's written, the hash table maps each element and attribute name to its offset + 1
+
+private final class HTMLSnapshotWriter {
+    
+    var nodes = [UInt32]()
+    var attributes = [UInt32]()
+    var strings = Data()
+    private let names : xmlHashTablePtr
+    private let nameBuffer = UnsafeMutablePointer<xmlChar>.allocate(capacity: snapshotNameBufferSize)
+    
+    init?() {
+        guard let names = xmlHashCreate(0) else { return nil }
+        self.names = names
+    }
+    
+    deinit {
+        xmlHashFree(names, nil)
+        nameBuffer.deallocate()
+    }
+    
+    func append(string: UnsafePointer<xmlChar>?) throws -> UInt32 {
+        guard let string = string else { return snapshotNone }
+        let length = Int(xmlStrlen(string)) + 1
+        guard length < Int(snapshotNone) - strings.count else { throw HTMLSnapshotError.unsupportedContent }
+        let offset = UInt32(strings.count)
+        strings.append(string, count: length)
+        return offset
+    }
+    
+    func append(name: UnsafePointer<xmlChar>?, namespace ns: xmlNsPtr?) throws -> UInt32 {
+        guard let name = name else { throw HTMLSnapshotError.unsupportedContent }
+        var qualifiedName = name
+        if let prefix = ns?.pointee.prefix {
+            guard let builtName = xmlBuildQName(name, prefix, nameBuffer, CInt(snapshotNameBufferSize)) else { throw HTMLSnapshotError.unsupportedContent }
+            qualifiedName = UnsafePointer(builtName)
+        }
+        defer {
+            if qualifiedName != name && qualifiedName != UnsafePointer(nameBuffer) { xmlFree(UnsafeMutablePointer(mutating: qualifiedName)) }
+        }
+        
+        if let payload = xmlHashLookup(names, qualifiedName) { return UInt32(UInt(bitPattern: payload) - 1) }
+        let offset = try append(string: qualifiedName)
+        guard xmlHashAddEntry(names, qualifiedName, UnsafeMutableRawPointer(bitPattern: UInt(offset) + 1)) == 0 else { throw HTMLSnapshotError.unsupportedContent }
+        return offset
+    }
+    
+    func append(node: xmlNodePtr, parent: UInt32) throws {
+        var count : UInt32 = 0
+        let string : UInt32
+        
+        switch node.pointee.type {
+        case XML_ELEMENT_NODE:
+            string = try append(name: node.pointee.name, namespace: node.pointee.ns)
+            var attr = node.pointee.properties
+            while let currentAttr = attr {
+                let name = try append(name: currentAttr.pointee.name, namespace: currentAttr.pointee.ns)
+                var value = snapshotNone
+                if let child = currentAttr.pointee.children {
+                    // the value of an HTML attribute is one text node, values of several nodes are concatenated
+                    if child.pointee.next == nil, child.pointee.type == XML_TEXT_NODE, let content = child.pointee.content {
+                        value = try append(string: content)
+                    } else if let listValue = xmlNodeListGetString(currentAttr.pointee.doc, child, 1) {
+                        defer { xmlFree(listValue) }
+                        value = try append(string: listValue)
+                    } else {
+                        value = try append(string: snapshotEmptyString)
+                    }
+                }
+                attributes.append(name.littleEndian)
+                attributes.append(value.littleEndian)
+                count += 1
+                guard count < snapshotMaxAttributes else { throw HTMLSnapshotError.unsupportedContent }
+                attr = currentAttr.pointee.next
+            }
+            
+        case XML_TEXT_NODE, XML_CDATA_SECTION_NODE, XML_COMMENT_NODE:
+            string = try append(string: node.pointee.content ?? UnsafeMutablePointer(mutating: snapshotEmptyString))
+            
+        case XML_PI_NODE:
+            guard node.pointee.name != nil else { throw HTMLSnapshotError.unsupportedContent }
+            count = (node.pointee.content != nil) ? 1 : 0
+            string = try append(string: node.pointee.name)
+            _ = try append(string: node.pointee.content)
+            
+        case XML_DTD_NODE:
+            let dtd = UnsafeMutableRawPointer(node).assumingMemoryBound(to: xmlDtd.self)
+            count = ((dtd.pointee.ExternalID != nil) ? 1 : 0) | ((dtd.pointee.SystemID != nil) ? 2 : 0)
+            string = try append(string: dtd.pointee.name ?? snapshotEmptyString)
+            _ = try append(string: dtd.pointee.ExternalID)
+            _ = try append(string: dtd.pointee.SystemID)
+            
+        default:
+            throw HTMLSnapshotError.unsupportedContent // entity references, XInclude markers and declarations outside of the DTD
+        }
+        
+        nodes.append((node.pointee.type.rawValue | count << snapshotTypeBits).littleEndian)
+        nodes.append(parent.littleEndian)
+        nodes.append(string.littleEndian)
+    }
+}
+
+// MARK: - loading
+
+private func snapshotValue(_ bytes: UnsafeRawPointer, _ index: Int) -> UInt32 {
+    var value : UInt32 = 0
+    memcpy(&value, bytes + index * MemoryLayout<UInt32>.size, MemoryLayout<UInt32>.size)
+    return UInt32(littleEndian: value)
+}
+
+// Links a node as last child without merging adjacent text nodes like xmlAddChild() does
+
+private func snapshotAppendChild(_ node: xmlNodePtr, to parent: xmlNodePtr) {
+    node.pointee.parent = parent
+    node.pointee.prev = parent.pointee.last
+    if let last = parent.pointee.last { last.pointee.next = node } else { parent.pointee.children = node }
+    parent.pointee.last = node
+}
+
+// The validated sections of a snapshot and the document the tree is built in
+
+private struct HTMLSnapshotReader {
+    
+    let doc : htmlDocPtr
+    let nodeRecords : UnsafeRawPointer
+    let attributeRecords : UnsafeRawPointer
+    let strings : UnsafeMutablePointer<xmlChar>
+    let nodeCount : UInt32
+    let attributeCount : UInt32
+    let stringsLength : UInt32
+    let sharesStrings : Bool
+    
+    // Creates a node with the content at a string offset, a copy owned by the node or a pointer into the shared string table
+    
+    func newNode(content offset: UInt32, _ create: (UnsafePointer<xmlChar>?) -> xmlNodePtr?) -> xmlNodePtr? {
+        let content = strings + Int(offset)
+        guard let node = create(sharesStrings ? nil : UnsafePointer(content)) else { return nil }
+        if sharesStrings { node.pointee.content = content }
+        return node
+    }
+    
+    // Returns the offset of the string following the one at an offset or nil at the end of the string table
+    
+    func offset(after offset: UInt32) -> UInt32? {
+        let next = offset + UInt32(xmlStrlen(strings + Int(offset))) + 1
+        return (next < stringsLength) ? next : nil
+    }
+    
+    // The nodes are linked as soon as they exist, so the tree of a failed snapshot can be freed
+    
+    func buildTree() -> Bool {
+        let documentNode = UnsafeMutableRawPointer(doc).assumingMemoryBound(to: xmlNode.self)
+        var nodes = [xmlNodePtr]()
+        nodes.reserveCapacity(Int(nodeCount))
+        var nextAttribute : UInt32 = 0
+        
+        for i in 0..<Int(nodeCount) {
+            let record = nodeRecords + i * snapshotNodeSize
+            let info = snapshotValue(record, 0), parentIndex = snapshotValue(record, 1), string = snapshotValue(record, 2)
+            let type = info & ((1 << snapshotTypeBits) - 1), count = info >> snapshotTypeBits
+            
+            let parent : xmlNodePtr
+            if parentIndex == snapshotNone {
+                parent = documentNode
+            } else {
+                guard Int(parentIndex) < i, nodes[Int(parentIndex)].pointee.type == XML_ELEMENT_NODE else { return false }
+                parent = nodes[Int(parentIndex)]
+            }
+            guard string < stringsLength else { return false }
+            
+            let node : xmlNodePtr
+            switch xmlElementType(rawValue: type) {
+            case XML_ELEMENT_NODE:
+                guard count <= attributeCount - nextAttribute else { return false }
+                let name = strings + Int(string)
+                guard let element = sharesStrings ? xmlNewDocNodeEatName(doc, nil, name, nil) : xmlNewDocNode(doc, nil, name, nil) else { return false }
+                snapshotAppendChild(element, to: parent)
+                for _ in 0..<count {
+                    let attributeRecord = attributeRecords + Int(nextAttribute) * snapshotAttributeSize
+                    let attributeName = snapshotValue(attributeRecord, 0), value = snapshotValue(attributeRecord, 1)
+                    nextAttribute += 1
+                    guard attributeName < stringsLength, value == snapshotNone || value < stringsLength else { return false }
+                    
+                    let name = strings + Int(attributeName)
+                    guard let attr = sharesStrings ? xmlNewNsPropEatName(element, nil, name, nil) : xmlNewNsProp(element, nil, name, nil) else { return false }
+                    if value != snapshotNone {
+                        guard let text = newNode(content: value, { xmlNewDocText(doc, $0) }) else { return false }
+                        text.pointee.parent = UnsafeMutableRawPointer(attr).assumingMemoryBound(to: xmlNode.self)
+                        attr.pointee.children = text
+                        attr.pointee.last = text
+                        // like the HTML parser register the id attributes for xmlGetID and the id() function of XPath
+                        if xmlStrEqual(attr.pointee.name, "id") == 1 { xmlAddID(nil, doc, text.pointee.content, attr) }
+                    }
+                }
+                nodes.append(element)
+                continue
+                
+            case XML_TEXT_NODE:
+                guard let text = newNode(content: string, { xmlNewDocText(doc, $0) }) else { return false }
+                node = text
+                
+            case XML_COMMENT_NODE:
+                guard let comment = newNode(content: string, { xmlNewDocComment(doc, $0) }) else { return false }
+                node = comment
+                
+            case XML_CDATA_SECTION_NODE:
+                guard let cdata = newNode(content: string, { xmlNewCDataBlock(doc, $0, ($0 != nil) ? xmlStrlen($0) : 0) }) else { return false }
+                node = cdata
+                
+            case XML_PI_NODE:
+                guard count <= 1 else { return false }
+                let content = (count == 1) ? offset(after: string) : nil
+                guard count == 0 || content != nil,
+                    let pi = xmlNewDocPI(doc, strings + Int(string), content.map { UnsafePointer(strings + Int($0)) }) else { return false }
+                node = pi
+                
+            case XML_DTD_NODE:
+                // the DTD links itself as first child of the document
+                guard parent == documentNode, doc.pointee.children == nil, count <= 3 else { return false }
+                let externalID = (count & 1 != 0) ? offset(after: string) : nil
+                guard count & 1 == 0 || externalID != nil else { return false }
+                let systemID = (count & 2 != 0) ? offset(after: externalID ?? string) : nil
+                guard count & 2 == 0 || systemID != nil,
+                    let dtd = xmlCreateIntSubset(doc, strings + Int(string), externalID.map { UnsafePointer(strings + Int($0)) },
+                                                 systemID.map { UnsafePointer(strings + Int($0)) }) else { return false }
+                nodes.append(UnsafeMutableRawPointer(dtd).assumingMemoryBound(to: xmlNode.self))
+                continue
+                
+            default:
+                return false
+            }
+            snapshotAppendChild(node, to: parent)
+            nodes.append(node)
+        }
+        return nextAttribute == attributeCount
+    }
+}
+
+// Builds the tree of a validated snapshot with the allocation functions of libxml2, the string table is copied once
+// if the nodes share the strings. Returns nil for invalid snapshots, the tree of a failed snapshot is freed unless it shares the strings
+
+private func documentOfSnapshot(_ buffer: UnsafeRawBufferPointer, sharesStrings: Bool) -> htmlDocPtr?
+{
+    guard let bytes = buffer.baseAddress, buffer.count >= snapshotHeaderSize,
+        memcmp(bytes, snapshotMagic, snapshotMagicLength) == 0 else { return nil }
+    let header = bytes + snapshotMagicLength
+    guard snapshotValue(header, 0) == htmlDocumentSnapshotVersion else { return nil }
+    let flags = snapshotValue(header, 1)
+    let nodeCount = snapshotValue(header, 2)
+    let attributeCount = snapshotValue(header, 3)
+    let stringsLength = snapshotValue(header, 4)
+    
+    let expectedLength = snapshotHeaderSize + Int(nodeCount) * snapshotNodeSize + Int(attributeCount) * snapshotAttributeSize + Int(stringsLength)
+    guard expectedLength == buffer.count, stringsLength > 0, buffer[buffer.count - 1] == 0 else { return nil }
+    let nodeRecords = bytes + snapshotHeaderSize
+    let attributeRecords = nodeRecords + Int(nodeCount) * snapshotNodeSize
+    var strings = UnsafeMutablePointer(mutating: (attributeRecords + Int(attributeCount) * snapshotAttributeSize).assumingMemoryBound(to: xmlChar.self))
+    
+    guard let doc = (flags & snapshotFlagXML != 0) ? xmlNewDoc(nil) : htmlNewDocNoDtD(nil, nil) else { return nil }
+    if sharesStrings {
+        // one copy of the string table which is released with the arena
+        guard let sharedStrings = xmlMalloc(Int(stringsLength)) else { return nil }
+        memcpy(sharedStrings, strings, Int(stringsLength))
+        strings = sharedStrings.assumingMemoryBound(to: xmlChar.self)
+    }
+    
+    let reader = HTMLSnapshotReader(doc: doc, nodeRecords: nodeRecords, attributeRecords: attributeRecords, strings: strings,
+                                    nodeCount: nodeCount, attributeCount: attributeCount, stringsLength: stringsLength, sharesStrings: sharesStrings)
+    guard reader.buildTree() else {
+        if !sharesStrings { xmlFreeDoc(doc) }
+        return nil
+    }
+    return doc
+}
+
+extension HTMLDocument {
+    
+    /// Returns a snapshot of the tree of the document.
+    /// - Returns: The snapshot data, if the tree contains nodes which can't be stored or the snapshot exceeds 4 GB an error is thrown.
+    
+    func snapshotData() throws -> Data
+    {
+        guard let writer = HTMLSnapshotWriter() else { throw HTMLSnapshotError.unsupportedContent }
+        
+        // the nodes are written in document order, the indexes of the open ancestors are kept on a stack
+        let documentNode = UnsafeMutableRawPointer(htmlDoc)
+        var parents = [UInt32]()
+        var nodeCount : UInt32 = 0
+        var node = htmlDoc.pointee.children
+        while let currentNode = node {
+            guard nodeCount < snapshotNone - 1 else { throw HTMLSnapshotError.unsupportedContent }
+            try writer.append(node: currentNode, parent: parents.last ?? snapshotNone)
+            nodeCount += 1
+            
+            // the children of a DTD are its declarations, they are restored with the DTD
+            if currentNode.pointee.type == XML_ELEMENT_NODE, let child = currentNode.pointee.children {
+                parents.append(nodeCount - 1)
+                node = child
+                continue
+            }
+            var ancestor = currentNode
+            node = nil
+            while true {
+                if let sibling = ancestor.pointee.next { node = sibling; break }
+                guard let parent = ancestor.pointee.parent, UnsafeMutableRawPointer(parent) != documentNode else { break }
+                parents.removeLast()
+                ancestor = parent
+            }
+        }
+        guard writer.attributes.count / 2 < Int(snapshotNone) else { throw HTMLSnapshotError.unsupportedContent }
+        
+        let header : [UInt32] = [htmlDocumentSnapshotVersion, (htmlDoc.pointee.type == XML_HTML_DOCUMENT_NODE) ? 0 : snapshotFlagXML, nodeCount,
+                                 UInt32(writer.attributes.count / 2), UInt32(writer.strings.count), 0]
+        var snapshot = Data(capacity: snapshotHeaderSize + writer.nodes.count * 4 + writer.attributes.count * 4 + writer.strings.count)
+        snapshot.append(snapshotMagic, count: snapshotMagicLength)
+        header.map { $0.littleEndian }.withUnsafeBufferPointer { snapshot.append($0) }
+        writer.nodes.withUnsafeBufferPointer { snapshot.append($0) }
+        writer.attributes.withUnsafeBufferPointer { snapshot.append($0) }
+        snapshot.append(writer.strings)
+        return snapshot
+    }
+    
+    /// Initializes and returns an HTMLDocument object loaded from a snapshot.
+    /// - Parameters:
+    ///   - data: The snapshot data, it's not referenced after the initializer returns.
+    ///   - usesArena: true to load the tree into an arena with one shared copy of the string table, the nodes point into the copy
+    ///                instead of owning their strings, so the tree must not be modified. false for a regular libxml2 tree (optional, default is true).
+    /// - Returns: An initialized HTMLDocument object, if the snapshot is invalid or initialization fails an error is thrown.
+    
+    convenience init(snapshotData data: Data, usesArena: Bool = true) throws
+    {
+        if usesArena {
+            guard let arena = HTMLArena() else { throw HTMLSnapshotError.invalidSnapshot }
+            let htmlDoc = arena.perform { data.withUnsafeBytes { documentOfSnapshot($0, sharesStrings: true) } }
+            guard htmlDoc != nil else { throw HTMLSnapshotError.invalidSnapshot }
+            try self.init(htmlDoc: htmlDoc, arena: arena)
+        } else {
+            let htmlDoc = data.withUnsafeBytes { documentOfSnapshot($0, sharesStrings: false) }
+            guard htmlDoc != nil else { throw HTMLSnapshotError.invalidSnapshot }
+            try self.init(htmlDoc: htmlDoc)
+        }
+    }
+    
+    /// Initializes and returns an HTMLDocument object loaded from a snapshot file into an arena.
+    /// The file is mapped into virtual memory if possible.
+    /// - Parameters:
+    ///   - url: The file URL of the snapshot.
+    /// - Returns: An initialized HTMLDocument object, if the file can't be read, the snapshot is invalid or initialization fails an error is thrown.
+    
+    convenience init(contentsOfSnapshot url: URL) throws
+    {
+        let data = try Data(contentsOf: url, options: .alwaysMapped)
+        try self.init(snapshotData: data)
+    }
+}
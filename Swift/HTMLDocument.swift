@@ -43,6 +43,311 @@ enum HTMLDocumentError: Error {
     case notHTML
     case couldNotParse
     case missingRootElement
+    case parserFinished
+}
+
+/// The way the contents of a file URL are passed to the parser.
+
+enum HTMLDocumentLoadingMode {
+    /// The file is read into memory.
+    case read
+    /// The file is mapped into virtual memory if possible.
+    case mapped
+    /// The parser reads the file descriptor in chunks.
+    case fileDescriptor
+}
+
+/// The options passed to the libxml2 parser, the raw values match the HTML_PARSE_* constants.
+
+struct HTMLParseOptions : OptionSet {
+    let rawValue : CInt
+    
+    /// Relaxed parsing.
+    static let recover   = HTMLParseOptions(rawValue: 1 << 0)
+    /// Suppress error reports.
+    static let noError   = HTMLParseOptions(rawValue: 1 << 5)
+    /// Suppress warning reports.
+    static let noWarning = HTMLParseOptions(rawValue: 1 << 6)
+    /// Remove ignorable whitespace-only text nodes.
+    static let noBlanks  = HTMLParseOptions(rawValue: 1 << 8)
+    /// Forbid network access.
+    static let noNet     = HTMLParseOptions(rawValue: 1 << 11)
+    /// Do not add implied html, head or body elements, content without html root element fails to initialize.
+    static let noImplied = HTMLParseOptions(rawValue: 1 << 13)
+    /// Store small text nodes inline to save memory, the text nodes must not be modified.
+    static let compact   = HTMLParseOptions(rawValue: 1 << 16)
+    
+    /// The options used by default: recover, noError and noWarning.
+    static let `default` : HTMLParseOptions = [.recover, .noError, .noWarning]
+}
+
+// Returns the IANA character set name of the string encoding which is passed to the libxml2 parser functions
+
+func convertStringEncoding(_ encoding: String.Encoding) -> UnsafePointer<CChar>?
+{
+    let cfEncoding = CFStringConvertNSStringEncodingToEncoding(encoding.rawValue)
+    let cfEncodingAsString = CFStringConvertEncodingToIANACharSetName(cfEncoding)
+    return CFStringGetCStringPtr(cfEncodingAsString, 0)
+}
+
+// MARK: - arena
+
+// The arena hands out the memory of its chunks in increasing order, free() is a no-op and realloc() grows the last allocation in place.
+// The chunks are aligned to their size and registered in a bitmap of the address space, so the libxml2 free and realloc functions
+// recognize arena pointers by address alone. Pointers allocated with malloc() before the functions were installed remain valid.
+// The bitmap is modified under the mutex only, its leaves and words are read with atomic loads without lock (see HTMLAtomics.h):
+// the bit of a chunk is set before any of its pointers is handed out and cleared after the last one has been given up,
+// concurrent changes only affect the bits of other chunks.
+
+private let arenaBlockShift = 18                            // 256 KB, the size and alignment of a chunk
+private let arenaBlockSize = 1 << arenaBlockShift
+private let arenaAddressBits = 48
+private let arenaLeafShift = 15                             // the blocks per leaf of the bitmap
+private let arenaNumberOfLeaves = 1 << (arenaAddressBits - arenaBlockShift - arenaLeafShift)
+private let arenaAlignment = 16
+private let arenaHeaderSize = 16                            // the size of each allocation precedes it, padded to the alignment
+private let arenaChunkHeaderSize = 16                       // the next chunk and the size of the chunk
+private let arenaLargeAllocation = arenaBlockSize / 4       // larger allocations get a chunk of their own
+private let arenaCachedChunks = 32                          // the freed chunks kept for the next arenas
+
+private struct HTMLArenaState {
+    var chunks : UnsafeMutableRawPointer?   // the current chunk first
+    var cursor : UnsafeMutableRawPointer?   // the next free byte of the current chunk
+    var limit : UnsafeMutableRawPointer?    // the end of the current chunk
+}
+
+// the process wide state of the allocation functions, allocated once and never freed
+private struct HTMLArenaRegistry {
+    var mutex = pthread_mutex_t()
+    var blockMap : UnsafeMutablePointer<UnsafeMutablePointer<UInt64>?>  // the leaves are created on demand
+    var cachedChunks : UnsafeMutableRawPointer?                         // the chunks of freed arenas stay registered
+    var numberOfCachedChunks = 0
+}
+
+private let arenaRegistry : UnsafeMutablePointer<HTMLArenaRegistry> = {
+    let blockMap = UnsafeMutablePointer<UnsafeMutablePointer<UInt64>?>.allocate(capacity: arenaNumberOfLeaves)
+    blockMap.initialize(repeating: nil, count: arenaNumberOfLeaves)
+    let registry = UnsafeMutablePointer<HTMLArenaRegistry>.allocate(capacity: 1)
+    registry.initialize(to: HTMLArenaRegistry(blockMap: blockMap))
+    pthread_mutex_init(&registry.pointee.mutex, nil)
+    return registry
+}()
+
+// the key of the current arena of a thread
+private let arenaKey : pthread_key_t = {
+    var key = pthread_key_t()
+    pthread_key_create(&key, nil)
+    return key
+}()
+
+private func alignedLength(_ size: Int) -> Int {
+    return (arenaHeaderSize + size + arenaAlignment - 1) & ~(arenaAlignment - 1)
+}
+
+private func chunkNext(_ chunk: UnsafeMutableRawPointer) -> UnsafeMutablePointer<UnsafeMutableRawPointer?> {
+    return chunk.assumingMemoryBound(to: UnsafeMutableRawPointer?.self)
+}
+
+private func chunkSize(_ chunk: UnsafeMutableRawPointer) -> UnsafeMutablePointer<Int> {
+    return (chunk + MemoryLayout<UnsafeMutableRawPointer?>.stride).assumingMemoryBound(to: Int.self)
+}
+
+private func allocationSize(_ pointer: UnsafeMutableRawPointer) -> UnsafeMutablePointer<Int> {
+    return (pointer - arenaHeaderSize).assumingMemoryBound(to: Int.self)
+}
+
+private func isArenaPointer(_ pointer: UnsafeRawPointer) -> Bool {
+    let block = UInt(bitPattern: pointer) >> UInt(arenaBlockShift)
+    guard block < 1 << UInt(arenaAddressBits - arenaBlockShift),
+        let leaf = HTMLAtomicLoadLeaf(arenaRegistry.pointee.blockMap + Int(block >> UInt(arenaLeafShift))) else { return false }
+    
+    let bit = Int(block) & ((1 << arenaLeafShift) - 1)
+    return (HTMLAtomicLoadWord(leaf + bit / 64) >> UInt64(bit % 64)) & 1 == 1
+}
+
+// called with the locked mutex
+private func markArenaBlock(_ chunk: UnsafeRawPointer, _ isArena: Bool) -> Bool {
+    let block = UInt(bitPattern: chunk) >> UInt(arenaBlockShift)
+    guard block < 1 << UInt(arenaAddressBits - arenaBlockShift) else { return false }
+    
+    let slot = arenaRegistry.pointee.blockMap + Int(block >> UInt(arenaLeafShift))
+    var leaf = HTMLAtomicLoadLeaf(slot)
+    if leaf == nil {
+        guard let newLeaf = calloc((1 << arenaLeafShift) / 64, MemoryLayout<UInt64>.stride) else { return false }
+        leaf = newLeaf.assumingMemoryBound(to: UInt64.self)
+        HTMLAtomicStoreLeaf(slot, leaf)
+    }
+    let bit = Int(block) & ((1 << arenaLeafShift) - 1)
+    if isArena {
+        HTMLAtomicSetBits(leaf! + bit / 64, 1 << UInt64(bit % 64))
+    } else {
+        HTMLAtomicClearBits(leaf! + bit / 64, 1 << UInt64(bit % 64))
+    }
+    return true
+}
+
+// Adds a chunk for small allocations which becomes the current chunk, or a chunk for one large allocation
+private func arenaAddChunk(_ arena: UnsafeMutablePointer<HTMLArenaState>, size: Int, isLarge: Bool) -> UnsafeMutableRawPointer? {
+    let (sum, overflow) = (size + arenaChunkHeaderSize).addingReportingOverflow(arenaBlockSize - 1)
+    guard !overflow else { return nil }
+    let size = sum & ~(arenaBlockSize - 1)
+    
+    var chunk : UnsafeMutableRawPointer?
+    pthread_mutex_lock(&arenaRegistry.pointee.mutex)
+    if size == arenaBlockSize, let cachedChunk = arenaRegistry.pointee.cachedChunks {
+        arenaRegistry.pointee.cachedChunks = chunkNext(cachedChunk).pointee
+        arenaRegistry.pointee.numberOfCachedChunks -= 1
+        chunk = cachedChunk
+    } else if posix_memalign(&chunk, arenaBlockSize, size) == 0, let newChunk = chunk {
+        if markArenaBlock(newChunk, true) {
+            chunkSize(newChunk).pointee = size
+        } else {
+            free(newChunk)
+            chunk = nil
+        }
+    } else {
+        chunk = nil
+    }
+    pthread_mutex_unlock(&arenaRegistry.pointee.mutex)
+    guard let newChunk = chunk else { return nil }
+    
+    if isLarge, let current = arena.pointee.chunks {
+        // a large chunk is inserted behind the current chunk which keeps its free space
+        chunkNext(newChunk).pointee = chunkNext(current).pointee
+        chunkNext(current).pointee = newChunk
+    } else if isLarge {
+        chunkNext(newChunk).pointee = nil
+        arena.pointee.chunks = newChunk
+        arena.pointee.cursor = nil // no free space, the next small allocation adds a chunk
+        arena.pointee.limit = nil
+    } else {
+        chunkNext(newChunk).pointee = arena.pointee.chunks
+        arena.pointee.chunks = newChunk
+        arena.pointee.cursor = newChunk + arenaChunkHeaderSize
+        arena.pointee.limit = newChunk + size
+    }
+    return newChunk
+}
+
+private func arenaAllocate(_ arena: UnsafeMutablePointer<HTMLArenaState>, _ size: Int) -> UnsafeMutableRawPointer? {
+    guard size >= 0, size < Int.max - arenaHeaderSize - arenaAlignment else { return nil }
+    let length = alignedLength(size)
+    
+    let header : UnsafeMutableRawPointer
+    if length >= arenaLargeAllocation {
+        guard let chunk = arenaAddChunk(arena, size: length, isLarge: true) else { return nil }
+        header = chunk + arenaChunkHeaderSize
+    } else {
+        if arena.pointee.cursor == nil || arena.pointee.cursor!.distance(to: arena.pointee.limit!) < length {
+            guard arenaAddChunk(arena, size: 0, isLarge: false) != nil else { return nil }
+        }
+        header = arena.pointee.cursor!
+        arena.pointee.cursor = header + length
+    }
+    let pointer = header + arenaHeaderSize
+    allocationSize(pointer).pointee = size
+    return pointer
+}
+
+// the allocation functions installed in libxml2, without current arena they forward to the malloc functions
+
+private let arenaMalloc : xmlMallocFunc = { size in
+    guard let arena = pthread_getspecific(arenaKey) else { return malloc(size) }
+    return arenaAllocate(arena.assumingMemoryBound(to: HTMLArenaState.self), size)
+}
+
+private let arenaFree : xmlFreeFunc = { pointer in
+    guard let pointer = pointer, !isArenaPointer(pointer) else { return }
+    free(pointer)
+}
+
+private let arenaRealloc : xmlReallocFunc = { pointer, size in
+    guard let pointer = pointer else { return arenaMalloc(size) }
+    guard isArenaPointer(pointer) else { return realloc(pointer, size) } // a malloc block stays a malloc block
+    
+    let oldSize = allocationSize(pointer).pointee
+    if let arena = pthread_getspecific(arenaKey)?.assumingMemoryBound(to: HTMLArenaState.self), size >= 0, size < arenaLargeAllocation {
+        // grow or shrink the last allocation of the current chunk in place
+        let header = pointer - arenaHeaderSize
+        let newLength = alignedLength(size)
+        if header + alignedLength(oldSize) == arena.pointee.cursor, header.distance(to: arena.pointee.limit!) >= newLength {
+            arena.pointee.cursor = header + newLength
+            allocationSize(pointer).pointee = size
+            return pointer
+        }
+    }
+    guard let newPointer = arenaMalloc(size) else { return nil }
+    newPointer.copyMemory(from: pointer, byteCount: min(oldSize, size))
+    return newPointer
+}
+
+private let arenaStrdup : xmlStrdupFunc = { string in
+    guard let string = string else { return nil }
+    let length = Int(strlen(string)) + 1
+    guard let copy = arenaMalloc(length) else { return nil }
+    copy.copyMemory(from: string, byteCount: length)
+    return copy.assumingMemoryBound(to: CChar.self)
+}
+
+// libxml2 calls the functions through global pointers, they must be set before the parser is initialized on several threads
+private let arenaFunctionsInstalled : Bool = {
+    _ = arenaRegistry
+    _ = arenaKey
+    let installed = xmlMemSetup(arenaFree, arenaMalloc, arenaRealloc, arenaStrdup) == 0
+    xmlInitParser()
+    return installed
+}()
+
+/// A bump allocator the libxml2 allocations of one document are taken from while it's current, see `HTMLParser.usesArena`.
+/// The memory is released in one step when the arena is deallocated, a document allocated in the arena must not be freed with xmlFreeDoc().
+
+final class HTMLArena {
+    
+    private let state : UnsafeMutablePointer<HTMLArenaState>
+    
+    /// Initializes and returns an empty arena. The first arena installs arena aware allocation functions in libxml2 with xmlMemSetup(),
+    /// they forward to malloc() if no arena is current.
+    /// - Returns: An initialized HTMLArena object, or nil if the functions could not be installed.
+    
+    init?() {
+        guard arenaFunctionsInstalled else { return nil }
+        state = UnsafeMutablePointer<HTMLArenaState>.allocate(capacity: 1)
+        state.initialize(to: HTMLArenaState())
+    }
+    
+    deinit {
+        var chunk = state.pointee.chunks
+        while let currentChunk = chunk {
+            chunk = chunkNext(currentChunk).pointee
+            pthread_mutex_lock(&arenaRegistry.pointee.mutex)
+            if chunkSize(currentChunk).pointee == arenaBlockSize && arenaRegistry.pointee.numberOfCachedChunks < arenaCachedChunks {
+                chunkNext(currentChunk).pointee = arenaRegistry.pointee.cachedChunks
+                arenaRegistry.pointee.cachedChunks = currentChunk
+                arenaRegistry.pointee.numberOfCachedChunks += 1
+            } else {
+                _ = markArenaBlock(currentChunk, false)
+                free(currentChunk)
+            }
+            pthread_mutex_unlock(&arenaRegistry.pointee.mutex)
+        }
+        state.deinitialize(count: 1)
+        state.deallocate()
+    }
+    
+    /// Calls the closure with the arena as target of the libxml2 allocations on the current thread.
+    /// - Parameters:
+    ///   - body: The closure whose libxml2 allocations are taken from the arena.
+    /// - Returns: The value returned by the closure.
+    
+    func perform<T>(_ body: () throws -> T) rethrows -> T {
+        let previousArena = pthread_getspecific(arenaKey)
+        pthread_setspecific(arenaKey, state)
+        defer {
+            xmlResetLastError() // the last error of the thread must not reference arena memory
+            pthread_setspecific(arenaKey, previousArena)
+        }
+        return try body()
+    }
 }
 
 class HTMLDocument {
@@ -57,9 +362,11 @@ class HTMLDocument {
     
     let htmlDoc: htmlDocPtr
     
-    /// The root node.
+    /// The root node, a new node object for each access. The nodes retain their document, the document doesn't retain any node.
     
-    let rootNode: HTMLNode
+    var rootNode: HTMLNode {
+        return HTMLNode(pointer: xmlDocGetRootElement(htmlDoc))!
+    }
     
     /// The head node.
     
@@ -79,52 +386,207 @@ class HTMLDocument {
         return head?.child(ofTag:"title")?.stringValue
     }
     
+    /// Enables an index of the element nodes by id, class token and tag name. The index is built lazily in one pass by the first query
+    /// and answers the descendant queries by id, class and tag name of all nodes in the document without walking the tree.
+    /// Disabling the index frees its memory. The default is false.
+    
+    var isIndexingEnabled : Bool {
+        get {
+            indexLock.lock()
+            defer { indexLock.unlock() }
+            return indexingEnabled
+        }
+        set {
+            indexLock.lock()
+            defer { indexLock.unlock() }
+            indexingEnabled = newValue
+            if !newValue { index = nil }
+        }
+    }
+    
+    /// The node index, built on first access if indexing is enabled, otherwise nil.
+    
+    var nodeIndex : HTMLNodeIndex? {
+        indexLock.lock()
+        defer { indexLock.unlock() }
+        if indexingEnabled && index == nil && !isClosed {
+            index = HTMLNodeIndex(document: htmlDoc)
+        }
+        return index
+    }
+    
+    private var indexingEnabled = false
+    private var index : HTMLNodeIndex?
+    private let indexLock = NSLock()
+    
+    /// Numbers the elements in document order once with `xmlXPathOrderDocElems`, the numbers are stored in the unused content fields of the elements.
+    /// Afterwards the document order of two elements and the sorting of the node sets of XPath queries take O(1) per comparison.
+    /// Called on demand by the document order functions of HTMLNode, the numbers of elements added to the tree later are missing.
+    
+    func prepareDocumentOrder() {
+        indexLock.lock()
+        defer { indexLock.unlock() }
+        guard !elementsOrdered && !isClosed else { return }
+        xmlXPathOrderDocElems(htmlDoc)
+        elementsOrdered = true
+    }
+    
+    private var elementsOrdered = false
+    
+    /// Calls the closure with the XPath context of the document. The context is created on first use and reused by all XPath queries
+    /// of the nodes of the document, the calls are serialized. The context must not be used outside of the closure.
+    /// - Parameters:
+    ///   - body: The closure called with the context, or with nil if the context couldn't be created.
+    /// - Returns: The value returned by the closure.
+    
+    func withXPathContext<T>(_ body: (xmlXPathContextPtr?) throws -> T) rethrows -> T {
+        xpathContextLock.lock()
+        defer { xpathContextLock.unlock() }
+        if isClosed { return try body(nil) }
+        if xpathContext == nil {
+            xpathContext = xmlXPathNewContext(htmlDoc)
+        }
+        return try body(xpathContext)
+    }
+    
+    private var xpathContext : xmlXPathContextPtr?
+    private let xpathContextLock = NSLock()
+    
+    // the arena the tree is allocated in, it's released instead of freeing the tree node by node
+    private var arena : HTMLArena?
+    
+    // set by closeDocument() while both locks are held
+    private var isClosed = false
+    
+    // the parse measurement of the instrumentation, see metrics
+    var parseMeasurement : (parseTime: TimeInterval, inputLength: Int) = (0, 0)
+    
+    /// Frees the tree, the node index and the XPath context immediately instead of when the document and the last of its nodes are released,
+    /// e.g. at the end of each work item of a high-throughput worker. Neither the document nor any of its nodes must be used afterwards.
+    
+    func closeDocument() {
+        xpathContextLock.lock()
+        defer { xpathContextLock.unlock() }
+        indexLock.lock()
+        defer { indexLock.unlock() }
+        guard !isClosed else { return }
+        
+        isClosed = true
+        index = nil
+        if let context = xpathContext { xmlXPathFreeContext(context) }
+        xpathContext = nil
+        htmlDoc.pointee._private = nil
+        if arena == nil { xmlFreeDoc(htmlDoc) }
+        arena = nil
+    }
+    
     // MARK: - Initialzers
     
     // default text encoding is UTF-8
     
-    /// Initializes and returns an HTMLDocument object created from an Data object with specified string encoding.
+    /// Initializes and returns an HTMLDocument object created from an Data object with specified string encoding and parse options.
     /// - Parameters:
     ///   - data: A data object with HTML content.
     ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
     /// - Returns: An initialized HTMLDocument object, if initialization fails an error is thrown.
     
-    init(data: Data?, encoding: String.Encoding = .utf8) throws // designated initializer
+    convenience init(data: Data?, encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default) throws
     {
         guard let htmlData = data else { throw HTMLDocumentError.invalidData }
         guard !htmlData.isEmpty else { throw HTMLDocumentError.dataEmpty }
         
-        let cfEncoding = CFStringConvertNSStringEncodingToEncoding(encoding.rawValue)
-        let cfEncodingAsString = CFStringConvertEncodingToIANACharSetName(cfEncoding)
-        let cEncoding = CFStringGetCStringPtr(cfEncodingAsString, 0)
+        let cEncoding = convertStringEncoding(encoding)
         
-        let htmlParseOptions : CInt = 1 << 0 | 1 << 5 | 1 << 6 // HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING
-        let cCharacters = htmlData.withUnsafeBytes { (bytes: UnsafePointer<Int8>) -> [CChar] in
-            let buffer = UnsafeBufferPointer(start: bytes, count: htmlData.count)
-            return [CChar](buffer)
+        guard htmlData.count <= Int(CInt.max) else { throw HTMLDocumentError.invalidData }
+        
+        // libxml2 reads the bytes of the data object in place, no intermediate copy is needed
+        let (htmlDoc, parseTime) = measureParse {
+            htmlData.withUnsafeBytes { (buffer: UnsafeRawBufferPointer) -> htmlDocPtr? in
+                let bytes = buffer.baseAddress!.assumingMemoryBound(to: CChar.self)
+                return htmlReadMemory(bytes, CInt(buffer.count), nil, cEncoding, options.rawValue)
+            }
         }
         
-        guard let htmlDoc = htmlReadMemory(cCharacters, CInt(htmlData.count), nil, cEncoding, htmlParseOptions) else { throw HTMLDocumentError.couldNotParse }
-        guard let xmlDocRootNode = xmlDocGetRootElement(htmlDoc) else { throw HTMLDocumentError.missingRootElement }
+        try self.init(htmlDoc: htmlDoc)
+        if let parseTime = parseTime { parseMeasurement = (parseTime, htmlData.count) }
+    }
+    
+    /// Initializes and returns an HTMLDocument object for an already parsed libxml2 document.
+    /// The document takes ownership of the pointer and frees it also if initialization fails.
+    /// - Parameters:
+    ///   - htmlDoc: A document pointer created by one of the libxml2 parser functions.
+    ///   - arena: The arena the document was allocated in (optional, default is nil for a document allocated with malloc()).
+    ///            The arena is released with the document instead of freeing the tree node by node.
+    /// - Returns: An initialized HTMLDocument object, if initialization fails an error is thrown.
+    
+    init(htmlDoc: htmlDocPtr?, arena: HTMLArena? = nil) throws // designated initializer
+    {
+        guard let htmlDoc = htmlDoc else { throw HTMLDocumentError.couldNotParse }
+        guard let xmlDocRootNode = xmlDocGetRootElement(htmlDoc) else {
+            if arena == nil { xmlFreeDoc(htmlDoc) }
+            throw HTMLDocumentError.missingRootElement
+        }
         if let docRootNodeName = String.decodeCString(xmlDocRootNode.pointee.name, as: UTF8.self, repairingInvalidCodeUnits: false)?.result,
             docRootNodeName == "html" {
             self.htmlDoc = htmlDoc
-            self.rootNode = HTMLNode(pointer: xmlDocRootNode)!
+            self.arena = arena
+            htmlDoc.pointee._private = Unmanaged.passUnretained(self).toOpaque() // back reference retained by the nodes
         } else {
+            if arena == nil { xmlFreeDoc(htmlDoc) }
             throw HTMLDocumentError.notHTML
         }
     }
     
-    /// Initializes and returns an HTMLDocument object created from the HTML contents of a URL-referenced source with specified string encoding.
+    /// Initializes and returns an HTMLDocument object created from the HTML contents of a URL-referenced source with specified string encoding and loading mode.
     /// - Parameters:
     ///   - url: An URL object specifying a URL source.
     ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - loadingMode: The way the contents of a file URL are passed to the parser (optional, default is mapped). Other URLs are always read into memory.
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
     /// - Returns: An initialized HTMLDocument object, or an error is thrown.
     
-    convenience init(contentsOf url: URL, encoding: String.Encoding = .utf8) throws
+    convenience init(contentsOf url: URL, encoding: String.Encoding = .utf8, loadingMode: HTMLDocumentLoadingMode = .mapped, options: HTMLParseOptions = .default) throws
     {
-        let data = try Data(contentsOf: url)
-        try self.init(data:data, encoding:encoding)
+        guard url.isFileURL else {
+            let data = try Data(contentsOf: url)
+            try self.init(data:data, encoding:encoding, options:options)
+            return
+        }
+        switch loadingMode {
+        case .read:
+            let data = try Data(contentsOf: url)
+            try self.init(data:data, encoding:encoding, options:options)
+            
+        case .mapped:
+            try self.init(mappedContentsOf: url, encoding:encoding, options:options)
+            
+        case .fileDescriptor:
+            let fd = open(url.path, O_RDONLY)
+            guard fd >= 0 else { throw POSIXError(POSIXErrorCode(rawValue: errno) ?? .EIO) }
+            defer { close(fd) }
+            
+            var fileStatus = stat()
+            if fstat(fd, &fileStatus) == 0 && fileStatus.st_size == 0 { throw HTMLDocumentError.dataEmpty }
+            
+            let (htmlDoc, parseTime) = measureParse { htmlReadFd(fd, nil, convertStringEncoding(encoding), options.rawValue) }
+            try self.init(htmlDoc: htmlDoc)
+            if let parseTime = parseTime { parseMeasurement = (parseTime, Int(fileStatus.st_size)) }
+        }
+    }
+    
+    /// Initializes and returns an HTMLDocument object created from the HTML contents of a local file with specified string encoding.
+    /// The file is mapped into virtual memory and parsed in place rather than read into a buffer.
+    /// - Parameters:
+    ///   - url: A file URL specifying the HTML source.
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
+    /// - Returns: An initialized HTMLDocument object, or an error is thrown.
+    
+    convenience init(mappedContentsOf url: URL, encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default) throws
+    {
+        let data = try Data(contentsOf: url, options: .alwaysMapped)
+        try self.init(data:data, encoding:encoding, options:options)
     }
     
     /// Initializes and returns an HTMLDocument object created from a string containing HTML markup text with specified string encoding.
@@ -138,4 +600,12 @@ class HTMLDocument {
     {
         try self.init(data: string.data(using: encoding), encoding:encoding)
     }
+    
+    deinit {
+        // no node references the document any more
+        guard !isClosed else { return }
+        if let xpathContext = xpathContext { xmlXPathFreeContext(xpathContext) }
+        htmlDoc.pointee._private = nil
+        if arena == nil { xmlFreeDoc(htmlDoc) } // the arena is released with the properties
+    }
 }
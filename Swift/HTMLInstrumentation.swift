@@ -0,0 +1,301 @@
+/*###################################################################################
+ #                                                                                   #
+ #    HTMLInstrumentation.swift - Timing, counters and signposts                     #
+ #                                                                                   #
+ #    Copyright © 2014-2017 by Stefan Klieme                                         #
+ #                                                                                   #
+ #    Swift wrapper for HTML parser of libxml2                                       #
+ #                                                                                   #
+ #    Version 1.1 - 13. Sep 2017                                                     #
+ #                                                                                   #
+ #    usage:     add libxml2.dylib to frameworks (depends on autoload settings)      #
+ #               add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths   #
+ #               add -lxml2 to target -> other linker flags                          #
+ #               add Bridging-Header.h to your project and rename it as              #
+ #                  [Modulename]-Bridging-Header.h                                   #
+ #                  where [Modulename] is the module name in your project            #
+ #                  or copy&paste the #import lines into your bridging header        #
+ #                                                                                   #
+ #####################################################################################
+ #                                                                                   #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+ # this software and associated documentation files (the "Software"), to deal        #
+ # in the Software without restriction, including without limitation the rights      #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+ # of the Software, and to permit persons to whom the Software is furnished to do    #
+ # so, subject to the following conditions:                                          #
+ # The above copyright notice and this permission notice shall be included in        #
+ # all copies or substantial portions of the Software.                               #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+ #                                                                                   #
+ ###################################################################################*/
+
+import Foundation
+#if canImport(os)
+import os
+#endif
+
+// The instrumentation measures the parsing of documents and the queries of nodes in production code.
+// It's disabled by default, while it's disabled each hook costs one test of a flag. While it's enabled
+// each query is counted and timed, and os_signpost intervals of the subsystem com.klieme.HTMLDocument
+// are emitted around parsing and queries for Instruments.
+
+/// The kinds of queries counted separately.
+
+enum HTMLQueryKind : Int, CaseIterable {
+    /// The tag, attribute, class name, sequence and batch queries of HTMLNode, queries answered by the node index aren't counted.
+    case search
+    /// The XPath queries of HTMLNode+XPath.
+    case xpath
+    /// The selector queries of HTMLNode+CSS.
+    case css
+}
+
+/// The totals of the queries of one kind since the instrumentation was enabled or reset.
+
+struct HTMLQueryCounters {
+    /// The number of queries.
+    var calls = 0
+    /// The nodes the queries compared, XPath queries are evaluated by libxml2 and visit none.
+    var nodesVisited = 0
+    /// The nodes matching the queries, the queries for the first node stop at the first match.
+    var matches = 0
+    /// The HTMLNode objects created by the queries.
+    var wrappersAllocated = 0
+    /// The time spent in the queries, lazy sequences are measured from the creation of the iterator to its end.
+    var duration : TimeInterval = 0
+}
+
+/// The measurements of one document.
+
+struct HTMLDocumentMetrics {
+    /// The duration of the parser call, 0 if the document wasn't parsed while the instrumentation was enabled.
+    var parseTime : TimeInterval = 0
+    /// The length of the parsed bytes, 0 if unknown like parseTime.
+    var inputLength = 0
+    /// All nodes of the tree except attributes.
+    var numberOfNodes = 0
+    var numberOfElements = 0
+    var numberOfAttributes = 0
+    /// The bytes of the node structures and their strings, names shared in the dictionary of the document aren't included.
+    var estimatedTreeMemory = 0
+}
+
+// the flag is toggled while other threads parse and query, the storage is accessed atomically by the HTMLAtomics.h functions
+private let instrumentationFlag : UnsafeMutablePointer<Bool> = {
+    let flag = UnsafeMutablePointer<Bool>.allocate(capacity: 1)
+    flag.initialize(to: false)
+    return flag
+}()
+
+// read by the hooks
+var htmlInstrumentationEnabled : Bool {
+    return HTMLAtomicLoadFlag(instrumentationFlag)
+}
+
+private var queryCounters = [HTMLQueryCounters](repeating: HTMLQueryCounters(), count: HTMLQueryKind.allCases.count)
+private let queryCountersLock = NSLock()
+
+enum HTMLInstrumentation {
+    
+    /// Enables or disables the instrumentation of all documents and queries, the counters are kept.
+    
+    static var isEnabled : Bool {
+        get { return htmlInstrumentationEnabled }
+        set { HTMLAtomicStoreFlag(instrumentationFlag, newValue) }
+    }
+    
+    /// Returns the totals of one kind of queries.
+    /// - Parameters:
+    ///   - kind: The kind of the queries.
+    /// - Returns: The counters of all threads.
+    
+    static func counters(for kind: HTMLQueryKind) -> HTMLQueryCounters {
+        queryCountersLock.lock()
+        defer { queryCountersLock.unlock() }
+        return queryCounters[kind.rawValue]
+    }
+    
+    /// Sets all query counters to zero.
+    
+    static func reset() {
+        queryCountersLock.lock()
+        defer { queryCountersLock.unlock() }
+        for kind in HTMLQueryKind.allCases { queryCounters[kind.rawValue] = HTMLQueryCounters() }
+    }
+}
+
+// MARK: - signposts
+
+#if canImport(os)
+private let signpostLog = OSLog(subsystem: "com.klieme.HTMLDocument", category: "PointsOfInterest")
+#endif
+
+// the names of the intervals must be static strings
+private func signpostName(_ kind: HTMLQueryKind?) -> StaticString {
+    switch kind {
+    case .search?: return "Search"
+    case .xpath?: return "XPath"
+    case .css?: return "CSS"
+    case nil: return "Parse"
+    }
+}
+
+// Emits the begin of an interval, returns the raw signpost ID or 0 if signposts aren't recorded
+private func beginSignpost(_ kind: HTMLQueryKind?) -> UInt64 {
+    #if canImport(os)
+    if #available(macOS 10.14, iOS 12.0, tvOS 12.0, watchOS 5.0, *), signpostLog.signpostsEnabled {
+        let signpostID = OSSignpostID(log: signpostLog)
+        os_signpost(.begin, log: signpostLog, name: signpostName(kind), signpostID: signpostID)
+        return signpostID.rawValue
+    }
+    #endif
+    return 0
+}
+
+private func endSignpost(_ kind: HTMLQueryKind?, _ rawID: UInt64, visited: Int = 0, matches: Int = 0) {
+    #if canImport(os)
+    guard rawID != 0 else { return }
+    if #available(macOS 10.14, iOS 12.0, tvOS 12.0, watchOS 5.0, *) {
+        let signpostID = OSSignpostID(rawID)
+        if kind == nil {
+            os_signpost(.end, log: signpostLog, name: signpostName(kind), signpostID: signpostID)
+        } else {
+            os_signpost(.end, log: signpostLog, name: signpostName(kind), signpostID: signpostID, "visited %ld, matches %ld", visited, matches)
+        }
+    }
+    #endif
+}
+
+// MARK: - hooks of the library
+
+/// The measurement of one query, the counts are taken while the query runs and added to the totals when it ends.
+/// The interval ends explicitly or when it's released, e.g. with an iterator which isn't iterated to the end.
+
+final class HTMLQueryInterval {
+    
+    let kind : HTMLQueryKind
+    var nodesVisited = 0
+    var matches = 0
+    var wrappersAllocated = 0
+    
+    private let start = DispatchTime.now().uptimeNanoseconds
+    private let signpostID : UInt64
+    private var isEnded = false
+    
+    private init(kind: HTMLQueryKind) {
+        self.kind = kind
+        self.signpostID = beginSignpost(kind)
+    }
+    
+    /// Starts the measurement of a query.
+    /// - Parameters:
+    ///   - kind: The kind of the query.
+    /// - Returns: The interval or nil if the instrumentation is disabled.
+    
+    static func begin(_ kind: HTMLQueryKind) -> HTMLQueryInterval? {
+        return htmlInstrumentationEnabled ? HTMLQueryInterval(kind: kind) : nil
+    }
+    
+    func end() {
+        guard !isEnded else { return }
+        isEnded = true
+        let duration = TimeInterval(DispatchTime.now().uptimeNanoseconds - start) / TimeInterval(NSEC_PER_SEC)
+        
+        queryCountersLock.lock()
+        queryCounters[kind.rawValue].calls += 1
+        queryCounters[kind.rawValue].nodesVisited += nodesVisited
+        queryCounters[kind.rawValue].matches += matches
+        queryCounters[kind.rawValue].wrappersAllocated += wrappersAllocated
+        queryCounters[kind.rawValue].duration += duration
+        queryCountersLock.unlock()
+        endSignpost(kind, signpostID, visited: nodesVisited, matches: matches)
+    }
+    
+    deinit {
+        end()
+    }
+}
+
+/// Measures a parser call.
+/// - Parameters:
+///   - parse: The closure calling the parser.
+/// - Returns: The result of the parser and its duration or nil if the instrumentation is disabled.
+
+func measureParse<T>(_ parse: () throws -> T) rethrows -> (result: T, parseTime: TimeInterval?) {
+    guard htmlInstrumentationEnabled else { return (try parse(), nil) }
+    
+    let signpostID = beginSignpost(nil)
+    let start = DispatchTime.now().uptimeNanoseconds
+    defer { endSignpost(nil, signpostID) }
+    let result = try parse()
+    return (result, TimeInterval(DispatchTime.now().uptimeNanoseconds - start) / TimeInterval(NSEC_PER_SEC))
+}
+
+// MARK: - document metrics
+
+// the bytes of a string owned by the node, names from the dictionary are shared
+private func stringMemory(_ string: UnsafePointer<xmlChar>?, _ dict: xmlDictPtr?) -> Int {
+    guard let string = string else { return 0 }
+    if let dict = dict, xmlDictOwns(dict, string) == 1 { return 0 }
+    return Int(xmlStrlen(string)) + 1
+}
+
+extension HTMLDocument {
+    
+    /// The measurements of the document, the counts walk the whole tree on every call.
+    
+    var metrics : HTMLDocumentMetrics {
+        var metrics = HTMLDocumentMetrics()
+        metrics.parseTime = parseMeasurement.parseTime
+        metrics.inputLength = parseMeasurement.inputLength
+        
+        let dict = htmlDoc.pointee.dict
+        var memory = MemoryLayout<xmlDoc>.size + stringMemory(htmlDoc.pointee.URL, nil) + stringMemory(htmlDoc.pointee.encoding, nil)
+        
+        let root = UnsafeMutableRawPointer(htmlDoc).assumingMemoryBound(to: xmlNode.self)
+        var iterator = HTMLNodeSequence(root: root, scope: .descendants, kind: nil).makeIterator()
+        while let node = iterator.nextPointer() {
+            metrics.numberOfNodes += 1
+            switch node.pointee.type {
+            case XML_ELEMENT_NODE:
+                metrics.numberOfElements += 1
+                memory += MemoryLayout<xmlNode>.size + stringMemory(node.pointee.name, dict)
+                var attribute = node.pointee.properties
+                while let attr = attribute {
+                    metrics.numberOfAttributes += 1
+                    memory += MemoryLayout<xmlAttr>.size + stringMemory(attr.pointee.name, dict)
+                    var child = attr.pointee.children
+                    while let text = child {
+                        memory += MemoryLayout<xmlNode>.size + stringMemory(text.pointee.content, dict)
+                        child = text.pointee.next
+                    }
+                    attribute = attr.pointee.next
+                }
+                
+            case XML_TEXT_NODE, XML_CDATA_SECTION_NODE, XML_COMMENT_NODE, XML_PI_NODE:
+                // the names of text and comment nodes are static strings, compact text nodes store their content inline
+                if node.pointee.type == XML_PI_NODE { memory += stringMemory(node.pointee.name, dict) }
+                memory += MemoryLayout<xmlNode>.size
+                let inlineContent = UnsafeMutableRawPointer(node) + MemoryLayout<xmlNode>.offset(of: \xmlNode.properties)!
+                if let content = node.pointee.content, UnsafeMutableRawPointer(content) != inlineContent {
+                    memory += stringMemory(content, dict)
+                }
+                
+            case XML_DTD_NODE:
+                memory += MemoryLayout<xmlDtd>.size
+                
+            default:
+                // the declarations of the DTD have structures of their own, the size of a node is an approximation
+                memory += MemoryLayout<xmlNode>.size
+            }
+        }
+        metrics.estimatedTreeMemory = memory
+        return metrics
+    }
+}
@@ -0,0 +1,554 @@
+/*###################################################################################
+ #                                                                                   #
+ #    HTMLNode+CSS.swift - Extension for HTMLNode                                    #
+ #                                                                                   #
+ #    Copyright © 2014-2017 by Stefan Klieme                                         #
+ #                                                                                   #
+ #    Swift wrapper for HTML parser of libxml2                                       #
+ #                                                                                   #
+ #    Version 1.1 - 13. Sep 2017                                                     #
+ #                                                                                   #
+ #    usage:     add libxml2.dylib to frameworks (depends on autoload settings)      #
+ #               add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths   #
+ #               add -lxml2 to target -> other linker flags                          #
+ #               add Bridging-Header.h to your project and rename it as              #
+ #                  [Modulename]-Bridging-Header.h                                   #
+ #                  where [Modulename] is the module name in your project            #
+ #                  or copy&paste the #import lines into your bridging header        #
+ #                                                                                   #
+ #####################################################################################
+ #                                                                                   #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+ # this software and associated documentation files (the "Software"), to deal        #
+ # in the Software without restriction, including without limitation the rights      #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+ # of the Software, and to permit persons to whom the Software is furnished to do    #
+ # so, subject to the following conditions:                                          #
+ # The above copyright notice and this permission notice shall be included in        #
+ # all copies or substantial portions of the Software.                               #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+ #                                                                                   #
+ ###################################################################################*/
+
+import Foundation
+
+enum CSSSelectorError: Error {
+    case invalidSelector(String, Int) // reason and position
+}
+
+/// A compiled CSS selector. The selector string is parsed once and the object can be reused for any number of queries,
+/// it's immutable and may be shared between threads. The nodes are matched from right to left directly on the libxml2 tree.
+///
+/// Supported syntax:
+/// - type selectors and *, #id, .class
+/// - [attr], [attr=value], [attr~=value], [attr|=value], [attr^=value], [attr$=value], [attr*=value]
+/// - :nth-child(an+b | odd | even), :nth-last-child(...), :first-child, :last-child
+/// - the combinators descendant (whitespace), child (>), adjacent sibling (+) and general sibling (~)
+/// - comma separated selector lists
+///
+/// Tag and attribute names are compared case-insensitively, attribute values case-sensitively.
+
+final class HTMLSelector : CustomStringConvertible {
+    
+    fileprivate enum Combinator {
+        case none, descendant, child, adjacentSibling, generalSibling
+    }
+    
+    fileprivate enum Operator {
+        case exists, equals, includes, dashMatch, prefix, suffix, substring
+    }
+    
+    // names and values are null-terminated UTF-8 arrays passed directly to the libxml2 string functions
+    
+    fileprivate struct AttributeCondition {
+        let name : [xmlChar]
+        let value : [xmlChar]
+        let op : Operator
+        var valueLength : Int { return value.count - 1 }
+    }
+    
+    // one compound selector like div.item[title]:nth-child(2n+1)
+    
+    fileprivate struct Compound {
+        var tagName : [xmlChar]?
+        var attributes = [AttributeCondition]()
+        var nth : (a: Int, b: Int, fromEnd: Bool)?
+        var combinator = Combinator.none
+    }
+    
+    /// The selector string.
+    
+    let selectorString : String
+    
+    // the complex selectors of the list, each with its compound selectors from left to right
+    private let complexes : [[Compound]]
+    
+    /// Initializes and returns a compiled selector.
+    /// - Parameters:
+    ///   - string: The CSS selector string.
+    /// - Returns: A compiled selector, a CSSSelectorError is thrown if the string isn't a valid or supported selector.
+    
+    init(_ string: String) throws {
+        var parser = SelectorParser(string)
+        self.complexes = try parser.parseSelectorList()
+        self.selectorString = string
+    }
+    
+    var description : String {
+        return "HTMLSelector: \(selectorString)"
+    }
+    
+    /// Returns whether a node matches the selector.
+    /// - Parameters:
+    ///   - node: The node to test.
+    /// - Returns: true if the node is an element matching any selector of the list.
+    
+    func matches(_ node: HTMLNode) -> Bool {
+        return matches(node.pointer)
+    }
+    
+    // the predicate of the node sequences
+    
+    fileprivate func matches(_ nodePtr: xmlNodePtr) -> Bool {
+        guard nodePtr.pointee.type == XML_ELEMENT_NODE else { return false }
+        for compounds in complexes where matches(nodePtr, compounds: compounds, at: compounds.count - 1) {
+            return true
+        }
+        return false
+    }
+    
+    // MARK: - right to left matching
+    
+    private func matches(_ nodePtr: xmlNodePtr, compounds: [Compound], at index: Int) -> Bool {
+        let compound = compounds[index]
+        guard matches(nodePtr, compound: compound) else { return false }
+        if index == 0 { return true }
+        
+        switch compound.combinator {
+        case .child:
+            guard let parent = parentElement(of: nodePtr) else { return false }
+            return matches(parent, compounds: compounds, at: index - 1)
+            
+        case .descendant:
+            var ancestor = parentElement(of: nodePtr)
+            while let currentNode = ancestor {
+                if matches(currentNode, compounds: compounds, at: index - 1) { return true }
+                ancestor = parentElement(of: currentNode)
+            }
+            return false
+            
+        case .adjacentSibling:
+            guard let sibling = previousElementSibling(of: nodePtr) else { return false }
+            return matches(sibling, compounds: compounds, at: index - 1)
+            
+        case .generalSibling:
+            var sibling = previousElementSibling(of: nodePtr)
+            while let currentNode = sibling {
+                if matches(currentNode, compounds: compounds, at: index - 1) { return true }
+                sibling = previousElementSibling(of: currentNode)
+            }
+            return false
+            
+        case .none:
+            return false
+        }
+    }
+    
+    private func matches(_ nodePtr: xmlNodePtr, compound: Compound) -> Bool {
+        guard nodePtr.pointee.type == XML_ELEMENT_NODE else { return false }
+        if let tagName = compound.tagName,
+            tagName.withUnsafeBufferPointer({ xmlStrcasecmp(nodePtr.pointee.name, $0.baseAddress) }) != 0 { return false }
+        
+        for attribute in compound.attributes where !matches(nodePtr, attribute: attribute) {
+            return false
+        }
+        
+        if let nth = compound.nth {
+            var position = 1
+            var sibling = nth.fromEnd ? nodePtr.pointee.next : nodePtr.pointee.prev
+            while let currentNode = sibling {
+                if currentNode.pointee.type == XML_ELEMENT_NODE { position += 1 }
+                sibling = nth.fromEnd ? currentNode.pointee.next : currentNode.pointee.prev
+            }
+            if nth.a == 0 { return position == nth.b }
+            let steps = position - nth.b
+            return steps % nth.a == 0 && steps / nth.a >= 0
+        }
+        return true
+    }
+    
+    private func matches(_ nodePtr: xmlNodePtr, attribute condition: AttributeCondition) -> Bool {
+        var attribute = nodePtr.pointee.properties
+        while let attr = attribute {
+            if condition.name.withUnsafeBufferPointer({ xmlStrcasecmp(attr.pointee.name, $0.baseAddress) }) == 0 {
+                // an attribute without value like <input disabled> compares as empty string
+                let empty : [xmlChar] = [0]
+                return empty.withUnsafeBufferPointer { emptyString in
+                    condition.value.withUnsafeBufferPointer {
+                        compare(UnsafePointer(attr.pointee.children?.pointee.content) ?? emptyString.baseAddress!, with: $0.baseAddress!, condition)
+                    }
+                }
+            }
+            attribute = attr.pointee.next
+        }
+        return false
+    }
+    
+    private func compare(_ content: UnsafePointer<xmlChar>, with value: UnsafePointer<xmlChar>, _ condition: AttributeCondition) -> Bool {
+        let length = CInt(condition.valueLength)
+        
+        switch condition.op {
+        case .exists:
+            return true
+            
+        case .equals:
+            return xmlStrEqual(content, value) == 1
+            
+        case .includes:
+            guard length > 0 else { return false }
+            var token = content
+            while true {
+                token += strspn(UnsafeRawPointer(token).assumingMemoryBound(to: CChar.self), selectorWhitespace)
+                if token.pointee == 0 { return false }
+                let tokenLength = strcspn(UnsafeRawPointer(token).assumingMemoryBound(to: CChar.self), selectorWhitespace)
+                if tokenLength == Int(length) && memcmp(token, value, tokenLength) == 0 { return true }
+                token += tokenLength
+            }
+            
+        case .dashMatch:
+            return xmlStrncmp(content, value, length) == 0 && (content[Int(length)] == 0 || content[Int(length)] == UInt8(ascii: "-"))
+            
+        case .prefix:
+            return length > 0 && xmlStrncmp(content, value, length) == 0
+            
+        case .suffix:
+            let contentLength = xmlStrlen(content)
+            return length > 0 && contentLength >= length && xmlStrEqual(content + Int(contentLength - length), value) == 1
+            
+        case .substring:
+            return length > 0 && xmlStrstr(content, value) != nil
+        }
+    }
+    
+    private func parentElement(of nodePtr: xmlNodePtr) -> xmlNodePtr? {
+        guard let parent = nodePtr.pointee.parent, parent.pointee.type == XML_ELEMENT_NODE else { return nil }
+        return parent
+    }
+    
+    private func previousElementSibling(of nodePtr: xmlNodePtr) -> xmlNodePtr? {
+        var sibling = nodePtr.pointee.prev
+        while let currentNode = sibling {
+            if currentNode.pointee.type == XML_ELEMENT_NODE { return currentNode }
+            sibling = currentNode.pointee.prev
+        }
+        return nil
+    }
+}
+
+private let selectorWhitespace = " \t\n\u{0C}\r"
+
+// MARK: - selector parser
+
+private struct SelectorParser {
+    
+    private let bytes : [UInt8]
+    private var index = 0
+    
+    init(_ string: String) {
+        self.bytes = Array(string.utf8)
+    }
+    
+    private var current : UInt8 {
+        return index < bytes.count ? bytes[index] : 0
+    }
+    
+    private func character(at offset: Int) -> UInt8 {
+        return index + offset < bytes.count ? bytes[index + offset] : 0
+    }
+    
+    private func error(_ reason: String) -> CSSSelectorError {
+        return CSSSelectorError.invalidSelector(reason, index)
+    }
+    
+    private static func isWhitespace(_ c: UInt8) -> Bool {
+        return c == 0x20 || c == 0x09 || c == 0x0A || c == 0x0C || c == 0x0D
+    }
+    
+    private static func isIdentifierCharacter(_ c: UInt8) -> Bool {
+        switch c {
+        case UInt8(ascii: "a")...UInt8(ascii: "z"), UInt8(ascii: "A")...UInt8(ascii: "Z"), UInt8(ascii: "0")...UInt8(ascii: "9"),
+             UInt8(ascii: "-"), UInt8(ascii: "_"), UInt8(ascii: "\\"), 0x80...0xFF: return true
+        default: return false
+        }
+    }
+    
+    private mutating func skipWhitespace() {
+        while SelectorParser.isWhitespace(current) { index += 1 }
+    }
+    
+    private func hasPrefix(_ prefix: String) -> Bool {
+        let prefixBytes = Array(prefix.utf8)
+        guard index + prefixBytes.count <= bytes.count else { return false }
+        for (offset, c) in prefixBytes.enumerated() where bytes[index + offset] | 0x20 != c | 0x20 {
+            return false
+        }
+        return true
+    }
+    
+    // an identifier or a quoted string with resolved backslash escapes as null-terminated array
+    
+    private mutating func parseIdentifierOrString(allowString: Bool) throws -> [xmlChar] {
+        var result = [xmlChar]()
+        var quote : UInt8 = 0
+        
+        if allowString && (current == UInt8(ascii: "\"") || current == UInt8(ascii: "'")) {
+            quote = current
+            index += 1
+        } else if !SelectorParser.isIdentifierCharacter(current) {
+            throw error("Identifier expected")
+        }
+        
+        while current != 0 {
+            if quote != 0 {
+                if current == quote { break }
+            } else if !SelectorParser.isIdentifierCharacter(current) { break }
+            
+            if current == UInt8(ascii: "\\") && character(at: 1) != 0 { index += 1 }
+            result.append(current)
+            index += 1
+        }
+        if quote != 0 {
+            guard current == quote else { throw error("Unterminated string") }
+            index += 1
+        }
+        result.append(0)
+        return result
+    }
+    
+    private mutating func parseAttributeSelector(into compound: inout HTMLSelector.Compound) throws {
+        index += 1 // [
+        skipWhitespace()
+        let name = try parseIdentifierOrString(allowString: false)
+        skipWhitespace()
+        
+        let op : HTMLSelector.Operator
+        switch current {
+        case UInt8(ascii: "="): op = .equals
+        case UInt8(ascii: "~"): op = .includes
+        case UInt8(ascii: "|"): op = .dashMatch
+        case UInt8(ascii: "^"): op = .prefix
+        case UInt8(ascii: "$"): op = .suffix
+        case UInt8(ascii: "*"): op = .substring
+        case UInt8(ascii: "]"): op = .exists
+        default: throw error("Invalid attribute selector")
+        }
+        
+        var value : [xmlChar] = [0]
+        if op != .exists {
+            if op != .equals {
+                guard character(at: 1) == UInt8(ascii: "=") else { throw error("Invalid attribute operator") }
+                index += 1
+            }
+            index += 1
+            skipWhitespace()
+            value = try parseIdentifierOrString(allowString: true)
+            skipWhitespace()
+        }
+        guard current == UInt8(ascii: "]") else { throw error("] expected") }
+        index += 1
+        compound.attributes.append(HTMLSelector.AttributeCondition(name: name, value: value, op: op))
+    }
+    
+    // the values are limited to the range of Int32 like the int of the Objective-C version,
+    // so the arithmetic of the match can't overflow
+    
+    private mutating func parseInteger() throws -> Int? {
+        var value = 0, hasDigits = false
+        while current >= UInt8(ascii: "0") && current <= UInt8(ascii: "9") {
+            let digit = Int(current - UInt8(ascii: "0"))
+            guard value <= (Int(Int32.max) - digit) / 10 else { throw error("Invalid nth expression") }
+            value = value * 10 + digit
+            hasDigits = true
+            index += 1
+        }
+        return hasDigits ? value : nil
+    }
+    
+    // an+b, odd or even
+    
+    private mutating func parseNthExpression(fromEnd: Bool) throws -> (a: Int, b: Int, fromEnd: Bool) {
+        skipWhitespace()
+        var a = 0, b = 0
+        
+        if hasPrefix("odd") {
+            a = 2; b = 1
+            index += 3
+        } else if hasPrefix("even") {
+            a = 2; b = 0
+            index += 4
+        } else {
+            var sign = 1
+            if current == UInt8(ascii: "+") || current == UInt8(ascii: "-") {
+                if current == UInt8(ascii: "-") { sign = -1 }
+                index += 1
+            }
+            let number = try parseInteger()
+            if current | 0x20 == UInt8(ascii: "n") {
+                index += 1
+                a = sign * (number ?? 1)
+                skipWhitespace()
+                if current == UInt8(ascii: "+") || current == UInt8(ascii: "-") {
+                    let bSign = (current == UInt8(ascii: "-")) ? -1 : 1
+                    index += 1
+                    skipWhitespace()
+                    guard let offset = try parseInteger() else { throw error("Invalid nth expression") }
+                    b = bSign * offset
+                }
+            } else if let number = number {
+                b = sign * number
+            } else {
+                throw error("Invalid nth expression")
+            }
+        }
+        skipWhitespace()
+        guard current == UInt8(ascii: ")") else { throw error(") expected") }
+        index += 1
+        return (a, b, fromEnd)
+    }
+    
+    private mutating func parsePseudoClass(into compound: inout HTMLSelector.Compound) throws {
+        index += 1 // :
+        guard compound.nth == nil else { throw error("Only one structural pseudo-class per compound selector is supported") }
+        
+        if hasPrefix("nth-child(") {
+            index += 10
+            compound.nth = try parseNthExpression(fromEnd: false)
+        } else if hasPrefix("nth-last-child(") {
+            index += 15
+            compound.nth = try parseNthExpression(fromEnd: true)
+        } else if hasPrefix("first-child") && !SelectorParser.isIdentifierCharacter(character(at: 11)) {
+            index += 11
+            compound.nth = (0, 1, false)
+        } else if hasPrefix("last-child") && !SelectorParser.isIdentifierCharacter(character(at: 10)) {
+            index += 10
+            compound.nth = (0, 1, true)
+        } else {
+            throw error("Unsupported pseudo-class")
+        }
+    }
+    
+    private mutating func parseCompound(combinator: HTMLSelector.Combinator) throws -> HTMLSelector.Compound {
+        var compound = HTMLSelector.Compound()
+        compound.combinator = combinator
+        let start = index
+        
+        if current == UInt8(ascii: "*") {
+            index += 1
+        } else if SelectorParser.isIdentifierCharacter(current) {
+            compound.tagName = try parseIdentifierOrString(allowString: false)
+        }
+        
+        loop: while true {
+            switch current {
+            case UInt8(ascii: "#"), UInt8(ascii: "."):
+                let isID = current == UInt8(ascii: "#")
+                index += 1
+                let value = try parseIdentifierOrString(allowString: false)
+                let name = Array((isID ? AttributeKey.id : AttributeKey.`class`).utf8) + [0]
+                compound.attributes.append(HTMLSelector.AttributeCondition(name: name, value: value, op: isID ? .equals : .includes))
+            case UInt8(ascii: "["):
+                try parseAttributeSelector(into: &compound)
+            case UInt8(ascii: ":"):
+                try parsePseudoClass(into: &compound)
+            default:
+                break loop
+            }
+        }
+        guard index > start else { throw error("Selector expected") }
+        return compound
+    }
+    
+    mutating func parseSelectorList() throws -> [[HTMLSelector.Compound]] {
+        var complexes = [[HTMLSelector.Compound]]()
+        skipWhitespace()
+        
+        while true {
+            var compounds = [HTMLSelector.Compound]()
+            var combinator = HTMLSelector.Combinator.none
+            
+            while true {
+                compounds.append(try parseCompound(combinator: combinator))
+                
+                let end = index
+                skipWhitespace()
+                let c = current
+                if c == 0 || c == UInt8(ascii: ",") { break }
+                
+                switch c {
+                case UInt8(ascii: ">"), UInt8(ascii: "+"), UInt8(ascii: "~"):
+                    combinator = (c == UInt8(ascii: ">")) ? .child : (c == UInt8(ascii: "+")) ? .adjacentSibling : .generalSibling
+                    index += 1
+                    skipWhitespace()
+                default:
+                    guard index > end else { throw error("Unexpected character") }
+                    combinator = .descendant
+                }
+            }
+            complexes.append(compounds)
+            
+            if current == 0 { return complexes }
+            index += 1 // ,
+            skipWhitespace()
+        }
+    }
+}
+
+extension HTMLNode {
+    
+    // MARK: - CSS query methods, all methods consider the descendants of the node in document order
+    
+    /// Returns a lazy sequence of the descendant nodes matching a compiled selector.
+    /// - Parameters:
+    ///   - selector: The compiled selector.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(matching selector: HTMLSelector) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: .descendants, predicate: selector.matches, kind: .css)
+    }
+    
+    /// Returns the first descendant node matching a compiled selector.
+    /// - Parameters:
+    ///   - selector: The compiled selector.
+    /// - Returns: The first found descendant node or nil if no node matches the selector.
+    
+    func node(matching selector: HTMLSelector) -> HTMLNode?
+    {
+        return nodes(matching: selector).first
+    }
+    
+    /// Returns whether the node matches a compiled selector.
+    /// - Parameters:
+    ///   - selector: The compiled selector.
+    /// - Returns: true if the node matches the selector.
+    
+    func matches(_ selector: HTMLSelector) -> Bool
+    {
+        return selector.matches(pointer)
+    }
+    
+    /// Returns all descendant nodes matching a CSS selector string, the string is compiled on each call.
+    /// - Parameters:
+    ///   - selector: The CSS selector string.
+    /// - Returns: The array of all found descendant nodes or an empty array, a CSSSelectorError is thrown for an invalid selector.
+    
+    func nodes(forCSSSelector selector: String) throws -> [HTMLNode]
+    {
+        return Array(nodes(matching: try HTMLSelector(selector)))
+    }
+}
@@ -39,67 +39,219 @@ import Foundation
 
 enum XPathError: Error {
     case evaluationFailed(Int32, String)
+    case compilationFailed(Int32, String)
     case contextFailed
 }
 
+// the messages of the XPath errors 1200 - 1222 as defined in xpath.c of libxml2
+
+private let xpathErrorMessages = [
+    "Ok", "Number encoding", "Unfinished literal", "Start of literal", "Expected $ for variable reference",
+    "Undefined variable", "Invalid predicate", "Invalid expression", "Missing closing curly brace", "Unregistered function",
+    "Invalid operand", "Invalid type", "Invalid number of arguments", "Invalid context size", "Invalid context position",
+    "Memory allocation error", "Syntax error", "Resource error", "Sub resource error", "Undefined namespace prefix",
+    "Encoding error", "Char out of XML range", "Invalid or incomplete context"
+]
+
+// The first XPath error of one compilation or evaluation. The error hook of the XPath context writes it to the state
+// on the caller's stack, unlike the global structured error function the hook belongs to one context and parallel queries don't interfere
+
+private struct XPathErrorState {
+    var code : Int32 = 0
+    var message = "Unknown Error"
+    
+    static let callback : xmlStructuredErrorFunc = { (userData, errorPtr) in
+        guard let userData = userData, let error = errorPtr?.pointee else { return }
+        let state = userData.assumingMemoryBound(to: XPathErrorState.self)
+        guard state.pointee.code == 0, error.code > 1199 && error.code < 1223 else { return } // keep the first XPath error
+        
+        state.pointee.code = error.code
+        if let message = error.message {
+            state.pointee.message = String(cString: message).trimmingCharacters(in: CharacterSet.newlines)
+        } else {
+            // the errors passed to the hook of a context have no message, the code and position describe the error
+            let message = xpathErrorMessages[Int(error.code - 1200)]
+            state.pointee.message = (error.str1 != nil) ? "\(message) at position \(error.int1)" : message
+        }
+    }
+    
+    // Calls the closure with the error hook installed in the context
+    
+    mutating func capture<T>(in xpathContext: xmlXPathContextPtr, _ body: () throws -> T) rethrows -> T {
+        return try withUnsafeMutablePointer(to: &self) { state in
+            xpathContext.pointee.error = XPathErrorState.callback
+            xpathContext.pointee.userData = UnsafeMutableRawPointer(state)
+            defer {
+                xpathContext.pointee.error = nil
+                xpathContext.pointee.userData = nil
+            }
+            return try body()
+        }
+    }
+}
+
+/// A compiled XPath expression. The expression is compiled once and the object can be reused for any number of queries of any document.
+/// The query string methods of HTMLNode compile each string once per thread and keep the 64 most recently used expressions in a cache of the current thread.
+/// Like xmlXPathNodeEval expressions beginning with // or ./ are evaluated with the queried node as context node.
+
+final class HTMLXPathQuery : CustomStringConvertible {
+    
+    /// The XPath query string.
+    
+    let queryString : String
+    
+    /// The compiled expression, owned by the query object.
+    
+    let compiledExpression : xmlXPathCompExprPtr
+    
+    // true if the queried node is the context node of the evaluation
+    let isNodeRelative : Bool
+    
+    /// Initializes and returns a compiled XPath query.
+    /// - Parameters:
+    ///   - query: The XPath query string.
+    /// - Returns: A compiled query, a XPathError is thrown if the expression can't be compiled.
+    
+    init(_ query: String) throws {
+        // a temporary context reports the errors of the compilation to the hook
+        guard let xpathContext = xmlXPathNewContext(nil) else { throw XPathError.contextFailed }
+        defer { xmlXPathFreeContext(xpathContext) }
+        
+        var errorState = XPathErrorState()
+        let expression = errorState.capture(in: xpathContext) {
+            query.withXmlChar { xmlXPathCtxtCompile(xpathContext, $0) }
+        }
+        guard let compiledExpression = expression else { throw XPathError.compilationFailed(errorState.code, errorState.message) }
+        self.compiledExpression = compiledExpression
+        self.queryString = query
+        self.isNodeRelative = query.hasPrefix("//") || query.hasPrefix("./")
+    }
+    
+    deinit {
+        xmlXPathFreeCompExpr(compiledExpression)
+    }
+    
+    var description : String {
+        return "HTMLXPathQuery: \(queryString)"
+    }
+}
+
+// The least recently used cache of compiled queries of a thread
+
+private final class XPathQueryCache {
+    
+    private static let threadDictionaryKey = "com.klieme.HTMLXPathQueryCache"
+    private static let capacity = 64
+    
+    private var queries = [String : HTMLXPathQuery]()
+    private var order = [String]() // most recently used last
+    
+    static var current : XPathQueryCache {
+        let threadDictionary = Thread.current.threadDictionary
+        if let cache = threadDictionary[threadDictionaryKey] as? XPathQueryCache { return cache }
+        let cache = XPathQueryCache()
+        threadDictionary[threadDictionaryKey] = cache
+        return cache
+    }
+    
+    func query(for queryString: String) throws -> HTMLXPathQuery {
+        if let query = queries[queryString] {
+            if order.last != queryString, let index = order.firstIndex(of: queryString) {
+                order.remove(at: index)
+                order.append(queryString)
+            }
+            return query
+        }
+        let query = try HTMLXPathQuery(queryString)
+        if order.count == XPathQueryCache.capacity {
+            queries[order.removeFirst()] = nil
+        }
+        queries[queryString] = query
+        order.append(queryString)
+        return query
+    }
+}
+
 extension HTMLNode  {
     
-    // XPath format predicates
+    // XPath format predicates, the predicates with attribute values refer to the variable $value
     
     struct XPathPredicate {
         static var node: (String) -> String = { return "./descendant::\($0)" }
         static var nodeWith: (String, String) -> String = { return "//\($0)[@\($1)]" }
         static var attribute: (String) -> String = { return "//*[@\($0)]" }
-        static var attributeIsEqual: (String, String) -> String = { return "//*[@\($0) ='\($1)']" }
-        static var attributeBeginsWith: (String, String) -> String = { return "./*[starts-with(@\($0),'\($1)')]" }
-        static var attributeEndsWith: (String, String) -> String = { return "//*['\($1)' = substring(@\($0)@, string-length(@\($0))- string-length('\($1)') +1)]" }
-        static var attributeContains: (String, String) -> String = { return "//*[contains(@\($0),'\($1)')]" }
+        static var attributeIsEqual: (String) -> String = { return "//*[@\($0) = $value]" }
+        static var attributeBeginsWith: (String) -> String = { return "//*[starts-with(@\($0), $value)]" }
+        static var attributeEndsWith: (String) -> String = { return "//*[$value = substring(@\($0), string-length(@\($0)) - string-length($value) + 1)]" }
+        static var attributeContains: (String) -> String = { return "//*[contains(@\($0), $value)]" }
     }
     
     // performXPathQuery() Returns an array of HTMLNode objects if the query matches any nodes, otherwise an empty array
     
-    private func performXPathQuery(node : xmlNodePtr, query : String, returnSingleNode : Bool) throws -> [HTMLNode]
+    private func performXPathQuery(node : xmlNodePtr, query : String, value : String? = nil, returnSingleNode : Bool) throws -> [HTMLNode]
     {
-        let xmlDoc = node.pointee.doc
-        let xpathContext = xmlXPathNewContext(xmlDoc)
-        
-        guard xpathContext != nil else { throw XPathError.contextFailed }
-        defer { xmlXPathFreeContext(xpathContext!) }
-        
-        let xpathErrorCallBack : xmlStructuredErrorFunc = { (context, errorPtr) in
-            let node = Unmanaged<HTMLNode>.fromOpaque(context!).takeUnretainedValue()
-            let error = errorPtr!.pointee
-            let message = error.message!
-            node.xpathErrorCode = error.code
-            node.xpathErrorMessage = String(validatingUTF8: message)!.trimmingCharacters(in: CharacterSet.newlines)
+        let compiledQuery : HTMLXPathQuery
+        do {
+            compiledQuery = try XPathQueryCache.current.query(for: query)
+        } catch XPathError.compilationFailed(let code, let message) {
+            throw XPathError.evaluationFailed(code, message)
         }
+        return try evaluate(compiledQuery, node: node, value: value, returnSingleNode: returnSingleNode)
+    }
+    
+    // Evaluates a compiled query in the XPath context of the document of the node,
+    // nodes of documents not owned by an HTMLDocument object use a temporary context
+    
+    private func evaluate(_ query : HTMLXPathQuery, node : xmlNodePtr, value : String?, returnSingleNode : Bool) throws -> [HTMLNode]
+    {
+        let interval = HTMLQueryInterval.begin(.xpath)
+        defer { interval?.end() }
         
-        xmlSetStructuredErrorFunc(UnsafeMutableRawPointer(Unmanaged.passUnretained(self).toOpaque()), xpathErrorCallBack)
-        
-        defer { xmlSetStructuredErrorFunc(nil, nil) }
-        
-        let xpathObject = query.withXmlChar { xmlQuery -> xmlXPathObjectPtr? in
-            if (query.hasPrefix("//") || query.hasPrefix("./")) {
-                return xmlXPathNodeEval(node, xmlQuery, xpathContext)
-            } else {
-                return xmlXPathEvalExpression(xmlQuery, xpathContext)
+        let evaluation = { (context : xmlXPathContextPtr?) throws -> [HTMLNode] in
+            guard let xpathContext = context else { throw XPathError.contextFailed }
+            
+            xpathContext.pointee.node = query.isNodeRelative ? node : nil
+            xpathContext.pointee.contextSize = -1
+            xpathContext.pointee.proximityPosition = -1
+            if let value = value {
+                xmlXPathRegisterVariable(xpathContext, "value", value.withXmlChar { xmlXPathNewString($0) })
             }
-        }
-        
-        guard xpathObject != nil else { throw XPathError.evaluationFailed(xpathErrorCode, xpathErrorMessage) }
-        defer { xmlXPathFreeObject(xpathObject) }
-        
-        if let nodes = xpathObject!.pointee.nodesetval, nodes.pointee.nodeNr > 0, nodes.pointee.nodeTab != nil {
-            let nodesArray = UnsafeBufferPointer(start: nodes.pointee.nodeTab, count: Int(nodes.pointee.nodeNr))
-            if returnSingleNode {
-                if let node = HTMLNode(pointer:nodesArray[0]) {
-                    return [node]
+            defer {
+                if value != nil { xmlXPathRegisterVariable(xpathContext, "value", nil) }
+                xpathContext.pointee.node = nil
+            }
+            
+            var errorState = XPathErrorState()
+            let result = errorState.capture(in: xpathContext) { xmlXPathCompiledEval(query.compiledExpression, xpathContext) }
+            guard let xpathObject = result else {
+                throw XPathError.evaluationFailed(errorState.code, errorState.message)
+            }
+            defer { xmlXPathFreeObject(xpathObject) }
+            
+            if let nodes = xpathObject.pointee.nodesetval, nodes.pointee.nodeNr > 0, nodes.pointee.nodeTab != nil {
+                let nodesArray = UnsafeBufferPointer(start: nodes.pointee.nodeTab, count: Int(nodes.pointee.nodeNr))
+                if returnSingleNode {
+                    if let node = HTMLNode(pointer:nodesArray[0]) {
+                        interval?.matches = 1
+                        interval?.wrappersAllocated = 1
+                        return [node]
+                    }
+                } else {
+                    let wrappers = nodesArray.compactMap{ HTMLNode(pointer:$0) }
+                    interval?.matches = wrappers.count
+                    interval?.wrappersAllocated = wrappers.count
+                    return wrappers
                 }
-            } else {
-                return nodesArray.compactMap{ HTMLNode(pointer:$0) }
             }
+            return [HTMLNode]()
+        }
+        
+        if let document = owningDocument {
+            return try document.withXPathContext(evaluation)
         }
-        return [HTMLNode]()
+        let xpathContext = xmlXPathNewContext(node.pointee.doc)
+        defer { if let xpathContext = xpathContext { xmlXPathFreeContext(xpathContext) } }
+        return try evaluation(xpathContext)
     }
     
     
@@ -125,6 +277,26 @@ extension HTMLNode  {
         return try performXPathQuery(node: pointer, query: query, returnSingleNode: false)
     }
     
+    /// Returns the first descendant node for a compiled XPath query.
+    /// - Parameters:
+    ///   - query: The compiled XPath query.
+    /// - Returns:  The first found descendant node or nil if no node matches the parameters.
+    
+    func node(forXPath query : HTMLXPathQuery) throws -> HTMLNode?
+    {
+        return try evaluate(query, node: pointer, value: nil, returnSingleNode: true).first
+    }
+    
+    /// Returns all descendant nodes for a compiled XPath query.
+    /// - Parameters:
+    ///   - query: The compiled XPath query.
+    /// - Returns:  The array of all found descendant nodes or an empty array.
+    
+    func nodes(forXPath query : HTMLXPathQuery) throws -> [HTMLNode]
+    {
+        return try evaluate(query, node: pointer, value: nil, returnSingleNode: false)
+    }
+    
     // MARK: - specific XPath Query methods
     // Note: In the HTMLNode main class all appropriate query methods begin with descendant instead of node
     
@@ -180,7 +352,7 @@ extension HTMLNode  {
     
     func node(withAttribute attribute : String, matches value : String) throws -> HTMLNode?
     {
-        return try node(forXPath: XPathPredicate.attributeIsEqual(attribute, value))
+        return try performXPathQuery(node: pointer, query: XPathPredicate.attributeIsEqual(attribute), value: value, returnSingleNode: true).first
     }
     
     /// Returns all descendant nodes for a matching attribute name and matching attribute value.
@@ -191,7 +363,7 @@ extension HTMLNode  {
     
     func nodes(withAttribute attribute : String, matches value : String) throws -> [HTMLNode]
     {
-        return try nodes(forXPath: XPathPredicate.attributeIsEqual(attribute, value))
+        return try performXPathQuery(node: pointer, query: XPathPredicate.attributeIsEqual(attribute), value: value, returnSingleNode: false)
     }
     
     /// Returns the first descendant node for a matching attribute name and beginning of the attribute value.
@@ -202,7 +374,7 @@ extension HTMLNode  {
     
     func node(withAttribute attribute : String, beginsWith value : String) throws -> HTMLNode?
     {
-        return try node(forXPath: XPathPredicate.attributeBeginsWith(attribute, value))
+        return try performXPathQuery(node: pointer, query: XPathPredicate.attributeBeginsWith(attribute), value: value, returnSingleNode: true).first
     }
     
     /// Returns all descendant nodes for a matching attribute name and beginning of the attribute value.
@@ -213,7 +385,7 @@ extension HTMLNode  {
     
     func nodes(withAttribute attribute : String, beginsWith value : String) throws -> [HTMLNode]
     {
-        return try nodes(forXPath: XPathPredicate.attributeBeginsWith(attribute, value))
+        return try performXPathQuery(node: pointer, query: XPathPredicate.attributeBeginsWith(attribute), value: value, returnSingleNode: false)
     }
     
     /// Returns the first descendant node for a matching attribute name and ending of the attribute value.
@@ -224,7 +396,7 @@ extension HTMLNode  {
     
     func node(withAttribute attribute : String, endsWith value : String) throws -> HTMLNode?
     {
-        return try node(forXPath: XPathPredicate.attributeEndsWith(attribute, value))
+        return try performXPathQuery(node: pointer, query: XPathPredicate.attributeEndsWith(attribute), value: value, returnSingleNode: true).first
     }
     
     /// Returns all descendant nodes for a matching attribute name and ending of the attribute value.
@@ -235,7 +407,7 @@ extension HTMLNode  {
     
     func nodes(withAttribute attribute : String, endsWith value : String) throws -> [HTMLNode]
     {
-        return try nodes(forXPath: XPathPredicate.attributeEndsWith(attribute, value))
+        return try performXPathQuery(node: pointer, query: XPathPredicate.attributeEndsWith(attribute), value: value, returnSingleNode: false)
     }
     
     /// Returns the first descendant node for a matching attribute name and containing the attribute value.
@@ -246,7 +418,7 @@ extension HTMLNode  {
     
     func node(withAttribute attribute : String, contains value : String) throws -> HTMLNode?
     {
-        return try node(forXPath: XPathPredicate.attributeContains(attribute, value))
+        return try performXPathQuery(node: pointer, query: XPathPredicate.attributeContains(attribute), value: value, returnSingleNode: true).first
     }
     
     /// Returns all descendant nodes for a matching attribute name and containing the attribute value.
@@ -257,7 +429,7 @@ extension HTMLNode  {
     
     func nodes(withAttribute attribute : String, contains value : String) throws -> [HTMLNode]
     {
-        return try nodes(forXPath: XPathPredicate.attributeContains(attribute, value))
+        return try performXPathQuery(node: pointer, query: XPathPredicate.attributeContains(attribute), value: value, returnSingleNode: false)
     }
     
     /// Returns the first descendant node for a specified class name.
@@ -54,46 +54,82 @@ enum AttributeKey {
     static let src = "src"
 }
 
+// formatters are expensive to create, each thread keeps its own configured formatters, so no locking is needed.
+// The cache is emptied when it's full
+
+private let numberFormatterCacheKey = "com.klieme.HTMLNodeNumberFormatters"
+private let dateFormatterCacheKey = "com.klieme.HTMLNodeDateFormatters"
+private let formatterCacheSize = 16
+
+private func cachedFormatter<T : Formatter>(_ cacheKey: String, key: String, create: () -> T) -> T {
+    let threadDictionary = Thread.current.threadDictionary
+    let cache : NSMutableDictionary
+    if let existingCache = threadDictionary[cacheKey] as? NSMutableDictionary {
+        cache = existingCache
+    } else {
+        cache = NSMutableDictionary(capacity: formatterCacheSize)
+        threadDictionary[cacheKey] = cache
+    }
+    
+    if let formatter = cache[key] as? T { return formatter }
+    if cache.count == formatterCacheSize { cache.removeAllObjects() }
+    let formatter = create()
+    cache[key] = formatter
+    return formatter
+}
+
 extension String {
     
     func collapseCharacters(in characterSet: CharacterSet?, using separator: String) -> String
     {
         guard let charSet = characterSet else { return self }
-        let array = self.components(separatedBy: charSet)
-        let result = array.reduce("") { "\($0)\(separator)\($1)" }
-        return result
+        return self.components(separatedBy: charSet).filter { !$0.isEmpty }.joined(separator: separator)
     }
     
+    // collapses directly in the UTF-8 bytes of the string with the same whitespace and newline characters as the character set
+    
     func collapseWhitespaceAndNewLine() -> String
     {
-        return self.collapseCharacters(in: CharacterSet.whitespacesAndNewlines, using:" ")
+        return self.withCString { cString in
+            collapsedString(UnsafeRawPointer(cString).assumingMemoryBound(to: xmlChar.self), strlen(cString))
+        }
     }
     
     // ISO 639 identifier e.g. en_US or fr_CH
+    // the formatters are cached per thread by locale identifier and plus sign
     func doubleValue(forLocaleIdentifier localeIdentifier: String?, consideringPlusSign: Bool = false) -> Double?
     {
         if self.isEmpty { return nil }
-        let numberFormatter = NumberFormatter()
-        if let identifier = localeIdentifier {
-            let locale = Locale(identifier: identifier)
-            numberFormatter.locale = locale
-        }
-        if consideringPlusSign && self.hasPrefix("+") {
-            numberFormatter.positivePrefix = "+"
+        let plusSign = consideringPlusSign && self.hasPrefix("+")
+        let key = (localeIdentifier ?? "") + (plusSign ? "+" : "")
+        let numberFormatter = cachedFormatter(numberFormatterCacheKey, key: key) { () -> NumberFormatter in
+            let formatter = NumberFormatter()
+            if let identifier = localeIdentifier {
+                formatter.locale = Locale(identifier: identifier)
+            }
+            if plusSign {
+                formatter.positivePrefix = "+"
+            }
+            formatter.numberStyle = .decimal
+            return formatter
         }
-        numberFormatter.numberStyle = .decimal
         let number = numberFormatter.number(from: self)
         
         return number?.doubleValue
     }
     
     // date format e.g. @"yyyy-MM-dd 'at' HH:mm" --> 2001-01-02 at 13:00
+    // the formatters are cached per thread by date format and time zone
     func dateValue(withFormat format: String, timeZone: TimeZone?) -> Date?
     {
         if self.isEmpty { return nil }
-        let dateFormatter = DateFormatter()
-        dateFormatter.dateFormat = format
-        if timeZone != nil { dateFormatter.timeZone = timeZone }
+        let key = format + "\n" + (timeZone?.identifier ?? "")
+        let dateFormatter = cachedFormatter(dateFormatterCacheKey, key: key) { () -> DateFormatter in
+            let formatter = DateFormatter()
+            formatter.dateFormat = format
+            if timeZone != nil { formatter.timeZone = timeZone }
+            return formatter
+        }
         return dateFormatter.date(from: self)
     }
     
@@ -105,46 +141,893 @@ extension String {
     }
 }
 
-// helper class to make the pointers `xmlAttr` and `xmlNode` a sequence
+/// The scope of the nodes visited by an HTMLNodeSequence.
+
+enum HTMLNodeScope {
+    /// The first level of children.
+    case children
+    /// All descendants in document order.
+    case descendants
+    /// The following siblings.
+    case siblings
+}
+
+/// A lazy sequence of nodes in a specified scope of a node.
+/// The tree is walked iteratively while the sequence is iterated, so `first(where:)`, `prefix(_:)` or `lazy.filter`
+/// stop as soon as they have their result and deeply nested documents don't exhaust the stack.
+/// An HTMLNode object is created only for the nodes matching the predicate.
+/// Each iterator is measured as one query of the kind if the instrumentation is enabled, see `HTMLInstrumentation`.
+
+struct HTMLNodeSequence : Sequence {
+    
+    typealias Predicate = (xmlNodePtr) -> Bool
+    
+    private let root : xmlNodePtr
+    private let scope : HTMLNodeScope
+    private let predicate : Predicate?
+    private let kind : HTMLQueryKind?
+    
+    init(root: xmlNodePtr, scope: HTMLNodeScope, predicate: Predicate? = nil, kind: HTMLQueryKind? = .search) {
+        self.root = root
+        self.scope = scope
+        self.predicate = predicate
+        self.kind = kind
+    }
+    
+    /// The first node of the sequence or nil if the sequence is empty.
+    
+    var first : HTMLNode? {
+        var iterator = makeIterator()
+        return iterator.next()
+    }
+    
+    func makeIterator() -> Iterator {
+        return Iterator(root: root, scope: scope, predicate: predicate, kind: kind)
+    }
+    
+    struct Iterator : IteratorProtocol {
+        
+        private let root : xmlNodePtr
+        private let scope : HTMLNodeScope
+        private let predicate : Predicate?
+        private var current : xmlNodePtr?
+        private var interval : HTMLQueryInterval?
+        
+        fileprivate init(root: xmlNodePtr, scope: HTMLNodeScope, predicate: Predicate?, kind: HTMLQueryKind?) {
+            self.root = root
+            self.scope = scope
+            self.predicate = predicate
+            self.current = (scope == .siblings) ? root.pointee.next : root.pointee.children
+            if htmlInstrumentationEnabled, let kind = kind { self.interval = HTMLQueryInterval.begin(kind) }
+        }
+        
+        mutating func next() -> HTMLNode? {
+            guard let nodePtr = nextPointer() else { return nil }
+            interval?.wrappersAllocated += 1
+            return HTMLNode(pointer: nodePtr)
+        }
+        
+        // the next matching node without creating an HTMLNode object
+        
+        mutating func nextPointer() -> xmlNodePtr? {
+            while let nodePtr = current {
+                current = (scope == .descendants) ? nextNode(inSubtreeOf: nodePtr) : nodePtr.pointee.next
+                interval?.nodesVisited += 1
+                if predicate?(nodePtr) ?? true {
+                    interval?.matches += 1
+                    return nodePtr
+                }
+            }
+            interval?.end()
+            interval = nil
+            return nil
+        }
+        
+        // pre-order successor within the subtree of the root node
+        
+        private func nextNode(inSubtreeOf nodePtr: xmlNodePtr) -> xmlNodePtr? {
+            // the children of entity references are the entity declarations outside of the subtree
+            if let children = nodePtr.pointee.children, nodePtr.pointee.type != XML_ENTITY_REF_NODE { return children }
+            
+            var node : xmlNodePtr? = nodePtr
+            while let currentNode = node, currentNode != root {
+                if let next = currentNode.pointee.next { return next }
+                node = currentNode.pointee.parent
+            }
+            return nil
+        }
+    }
+}
+
+/// Index of the element nodes of a document by id, class token and tag name, see `HTMLDocument.isIndexingEnabled`.
+/// The nodes of each key are stored in document order, the preorder numbers locate the nodes of a subtree by binary search.
 
-private class XMLSequence<T> : Sequence {
+final class HTMLNodeIndex {
+    
+    private static let classWhitespace : Set<Character> = [" ", "\t", "\n", "\r", "\u{0C}"]
+    
+    private var ids = [String : [xmlNodePtr]]()
+    private var classes = [String : [xmlNodePtr]]()
+    private var tags = [String : [xmlNodePtr]]()
+    private var preorderNumbers = [xmlNodePtr : Int]()
+    
+    /// Creates the index of a document in one pass over the tree.
+    /// - Parameters:
+    ///   - document: The document pointer.
+    
+    init(document: htmlDocPtr) {
+        let root = UnsafeMutableRawPointer(document).assumingMemoryBound(to: xmlNode.self)
+        var iterator = HTMLNodeSequence(root: root, scope: .descendants, predicate: { $0.pointee.type == XML_ELEMENT_NODE }, kind: nil).makeIterator()
+        
+        while let nodePtr = iterator.nextPointer() {
+            preorderNumbers[nodePtr] = preorderNumbers.count
+            if let name = nodePtr.pointee.name {
+                tags[String(cString: name), default: []].append(nodePtr)
+            }
+            var attribute = nodePtr.pointee.properties
+            while let attr = attribute {
+                if let content = attr.pointee.children?.pointee.content {
+                    if xmlStrEqual(attr.pointee.name, "id") == 1 {
+                        ids[String(cString: content), default: []].append(nodePtr)
+                    } else if xmlStrEqual(attr.pointee.name, "class") == 1 {
+                        for token in Set(String(cString: content).split(whereSeparator: { HTMLNodeIndex.classWhitespace.contains($0) })) {
+                            classes[String(token), default: []].append(nodePtr)
+                        }
+                    }
+                }
+                attribute = attr.pointee.next
+            }
+        }
+    }
     
-    typealias Element = UnsafeMutablePointer<T>
-    var current: Element?
-    var next: Element? { return nil }
+    // the nodes with a specified id value within the subtree of an indexed element,
+    // returns nil if the node is not indexed
+    
+    func nodes(withID value: String, inSubtreeOf root: xmlNodePtr) -> ArraySlice<xmlNodePtr>? {
+        return nodes(ids[value], inSubtreeOf: root)
+    }
+    
+    // the candidates for a class value within the subtree of an indexed element,
+    // they contain the first class token of the value, the caller compares the whole value
+    
+    func nodes(withClass value: String, inSubtreeOf root: xmlNodePtr) -> ArraySlice<xmlNodePtr>? {
+        guard let token = value.split(whereSeparator: { HTMLNodeIndex.classWhitespace.contains($0) }).first else { return nil }
+        return nodes(classes[String(token)], inSubtreeOf: root)
+    }
+    
+    // the elements with a specified tag name within the subtree of an indexed element,
+    // returns nil also for the names of text and comment nodes which are not indexed
+    
+    func nodes(ofTag tag: String, inSubtreeOf root: xmlNodePtr) -> ArraySlice<xmlNodePtr>? {
+        guard tag != "text" && tag != "textnoenc" && tag != "comment" else { return nil }
+        return nodes(tags[tag], inSubtreeOf: root)
+    }
+    
+    private func nodes(_ list: [xmlNodePtr]?, inSubtreeOf root: xmlNodePtr) -> ArraySlice<xmlNodePtr>? {
+        guard let rootNumber = preorderNumbers[root] else { return nil }
+        guard let list = list else { return [] }
+        
+        // the last element in document order within the subtree
+        var lastNode = root
+        var child = root.pointee.last
+        while let currentNode = child {
+            if currentNode.pointee.type == XML_ELEMENT_NODE {
+                lastNode = currentNode
+                child = currentNode.pointee.last
+            } else {
+                child = currentNode.pointee.prev
+            }
+        }
+        let lastNumber = preorderNumbers[lastNode] ?? rootNumber
+        
+        var lower = 0, upper = list.count
+        while lower < upper {
+            let middle = lower + (upper - lower) / 2
+            if preorderNumbers[list[middle]]! <= rootNumber { lower = middle + 1 } else { upper = middle }
+        }
+        var end = lower
+        while end < list.count && preorderNumbers[list[end]]! <= lastNumber { end += 1 }
+        return list[lower..<end]
+    }
+}
+
+// predicates of the node sequences, names and values are converted once into null-terminated UTF-8 arrays
+
+private enum AttributeValueComparison {
+    case matches, contains, beginsWith, endsWith
+    
+    func compare(_ content: UnsafePointer<xmlChar>, with value: UnsafePointer<xmlChar>, length: CInt) -> Bool {
+        switch self {
+        case .matches: return xmlStrEqual(content, value) == 1
+        case .contains: return xmlStrstr(content, value) != nil
+        case .beginsWith: return xmlStrncmp(content, value, length) == 0
+        case .endsWith:
+            let contentLength = xmlStrlen(content)
+            return contentLength >= length && xmlStrEqual(content + Int(contentLength - length), value) == 1
+        }
+    }
+}
+
+private func xmlCharArray(from string: String) -> [xmlChar] {
+    return Array(string.utf8) + [0]
+}
+
+private func findAttribute(of nodePtr: xmlNodePtr, named name: UnsafePointer<xmlChar>) -> xmlAttrPtr? {
+    guard nodePtr.pointee.type == XML_ELEMENT_NODE else { return nil }
+    
+    var attribute = nodePtr.pointee.properties
+    while let attr = attribute {
+        if xmlStrEqual(attr.pointee.name, name) == 1 { return attr }
+        attribute = attr.pointee.next
+    }
+    return nil
+}
+
+private func nodeIsOfTag(_ tag: String) -> HTMLNodeSequence.Predicate {
+    let tagName = xmlCharArray(from: tag)
+    return { nodePtr in
+        guard let nodeName = nodePtr.pointee.name else { return false }
+        return tagName.withUnsafeBufferPointer { xmlStrEqual(nodeName, $0.baseAddress) == 1 }
+    }
+}
+
+private func nodeIsOfTag(_ tag: String, value: String, _ comparison: AttributeValueComparison) -> HTMLNodeSequence.Predicate {
+    let tagName = xmlCharArray(from: tag), tagValue = xmlCharArray(from: value)
+    let length = CInt(tagValue.count - 1)
+    return { nodePtr in
+        guard let nodeName = nodePtr.pointee.name,
+            tagName.withUnsafeBufferPointer({ xmlStrEqual(nodeName, $0.baseAddress) == 1 }),
+            let child = nodePtr.pointee.children, child.pointee.type != XML_ELEMENT_NODE,
+            let content = child.pointee.content else { return false }
+        return tagValue.withUnsafeBufferPointer { comparison.compare(content, with: $0.baseAddress!, length: length) }
+    }
+}
+
+private func nodeHasAttribute(_ attribute: String) -> HTMLNodeSequence.Predicate {
+    let attributeName = xmlCharArray(from: attribute)
+    return { nodePtr in
+        return attributeName.withUnsafeBufferPointer { findAttribute(of: nodePtr, named: $0.baseAddress!) != nil }
+    }
+}
+
+private func nodeHasAttribute(_ attribute: String, value: String, _ comparison: AttributeValueComparison) -> HTMLNodeSequence.Predicate {
+    let attributeName = xmlCharArray(from: attribute), attributeContent = xmlCharArray(from: value)
+    let length = CInt(attributeContent.count - 1)
+    return { nodePtr in
+        guard let attr = attributeName.withUnsafeBufferPointer({ findAttribute(of: nodePtr, named: $0.baseAddress!) }),
+            let content = attr.pointee.children?.pointee.content else { return false }
+        return attributeContent.withUnsafeBufferPointer { comparison.compare(content, with: $0.baseAddress!, length: length) }
+    }
+}
+
+// the required names of a class names query are split once, the class attributes are scanned in place
+// and the found names are ticked off in a bit mask; returns nil for an empty list or more than 64 names
+
+private let classTokenSeparators = " \t\n\u{0C}\r"
+
+private func nodeHasClassNames(_ classNames: String) -> HTMLNodeSequence.Predicate? {
+    let names = xmlCharArray(from: classNames)
+    var tokens = [(offset: Int, length: Int)]()
+    names.withUnsafeBufferPointer { buffer in
+        let start = UnsafeRawPointer(buffer.baseAddress!).assumingMemoryBound(to: CChar.self)
+        var offset = 0
+        while true {
+            offset += strspn(start + offset, classTokenSeparators)
+            guard start[offset] != 0 else { break }
+            let length = strcspn(start + offset, classTokenSeparators)
+            if !tokens.contains(where: { $0.length == length && memcmp(start + $0.offset, start + offset, length) == 0 }) {
+                tokens.append((offset, length))
+            }
+            offset += length
+        }
+    }
+    guard !tokens.isEmpty && tokens.count <= 64 else { return nil }
+    let required : UInt64 = tokens.count == 64 ? .max : (1 << UInt64(tokens.count)) - 1
+    let className = xmlCharArray(from: AttributeKey.`class`)
+    
+    return { nodePtr in
+        guard let attr = className.withUnsafeBufferPointer({ findAttribute(of: nodePtr, named: $0.baseAddress!) }),
+            let content = attr.pointee.children?.pointee.content else { return false }
+        return names.withUnsafeBufferPointer { buffer in
+            let start = UnsafeRawPointer(buffer.baseAddress!).assumingMemoryBound(to: CChar.self)
+            var token = UnsafeRawPointer(content).assumingMemoryBound(to: CChar.self)
+            var found : UInt64 = 0
+            while true {
+                token += strspn(token, classTokenSeparators)
+                guard token.pointee != 0 else { return false }
+                let length = strcspn(token, classTokenSeparators)
+                for (i, name) in tokens.enumerated() where name.length == length && found & (1 << UInt64(i)) == 0 && memcmp(start + name.offset, token, length) == 0 {
+                    found |= 1 << UInt64(i)
+                    if found == required { return true }
+                    break
+                }
+                token += length
+            }
+        }
+    }
+}
+
+// text extraction in one pass: the text nodes are visited once and appended to one buffer,
+// no subtree is concatenated twice and no intermediate string is created per node
+
+// the UTF-8 length of the whitespace or newline character at bytes or 0, the characters are those of
+// CharacterSet.whitespacesAndNewlines: tab, U+000A–U+000D, U+0085, U+2028, U+2029 and the space separators (Zs)
+
+private func whitespaceLength(_ bytes: UnsafePointer<xmlChar>, _ length: Int) -> Int {
+    guard length > 0 else { return 0 }
+    let c = bytes[0]
+    if c == 0x20 || (c >= 0x09 && c <= 0x0D) { return 1 }
+    if c < 0xC2 { return 0 }
+    if c == 0xC2 { return length >= 2 && (bytes[1] == 0x85 || bytes[1] == 0xA0) ? 2 : 0 }
+    guard length >= 3 else { return 0 }
+    switch (c, bytes[1], bytes[2]) {
+    case (0xE1, 0x9A, 0x80),                // U+1680
+         (0xE2, 0x80, 0x80...0x8A),         // U+2000–U+200A
+         (0xE2, 0x80, 0xA8), (0xE2, 0x80, 0xA9), (0xE2, 0x80, 0xAF), // U+2028, U+2029, U+202F
+         (0xE2, 0x81, 0x9F),                // U+205F
+         (0xE3, 0x80, 0x80):                // U+3000
+        return 3
+    default:
+        return 0
+    }
+}
+
+// the range of bytes without leading and trailing whitespace and newline characters
+
+private func trimmedRange(_ bytes: UnsafePointer<xmlChar>, _ length: Int) -> Range<Int> {
+    var start = 0, end = length
+    while start < end {
+        let whitespace = whitespaceLength(bytes + start, end - start)
+        if whitespace == 0 { break }
+        start += whitespace
+    }
+    // a whitespace character is at most 3 bytes long and its lead byte can't be a continuation byte
+    trailing: while end > start {
+        for whitespace in 1...min(3, end - start) where whitespaceLength(bytes + end - whitespace, whitespace) == whitespace {
+            end -= whitespace
+            continue trailing
+        }
+        break
+    }
+    return start..<end
+}
+
+// the length of the leading run of bytes without whitespace and newline characters.
+// The bytes are scanned 8 at a time as long as they are all printable ASCII characters (0x21–0x7F),
+// the high bit of a byte of (word - 0x21…) | word is set for bytes below 0x21 or above 0x7F
+
+private let swarOnes : UInt64 = 0x0101010101010101
+private let swarHighBits : UInt64 = 0x8080808080808080
+
+private func nonWhitespaceLength(_ bytes: UnsafePointer<xmlChar>, _ length: Int) -> Int {
+    var i = 0
+    while i < length {
+        if i + 8 <= length {
+            var word : UInt64 = 0
+            memcpy(&word, bytes + i, 8)
+            if ((word &- swarOnes &* 0x21) | word) & swarHighBits == 0 {
+                i += 8
+                continue
+            }
+        }
+        let c = bytes[i]
+        if (c <= 0x20 || c >= 0x80) && whitespaceLength(bytes + i, length - i) > 0 { break }
+        i += 1
+    }
+    return i
+}
+
+// appends the bytes with all runs of whitespace and newline characters collapsed into a single space,
+// a pending space is written only before the next non-whitespace character, so the result is trimmed.
+// The text begins at start of the buffer, whitespace before its first character is dropped
+
+private func appendCollapsingWhitespace(_ bytes: UnsafePointer<xmlChar>, _ length: Int, to buffer: inout [xmlChar], pendingSpace: inout Bool, startingAt start: Int = 0) {
+    var i = 0
+    while i < length {
+        let whitespace = whitespaceLength(bytes + i, length - i)
+        if whitespace > 0 {
+            if buffer.count > start { pendingSpace = true }
+            i += whitespace
+            continue
+        }
+        let run = nonWhitespaceLength(bytes + i, length - i)
+        if pendingSpace { buffer.append(0x20) }
+        pendingSpace = false
+        buffer.append(contentsOf: UnsafeBufferPointer(start: bytes + i, count: run))
+        i += run
+    }
+}
+
+// the string of the trimmed bytes, nil for invalid UTF-8 like String.decodeCString
+
+private func trimmedString(_ bytes: UnsafePointer<xmlChar>, length: Int) -> String? {
+    let range = trimmedRange(bytes, length)
+    return String(bytes: UnsafeBufferPointer(start: bytes + range.lowerBound, count: range.count), encoding: .utf8)
+}
+
+// the string of the trimmed and collapsed bytes
+
+private func collapsedString(_ bytes: UnsafePointer<xmlChar>, _ length: Int) -> String {
+    var buffer = [xmlChar]()
+    buffer.reserveCapacity(length)
+    var pendingSpace = false
+    appendCollapsingWhitespace(bytes, length, to: &buffer, pendingSpace: &pendingSpace)
+    return String(decoding: buffer, as: UTF8.self)
+}
+
+// parses a number in the UTF-8 bytes without locale: an optional sign, the digits with optional grouping separators,
+// the decimal separator, the fraction digits and an optional exponent. Leading and trailing whitespace is ignored
+
+private let numericCLocale = newlocale(LC_NUMERIC_MASK, "C", nil)
+
+// the bytes of the separators or nil if a separator isn't ASCII, UInt8(ascii:) traps on other scalars
+private func asciiSeparators(_ decimalSeparator: Unicode.Scalar, _ groupingSeparator: Unicode.Scalar?) -> (UInt8, UInt8?)? {
+    guard decimalSeparator.isASCII, groupingSeparator?.isASCII ?? true else { return nil }
+    return (UInt8(ascii: decimalSeparator), groupingSeparator.map { UInt8(ascii: $0) })
+}
+
+private func parseDouble(_ bytes: UnsafePointer<xmlChar>, _ length: Int, decimalSeparator: UInt8, groupingSeparator: UInt8?) -> Double? {
+    let range = trimmedRange(bytes, length)
+    // the normalized number in the C locale
+    var number = [CChar]()
+    number.reserveCapacity(range.count + 1)
+    var hasDigits = false, hasDecimalSeparator = false, hasExponent = false
+    
+    for i in range {
+        var c = bytes[i]
+        switch c {
+        case UInt8(ascii: "0")...UInt8(ascii: "9"):
+            hasDigits = true
+        case UInt8(ascii: "+"), UInt8(ascii: "-"):
+            if let last = number.last, last != CChar(UInt8(ascii: "e")) { return nil }
+        case decimalSeparator where !hasDecimalSeparator && !hasExponent:
+            hasDecimalSeparator = true
+            c = UInt8(ascii: ".")
+        case groupingSeparator where hasDigits && !hasDecimalSeparator && !hasExponent:
+            continue
+        case UInt8(ascii: "e"), UInt8(ascii: "E"):
+            guard hasDigits && !hasExponent else { return nil }
+            hasExponent = true
+            c = UInt8(ascii: "e")
+        default:
+            return nil
+        }
+        number.append(CChar(bitPattern: c))
+    }
+    guard hasDigits else { return nil }
+    number.append(0)
     
-    init(node: Element) { self.current = node }
+    return number.withUnsafeBufferPointer { buffer -> Double? in
+        var parsedEnd : UnsafeMutablePointer<CChar>? = nil
+        let value = strtod_l(buffer.baseAddress!, &parsedEnd, numericCLocale)
+        return parsedEnd?.pointee == 0 ? value : nil
+    }
+}
+
+// the trimmed content or nil for empty or whitespace only content
+
+private func trimmedTextContent(_ bytes: UnsafePointer<xmlChar>?, _ length: Int) -> String? {
+    guard let bytes = bytes, length > 0, let content = trimmedString(bytes, length: length), !content.isEmpty else { return nil }
+    return content
+}
+
+private func isTextNode(_ nodePtr: xmlNodePtr) -> Bool {
+    return nodePtr.pointee.type == XML_TEXT_NODE || nodePtr.pointee.type == XML_CDATA_SECTION_NODE
+}
+
+// the text and CDATA nodes of descendant-or-self in document order,
+// like xmlNodeGetContent only the children of elements are considered
+
+private func forEachTextNode(in root: xmlNodePtr, _ body: (xmlNodePtr) -> Void) {
+    var current : xmlNodePtr? = root
+    if isTextNode(root) { body(root); return }
     
-    func makeIterator() -> AnyIterator<UnsafeMutablePointer<T>> {
-        return AnyIterator {
-            guard let current = self.current else { return nil }
-            self.current = self.next
-            return current
+    while let nodePtr = current {
+        if let children = nodePtr.pointee.children, nodePtr.pointee.type == XML_ELEMENT_NODE || nodePtr == root {
+            current = children
+        } else {
+            var node = nodePtr
+            while node != root && node.pointee.next == nil { node = node.pointee.parent }
+            current = (node != root) ? node.pointee.next : nil
         }
+        if let textNode = current, isTextNode(textNode) { body(textNode) }
+    }
+}
+
+// the value of an HTML attribute is one text node and an empty attribute has none,
+// values of several nodes (entity references in XML documents) are concatenated like xmlGetProp
+
+private func borrowedAttributeValue(_ attr: xmlAttrPtr) -> UnsafePointer<xmlChar>? {
+    guard let child = attr.pointee.children else { return emptyAttributeValue }
+    guard child.pointee.next == nil, child.pointee.type == XML_TEXT_NODE, let content = child.pointee.content else { return nil }
+    return UnsafePointer(content)
+}
+
+private let emptyAttributeValue : UnsafePointer<xmlChar> = ("" as StaticString).utf8Start
+
+private func attributeValueString(_ attr: xmlAttrPtr) -> String? {
+    if let value = borrowedAttributeValue(attr) {
+        return String.decodeCString(value, as: UTF8.self, repairingInvalidCodeUnits: false)?.result
     }
+    guard let listValue = xmlNodeListGetString(attr.pointee.doc, attr.pointee.children, 1) else { return "" }
+    defer { xmlFree(listValue) }
+    return String.decodeCString(listValue, as: UTF8.self, repairingInvalidCodeUnits: false)?.result
 }
 
-private class XmlAttrSequence : XMLSequence<xmlAttr> {
+/// A borrowed view of an attribute, the name and the value point into the document and are valid as long as the document exists.
+
+struct HTMLAttributeView {
+    
+    /// The null-terminated UTF-8 name of the attribute.
     
-    override var next: Element? { return current?.pointee.next }
-    override init(node: Element) { super.init(node: node) }
+    let name : UnsafePointer<xmlChar>
+    
+    /// The null-terminated UTF-8 value of the attribute.
+    
+    let value : UnsafePointer<xmlChar>
+    
+    fileprivate init?(_ attr: xmlAttrPtr) {
+        guard let name = attr.pointee.name, let value = borrowedAttributeValue(attr) else { return nil }
+        self.name = name
+        self.value = value
+    }
+    
+    /// The UTF-8 bytes of the value without the terminating null.
+    
+    var valueBytes : UnsafeBufferPointer<xmlChar> {
+        return UnsafeBufferPointer(start: value, count: Int(xmlStrlen(value)))
+    }
+    
+    /// The name as string.
+    
+    var nameString : String {
+        return String(cString: name)
+    }
+    
+    /// The value as string.
+    
+    var valueString : String {
+        return String(cString: value)
+    }
+    
+    /// Returns true if the attribute has the name, compared in place.
+    
+    func hasName(_ attributeName : String) -> Bool {
+        return attributeName.withCString { xmlStrEqual(name, UnsafeRawPointer($0).assumingMemoryBound(to: xmlChar.self)) == 1 }
+    }
+    
+    /// Returns true if the value matches the string exactly, compared in place.
+    
+    func valueMatches(_ string : String) -> Bool {
+        return string.withCString { xmlStrEqual(value, UnsafeRawPointer($0).assumingMemoryBound(to: xmlChar.self)) == 1 }
+    }
 }
 
-private class XmlNodeSequence : XMLSequence<xmlNode> {
+// the write callbacks of the sinks of writeHTML, the context is the sink
+
+private let dataWriteCallback : xmlOutputWriteCallback = { context, buffer, length in
+    let data = context!.assumingMemoryBound(to: Data.self)
+    data.pointee.append(UnsafeRawPointer(buffer!).assumingMemoryBound(to: UInt8.self), count: Int(length))
+    return length
+}
+
+private let streamWriteCallback : xmlOutputWriteCallback = { context, buffer, length in
+    let stream = Unmanaged<OutputStream>.fromOpaque(context!).takeUnretainedValue()
+    let bytes = UnsafeRawPointer(buffer!).assumingMemoryBound(to: UInt8.self)
+    var written = 0
+    while written < Int(length) {
+        let result = stream.write(bytes + written, maxLength: Int(length) - written)
+        if result <= 0 { return -1 }
+        written += result
+    }
+    return length
+}
+
+private struct FileDescriptorSink {
+    let fileDescriptor : Int32
+    var errorNumber : Int32
+}
+
+private let fileDescriptorWriteCallback : xmlOutputWriteCallback = { context, buffer, length in
+    let sink = context!.assumingMemoryBound(to: FileDescriptorSink.self)
+    var written = 0
+    while written < Int(length) {
+        let result = write(sink.pointee.fileDescriptor, buffer! + written, Int(length) - written)
+        if result < 0 {
+            if errno == EINTR { continue }
+            sink.pointee.errorNumber = errno
+            return -1
+        }
+        written += result
+    }
+    return length
+}
+
+/// One query of a batch evaluated by `descendants(matching:)`, a node matches if it has the tag name and the attribute.
+/// A nil tag matches any node, a nil attribute any node of the tag.
+
+struct HTMLNodeQuery {
     
-    override var next: Element? { return current?.pointee.next }
-    override init(node: Element) { super.init(node: node) }
+    /// The comparison of the attribute value.
+    
+    enum Match {
+        case exists, matches, contains, beginsWith, endsWith
+    }
+    
+    let tag : String?
+    let attribute : String?
+    let match : Match
+    let value : String
+    let firstOnly : Bool
+    
+    /// Creates a query for a tag name and an attribute.
+    /// - Parameters:
+    ///   - tag: The name of the tag or nil for any tag.
+    ///   - attribute: The name of the attribute or nil for no attribute condition.
+    ///   - match: The comparison of the attribute value, `.exists` ignores the value.
+    ///   - value: The value compared with the value of the attribute.
+    ///   - firstOnly: true to find only the first matching node.
+    
+    init(tag: String? = nil, attribute: String? = nil, match: Match = .exists, value: String = "", firstOnly: Bool = false) {
+        self.tag = tag
+        self.attribute = attribute
+        self.match = match
+        self.value = value
+        self.firstOnly = firstOnly
+    }
+    
+    // the predicate combines the tag and attribute predicates, the strings are converted once per batch
+    
+    fileprivate var predicate : HTMLNodeSequence.Predicate {
+        var attributePredicate : HTMLNodeSequence.Predicate?
+        if let attribute = attribute {
+            switch match {
+            case .exists: attributePredicate = nodeHasAttribute(attribute)
+            case .matches: attributePredicate = nodeHasAttribute(attribute, value: value, .matches)
+            case .contains: attributePredicate = nodeHasAttribute(attribute, value: value, .contains)
+            case .beginsWith: attributePredicate = nodeHasAttribute(attribute, value: value, .beginsWith)
+            case .endsWith: attributePredicate = nodeHasAttribute(attribute, value: value, .endsWith)
+            }
+        }
+        switch (tag.map(nodeIsOfTag), attributePredicate) {
+        case let (isOfTag?, hasAttribute?): return { isOfTag($0) && hasAttribute($0) }
+        case let (isOfTag?, nil): return isOfTag
+        case let (nil, hasAttribute?): return hasAttribute
+        case (nil, nil): return { _ in true }
+        }
+    }
+}
+
+// the row following row (or the first row for nil) in document order, the rows are the tr children
+// of the table and of its thead, tbody and tfoot sections
+
+private func nextTableRow(after row: xmlNodePtr?, in table: xmlNodePtr) -> xmlNodePtr? {
+    var parent = row?.pointee.parent ?? table
+    var current = row.map { $0.pointee.next } ?? table.pointee.children
+    while true {
+        guard let nodePtr = current else {
+            guard parent != table else { return nil }
+            current = parent.pointee.next
+            parent = table
+            continue
+        }
+        if nodePtr.pointee.type == XML_ELEMENT_NODE {
+            if xmlStrEqual(nodePtr.pointee.name, "tr") == 1 { return nodePtr }
+            if parent == table, let children = nodePtr.pointee.children,
+                xmlStrEqual(nodePtr.pointee.name, "tbody") == 1 || xmlStrEqual(nodePtr.pointee.name, "thead") == 1 || xmlStrEqual(nodePtr.pointee.name, "tfoot") == 1 {
+                parent = nodePtr
+                current = children
+                continue
+            }
+        }
+        current = nodePtr.pointee.next
+    }
+}
+
+// the leading non-negative integer of a colspan or rowspan attribute or nil if it's missing or invalid
+
+private func spanAttribute(of cell: xmlNodePtr, named name: String) -> Int? {
+    guard let attr = findAttribute(of: cell, named: name), let value = borrowedAttributeValue(attr) else { return nil }
+    return value.withMemoryRebound(to: CChar.self, capacity: 1) { string -> Int? in
+        var end : UnsafeMutablePointer<CChar>? = nil
+        let span = strtol(string, &end, 10)
+        return (end == UnsafeMutablePointer(mutating: string) || span < 0) ? nil : span
+    }
 }
 
-class HTMLNode : Sequence, Equatable, CustomStringConvertible {
+/// The contents of a table element extracted in one pass: the text of each td and th cell is trimmed, collapsed and
+/// stored in one buffer, the slots of the rows and columns reference the cells. A cell spanning several rows or columns
+/// occupies all its slots, a rowspan is clipped at the last row of the table. The table doesn't reference the document.
+
+struct HTMLTable {
+    
+    /// The number of rows.
+    
+    let numberOfRows : Int
+    
+    /// The number of columns, the maximum number of slots of a row including the spans.
+    
+    let numberOfColumns : Int
+    
+    /// The number of leading rows in the thead section.
+    
+    let numberOfHeaderRows : Int
     
-    // MARK: Constants
+    // the texts of all cells in document order, the ranges of the cells and the cell index of each slot in row-major order
+    private let bytes : [xmlChar]
+    private let cells : [Range<Int>]
+    private let slots : [Int]
+    
+    private static let maximumColumnSpan = 1000
+    private static let maximumRowSpan = 65534
+    
+    /// Creates a table with the contents of a table element.
+    /// The rows are the tr children of the table and of its thead, tbody and tfoot sections, nested tables aren't considered.
+    /// - Parameters:
+    ///   - tableNode: The xmlNode pointer of the table element.
+    /// - Returns: The table or nil if the node is not a table element.
+    
+    init?(tableNode: xmlNodePtr) {
+        guard tableNode.pointee.type == XML_ELEMENT_NODE, xmlStrEqual(tableNode.pointee.name, "table") == 1 else { return nil }
+        
+        var bytes = [xmlChar]()
+        var cells = [Range<Int>]()
+        var placements = [(row: Int, column: Int, rowSpan: Int, columnSpan: Int)]()
+        // the number of following rows still occupied by a rowspan of each column
+        var pendingRows = [Int]()
+        var rowCount = 0, columnCount = 0, headerRowCount = 0
+        var headerRows = true
+        
+        var currentRow = nextTableRow(after: nil, in: tableNode)
+        while let row = currentRow {
+            var column = 0
+            var currentCell = row.pointee.children
+            while let cell = currentCell {
+                currentCell = cell.pointee.next
+                guard cell.pointee.type == XML_ELEMENT_NODE,
+                    xmlStrEqual(cell.pointee.name, "td") == 1 || xmlStrEqual(cell.pointee.name, "th") == 1 else { continue }
+                
+                while column < pendingRows.count && pendingRows[column] > 0 { column += 1 }
+                let columnSpan = min(max(spanAttribute(of: cell, named: "colspan") ?? 1, 1), HTMLTable.maximumColumnSpan)
+                // rowspan="0" spans the remaining rows
+                let rowSpan = spanAttribute(of: cell, named: "rowspan").map { $0 == 0 ? Int.max : min($0, HTMLTable.maximumRowSpan) } ?? 1
+                if column + columnSpan > pendingRows.count {
+                    pendingRows.append(contentsOf: repeatElement(0, count: column + columnSpan - pendingRows.count))
+                }
+                
+                let start = bytes.count
+                var pendingSpace = false
+                forEachTextNode(in: cell) { textNode in
+                    guard let content = textNode.pointee.content else { return }
+                    appendCollapsingWhitespace(content, Int(xmlStrlen(content)), to: &bytes, pendingSpace: &pendingSpace, startingAt: start)
+                }
+                cells.append(start..<bytes.count)
+                placements.append((rowCount, column, rowSpan, columnSpan))
+                for i in column..<column + columnSpan { pendingRows[i] = rowSpan }
+                column += columnSpan
+            }
+            
+            // the slots of the following row which are still occupied
+            for i in pendingRows.indices where pendingRows[i] > 0 {
+                columnCount = max(columnCount, i + 1)
+                if pendingRows[i] != Int.max { pendingRows[i] -= 1 }
+            }
+            if headerRows, let parent = row.pointee.parent, xmlStrEqual(parent.pointee.name, "thead") == 1 {
+                headerRowCount += 1
+            } else {
+                headerRows = false
+            }
+            rowCount += 1
+            currentRow = nextTableRow(after: row, in: tableNode)
+        }
+        
+        // a slot belongs to the first cell occupying it, later overlapping cells don't replace it
+        var slots = [Int](repeating: -1, count: rowCount * columnCount)
+        for (index, placement) in placements.enumerated() {
+            let lastRow = placement.rowSpan > rowCount - placement.row ? rowCount : placement.row + placement.rowSpan
+            for row in placement.row..<lastRow {
+                for column in placement.column..<placement.column + placement.columnSpan where slots[row * columnCount + column] < 0 {
+                    slots[row * columnCount + column] = index
+                }
+            }
+        }
+        
+        self.bytes = bytes
+        self.cells = cells
+        self.slots = slots
+        self.numberOfRows = rowCount
+        self.numberOfColumns = columnCount
+        self.numberOfHeaderRows = headerRowCount
+    }
     
-    private let dumpBufferSize = 4000
+    // the range of the text of the cell at a slot or nil
+    
+    private func cellRange(atRow row: Int, column: Int) -> Range<Int>? {
+        guard (0..<numberOfRows).contains(row), (0..<numberOfColumns).contains(column) else { return nil }
+        let index = slots[row * numberOfColumns + column]
+        return index < 0 ? nil : cells[index]
+    }
+    
+    /// The text of the cell at a slot.
+    /// - Parameters:
+    ///   - row: The index of the row.
+    ///   - column: The index of the column.
+    /// - Returns: The trimmed and collapsed text of the cell or nil if the slot is out of range or no cell occupies it.
+    
+    subscript(row: Int, column: Int) -> String? {
+        guard let range = cellRange(atRow: row, column: column) else { return nil }
+        return String(decoding: bytes[range], as: UTF8.self)
+    }
+    
+    /// Calls a closure with the UTF-8 text of the cell at a slot without creating a string.
+    /// - Parameters:
+    ///   - row: The index of the row.
+    ///   - column: The index of the column.
+    ///   - body: The closure, the buffer is valid only during the call.
+    /// - Returns: The result of the closure or nil if the slot is out of range or no cell occupies it.
+    
+    func withUTF8Text<T>(atRow row: Int, column: Int, _ body: (UnsafeBufferPointer<xmlChar>) throws -> T) rethrows -> T? {
+        guard let range = cellRange(atRow: row, column: column) else { return nil }
+        return try bytes.withUnsafeBufferPointer { try body(UnsafeBufferPointer(rebasing: $0[range])) }
+    }
+    
+    /// The texts of all slots of a row.
+    /// - Parameters:
+    ///   - row: The index of the row.
+    /// - Returns: An array of `numberOfColumns` strings, slots without cell are empty strings, or an empty array if the row is out of range.
+    
+    func strings(inRow row: Int) -> [String] {
+        guard (0..<numberOfRows).contains(row) else { return [] }
+        return (0..<numberOfColumns).map { self[row, $0] ?? "" }
+    }
+    
+    /// The texts of all slots of a column.
+    /// - Parameters:
+    ///   - column: The index of the column.
+    /// - Returns: An array of `numberOfRows` strings, slots without cell are empty strings, or an empty array if the column is out of range.
+    
+    func strings(inColumn column: Int) -> [String] {
+        guard (0..<numberOfColumns).contains(column) else { return [] }
+        return (0..<numberOfRows).map { self[$0, column] ?? "" }
+    }
+    
+    /// Parses the double value of the cell at a slot directly from the UTF-8 text without locale and without creating a string.
+    /// - Parameters:
+    ///   - row: The index of the row.
+    ///   - column: The index of the column.
+    ///   - decimalSeparator: The ASCII decimal separator e.g. "." or ",".
+    ///   - groupingSeparator: The ASCII grouping separator ignored in the integer digits (optional, default is none).
+    /// - Returns: The double value or nil if the slot has no cell, its text is not a number or a separator is not ASCII.
+    
+    func doubleValue(atRow row: Int, column: Int, decimalSeparator : Unicode.Scalar, groupingSeparator : Unicode.Scalar? = nil) -> Double? {
+        guard case let (decimal, grouping)? = asciiSeparators(decimalSeparator, groupingSeparator) else { return nil }
+        return withUTF8Text(atRow: row, column: column) { text -> Double? in
+            guard let baseAddress = text.baseAddress else { return nil }
+            return parseDouble(baseAddress, text.count, decimalSeparator: decimal, groupingSeparator: grouping)
+        } ?? nil
+    }
+    
+    /// Parses the double values of a column from a row to the last row like `doubleValue(atRow:column:decimalSeparator:groupingSeparator:)`.
+    /// - Parameters:
+    ///   - column: The index of the column.
+    ///   - row: The index of the first row e.g. `numberOfHeaderRows` (optional, default is 0).
+    ///   - decimalSeparator: The ASCII decimal separator e.g. "." or ",".
+    ///   - groupingSeparator: The ASCII grouping separator ignored in the integer digits (optional, default is none).
+    /// - Returns: An array of `numberOfRows - row` values, nil for slots which are not a number, or an empty array if the column or the row is out of range.
+    
+    func doubleValues(inColumn column: Int, fromRow row: Int = 0, decimalSeparator : Unicode.Scalar, groupingSeparator : Unicode.Scalar? = nil) -> [Double?] {
+        guard (0..<numberOfColumns).contains(column), (0..<numberOfRows).contains(row) else { return [] }
+        return (row..<numberOfRows).map { doubleValue(atRow: $0, column: column, decimalSeparator: decimalSeparator, groupingSeparator: groupingSeparator) }
+    }
+}
+
+class HTMLNode : Sequence, Hashable, Comparable, CustomStringConvertible {
     
     // MARK: XPath Error variables
     
+    @available(*, deprecated, message: "The XPath methods throw XPathError, the variables aren't set anymore")
     var xpathErrorCode : Int32 = 99999
+    @available(*, deprecated, message: "The XPath methods throw XPathError, the variables aren't set anymore")
     var xpathErrorMessage = "Unknown Error"
 
     // MARK: Private variables for the current node and its pointer
@@ -152,6 +1035,11 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     let pointer : xmlNodePtr
     fileprivate let node : xmlNode
     
+    /// The document of the node. The node keeps it alive, the tree is freed when the document and the last of its nodes are released.
+    /// nil for nodes of a tree without HTMLDocument object.
+    
+    let owningDocument : HTMLDocument?
+    
     // MARK: - init methods
     
     /// Initializes and returns a newly allocated HTMLNode object with a specified xmlNode pointer.
@@ -163,6 +1051,12 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
         guard let nodePointer = pointer else { return nil }
         self.pointer = nodePointer
         self.node = nodePointer.pointee
+        // the _private field of the document pointer references the HTMLDocument object
+        if let document = nodePointer.pointee.doc?.pointee._private {
+            self.owningDocument = Unmanaged<HTMLDocument>.fromOpaque(document).takeUnretainedValue()
+        } else {
+            self.owningDocument = nil
+        }
     }
     
     // MARK: - navigating methods
@@ -199,17 +1093,10 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     /// The first level of children.
     
-    // delete 'where xmlNodeIsText(currentNode) == 0' to consider all the text nodes
-    // see also the 'makeIterator()' function
+    // text nodes are skipped, see the 'makeIterator()' function
     
     var children : [HTMLNode] {
-        var array = [HTMLNode]()
-        for currentNode in XmlNodeSequence(node: node.children) where xmlNodeIsText(currentNode) == 0 {
-            if let node = HTMLNode(pointer: currentNode) {
-                array.append(node)
-            }
-        }
-        return array
+        return Array(self)
     }
     
     /// The child node at specified index.
@@ -219,8 +1106,8 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
 
     func child(at index : Int) -> HTMLNode?
     {
-        let childrenArray = self.children
-        return (index < childrenArray.count) ? childrenArray[index] : nil
+        guard index >= 0 else { return nil }
+        return self.dropFirst(index).first { _ in true }
     }
     
     /// The number of children
@@ -238,33 +1125,67 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func attribute(for name : String) -> String?
     {
-        return name.withXmlChar { attrName -> String? in
-            if let attributeValue = xmlGetProp(pointer, attrName) {
-                let result = stringFrom(xmlchar: attributeValue)
-                free(attributeValue)
-                return result
-            }
-            return nil
-        }
+        let attributeName = xmlCharArray(from: name)
+        guard let attr = attributeName.withUnsafeBufferPointer({ findAttribute(of: pointer, named: $0.baseAddress!) }) else { return nil }
+        return attributeValueString(attr)
     }
     
     /// All attributes and values as dictionary.
     
     var attributes : [String:String] {
         var result = [String:String]()
-        if let properties = node.properties {
-            for attribute in XmlAttrSequence(node: properties) {
-                if let children = attribute.pointee.children,
-                    let name = attribute.pointee.name {
-                    let value = stringFrom(xmlchar: children.pointee.content)
-                    let key = stringFrom(xmlchar: name)
-                    result[key] = value
-                }
+        var attribute = node.properties
+        while let attr = attribute {
+            if let name = attr.pointee.name, let value = attributeValueString(attr) {
+                result[stringFrom(xmlchar: name)] = value
             }
+            attribute = attr.pointee.next
         }
         return result
     }
     
+    /// Returns a borrowed view of the attribute matching a given name without copy.
+    /// - Parameters:
+    ///   - name: A name of an attribute.
+    /// - Returns: The view of the attribute or nil if the attribute could not be found or if its value consists of several nodes (entity references in XML documents).
+    
+    func attributeView(for name : String) -> HTMLAttributeView?
+    {
+        let attributeName = xmlCharArray(from: name)
+        guard let attr = attributeName.withUnsafeBufferPointer({ findAttribute(of: pointer, named: $0.baseAddress!) }) else { return nil }
+        return HTMLAttributeView(attr)
+    }
+    
+    /// Compares the value of the attribute matching a given name in place.
+    /// - Parameters:
+    ///   - name: A name of an attribute.
+    ///   - value: The value compared with the attribute value.
+    /// - Returns: true if the attribute exists and its value matches the value exactly.
+    
+    func attribute(_ name : String, matches value : String) -> Bool
+    {
+        let attributeName = xmlCharArray(from: name)
+        guard let attr = attributeName.withUnsafeBufferPointer({ findAttribute(of: pointer, named: $0.baseAddress!) }) else { return false }
+        if let attributeValue = borrowedAttributeValue(attr) {
+            return value.withCString { xmlStrEqual(attributeValue, UnsafeRawPointer($0).assumingMemoryBound(to: xmlChar.self)) == 1 }
+        }
+        return attributeValueString(attr) == value
+    }
+    
+    /// Calls the closure with a borrowed view of each attribute in document order without creating a dictionary, attributes consisting of several nodes are skipped.
+    /// - Parameters:
+    ///   - body: The closure to apply to each attribute view.
+    
+    func forEachAttribute(_ body: (HTMLAttributeView) throws -> Void) rethrows
+    {
+        guard node.type == XML_ELEMENT_NODE else { return }
+        var attribute = node.properties
+        while let attr = attribute {
+            if let view = HTMLAttributeView(attr) { try body(view) }
+            attribute = attr.pointee.next
+        }
+    }
+    
     /// The tag name.
     
     var tagName : String? {
@@ -332,6 +1253,33 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
         return self.textContent?.doubleValue(forLocaleIdentifier: identifier, consideringPlusSign:flag)
     }
     
+    /// Parses the double value of the string value directly from the UTF-8 bytes without locale and without creating a string.
+    /// - Parameters:
+    ///   - decimalSeparator: The ASCII decimal separator e.g. "." or ",".
+    ///   - groupingSeparator: The ASCII grouping separator ignored in the integer digits (optional, default is none).
+    /// - Returns: The double value or nil if the trimmed string value is not a number or a separator is not ASCII.
+    
+    func doubleValue(decimalSeparator : Unicode.Scalar, groupingSeparator : Unicode.Scalar? = nil) -> Double?
+    {
+        guard case let (decimal, grouping)? = asciiSeparators(decimalSeparator, groupingSeparator) else { return nil }
+        guard let child = node.children, child.pointee.type != XML_ELEMENT_NODE, let content = child.pointee.content else { return nil }
+        return parseDouble(content, Int(xmlStrlen(content)), decimalSeparator: decimal, groupingSeparator: grouping)
+    }
+    
+    /// Parses the double value of the text content directly from the UTF-8 bytes without locale and without creating a string.
+    /// - Parameters:
+    ///   - decimalSeparator: The ASCII decimal separator e.g. "." or ",".
+    ///   - groupingSeparator: The ASCII grouping separator ignored in the integer digits (optional, default is none).
+    /// - Returns: The double value or nil if the trimmed text content is not a number or a separator is not ASCII.
+    
+    func contentDoubleValue(decimalSeparator : Unicode.Scalar, groupingSeparator : Unicode.Scalar? = nil) -> Double?
+    {
+        guard case let (decimal, grouping)? = asciiSeparators(decimalSeparator, groupingSeparator) else { return nil }
+        guard let contents = xmlNodeGetContent(pointer) else { return nil }
+        defer { xmlFree(contents) }
+        return parseDouble(contents, Int(xmlStrlen(contents)), decimalSeparator: decimal, groupingSeparator: grouping)
+    }
+    
     /// Returns the date value of the string value for a specified date format and time zone.
     /// - Parameters:
     ///   - format: A date format string. The date format must conform to http://unicode.org/reports/tr35/tr35-10.html#Date_Format_Patterns
@@ -354,23 +1302,32 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
         return self.textContent?.dateValue(withFormat: format, timeZone:timeZone)
     }
     
+    // the content of the first child if it's not an element, the content field of an element holds its document order number after xmlXPathOrderDocElems
+    
+    private var childContent : UnsafeMutablePointer<xmlChar>? {
+        guard let child = node.children, child.pointee.type != XML_ELEMENT_NODE else { return nil }
+        return child.pointee.content
+    }
+    
     /// The raw string.
     
     var rawStringValue : String? {
-        guard let content = node.children?.pointee.content else { return nil }
+        guard let content = childContent else { return nil }
         return stringFrom(xmlchar: content)
     }
     
     /// The string value of a node trimmed by whitespace and newline characters.
     
     var stringValue : String? {
-        return self.rawStringValue?.trimmingCharacters(in: CharacterSet.whitespacesAndNewlines)
+        guard let content = childContent else { return nil }
+        return trimmedString(content, length: Int(xmlStrlen(content)))
     }
     
     /// The string value of a node trimmed by whitespace and newline characters and collapsing all multiple occurrences of whitespace and newline characters within the string into a single space.
     
     var stringValueCollapsingWhitespace : String? {
-        return self.stringValue?.collapseWhitespaceAndNewLine()
+        guard let content = childContent else { return nil }
+        return collapsedString(content, Int(xmlStrlen(content)))
     }
     
     /// The raw html text dump.
@@ -388,22 +1345,18 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
         return result
     }
     
-    private func textContentOfChildren(nodePtr : xmlNodePtr,
-                                       array : inout [String],
-                                       recursive : Bool)
+    private func textContentOfChildren(in scope : HTMLNodeScope) -> [String]
     {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let content = textContent(of: currentNodePtr), !content.isEmpty {
+        var array = [String]()
+        for currentNode in nodes(in: scope) {
+            if let content = textContent(of: currentNode.pointer), !content.isEmpty {
                 let trimmedContent = content.trimmingCharacters(in: CharacterSet.whitespacesAndNewlines)
                 if !trimmedContent.isEmpty {
                     array.append(trimmedContent)
                 }
             }
-            
-            if recursive, let children = currentNodePtr.pointee.children {
-                textContentOfChildren(nodePtr: children, array: &array, recursive: recursive)
-            }
         }
+        return array
     }
     
     /// The element type of the node.
@@ -463,10 +1416,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     /// The array of all text content of children.
     
     var textContentOfChildren : [String] {
-        var array = [String]()
-        guard let childrn = node.children else { return array }
-        textContentOfChildren(nodePtr: childrn, array:&array, recursive:false)
-        return array
+        return textContentOfChildren(in: .children)
     }
     
     
@@ -490,323 +1440,312 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     /// The text content of descendant-or-self trimmed by whitespace and newline characters.
     
     var textContent : String? {
-        return textContent(of: pointer)?.trimmingCharacters(in: CharacterSet.whitespacesAndNewlines)
+        guard let contents = xmlNodeGetContent(pointer) else { return nil }
+        defer { xmlFree(contents) }
+        return trimmedString(contents, length: Int(xmlStrlen(contents)))
     }
     
-    /// The text content of descendant-or-self in an array, each item trimmed by whitespace and newline characters.
+    /// The text content of descendant-or-self trimmed by whitespace and newline characters and collapsing all multiple occurrences of whitespace and newline characters within the string into a single space.
     
     var textContentCollapsingWhitespace : String? {
-        return self.textContent?.collapseWhitespaceAndNewLine()
+        switch node.type {
+        case XML_ELEMENT_NODE, XML_TEXT_NODE, XML_CDATA_SECTION_NODE, XML_DOCUMENT_NODE, XML_HTML_DOCUMENT_NODE, XML_DOCUMENT_FRAG_NODE:
+            var buffer = [xmlChar]()
+            var pendingSpace = false
+            forEachTextNode(in: pointer) { textNode in
+                guard let content = textNode.pointee.content else { return }
+                appendCollapsingWhitespace(content, Int(xmlStrlen(content)), to: &buffer, pendingSpace: &pendingSpace)
+            }
+            return String(decoding: buffer, as: UTF8.self)
+            
+        default:
+            return self.textContent?.collapseWhitespaceAndNewLine()
+        }
     }
     
     /// The text content of descendant-or-self in an array, each item trimmed by whitespace and newline characters.
+    /// The content of an element is the range of one text buffer between its start and its end, so the subtree is walked once.
     
     var textContentOfDescendants : [String] {
-        var array = [String]()
-        guard let childrn = node.children else { return array }
-        textContentOfChildren(nodePtr: childrn, array:&array, recursive:true)
-        return array
+        var contents = [String?]()
+        var buffer = [xmlChar]()
+        var openElements = [(start: Int, index: Int)]()
+        
+        var current = node.children
+        while let nodePtr = current {
+            let type = nodePtr.pointee.type
+            if type == XML_ELEMENT_NODE {
+                openElements.append((buffer.count, contents.count))
+                contents.append(nil)
+                if let children = nodePtr.pointee.children {
+                    current = children
+                    continue
+                }
+            } else if let content = nodePtr.pointee.content,
+                isTextNode(nodePtr) || type == XML_COMMENT_NODE || type == XML_PI_NODE {
+                let length = Int(xmlStrlen(content))
+                // comments and processing instructions aren't part of the content of their ancestors
+                if isTextNode(nodePtr) {
+                    buffer.append(contentsOf: UnsafeBufferPointer(start: content, count: length))
+                }
+                contents.append(trimmedTextContent(content, length))
+            }
+            
+            // the end of the node and of all ancestors whose last descendant it is
+            current = nil
+            var endedNode : xmlNodePtr? = nodePtr
+            while let ended = endedNode {
+                if ended.pointee.type == XML_ELEMENT_NODE, let element = openElements.popLast() {
+                    contents[element.index] = buffer.withUnsafeBufferPointer {
+                        trimmedTextContent($0.baseAddress.map { $0 + element.start }, $0.count - element.start)
+                    }
+                }
+                if let next = ended.pointee.next {
+                    current = next
+                    break
+                }
+                endedNode = ended.pointee.parent
+                if endedNode == pointer { break }
+            }
+        }
+        return contents.compactMap { $0 }
     }
     
-    /// The raw html text dump of descendant-or-self.
+    /// The text content of each text node of descendant-or-self in an array, each item trimmed by whitespace and newline characters.
+    /// The text nodes are visited once and whitespace only text nodes are omitted.
     
-    var HTMLContent : String?  {
-        
-        guard let document = node.doc else { return nil }
-        let xmlCharContent = document.pointee.encoding!
-        
-        var xmlBuffer = xmlBufferCreateSize(dumpBufferSize)
-        var outputBuffer = xmlOutputBufferCreateBuffer(xmlBuffer, nil)
-        
-        defer {
-            xmlOutputBufferClose(outputBuffer)
-            xmlBufferFree(xmlBuffer)
+    var textContentOfTextNodes : [String] {
+        var contents = [String]()
+        forEachTextNode(in: pointer) { textNode in
+            guard let content = textNode.pointee.content,
+                let trimmedContent = trimmedTextContent(content, Int(xmlStrlen(content))) else { return }
+            contents.append(trimmedContent)
         }
-        
-        let constChar = xmlCharContent.withMemoryRebound(to: Int8.self, capacity: MemoryLayout.size(ofValue: xmlCharContent)) {
-            return $0
+        return contents
+    }
+    
+    /// The text content of the text nodes of descendant-or-self, each trimmed by whitespace and newline characters and joined in one buffer.
+    /// - Parameters:
+    ///   - separator: The string inserted between the contents of two text nodes, whitespace only text nodes are omitted.
+    ///   - collapsingWhitespace: true to collapse all multiple occurrences of whitespace and newline characters within each text node into a single space.
+    /// - Returns: The joined text content.
+    
+    func textContent(joinedBy separator: String, collapsingWhitespace collapse: Bool = false) -> String
+    {
+        var buffer = [xmlChar]()
+        forEachTextNode(in: pointer) { textNode in
+            guard let content = textNode.pointee.content else { return }
+            let range = trimmedRange(content, Int(xmlStrlen(content)))
+            guard !range.isEmpty else { return }
+            
+            if !buffer.isEmpty { buffer.append(contentsOf: separator.utf8) }
+            if collapse {
+                var pendingSpace = false
+                appendCollapsingWhitespace(content + range.lowerBound, range.count, to: &buffer, pendingSpace: &pendingSpace)
+            } else {
+                buffer.append(contentsOf: UnsafeBufferPointer(start: content + range.lowerBound, count: range.count))
+            }
         }
-        
-        htmlNodeDumpOutput(outputBuffer, document, self.pointer, constChar)
-        xmlOutputBufferFlush(outputBuffer)
-        
-        guard let content = xmlBuffer?.pointee.content else { return nil }
-        return stringFrom(xmlchar: content)
+        return String(decoding: buffer, as: UTF8.self)
     }
     
+    /// The raw html text dump of descendant-or-self.
     
-    // MARK: -  query methods
-    // Note: In the category HTMLNode+XPath all appropriate query methods begin with node instead of descendant
+    var HTMLContent : String?  {
+        guard node.doc != nil else { return nil }
+        var data = Data()
+        guard (try? writeHTML(to: &data)) != nil else { return nil }
+        return String(decoding: data, as: UTF8.self)
+    }
     
+    // serializes descendant-or-self into the output buffer and closes it,
+    // libxml2 passes the output in chunks of its output buffer to the write callback of the sink
     
-    private func child(withAttribute attribute : UnsafePointer<xmlChar>,
-                       nodePtr : xmlNodePtr,
-                       recursive : Bool) -> HTMLNode?
+    private func dumpHTML(into outputBuffer : xmlOutputBufferPtr?) -> Bool
     {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1 {
-                        return HTMLNode(pointer: currentNodePtr)
-                    }
-                }
-                
-                if recursive, let children = currentNodePtr.pointee.children,
-                    let subNode = child(withAttribute: attribute, nodePtr: children, recursive: recursive) {
-                    return subNode
-                }
-            }
-        }
-        return nil
+        guard let outputBuffer = outputBuffer else { return false }
+        let encoding = node.doc?.pointee.encoding.map { UnsafeRawPointer($0).assumingMemoryBound(to: CChar.self) }
+        htmlNodeDumpOutput(outputBuffer, node.doc, pointer, encoding)
+        // flushes the remaining output and returns the error of a failed write
+        return xmlOutputBufferClose(outputBuffer) >= 0
     }
     
-    private func child(withAttribute attribute : UnsafePointer<xmlChar>,
-                       matches value : UnsafePointer<xmlChar>,
-                       nodePtr : xmlNodePtr,
-                       recursive : Bool) -> HTMLNode?
+    /// Appends the UTF-8 encoded html of descendant-or-self to a data object, the same serialization as `HTMLContent` without intermediate string.
+    /// - Parameters:
+    ///   - data: The data object, it can be reused for several nodes with `removeAll(keepingCapacity: true)`.
+    /// - Throws: `POSIXError.ENOMEM` if the output buffer could not be created.
+    
+    func writeHTML(to data : inout Data) throws
     {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1 {
-                        if let attrContent = attr.pointee.children?.pointee.content,
-                            xmlStrEqual(attrContent, value) == 1 {
-                            return HTMLNode(pointer: currentNodePtr)
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let children = currentNodePtr.pointee.children,
-                let subNode = child(withAttribute: attribute, matches: value, nodePtr: children, recursive: recursive) {
-                return subNode
-            }
+        let written = withUnsafeMutablePointer(to: &data) { dataPointer in
+            dumpHTML(into: xmlOutputBufferCreateIO(dataWriteCallback, nil, dataPointer, nil))
         }
-        return nil
+        guard written else { throw POSIXError(.ENOMEM) }
     }
     
-    private func child(withAttribute attribute : UnsafePointer<xmlChar>,
-                       contains value : UnsafePointer<xmlChar>,
-                       nodePtr : xmlNodePtr,
-                       recursive : Bool) -> HTMLNode?
+    /// Writes the UTF-8 encoded html of descendant-or-self to an opened output stream, the same serialization as `HTMLContent` without intermediate string.
+    /// - Parameters:
+    ///   - stream: The opened output stream, it's not closed.
+    /// - Throws: The error of the stream or `POSIXError.EIO` if the html could not be written.
+    
+    func writeHTML(to stream : OutputStream) throws
     {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1 {
-                        if let attrContent = attr.pointee.children.pointee.content,
-                            xmlStrstr(attrContent, value) != nil {
-                            return HTMLNode(pointer: currentNodePtr)
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let children = currentNodePtr.pointee.children,
-                let subNode = child(withAttribute: attribute, contains: value, nodePtr: children, recursive: recursive) {
-                return subNode
-            }
+        let context = Unmanaged.passUnretained(stream).toOpaque()
+        guard dumpHTML(into: xmlOutputBufferCreateIO(streamWriteCallback, nil, context, nil)) else {
+            throw stream.streamError ?? POSIXError(.EIO)
         }
-        return nil
     }
     
-    private func child(withAttribute attribute : UnsafePointer<xmlChar>,
-                       beginsWith value : UnsafePointer<xmlChar>,
-                       nodePtr : xmlNodePtr,
-                       recursive : Bool) -> HTMLNode?
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1,
-                        let attrContent = attr.pointee.children?.pointee.content {
-                        let subString = xmlStrsub(attrContent, 0, xmlStrlen(value))
-                        if xmlStrEqual(subString, value) == 1 {
-                            return HTMLNode(pointer: currentNodePtr)
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let children = currentNodePtr.pointee.children,
-                let subNode = child(withAttribute: attribute, beginsWith: value, nodePtr: children, recursive: recursive) {
-                return subNode
-            }
+    /// Writes the UTF-8 encoded html of descendant-or-self to a file descriptor, the same serialization as `HTMLContent` without intermediate string.
+    /// - Parameters:
+    ///   - fileDescriptor: The file descriptor opened for writing, it's not closed.
+    /// - Throws: The `POSIXError` of the failed write.
+    
+    func writeHTML(toFileDescriptor fileDescriptor : Int32) throws
+    {
+        var sink = FileDescriptorSink(fileDescriptor: fileDescriptor, errorNumber: 0)
+        let written = withUnsafeMutablePointer(to: &sink) { sinkPointer in
+            dumpHTML(into: xmlOutputBufferCreateIO(fileDescriptorWriteCallback, nil, sinkPointer, nil))
         }
-        return nil
+        guard written else { throw POSIXError(POSIXErrorCode(rawValue: sink.errorNumber) ?? .EIO) }
     }
     
-    private func child(withAttribute attribute : UnsafePointer<xmlChar>,
-                       endsWith value : UnsafePointer<xmlChar>,
-                       nodePtr : xmlNodePtr,
-                       recursive : Bool) -> HTMLNode?
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1,
-                        let attrContent = attr.pointee.children?.pointee.content {
-                        let addValueLength = xmlStrlen(value)
-                        let subString = xmlStrsub(attrContent, (xmlStrlen(attrContent) - addValueLength), addValueLength)
-                        if xmlStrEqual(subString, value) == 1 {
-                            return HTMLNode(pointer: currentNodePtr)
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let children = currentNodePtr.pointee.children,
-                let subNode = child(withAttribute: attribute, endsWith: value, nodePtr: children, recursive: recursive) {
-                return subNode
-            }
-        }
-        return nil
+    /// The contents of the table element in one pass without node objects, see `HTMLTable`.
+    
+    var tableContent : HTMLTable? {
+        return HTMLTable(tableNode: pointer)
     }
     
-    private func children(withAttribute attribute : UnsafePointer<xmlChar>,
-                          nodePtr : xmlNodePtr,
-                          array : inout [HTMLNode],
-                          recursive : Bool)
+    
+    // MARK: -  lazy node sequences
+    // The query methods below are built on top of these sequences, the predicates are evaluated on the raw node pointers
+    
+    /// Returns a lazy sequence of all nodes in the specified scope including text nodes.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    /// - Returns: The sequence of the nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope) -> HTMLNodeSequence
     {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1 {
-                        if let matchingNode = HTMLNode(pointer: currentNodePtr) {
-                            array.append(matchingNode)
-                            break
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let childrn = currentNodePtr.pointee.children {
-                children(withAttribute: attribute, nodePtr: childrn, array:&array, recursive:recursive)
-            }
-        }
+        return HTMLNodeSequence(root: pointer, scope: scope)
     }
     
-    private func children(withAttribute attribute : UnsafePointer<xmlChar>,
-                          matches value : UnsafePointer<xmlChar>,
-                          nodePtr : xmlNodePtr,
-                          array : inout [HTMLNode],
-                          recursive : Bool)
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1 {
-                        if let attrContent = attr.pointee.children?.pointee.content,
-                            xmlStrEqual(attrContent, value) == 1 {
-                            if let matchingNode = HTMLNode(pointer: currentNodePtr) {
-                                array.append(matchingNode)
-                                break
-                            }
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let childrn = currentNodePtr.pointee.children {
-                children(withAttribute: attribute, matches: value, nodePtr: childrn, array:&array, recursive:recursive)
-            }
-        }
+    /// Returns a lazy sequence of the nodes in the specified scope with the specified tag name.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - tag: The name of the tag.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope, ofTag tag : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeIsOfTag(tag))
     }
     
-    private func children(withAttribute attribute : UnsafePointer<xmlChar>,
-                          contains value : UnsafePointer<xmlChar>,
-                          nodePtr : xmlNodePtr,
-                          array : inout [HTMLNode],
-                          recursive : Bool)
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1 {
-                        if let attrContent = attr.pointee.children?.pointee.content,
-                            xmlStrstr(attrContent, value) != nil {
-                            if let matchingNode = HTMLNode(pointer: currentNodePtr) {
-                                array.append(matchingNode)
-                                break
-                            }
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let childrn = currentNodePtr.pointee.children {
-                children(withAttribute: attribute, contains:value, nodePtr: childrn, array:&array, recursive:recursive)
-            }
-        }
+    /// Returns a lazy sequence of the nodes in the specified scope with the specified tag name and string value matching exactly.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - tag: The name of the tag.
+    ///   - value: The string value of the tag.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope, ofTag tag : String, matches value : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeIsOfTag(tag, value: value, .matches))
     }
     
-    private func children(withAttribute attribute : UnsafePointer<xmlChar>,
-                          beginsWith value : UnsafePointer<xmlChar>,
-                          nodePtr : xmlNodePtr,
-                          array : inout [HTMLNode],
-                          recursive : Bool)
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1,
-                        let attrContent = attr.pointee.children?.pointee.content {
-                        let subString = xmlStrsub(attrContent, 0, xmlStrlen(value))
-                        if xmlStrEqual(subString, value) == 1 {
-                            if let matchingNode = HTMLNode(pointer: currentNodePtr) {
-                                array.append(matchingNode)
-                                break
-                            }
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let childrn = currentNodePtr.pointee.children {
-                children(withAttribute: attribute, beginsWith: value, nodePtr: childrn, array:&array, recursive:recursive)
-            }
-        }
+    /// Returns a lazy sequence of the nodes in the specified scope with the specified tag name and the string value contains the specified value.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - tag: The name of the tag.
+    ///   - value: The partial string value of the tag.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope, ofTag tag : String, contains value : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeIsOfTag(tag, value: value, .contains))
+    }
+    
+    /// Returns a lazy sequence of the nodes in the specified scope with the specified attribute name.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - attribute: The name of the attribute.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope, withAttribute attribute : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeHasAttribute(attribute))
+    }
+    
+    /// Returns a lazy sequence of the nodes in the specified scope with the specified attribute name and value matching exactly.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - attribute: The name of the attribute.
+    ///   - value: The value of the attribute.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope, withAttribute attribute : String, matches value : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeHasAttribute(attribute, value: value, .matches))
+    }
+    
+    /// Returns a lazy sequence of the nodes in the specified scope with the specified attribute name and the value contains the specified attribute value.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - attribute: The name of the attribute.
+    ///   - value: The partial string of the attribute value.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope, withAttribute attribute : String, contains value : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeHasAttribute(attribute, value: value, .contains))
+    }
+    
+    /// Returns a lazy sequence of the nodes in the specified scope with the specified attribute name and the value begins with the specified attribute value.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - attribute: The name of the attribute.
+    ///   - value: The partial string of the attribute value.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope, withAttribute attribute : String, beginsWith value : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeHasAttribute(attribute, value: value, .beginsWith))
+    }
+    
+    /// Returns a lazy sequence of the nodes in the specified scope with the specified attribute name and the value ends with the specified attribute value.
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - attribute: The name of the attribute.
+    ///   - value: The partial string of the attribute value.
+    /// - Returns: The sequence of the matching nodes in document order.
+    
+    func nodes(in scope : HTMLNodeScope, withAttribute attribute : String, endsWith value : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeHasAttribute(attribute, value: value, .endsWith))
+    }
+    
+    /// Returns a lazy sequence of the nodes in the specified scope having all specified class names in their class attribute.
+    /// The names are matched as whitespace separated tokens in any order, "btn" doesn't match "btn-primary".
+    /// - Parameters:
+    ///   - scope: The scope of the nodes: children, descendants or siblings.
+    ///   - classNames: A whitespace separated list of up to 64 class names.
+    /// - Returns: The sequence of the matching nodes in document order, empty for an empty list of names.
+    
+    func nodes(in scope : HTMLNodeScope, withClassNames classNames : String) -> HTMLNodeSequence
+    {
+        return HTMLNodeSequence(root: pointer, scope: scope, predicate: nodeHasClassNames(classNames) ?? { _ in false })
     }
     
-    private func children(withAttribute attribute : UnsafePointer<xmlChar>,
-                          endsWith value : UnsafePointer<xmlChar>,
-                          nodePtr : xmlNodePtr,
-                          array : inout [HTMLNode],
-                          recursive : Bool)
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let properties = currentNodePtr.pointee.properties {
-                for attr in XmlAttrSequence(node: properties) {
-                    if let attrName = attr.pointee.name,
-                        xmlStrEqual(attrName, attribute) == 1,
-                        let attrContent = attr.pointee.children?.pointee.content {
-                        let addValueLength = xmlStrlen(value)
-                        let subString = xmlStrsub(attrContent, (xmlStrlen(attrContent) - addValueLength), addValueLength)
-                        if xmlStrEqual(subString, value) == 1 {
-                            if let matchingNode = HTMLNode(pointer: currentNodePtr) {
-                                array.append(matchingNode)
-                                break
-                            }
-                        }
-                    }
-                }
-            }
-            
-            if recursive, let childrn = currentNodePtr.pointee.children {
-                children(withAttribute: attribute, endsWith: value, nodePtr: childrn, array:&array, recursive:recursive)
-            }
-        }
+    // The index of the document if indexing is enabled
+    
+    private var documentNodeIndex : HTMLNodeIndex? {
+        guard node.type == XML_ELEMENT_NODE else { return nil }
+        return owningDocument?.nodeIndex
     }
     
+    // MARK: -  query methods
+    // Note: In the category HTMLNode+XPath all appropriate query methods begin with node instead of descendant
+    
     /// Returns the first descendant node with the specifed attribute name and value matching exactly.
     /// - Parameters:
     ///   - attributeName: The name of the attribute.
@@ -815,12 +1754,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(withAttribute attribute : String, matches value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, matches: xmlValue, nodePtr: childrn, recursive: true)
-            }
-        }
+        return nodes(in: .descendants, withAttribute: attribute, matches: value).first
     }
     
     /// Returns the first child node with the specifed attribute name and value matching exactly.
@@ -830,12 +1764,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(withAttribute attribute : String, matches value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, matches: xmlValue, nodePtr: childrn, recursive: false)
-            }
-        }
+        return nodes(in: .children, withAttribute: attribute, matches: value).first
     }
     
     /// Returns the first sibling node with the specifed attribute name and value matching exactly.
@@ -846,12 +1775,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(withAttribute attribute : String, matches value : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, matches: xmlValue, nodePtr: next, recursive: false)
-            }
-        }
+        return nodes(in: .siblings, withAttribute: attribute, matches: value).first
     }
     
     /// Returns the first descendant node with the specifed attribute name and the value contains the specified attribute value.
@@ -862,12 +1786,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(withAttribute attribute : String, contains value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, contains: xmlValue, nodePtr: childrn, recursive: true)
-            }
-        }
+        return nodes(in: .descendants, withAttribute: attribute, contains: value).first
     }
     
     /// Returns the first child node with the specifed attribute name and the value contains the specified attribute value.
@@ -878,12 +1797,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(withAttribute attribute : String, contains value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, contains: xmlValue, nodePtr: childrn, recursive: false)
-            }
-        }
+        return nodes(in: .children, withAttribute: attribute, contains: value).first
     }
     
     /// Returns the first sibling node with the specifed attribute name and the value contains the specified attribute value.
@@ -894,12 +1808,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(withAttribute attribute : String, contains value : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, contains: xmlValue, nodePtr: next, recursive: false)
-            }
-        }
+        return nodes(in: .siblings, withAttribute: attribute, contains: value).first
     }
     
     /// Returns the first descendant node with the specifed attribute name and value begins with the specified attribute value.
@@ -911,12 +1820,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(withAttribute attribute : String, beginsWith value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, beginsWith: xmlValue, nodePtr: childrn, recursive: true)
-            }
-        }
+        return nodes(in: .descendants, withAttribute: attribute, beginsWith: value).first
     }
     
     /// Returns the first child node with the specifed attribute name and value begins with the specified attribute value.
@@ -927,12 +1831,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(withAttribute attribute : String, beginsWith value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, beginsWith: xmlValue, nodePtr: childrn, recursive: false)
-            }
-        }
+        return nodes(in: .children, withAttribute: attribute, beginsWith: value).first
     }
     
     /// Returns the first sibling node with the specifed attribute name and the value begins with the specified attribute value.
@@ -943,12 +1842,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(withAttribute attribute : String, beginsWith value : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, beginsWith: xmlValue, nodePtr: next, recursive: false)
-            }
-        }
+        return nodes(in: .siblings, withAttribute: attribute, beginsWith: value).first
     }
     
     /// Returns the first descendant node with the specifed attribute name and value ends with the specified attribute value.
@@ -960,12 +1854,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(withAttribute attribute : String, endsWith value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, endsWith: xmlValue, nodePtr: childrn, recursive: true)
-            }
-        }
+        return nodes(in: .descendants, withAttribute: attribute, endsWith: value).first
     }
     
     /// Returns the first child node with the specifed attribute name and value ends with the specified attribute value.
@@ -976,12 +1865,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(withAttribute attribute : String, endsWith value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, endsWith: xmlValue, nodePtr: childrn, recursive: false)
-            }
-        }
+        return nodes(in: .children, withAttribute: attribute, endsWith: value).first
     }
     
     /// Returns the first sibling node with the specifed attribute name and the value ends with the specified attribute value.
@@ -992,12 +1876,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(withAttribute attribute : String, endsWith value : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlAttr, endsWith: xmlValue, nodePtr: next, recursive: false)
-            }
-        }
+        return nodes(in: .siblings, withAttribute: attribute, endsWith: value).first
     }
     
     /// Returns all descendant nodes with the specifed attribute name and value matching exactly.
@@ -1008,14 +1887,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(withAttribute attribute : String, matches value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, matches: xmlValue, nodePtr: childrn, array: &array, recursive: true)
-            }
-        }
-        return array
+        return Array(nodes(in: .descendants, withAttribute: attribute, matches: value))
     }
     
     /// Returns all child nodes with the specifed attribute name and value matching exactly.
@@ -1026,14 +1898,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(withAttribute attribute : String, matches value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, matches: xmlValue, nodePtr: childrn, array: &array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .children, withAttribute: attribute, matches: value))
     }
     
     /// Returns all sibling nodes with the specifed attribute name and value matching exactly.
@@ -1044,14 +1909,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(withAttribute attribute : String, matches value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let next = node.next else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, matches: xmlValue, nodePtr: next, array: &array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .siblings, withAttribute: attribute, matches: value))
     }
     
     /// Returns all descendant nodes with the specifed attribute name and the value contains the specified attribute value.
@@ -1062,14 +1920,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(withAttribute attribute : String, contains value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, contains: xmlValue, nodePtr: childrn, array: &array, recursive: true)
-            }
-        }
-        return array
+        return Array(nodes(in: .descendants, withAttribute: attribute, contains: value))
     }
     
     /// Returns all child nodes with the specifed attribute name and the value contains the specified attribute value.
@@ -1080,14 +1931,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(withAttribute attribute : String, contains value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, contains: xmlValue, nodePtr: childrn, array: &array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .children, withAttribute: attribute, contains: value))
     }
     
     /// Returns all sibling nodes with the specifed attribute name and the value contains the specified attribute value.
@@ -1098,14 +1942,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(withAttribute attribute : String, contains value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let next = node.next else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, contains: xmlValue, nodePtr: next, array: &array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .siblings, withAttribute: attribute, contains: value))
     }
     
     /// Returns all descendant nodes with the specifed attribute name and the value begins with the specified attribute value.
@@ -1116,14 +1953,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(withAttribute attribute : String, beginsWith value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, beginsWith: xmlValue, nodePtr: childrn, array: &array, recursive: true)
-            }
-        }
-        return array
+        return Array(nodes(in: .descendants, withAttribute: attribute, beginsWith: value))
     }
     
     /// Returns all child nodes with the specifed attribute name and the value begins with the specified attribute value.
@@ -1134,14 +1964,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(withAttribute attribute : String, beginsWith value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, beginsWith: xmlValue, nodePtr: childrn, array:&array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .children, withAttribute: attribute, beginsWith: value))
     }
     
     /// Returns all sibling nodes with the specifed attribute name and the value begins with the specified attribute value.
@@ -1152,14 +1975,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(withAttribute attribute : String, beginsWith value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let next = node.next else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, beginsWith: xmlValue, nodePtr: next, array:&array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .siblings, withAttribute: attribute, beginsWith: value))
     }
     
     /// Returns all descendant nodes with the specifed attribute name and the value ends with the specified attribute value.
@@ -1170,14 +1986,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(withAttribute attribute : String, endsWith value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, endsWith: xmlValue, nodePtr: childrn, array:&array, recursive: true)
-            }
-        }
-        return array
+        return Array(nodes(in: .descendants, withAttribute: attribute, endsWith: value))
     }
     
     /// Returns all child nodes with the specifed attribute name and the value ends with the specified attribute value.
@@ -1188,14 +1997,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(withAttribute attribute : String, endsWith value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, endsWith: xmlValue, nodePtr: childrn, array:&array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .children, withAttribute: attribute, endsWith: value))
     }
     
     /// Returns all sibling nodes with the specifed attribute name and the value ends with the specified attribute value.
@@ -1206,14 +2008,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(withAttribute attribute : String, endsWith value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let next = node.next else { return array }
-        attribute.withXmlChar { xmlAttr in
-            value.withXmlChar { xmlValue in
-                children(withAttribute: xmlAttr, endsWith: xmlValue, nodePtr: next, array:&array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .siblings, withAttribute: attribute, endsWith: value))
     }
     
     /// Returns the first descendant node with the specifed attribute name.
@@ -1223,10 +2018,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(withAttribute attribute : String) -> HTMLNode?
     {
-       guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            return child(withAttribute: xmlAttr, nodePtr: childrn, recursive: true)
-        }
+        return nodes(in: .descendants, withAttribute: attribute).first
     }
     
     /// Returns the first child node with the specifed attribute name.
@@ -1236,10 +2028,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(withAttribute attribute : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            return child(withAttribute: xmlAttr, nodePtr: childrn, recursive: false)
-        }
+        return nodes(in: .children, withAttribute: attribute).first
     }
     
     /// Returns the first sibling node with the specifed attribute name.
@@ -1249,10 +2038,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(withAttribute attribute : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return attribute.withXmlChar { xmlAttr in
-            return child(withAttribute: xmlAttr, nodePtr: next, recursive: false)
-        }
+        return nodes(in: .siblings, withAttribute: attribute).first
     }
     
     /// Returns all descendant nodes with the specifed attribute name.
@@ -1262,12 +2048,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(withAttribute attribute : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            children(withAttribute: xmlAttr, nodePtr: childrn, array:&array, recursive: true)
-        }
-        return array
+        return Array(nodes(in: .descendants, withAttribute: attribute))
     }
     
     /// Returns all child nodes with the specifed attribute name.
@@ -1277,12 +2058,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(withAttribute attribute : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        attribute.withXmlChar { xmlAttr in
-            children(withAttribute: xmlAttr, nodePtr: childrn, array:&array, recursive: false)
-        }
-        return array
+        return Array(nodes(in: .children, withAttribute: attribute))
     }
     
     /// Returns all sibling nodes with the specifed attribute name.
@@ -1292,12 +2068,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(withAttribute attribute : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let next = node.next else { return array }
-        attribute.withXmlChar { xmlAttr in
-            children(withAttribute: xmlAttr, nodePtr: next, array:&array, recursive: false)
-        }
-        return array
+        return Array(nodes(in: .siblings, withAttribute: attribute))
     }
     
     /// Returns the first descendant node with the specifed class value.
@@ -1307,12 +2078,11 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(withClass value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return AttributeKey.`class`.withXmlChar { xmlClass in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlClass, matches: xmlValue, nodePtr: childrn, recursive: true)
-            }
+        if let candidates = documentNodeIndex?.nodes(withClass: value, inSubtreeOf: pointer) {
+            let matches = nodeHasAttribute(AttributeKey.`class`, value: value, .matches)
+            return HTMLNode(pointer: candidates.first(where: matches))
         }
+        return nodes(in: .descendants, withAttribute: AttributeKey.`class`, matches: value).first
     }
     
     /// Returns the first child node with the specifed class value.
@@ -1322,12 +2092,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(withClass value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return AttributeKey.`class`.withXmlChar { xmlClass in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlClass, matches: xmlValue, nodePtr: childrn, recursive: false)
-            }
-        }
+        return nodes(in: .children, withAttribute: AttributeKey.`class`, matches: value).first
     }
     
     /// Returns the first sibling node with the specifed class value.
@@ -1337,12 +2102,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(withClass value : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return AttributeKey.`class`.withXmlChar { xmlClass in
-            value.withXmlChar { xmlValue in
-                return child(withAttribute: xmlClass, matches: xmlValue, nodePtr: next, recursive: false)
-            }
-        }
+        return nodes(in: .siblings, withAttribute: AttributeKey.`class`, matches: value).first
     }
     
     /// Returns all descendant nodes with the specifed class value.
@@ -1352,7 +2112,11 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(withClass value : String) -> [HTMLNode]
     {
-        return self.descendants(withAttribute: AttributeKey.`class`, matches: value)
+        if let candidates = documentNodeIndex?.nodes(withClass: value, inSubtreeOf: pointer) {
+            let matches = nodeHasAttribute(AttributeKey.`class`, value: value, .matches)
+            return candidates.filter(matches).map { HTMLNode(pointer: $0)! }
+        }
+        return Array(nodes(in: .descendants, withAttribute: AttributeKey.`class`, matches: value))
     }
     
     /// Returns all child nodes with the specifed class value.
@@ -1362,7 +2126,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(withClass value : String) -> [HTMLNode]
     {
-        return self.children(withAttribute: AttributeKey.`class`, matches: value)
+        return Array(nodes(in: .children, withAttribute: AttributeKey.`class`, matches: value))
     }
     
     /// Returns all sibling nodes with the specifed class value.
@@ -1372,7 +2136,85 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(withClass value : String) -> [HTMLNode]
     {
-        return self.siblings(withAttribute: AttributeKey.`class`, matches: value)
+        return Array(nodes(in: .siblings, withAttribute: AttributeKey.`class`, matches: value))
+    }
+    
+    /// Returns the first descendant node having all specified class names.
+    /// - Parameters:
+    ///   - classNames: A whitespace separated list of class names.
+    /// - Returns: The first found descendant node or nil.
+    
+    func descendant(withClassNames classNames : String) -> HTMLNode?
+    {
+        guard let matches = nodeHasClassNames(classNames) else { return nil }
+        if let candidates = documentNodeIndex?.nodes(withClass: classNames, inSubtreeOf: pointer) {
+            return HTMLNode(pointer: candidates.first(where: matches))
+        }
+        return HTMLNodeSequence(root: pointer, scope: .descendants, predicate: matches).first
+    }
+    
+    /// Returns the first child node having all specified class names.
+    /// - Parameters:
+    ///   - classNames: A whitespace separated list of class names.
+    /// - Returns: The first found child node or nil.
+    
+    func child(withClassNames classNames : String) -> HTMLNode?
+    {
+        return nodes(in: .children, withClassNames: classNames).first
+    }
+    
+    /// Returns the first sibling node having all specified class names.
+    /// - Parameters:
+    ///   - classNames: A whitespace separated list of class names.
+    /// - Returns: The first found sibling node or nil.
+    
+    func sibling(withClassNames classNames : String) -> HTMLNode?
+    {
+        return nodes(in: .siblings, withClassNames: classNames).first
+    }
+    
+    /// Returns all descendant nodes having all specified class names.
+    /// - Parameters:
+    ///   - classNames: A whitespace separated list of class names.
+    /// - Returns: The array of all found descendant nodes or an empty array.
+    
+    func descendants(withClassNames classNames : String) -> [HTMLNode]
+    {
+        guard let matches = nodeHasClassNames(classNames) else { return [] }
+        if let candidates = documentNodeIndex?.nodes(withClass: classNames, inSubtreeOf: pointer) {
+            return candidates.filter(matches).map { HTMLNode(pointer: $0)! }
+        }
+        return Array(HTMLNodeSequence(root: pointer, scope: .descendants, predicate: matches))
+    }
+    
+    /// Returns all child nodes having all specified class names.
+    /// - Parameters:
+    ///   - classNames: A whitespace separated list of class names.
+    /// - Returns: The array of all found child nodes or an empty array.
+    
+    func children(withClassNames classNames : String) -> [HTMLNode]
+    {
+        return Array(nodes(in: .children, withClassNames: classNames))
+    }
+    
+    /// Returns all sibling nodes having all specified class names.
+    /// - Parameters:
+    ///   - classNames: A whitespace separated list of class names.
+    /// - Returns: The array of all found sibling nodes or an empty array.
+    
+    func siblings(withClassNames classNames : String) -> [HTMLNode]
+    {
+        return Array(nodes(in: .siblings, withClassNames: classNames))
+    }
+    
+    /// Returns whether the class attribute of the node contains all specified class names.
+    /// - Parameters:
+    ///   - classNames: A whitespace separated list of class names.
+    /// - Returns: true if the node has all class names.
+    
+    func hasClassNames(_ classNames : String) -> Bool
+    {
+        return nodeHasClassNames(classNames)?(pointer) ?? false
     }
     
     /// Returns the first descendant node with the specifed id value.
@@ -1382,12 +2224,10 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(withID value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return AttributeKey.id.withXmlChar { xmlID in
-            value.withXmlChar { xmlValue in
-               return child(withAttribute: xmlID, matches: xmlValue, nodePtr: childrn, recursive: true)
-            }
+        if let indexedNodes = documentNodeIndex?.nodes(withID: value, inSubtreeOf: pointer) {
+            return HTMLNode(pointer: indexedNodes.first)
         }
+        return nodes(in: .descendants, withAttribute: AttributeKey.id, matches: value).first
     }
     
     /// Returns the first child node with the specifed id value.
@@ -1397,12 +2237,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(withID value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return AttributeKey.id.withXmlChar { xmlID in
-            value.withXmlChar { xmlValue in
-               return child(withAttribute: xmlID, matches: xmlValue, nodePtr: childrn, recursive: false)
-            }
-        }
+        return nodes(in: .children, withAttribute: AttributeKey.id, matches: value).first
     }
     
     /// Returns the first sibling node with the specifed id value.
@@ -1412,58 +2247,9 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(withID value : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return AttributeKey.id.withXmlChar { xmlID in
-            value.withXmlChar { xmlValue in
-               return child(withAttribute: xmlID, matches: xmlValue, nodePtr: next, recursive: false)
-            }
-        }
-    }
-    
-    
-    private func child(ofTag tag : UnsafePointer<xmlChar>,
-                       matches value : UnsafePointer<xmlChar>,
-                       nodePtr : xmlNodePtr,
-                       recursive : Bool) -> HTMLNode?
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let currentNodeName = currentNodePtr.pointee.name,
-                xmlStrEqual(currentNodeName, tag) == 1 {
-                if let childContent = currentNodePtr.pointee.children.pointee.content,
-                    xmlStrEqual(childContent, value) == 1 {
-                    return HTMLNode(pointer: currentNodePtr)
-                }
-            }
-            
-            if recursive, let children = currentNodePtr.pointee.children,
-                let subNode = child(ofTag: tag, matches: value, nodePtr: children, recursive:recursive) {
-                return subNode
-            }
-        }
-        return nil
+        return nodes(in: .siblings, withAttribute: AttributeKey.id, matches: value).first
     }
     
-    private func child(ofTag tag : UnsafePointer<xmlChar>,
-                       contains value : UnsafePointer<xmlChar>,
-                       nodePtr : xmlNodePtr,
-                       recursive : Bool) -> HTMLNode?
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let currentNodeName = currentNodePtr.pointee.name,
-                xmlStrEqual(currentNodeName, tag) == 1 {
-                if let childContent = currentNodePtr.pointee.children.pointee.content,
-                    xmlStrstr(childContent, value) != nil {
-                    return HTMLNode(pointer: currentNodePtr)
-                }
-            }
-            
-            if recursive, let children = currentNodePtr.pointee.children,
-                let subNode = child(ofTag: tag, contains: value, nodePtr: children, recursive:recursive) {
-                return subNode
-            }
-        }
-        return nil
-    }
     
     /// Returns the first descendant node with the specifed tag name and string value matching exactly.
     /// - Parameters:
@@ -1473,12 +2259,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(ofTag tag : String, matches value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-               return child(ofTag: xmlTag, matches: xmlValue,  nodePtr: childrn, recursive: true)
-            }
-        }
+        return nodes(in: .descendants, ofTag: tag, matches: value).first
     }
     
     /// Returns the first child node with the specifed tag name and string value matching exactly.
@@ -1489,12 +2270,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(ofTag tag : String, matches value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                return child(ofTag: xmlTag, matches: xmlValue, nodePtr: childrn, recursive: false)
-            }
-        }
+        return nodes(in: .children, ofTag: tag, matches: value).first
     }
     
     /// Returns the first sibling node with the specifed tag name and string value matching exactly.
@@ -1505,12 +2281,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(ofTag tag : String, matches value : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                return child(ofTag: xmlTag, matches: xmlValue, nodePtr: next, recursive: false)
-            }
-        }
+        return nodes(in: .siblings, ofTag: tag, matches: value).first
     }
     
     /// Returns the first descendant node with the specifed attribute name and the string value contains the specified value.
@@ -1521,12 +2292,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(ofTag tag : String, contains value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                return child(ofTag: xmlTag, contains: xmlValue, nodePtr: childrn, recursive: true)
-            }
-        }
+        return nodes(in: .descendants, ofTag: tag, contains: value).first
     }
     
     /// Returns the child node with the specifed attribute name and the string value contains the specified value.
@@ -1537,12 +2303,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(ofTag tag : String, contains value : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                return child(ofTag: xmlTag, contains: xmlValue, nodePtr: childrn, recursive: false)
-            }
-        }
+        return nodes(in: .children, ofTag: tag, contains: value).first
     }
     
     /// Returns the sibling node with the specifed attribute name and the string value contains the specified value.
@@ -1553,60 +2314,9 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(ofTag tag : String, contains value : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                return child(ofTag: xmlTag, contains: xmlValue, nodePtr: next, recursive: false)
-            }
-        }
-    }
-    
-    
-    private func children(ofTag tag : UnsafePointer<xmlChar>,
-                          matches value : UnsafePointer<xmlChar>,
-                          nodePtr : xmlNodePtr,
-                          array : inout [HTMLNode],
-                          recursive : Bool)
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let currentNodeName = currentNodePtr.pointee.name,
-                xmlStrEqual(currentNodeName, tag) == 1 {
-                if let childContent = currentNodePtr.pointee.children?.pointee.content,
-                    xmlStrEqual(childContent, value) == 1 {
-                    if let matchingNode = HTMLNode(pointer: currentNodePtr) {
-                        array.append(matchingNode)
-                    }
-                }
-            }
-            
-            if recursive, let childrn = currentNodePtr.pointee.children {
-                children(ofTag:tag, matches: value, nodePtr: childrn, array: &array, recursive: recursive)
-            }
-        }
+        return nodes(in: .siblings, ofTag: tag, contains: value).first
     }
     
-    private func children(ofTag tag : UnsafePointer<xmlChar>,
-                          contains value : UnsafePointer<xmlChar>,
-                          nodePtr : xmlNodePtr,
-                          array : inout [HTMLNode],
-                          recursive : Bool)
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let currentNodeName = currentNodePtr.pointee.name,
-                xmlStrEqual(currentNodeName, tag) == 1 {
-                if let childContent = currentNodePtr.pointee.children?.pointee.content,
-                    xmlStrstr(childContent, value) != nil {
-                    if let matchingNode = HTMLNode(pointer: currentNodePtr) {
-                        array.append(matchingNode)
-                    }
-                }
-            }
-            
-            if recursive, let childrn = currentNodePtr.pointee.children {
-                children(ofTag: tag, contains: value, nodePtr: childrn, array: &array, recursive: recursive)
-            }
-        }
-    }
     
     /// Returns all descendant nodes with the specifed tag name and string value matching exactly.
     /// - Parameters:
@@ -1616,14 +2326,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(ofTag tag : String, matches value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                children(ofTag: xmlTag, matches: xmlValue, nodePtr:childrn, array: &array, recursive: true)
-            }
-        }
-        return array
+        return Array(nodes(in: .descendants, ofTag: tag, matches: value))
     }
     
     /// Returns all child nodes with the specifed tag name and string value matching exactly.
@@ -1634,14 +2337,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(ofTag tag : String, matches value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                 children(ofTag: xmlTag, matches: xmlValue, nodePtr:childrn, array: &array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .children, ofTag: tag, matches: value))
     }
     
     /// Returns all sibling nodes with the specifed tag name and string value matching exactly.
@@ -1652,14 +2348,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(ofTag tag : String, matches value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let next = node.next else { return array }
-        tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                children(ofTag: xmlTag, matches: xmlValue, nodePtr: next, array: &array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .siblings, ofTag: tag, matches: value))
     }
     
     /// Returns all descendant nodes with the specifed attribute name and the string value contains the specified value.
@@ -1670,14 +2359,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(ofTag tag : String, contains value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                children(ofTag: xmlTag, contains: xmlValue,  nodePtr: childrn, array: &array, recursive: true)
-            }
-        }
-        return array
+        return Array(nodes(in: .descendants, ofTag: tag, contains: value))
     }
     
     /// Returns all child nodes with the specifed attribute name and the string value contains the specified value.
@@ -1688,14 +2370,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(ofTag tag : String, contains value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                 children(ofTag:xmlTag, contains: xmlValue,  nodePtr: childrn, array: &array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .children, ofTag: tag, contains: value))
     }
     
     /// Returns all sibling nodes with the specifed attribute name and the string value contains the specified value.
@@ -1706,35 +2381,10 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(ofTag tag : String, contains value : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let next = node.next else { return array }
-        tag.withXmlChar { xmlTag in
-            value.withXmlChar { xmlValue in
-                children(ofTag: xmlTag, contains: xmlValue,  nodePtr: next, array: &array, recursive: false)
-            }
-        }
-        return array
+        return Array(nodes(in: .siblings, ofTag: tag, contains: value))
     }
     
     
-    private func child(ofTag tag : UnsafePointer<xmlChar>,
-                       nodePtr : xmlNodePtr!,
-                       recursive : Bool)  -> HTMLNode?
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let currentNodeName = currentNodePtr.pointee.name,
-                xmlStrEqual(currentNodeName, tag) == 1 {
-                return HTMLNode(pointer:currentNodePtr)
-            }
-            
-            if recursive, let children = currentNodePtr.pointee.children,
-                let subNode = child(ofTag: tag, nodePtr:children, recursive:recursive) {
-                return subNode
-            }
-        }
-        return nil
-    }
-    
     /// Returns the first descendant node with the specifed tag name.
     /// - Parameters:
     ///   - tag: The name of the tag.
@@ -1742,10 +2392,10 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendant(ofTag tag : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return tag.withXmlChar { xmlTag in
-            return child(ofTag: xmlTag, nodePtr: childrn, recursive: true)
+        if let indexedNodes = documentNodeIndex?.nodes(ofTag: tag, inSubtreeOf: pointer) {
+            return HTMLNode(pointer: indexedNodes.first)
         }
+        return nodes(in: .descendants, ofTag: tag).first
     }
     
     /// Returns the first child node with the specifed tag name.
@@ -1755,10 +2405,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func child(ofTag tag : String) -> HTMLNode?
     {
-        guard let childrn = node.children else { return nil }
-        return tag.withXmlChar { xmlTag in
-            return child(ofTag: xmlTag, nodePtr: childrn, recursive: false)
-        }
+        return nodes(in: .children, ofTag: tag).first
     }
     
     /// Returns the first sibling node with the specifed tag name.
@@ -1768,29 +2415,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func sibling(ofTag tag : String) -> HTMLNode?
     {
-        guard let next = node.next else { return nil }
-        return tag.withXmlChar { xmlTag in
-                return child(ofTag: xmlTag, nodePtr: next, recursive: false)
-        }
-    }
-    
-    private func children(ofTag tag : UnsafePointer<xmlChar>,
-                          nodePtr : xmlNodePtr,
-                          array : inout [HTMLNode],
-                          recursive : Bool)
-    {
-        for currentNodePtr in XmlNodeSequence(node: nodePtr) {
-            if let currentNodeName = currentNodePtr.pointee.name,
-                xmlStrEqual(currentNodeName, tag) == 1 {
-                if let matchingNode = HTMLNode(pointer: currentNodePtr) {
-                    array.append(matchingNode)
-                }
-            }
-            
-            if recursive, let childrn = currentNodePtr.pointee.children {
-                children(ofTag: tag, nodePtr: childrn, array: &array, recursive: recursive)
-            }
-        }
+        return nodes(in: .siblings, ofTag: tag).first
     }
     
     /// Returns all descendant nodes with the specifed tag name.
@@ -1800,12 +2425,10 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func descendants(ofTag tag : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        tag.withXmlChar { xmlTag in
-            children(ofTag: xmlTag, nodePtr: childrn, array: &array, recursive: true)
+        if let indexedNodes = documentNodeIndex?.nodes(ofTag: tag, inSubtreeOf: pointer) {
+            return indexedNodes.map { HTMLNode(pointer: $0)! }
         }
-        return array
+        return Array(nodes(in: .descendants, ofTag: tag))
     }
     
     /// Returns all child nodes with the specifed tag name.
@@ -1815,12 +2438,7 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func children(ofTag tag : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let childrn = node.children else { return array }
-        tag.withXmlChar { xmlTag in
-            children(ofTag: xmlTag, nodePtr: childrn, array: &array, recursive: false)
-        }
-        return array
+        return Array(nodes(in: .children, ofTag: tag))
     }
     
     /// Returns all sibling nodes with the specifed tag name.
@@ -1830,12 +2448,45 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     
     func siblings(ofTag tag : String) -> [HTMLNode]
     {
-        var array = [HTMLNode]()
-        guard let next = node.next else { return array }
-        tag.withXmlChar { xmlTag in
-            children(ofTag: xmlTag, nodePtr: next, array:&array, recursive: false)
+        return Array(nodes(in: .siblings, ofTag: tag))
+    }
+    
+    // MARK: -  batch query method
+    
+    /// Evaluates several queries in one pass over the descendants of the current node.
+    /// The pass ends early as soon as all queries have found their first match, if all queries are first-only.
+    /// - Parameters:
+    ///   - queries: The queries.
+    /// - Returns: An array of the same count as queries with the found nodes in document order for each query,
+    ///   the array of a first-only query contains at most one node.
+    
+    func descendants(matching queries: [HTMLNodeQuery]) -> [[HTMLNode]]
+    {
+        var results = [[HTMLNode]](repeating: [], count: queries.count)
+        guard !queries.isEmpty else { return results }
+        
+        let predicates = queries.map { $0.predicate }
+        var done = [Bool](repeating: false, count: queries.count)
+        var pending = queries.filter { $0.firstOnly }.count
+        let unbounded = pending < queries.count
+        
+        // one query of the instrumentation, the sequence of all descendants isn't measured by itself
+        let interval = HTMLQueryInterval.begin(.search)
+        defer { interval?.end() }
+        var iterator = HTMLNodeSequence(root: pointer, scope: .descendants, kind: nil).makeIterator()
+        while unbounded || pending > 0, let nodePtr = iterator.nextPointer() {
+            interval?.nodesVisited += 1
+            for i in queries.indices where !done[i] && predicates[i](nodePtr) {
+                interval?.matches += 1
+                interval?.wrappersAllocated += 1
+                results[i].append(HTMLNode(pointer: nodePtr)!)
+                if queries[i].firstOnly {
+                    done[i] = true
+                    pending -= 1
+                }
+            }
         }
-        return array
+        return results
     }
     
     // MARK: mark - description
@@ -1852,37 +2503,98 @@ class HTMLNode : Sequence, Equatable, CustomStringConvertible {
     }
     
     // sequence generator to be able to write "for item in HTMLNode" as a shortcut for "for item in HTMLNode.children"
+    // delete the predicate to consider all the text nodes
     
-    func makeIterator() -> HTMLNodeIterator {
-        return HTMLNodeIterator(node: self)
+    func makeIterator() -> HTMLNodeSequence.Iterator {
+        return HTMLNodeSequence(root: pointer, scope: .children, predicate: { xmlNodeIsText($0) == 0 }, kind: nil).makeIterator()
     }
     
     // MARK: -  Equation protocol
     
+    // node objects are equal if they represent the same xmlNode, so they can be de-duplicated in a Set
+    
     static func == (lhs: HTMLNode, rhs: HTMLNode) -> Bool {
-        return xmlXPathCmpNodes(lhs.pointer, rhs.pointer) == 0
+        return lhs.pointer == rhs.pointer
     }
-}
-
-struct HTMLNodeIterator : IteratorProtocol {
-    var node: xmlNodePtr?
     
-    init(node: HTMLNode) {
-        self.node = node.pointer.pointee.children
+    func hash(into hasher: inout Hasher) {
+        hasher.combine(pointer)
     }
     
-    mutating func next() -> HTMLNode? {
-        if xmlNodeIsText(node) == 1 {
-            node = node?.pointee.next
-            if node == nil  { return .none }
+    // MARK: -  document order
+    
+    /// Compares the position of the current node with another node in document order. The elements are numbered once per document
+    /// by `HTMLDocument.prepareDocumentOrder()`, so the comparison of two elements takes O(1), other nodes are compared by their ancestors.
+    /// - Parameters:
+    ///   - node: The node with which to compare the current node.
+    /// - Returns: `.orderedAscending` if the current node precedes the node, `.orderedDescending` if it follows the node and `.orderedSame` for the same node.
+    ///   Nodes of different documents are ordered by their documents, nodes of unlinked subtrees by their subtrees.
+    
+    func compareDocumentOrder(_ node: HTMLNode) -> ComparisonResult
+    {
+        if pointer != node.pointer, let document = owningDocument, document === node.owningDocument {
+            document.prepareDocumentOrder()
         }
-        let nextNode = HTMLNode(pointer:node)
-        node = node?.pointee.next
-        return node == nil ?  .none : nextNode
+        return documentOrder(pointer, node.pointer)
     }
     
+    static func < (lhs: HTMLNode, rhs: HTMLNode) -> Bool {
+        return lhs.compareDocumentOrder(rhs) == .orderedAscending
+    }
 }
 
+// the document order of two nodes, xmlXPathCmpNodes compares two numbered elements without walking their ancestors.
+// Nodes of different documents are ordered by the address of their documents, the trees of unlinked subtrees by the address
+// of their roots, so the order stays a strict total order as sorted() and Comparable require
 
+private func documentOrder(_ node1: xmlNodePtr, _ node2: xmlNodePtr) -> ComparisonResult {
+    if node1 == node2 { return .orderedSame }
+    if node1.pointee.doc != node2.pointee.doc {
+        let address1 = UInt(bitPattern: node1.pointee.doc), address2 = UInt(bitPattern: node2.pointee.doc)
+        return address1 < address2 ? .orderedAscending : .orderedDescending
+    }
+    switch xmlXPathCmpNodes(node1, node2) {
+    case 1: return .orderedAscending
+    case -1: return .orderedDescending
+    default:
+        // nodes of different trees
+        let root1 = rootOfTree(node1), root2 = rootOfTree(node2)
+        if root1 != root2 { return UInt(bitPattern: root1) < UInt(bitPattern: root2) ? .orderedAscending : .orderedDescending }
+        return UInt(bitPattern: node1) < UInt(bitPattern: node2) ? .orderedAscending : .orderedDescending
+    }
+}
 
+// the topmost ancestor of a node, the document or the root of an unlinked subtree
+private func rootOfTree(_ node: xmlNodePtr) -> xmlNodePtr {
+    var root = node
+    while let parent = root.pointee.parent { root = parent }
+    return root
+}
 
+extension Sequence where Element == HTMLNode {
+    
+    /// Sorts the nodes in document order, e.g. to merge the results of several queries.
+    /// - Parameters:
+    ///   - removeDuplicates: true to keep only one node object of the nodes occurring several times (optional, default is false).
+    /// - Returns: The sorted array of the nodes.
+    
+    func sortedInDocumentOrder(removingDuplicates removeDuplicates: Bool = false) -> [HTMLNode]
+    {
+        let nodes = Array(self)
+        // each document is numbered once before the sort
+        var previousDocument : HTMLDocument?
+        for node in nodes {
+            guard let document = node.owningDocument, document !== previousDocument else { continue }
+            document.prepareDocumentOrder()
+            previousDocument = document
+        }
+        
+        let sortedNodes = nodes.sorted { documentOrder($0.pointer, $1.pointer) == .orderedAscending }
+        guard removeDuplicates else { return sortedNodes }
+        var previousPointer : xmlNodePtr?
+        return sortedNodes.filter { node in
+            defer { previousPointer = node.pointer }
+            return node.pointer != previousPointer
+        }
+    }
+}
@@ -0,0 +1,698 @@
+/*###################################################################################
+ #                                                                                   #
+ #    HTMLParser.swift                                                               #
+ #                                                                                   #
+ #    Copyright © 2014-2017 by Stefan Klieme                                         #
+ #                                                                                   #
+ #    Swift wrapper for HTML parser of libxml2                                       #
+ #                                                                                   #
+ #    Version 1.1 - 13. Sep 2017                                                     #
+ #                                                                                   #
+ #    usage:     add libxml2.dylib to frameworks (depends on autoload settings)      #
+ #               add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths   #
+ #               add -lxml2 to target -> other linker flags                          #
+ #               add Bridging-Header.h to your project and rename it as              #
+ #                  [Modulename]-Bridging-Header.h                                   #
+ #                  where [Modulename] is the module name in your project            #
+ #                  or copy&paste the #import lines into your bridging header        #
+ #                                                                                   #
+ #####################################################################################
+ #                                                                                   #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+ # this software and associated documentation files (the "Software"), to deal        #
+ # in the Software without restriction, including without limitation the rights      #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+ # of the Software, and to permit persons to whom the Software is furnished to do    #
+ # so, subject to the following conditions:                                          #
+ # The above copyright notice and this permission notice shall be included in        #
+ # all copies or substantial portions of the Software.                               #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+ #                                                                                   #
+ ###################################################################################*/
+
+import Foundation
+
+// the encoding cannot be passed as name to the push parser, switch the input explicitly
+// and record the name for the document like htmlReadMemory() does
+
+private func switchPushParserEncoding(_ context: htmlParserCtxtPtr, _ encoding: String.Encoding)
+{
+    if let cEncoding = convertStringEncoding(encoding),
+        let encodingHandler = xmlFindCharEncodingHandler(cEncoding),
+        xmlSwitchToEncoding(context, encodingHandler) == 0 {
+        cEncoding.withMemoryRebound(to: xmlChar.self, capacity: 1) { xmlEncoding in
+            xmlFree(UnsafeMutablePointer(mutating: context.pointee.input.pointee.encoding))
+            context.pointee.input.pointee.encoding = UnsafePointer(xmlStrdup(xmlEncoding))
+        }
+    }
+}
+
+// Returns a copy of the string allocated by libxml2, the caller frees it with xmlFree
+
+private func copyXMLString(_ string: String?) -> UnsafeMutablePointer<xmlChar>?
+{
+    return string?.withCString { xmlStrdup(UnsafeRawPointer($0).assumingMemoryBound(to: xmlChar.self)) }
+}
+
+// MARK: - tag filter
+
+// The filter replaces the SAX callbacks of a parser context and forwards only the events outside of discarded subtrees
+// to the original tree building callbacks. The filter object is stored unretained in the _private field of the context
+
+private final class HTMLTagFilter {
+    
+    let tagNames : [UnsafeMutablePointer<xmlChar>]
+    var keepsElements = false
+    var depth = 0 // > 0 inside a discarded subtree
+    
+    private var savedPrivate : UnsafeMutableRawPointer?
+    fileprivate var startElement : startElementSAXFunc?
+    fileprivate var endElement : endElementSAXFunc?
+    fileprivate var characters : charactersSAXFunc?
+    fileprivate var ignorableWhitespace : ignorableWhitespaceSAXFunc?
+    fileprivate var cdataBlock : cdataBlockSAXFunc?
+    fileprivate var comment : commentSAXFunc?
+    fileprivate var processingInstruction : processingInstructionSAXFunc?
+    
+    init?(tagNames: Set<String>)
+    {
+        guard !tagNames.isEmpty else { return nil }
+        // the HTML parser reports tag names in lowercase
+        self.tagNames = tagNames.map { copyXMLString($0.lowercased())! }
+    }
+    
+    deinit {
+        tagNames.forEach { xmlFree($0) }
+    }
+    
+    func matches(_ name: UnsafePointer<xmlChar>?) -> Bool
+    {
+        return tagNames.contains { xmlStrEqual(name, $0) != 0 }
+    }
+    
+    static func filter(of ctx: UnsafeMutableRawPointer?) -> HTMLTagFilter
+    {
+        let context = ctx!.assumingMemoryBound(to: xmlParserCtxt.self)
+        return Unmanaged<HTMLTagFilter>.fromOpaque(context.pointee._private).takeUnretainedValue()
+    }
+    
+    // installs the filter callbacks, the context must have been created with the default SAX handler (user data is the context)
+    func attach(to context: htmlParserCtxtPtr, keepsElements: Bool)
+    {
+        self.keepsElements = keepsElements
+        depth = 0
+        savedPrivate = context.pointee._private
+        let sax = context.pointee.sax!
+        startElement = sax.pointee.startElement
+        endElement = sax.pointee.endElement
+        characters = sax.pointee.characters
+        ignorableWhitespace = sax.pointee.ignorableWhitespace
+        cdataBlock = sax.pointee.cdataBlock
+        comment = sax.pointee.comment
+        processingInstruction = sax.pointee.processingInstruction
+        
+        sax.pointee.startElement = { ctx, name, atts in
+            let filter = HTMLTagFilter.filter(of: ctx)
+            if filter.depth > 0 {
+                filter.depth += 1
+                return
+            }
+            if filter.matches(name) {
+                filter.depth = 1
+                if !filter.keepsElements { return }
+            }
+            filter.startElement?(ctx, name, atts)
+        }
+        sax.pointee.endElement = { ctx, name in
+            let filter = HTMLTagFilter.filter(of: ctx)
+            if filter.depth > 0 {
+                filter.depth -= 1
+                if filter.depth > 0 || !filter.keepsElements { return }
+            }
+            filter.endElement?(ctx, name)
+        }
+        sax.pointee.characters = { ctx, ch, len in
+            let filter = HTMLTagFilter.filter(of: ctx)
+            if filter.depth == 0 { filter.characters?(ctx, ch, len) }
+        }
+        sax.pointee.ignorableWhitespace = { ctx, ch, len in
+            let filter = HTMLTagFilter.filter(of: ctx)
+            if filter.depth == 0 { filter.ignorableWhitespace?(ctx, ch, len) }
+        }
+        sax.pointee.cdataBlock = { ctx, value, len in
+            let filter = HTMLTagFilter.filter(of: ctx)
+            if filter.depth == 0 { filter.cdataBlock?(ctx, value, len) }
+        }
+        sax.pointee.comment = { ctx, value in
+            let filter = HTMLTagFilter.filter(of: ctx)
+            if filter.depth == 0 { filter.comment?(ctx, value) }
+        }
+        sax.pointee.processingInstruction = { ctx, target, data in
+            let filter = HTMLTagFilter.filter(of: ctx)
+            if filter.depth == 0 { filter.processingInstruction?(ctx, target, data) }
+        }
+        context.pointee._private = Unmanaged.passUnretained(self).toOpaque()
+    }
+    
+    // restores the original callbacks, htmlCtxtUseOptions may have replaced ignorableWhitespace for HTML_PARSE_NOBLANKS already
+    func detach(from context: htmlParserCtxtPtr)
+    {
+        let sax = context.pointee.sax!
+        sax.pointee.startElement = startElement
+        sax.pointee.endElement = endElement
+        sax.pointee.characters = characters
+        sax.pointee.cdataBlock = cdataBlock
+        sax.pointee.comment = comment
+        sax.pointee.processingInstruction = processingInstruction
+        if context.pointee.keepBlanks != 0 { sax.pointee.ignorableWhitespace = ignorableWhitespace }
+        context.pointee._private = savedPrivate
+    }
+}
+
+// MARK: -
+
+/// HTMLPushParser builds an HTMLDocument incrementally from data chunks,
+/// e.g. passed in the URLSessionDataDelegate method `urlSession(_:dataTask:didReceive:)`.
+
+class HTMLPushParser {
+    
+    /// The parser context, nil after the parser has been finished.
+    
+    private var parserContext: htmlParserCtxtPtr?
+    
+    /// The number of bytes appended so far.
+    
+    private(set) var numberOfBytes = 0
+    
+    /// The names of the tags whose subtrees are discarded while parsing, e.g. script, style, noscript or svg.
+    /// Must be set before the first chunk is appended.
+    
+    var discardedTagNames = Set<String>()
+    
+    /// Keep the discarded tags as empty elements (with attributes) instead of removing them completely, default is false.
+    
+    var keepsDiscardedElements = false
+    
+    private var tagFilter : HTMLTagFilter?
+    
+    /// Is the parser finished.
+    
+    var isFinished : Bool {
+        return parserContext == nil
+    }
+    
+    // MARK: - Initialzers
+    
+    /// Initializes and returns an HTMLPushParser object with specified string encoding and parse options.
+    /// - Parameters:
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
+    /// - Returns: An initialized HTMLPushParser object, or nil if the parser context could not be created.
+    
+    init?(encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default)
+    {
+        guard let context = htmlCreatePushParserCtxt(nil, nil, nil, 0, nil, XML_CHAR_ENCODING_NONE) else { return nil }
+        htmlCtxtUseOptions(context, options.rawValue)
+        
+        switchPushParserEncoding(context, encoding)
+        self.parserContext = context
+    }
+    
+    deinit {
+        if let context = parserContext {
+            xmlFreeDoc(context.pointee.myDoc)
+            htmlFreeParserCtxt(context)
+        }
+    }
+    
+    // MARK: - parsing
+    
+    /// Parses the next chunk of HTML content.
+    /// - Parameters:
+    ///   - data: A data object with the next part of the HTML content.
+    /// - Throws: HTMLDocumentError.parserFinished if the parser has already been finished.
+    
+    func append(_ data: Data) throws
+    {
+        guard let context = parserContext else { throw HTMLDocumentError.parserFinished }
+        guard !data.isEmpty else { return }
+        
+        if numberOfBytes == 0 && tagFilter == nil {
+            tagFilter = HTMLTagFilter(tagNames: discardedTagNames)
+            tagFilter?.attach(to: context, keepsElements: keepsDiscardedElements)
+        }
+        
+        data.withUnsafeBytes { (buffer: UnsafeRawBufferPointer) in
+            // htmlParseChunk takes an int size, pass oversized buffers in slices
+            var offset = 0
+            while offset < buffer.count {
+                let chunkSize = min(buffer.count - offset, Int(CInt.max))
+                let chunk = buffer.baseAddress!.advanced(by: offset).assumingMemoryBound(to: CChar.self)
+                htmlParseChunk(context, chunk, CInt(chunkSize), 0)
+                offset += chunkSize
+            }
+        }
+        numberOfBytes += data.count
+    }
+    
+    /// Terminates parsing and returns the document. The parser cannot be used any more afterwards.
+    /// - Returns: An initialized HTMLDocument object, if no valid HTML content has been appended an error is thrown.
+    
+    func finish() throws -> HTMLDocument
+    {
+        guard let context = parserContext else { throw HTMLDocumentError.parserFinished }
+        
+        htmlParseChunk(context, nil, 0, 1)
+        let htmlDoc = context.pointee.myDoc
+        context.pointee.myDoc = nil
+        htmlFreeParserCtxt(context)
+        parserContext = nil
+        
+        guard numberOfBytes > 0 else {
+            xmlFreeDoc(htmlDoc)
+            throw HTMLDocumentError.dataEmpty
+        }
+        return try HTMLDocument(htmlDoc: htmlDoc)
+    }
+}
+
+/// HTMLParser keeps one libxml2 parser context and its name dictionary alive across many documents.
+/// An HTMLParser object must not be used on several threads simultaneously, use `HTMLParser.current` instead.
+
+class HTMLParser {
+    
+    // the dictionary of a long-lived context collects every tag and attribute name ever seen,
+    // the context is recreated when it exceeds this number of entries
+    private static let maximumDictionarySize = 1 << 16
+    
+    private static let threadDictionaryKey = "com.klieme.HTMLParser"
+    
+    /// The HTMLParser object of the current thread, it's created on first access.
+    
+    static var current : HTMLParser {
+        let threadDictionary = Thread.current.threadDictionary
+        if let parser = threadDictionary[threadDictionaryKey] as? HTMLParser {
+            return parser
+        }
+        let parser = HTMLParser()
+        threadDictionary[threadDictionaryKey] = parser
+        return parser
+    }
+    
+    private var parserContext: htmlParserCtxtPtr?
+    
+    /// The options passed to the libxml2 parser.
+    
+    var options : HTMLParseOptions
+    
+    /// The number of documents parsed so far.
+    
+    private(set) var numberOfDocuments = 0
+    
+    /// The names of the tags whose subtrees are discarded while parsing, e.g. script, style, noscript or svg.
+    
+    var discardedTagNames = Set<String>() {
+        didSet { tagFilter = HTMLTagFilter(tagNames: discardedTagNames) }
+    }
+    
+    /// Keep the discarded tags as empty elements (with attributes) instead of removing them completely, default is false.
+    
+    var keepsDiscardedElements = false
+    
+    private var tagFilter : HTMLTagFilter?
+    
+    /// Allocate each document in an arena which is released in one step with the document instead of freeing the tree node by node.
+    /// Enabling the arenas installs arena aware allocation functions in libxml2 for the whole process, they forward to malloc() outside of the parser calls.
+    /// The parser context isn't reused for arena documents, default is false.
+    
+    var usesArena = false
+    
+    // MARK: - Initialzers
+    
+    /// Initializes and returns an HTMLParser object with specified parse options.
+    /// - Parameters:
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default).
+    /// - Returns: An initialized HTMLParser object, the parser context is created on first use.
+    
+    init(options: HTMLParseOptions = .default)
+    {
+        self.options = options
+    }
+    
+    deinit {
+        if let context = parserContext { htmlFreeParserCtxt(context) }
+    }
+    
+    // MARK: - parsing
+    
+    /// Parses a Data object with specified string encoding reusing the parser context.
+    /// - Parameters:
+    ///   - data: A data object with HTML content.
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    /// - Returns: An initialized HTMLDocument object, if parsing fails an error is thrown.
+    
+    func document(with data: Data, encoding: String.Encoding = .utf8) throws -> HTMLDocument
+    {
+        guard !data.isEmpty else { throw HTMLDocumentError.dataEmpty }
+        guard data.count <= Int(CInt.max) else { throw HTMLDocumentError.invalidData }
+        if usesArena { return try arenaDocument(with: data, encoding: encoding) }
+        
+        if let context = parserContext, xmlDictSize(context.pointee.dict) > HTMLParser.maximumDictionarySize {
+            htmlFreeParserCtxt(context)
+            parserContext = nil
+        }
+        if parserContext == nil { parserContext = htmlNewParserCtxt() }
+        guard let context = parserContext else { throw HTMLDocumentError.couldNotParse }
+        
+        // htmlCtxtReadMemory resets the context but keeps its dictionary and input buffers
+        let cEncoding = convertStringEncoding(encoding)
+        tagFilter?.attach(to: context, keepsElements: keepsDiscardedElements)
+        let (htmlDoc, parseTime) = measureParse {
+            data.withUnsafeBytes { (buffer: UnsafeRawBufferPointer) -> htmlDocPtr? in
+                let bytes = buffer.baseAddress!.assumingMemoryBound(to: CChar.self)
+                return htmlCtxtReadMemory(context, bytes, CInt(buffer.count), nil, cEncoding, options.rawValue)
+            }
+        }
+        tagFilter?.detach(from: context)
+        numberOfDocuments += 1
+        let document = try HTMLDocument(htmlDoc: htmlDoc)
+        if let parseTime = parseTime { document.parseMeasurement = (parseTime, data.count) }
+        return document
+    }
+    
+    // A temporary parser context is created in the arena, its dictionary belongs to the document and must not outlive the arena.
+    // The context isn't reused, the arena makes creating and releasing it cheap
+    
+    private func arenaDocument(with data: Data, encoding: String.Encoding) throws -> HTMLDocument
+    {
+        guard let arena = HTMLArena() else { throw HTMLDocumentError.couldNotParse }
+        
+        let cEncoding = convertStringEncoding(encoding)
+        let (htmlDoc, parseTime) = try measureParse {
+            try arena.perform { () throws -> htmlDocPtr? in
+                guard let context = htmlNewParserCtxt() else { throw HTMLDocumentError.couldNotParse }
+                defer { htmlFreeParserCtxt(context) }
+                tagFilter?.attach(to: context, keepsElements: keepsDiscardedElements)
+                defer { tagFilter?.detach(from: context) }
+                return data.withUnsafeBytes { (buffer: UnsafeRawBufferPointer) -> htmlDocPtr? in
+                    let bytes = buffer.baseAddress!.assumingMemoryBound(to: CChar.self)
+                    return htmlCtxtReadMemory(context, bytes, CInt(buffer.count), nil, cEncoding, options.rawValue)
+                }
+            }
+        }
+        numberOfDocuments += 1
+        let document = try HTMLDocument(htmlDoc: htmlDoc, arena: arena)
+        if let parseTime = parseTime { document.parseMeasurement = (parseTime, data.count) }
+        return document
+    }
+    
+    /// Parses a string containing HTML markup text reusing the parser context.
+    /// - Parameters:
+    ///   - string: A string containing the HTML source.
+    /// - Returns: An initialized HTMLDocument object, if parsing fails an error is thrown.
+    
+    func document(with string: String) throws -> HTMLDocument
+    {
+        return try document(with: Data(string.utf8))
+    }
+}
+
+// MARK: - streaming extraction
+
+/// HTMLExtractionRule describes a value reported by HTMLStreamExtractor,
+/// e.g. tag a, attribute href or tag meta with name=description, attribute content.
+
+struct HTMLExtractionRule {
+    
+    /// The name of the tag.
+    let tagName : String
+    
+    /// The name of the reported attribute, nil for the text content.
+    let attributeName : String?
+    
+    /// The name of an attribute the tag must have.
+    let matchAttributeName : String?
+    
+    /// The value the matching attribute must have (case insensitive), nil matches any value.
+    let matchAttributeValue : String?
+    
+    /// Initializes and returns an HTMLExtractionRule reporting an attribute value or the text content of a tag with an optional matching attribute.
+    /// - Parameters:
+    ///   - tagName: The name of the tag.
+    ///   - attributeName: The name of the reported attribute, if nil the text content of the tag is reported.
+    ///   - matchAttributeName: The name of an attribute the tag must have (optional).
+    ///   - matchAttributeValue: The value the matching attribute must have (optional), if nil any value matches.
+    
+    init(tagName: String, attributeName: String?, matchingAttribute matchAttributeName: String? = nil, value matchAttributeValue: String? = nil)
+    {
+        // the HTML parser reports tag and attribute names in lowercase
+        self.tagName = tagName.lowercased()
+        self.attributeName = attributeName?.lowercased()
+        self.matchAttributeName = matchAttributeName?.lowercased()
+        self.matchAttributeValue = matchAttributeValue
+    }
+}
+
+/// HTMLStreamExtractor reports the values described by extraction rules while the HTML content is parsed with SAX callbacks.
+/// No tree is built, the memory usage is independent of the size of the document.
+/// Text content is reported trimmed, while a text rule is active other text rules are not evaluated.
+/// An HTMLStreamExtractor object must not be used on several threads simultaneously.
+
+class HTMLStreamExtractor {
+    
+    typealias Handler = (HTMLExtractionRule, String, inout Bool) -> Void
+    
+    private struct CompiledRule {
+        let tagName : UnsafeMutablePointer<xmlChar>
+        let attributeName : UnsafeMutablePointer<xmlChar>? // nil reports the text content
+        let matchAttributeName : UnsafeMutablePointer<xmlChar>?
+        let matchAttributeValue : UnsafeMutablePointer<xmlChar>?
+    }
+    
+    /// The extraction rules.
+    
+    let rules : [HTMLExtractionRule]
+    
+    private let compiledRules : [CompiledRule]
+    private var context : htmlParserCtxtPtr?
+    private var handler : Handler?
+    private var textRule : Int? // index of the rule collecting text
+    private var textDepth = 0
+    private let textBuffer = xmlBufferCreate()
+    private var stopped = false
+    
+    // MARK: - Initialzers
+    
+    /// Initializes and returns an HTMLStreamExtractor object with specified rules.
+    /// - Parameters:
+    ///   - rules: An array of extraction rules.
+    
+    init(rules: [HTMLExtractionRule])
+    {
+        self.rules = rules
+        self.compiledRules = rules.map { CompiledRule(tagName: copyXMLString($0.tagName)!,
+                                                      attributeName: copyXMLString($0.attributeName),
+                                                      matchAttributeName: copyXMLString($0.matchAttributeName),
+                                                      matchAttributeValue: copyXMLString($0.matchAttributeValue)) }
+    }
+    
+    deinit {
+        for rule in compiledRules {
+            xmlFree(rule.tagName)
+            if let name = rule.attributeName { xmlFree(name) }
+            if let name = rule.matchAttributeName { xmlFree(name) }
+            if let value = rule.matchAttributeValue { xmlFree(value) }
+        }
+        xmlBufferFree(textBuffer)
+    }
+    
+    // MARK: - SAX callbacks
+    
+    private static func extractor(of ctx: UnsafeMutableRawPointer?) -> HTMLStreamExtractor
+    {
+        return Unmanaged<HTMLStreamExtractor>.fromOpaque(ctx!).takeUnretainedValue()
+    }
+    
+    private static func attributeValue(_ atts: UnsafeMutablePointer<UnsafePointer<xmlChar>?>?, _ name: UnsafePointer<xmlChar>) -> UnsafePointer<xmlChar>?
+    {
+        guard let atts = atts else { return nil }
+        var i = 0
+        while let attributeName = atts[i] {
+            // attributes without value are reported with an empty value
+            if xmlStrEqual(attributeName, name) != 0 { return atts[i + 1] ?? UnsafePointer(emptyValue) }
+            i += 2
+        }
+        return nil
+    }
+    
+    private static let emptyValue : UnsafeMutablePointer<xmlChar> = {
+        let value = UnsafeMutablePointer<xmlChar>.allocate(capacity: 1)
+        value.pointee = 0
+        return value
+    }()
+    
+    private func matches(_ rule: CompiledRule, _ name: UnsafePointer<xmlChar>?, _ atts: UnsafeMutablePointer<UnsafePointer<xmlChar>?>?) -> Bool
+    {
+        guard xmlStrEqual(rule.tagName, name) != 0 else { return false }
+        if let matchAttributeName = rule.matchAttributeName {
+            guard let value = HTMLStreamExtractor.attributeValue(atts, matchAttributeName) else { return false }
+            if let matchAttributeValue = rule.matchAttributeValue, xmlStrcasecmp(value, matchAttributeValue) != 0 { return false }
+        }
+        return true
+    }
+    
+    private func startElement(_ name: UnsafePointer<xmlChar>?, _ atts: UnsafeMutablePointer<UnsafePointer<xmlChar>?>?)
+    {
+        guard !stopped else { return }
+        if let index = textRule, xmlStrEqual(name, compiledRules[index].tagName) != 0 { textDepth += 1 }
+        
+        for (index, rule) in compiledRules.enumerated() where !stopped && matches(rule, name, atts) {
+            if let attributeName = rule.attributeName {
+                if let value = HTMLStreamExtractor.attributeValue(atts, attributeName) {
+                    report(value, length: Int(xmlStrlen(value)), forRuleAt: index)
+                }
+            } else if textRule == nil {
+                textRule = index
+                textDepth = 1
+                xmlBufferEmpty(textBuffer)
+            }
+        }
+    }
+    
+    private func endElement(_ name: UnsafePointer<xmlChar>?)
+    {
+        guard !stopped, let index = textRule, xmlStrEqual(name, compiledRules[index].tagName) != 0 else { return }
+        textDepth -= 1
+        if textDepth == 0 {
+            textRule = nil
+            report(xmlBufferContent(textBuffer), length: Int(xmlBufferLength(textBuffer)), forRuleAt: index)
+        }
+    }
+    
+    private func report(_ value: UnsafePointer<xmlChar>?, length: Int, forRuleAt index: Int)
+    {
+        let buffer = UnsafeBufferPointer(start: value, count: value == nil ? 0 : length)
+        var string = String(decoding: buffer, as: UTF8.self)
+        if compiledRules[index].attributeName == nil { string = string.trimmingCharacters(in: .whitespacesAndNewlines) }
+        
+        var stop = false
+        handler?(rules[index], string, &stop)
+        if stop {
+            stopped = true
+            xmlStopParser(context)
+        }
+    }
+    
+    // MARK: - extraction
+    
+    private func begin(encoding: String.Encoding) throws
+    {
+        var saxHandler = htmlSAXHandler()
+        saxHandler.startElement = { ctx, name, atts in HTMLStreamExtractor.extractor(of: ctx).startElement(name, atts) }
+        saxHandler.endElement = { ctx, name in HTMLStreamExtractor.extractor(of: ctx).endElement(name) }
+        saxHandler.characters = { ctx, ch, len in
+            let extractor = HTMLStreamExtractor.extractor(of: ctx)
+            if extractor.textRule != nil && !extractor.stopped { xmlBufferAdd(extractor.textBuffer, ch, len) }
+        }
+        
+        let userData = Unmanaged.passUnretained(self).toOpaque()
+        guard let context = htmlCreatePushParserCtxt(&saxHandler, userData, nil, 0, nil, XML_CHAR_ENCODING_NONE) else { throw HTMLDocumentError.couldNotParse }
+        let htmlParseOptions : HTMLParseOptions = [.default, .noNet]
+        htmlCtxtUseOptions(context, htmlParseOptions.rawValue)
+        switchPushParserEncoding(context, encoding)
+        self.context = context
+        textRule = nil
+        textDepth = 0
+        stopped = false
+    }
+    
+    // returns false if parsing has been stopped
+    private func push(_ buffer: UnsafeRawBufferPointer) -> Bool
+    {
+        var offset = 0
+        while offset < buffer.count && !stopped {
+            let chunkSize = min(buffer.count - offset, Int(CInt.max))
+            htmlParseChunk(context, buffer.baseAddress!.advanced(by: offset).assumingMemoryBound(to: CChar.self), CInt(chunkSize), 0)
+            offset += chunkSize
+        }
+        return !stopped
+    }
+    
+    private func end()
+    {
+        if !stopped { htmlParseChunk(context, nil, 0, 1) }
+        htmlFreeParserCtxt(context)
+        context = nil
+        handler = nil
+    }
+    
+    /// Parses a Data object with specified string encoding and reports the values matching the rules.
+    /// - Parameters:
+    ///   - data: A data object with HTML content.
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - handler: The closure called for each match with the rule and the value, set the inout parameter to true to stop parsing.
+    /// - Throws: HTMLDocumentError.dataEmpty if the data object is empty.
+    
+    func extract(from data: Data, encoding: String.Encoding = .utf8, handler: Handler) throws
+    {
+        guard !data.isEmpty else { throw HTMLDocumentError.dataEmpty }
+        
+        try withoutActuallyEscaping(handler) { escapableHandler in
+            try begin(encoding: encoding)
+            self.handler = escapableHandler
+            defer { end() }
+            _ = data.withUnsafeBytes { push($0) }
+        }
+    }
+    
+    /// Parses the HTML contents of a URL-referenced source with specified string encoding and reports the values matching the rules.
+    /// The contents of file URLs are read in chunks.
+    /// - Parameters:
+    ///   - url: An URL object specifying a URL source.
+    ///   - encoding: The string encoding for the HTML content (optional, default is UTF8).
+    ///   - handler: The closure called for each match with the rule and the value, set the inout parameter to true to stop parsing.
+    /// - Throws: An error if the contents could not be read or are empty.
+    
+    func extract(contentsOf url: URL, encoding: String.Encoding = .utf8, handler: Handler) throws
+    {
+        guard url.isFileURL else {
+            try extract(from: Data(contentsOf: url), encoding: encoding, handler: handler)
+            return
+        }
+        
+        let fd = open(url.path, O_RDONLY)
+        guard fd >= 0 else { throw POSIXError(POSIXErrorCode(rawValue: errno) ?? .EIO) }
+        defer { close(fd) }
+        
+        var numberOfBytes = 0
+        var readError : CInt = 0
+        try withoutActuallyEscaping(handler) { escapableHandler in
+            try begin(encoding: encoding)
+            self.handler = escapableHandler
+            defer { end() }
+            
+            var buffer = [UInt8](repeating: 0, count: 65536)
+            readLoop: while true {
+                let bytesRead = buffer.withUnsafeMutableBytes { read(fd, $0.baseAddress, $0.count) }
+                switch bytesRead {
+                case 0: break readLoop
+                case ..<0:
+                    if errno == EINTR { continue }
+                    readError = errno
+                    break readLoop
+                default:
+                    numberOfBytes += bytesRead
+                    let pushed = buffer.withUnsafeBytes { push(UnsafeRawBufferPointer(rebasing: $0[0..<bytesRead])) }
+                    if !pushed { break readLoop }
+                }
+            }
+        }
+        if readError != 0 { throw POSIXError(POSIXErrorCode(rawValue: readError) ?? .EIO) }
+        if numberOfBytes == 0 { throw HTMLDocumentError.dataEmpty }
+    }
+}
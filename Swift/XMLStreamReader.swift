@@ -0,0 +1,174 @@
+/*###################################################################################
+ #                                                                                   #
+ #    XMLStreamReader.swift                                                          #
+ #                                                                                   #
+ #    Copyright © 2014-2017 by Stefan Klieme                                         #
+ #                                                                                   #
+ #    Swift wrapper for HTML parser of libxml2                                       #
+ #                                                                                   #
+ #    Version 1.1 - 13. Sep 2017                                                     #
+ #                                                                                   #
+ #    usage:     add libxml2.dylib to frameworks (depends on autoload settings)      #
+ #               add $SDKROOT/usr/include/libxml2 to target -> Header Search Paths   #
+ #               add -lxml2 to target -> other linker flags                          #
+ #               add Bridging-Header.h to your project and rename it as              #
+ #                  [Modulename]-Bridging-Header.h                                   #
+ #                  where [Modulename] is the module name in your project            #
+ #                  or copy&paste the #import lines into your bridging header        #
+ #                                                                                   #
+ #####################################################################################
+ #                                                                                   #
+ # Permission is hereby granted, free of charge, to any person obtaining a copy of   #
+ # this software and associated documentation files (the "Software"), to deal        #
+ # in the Software without restriction, including without limitation the rights      #
+ # to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies  #
+ # of the Software, and to permit persons to whom the Software is furnished to do    #
+ # so, subject to the following conditions:                                          #
+ # The above copyright notice and this permission notice shall be included in        #
+ # all copies or substantial portions of the Software.                               #
+ # THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR        #
+ # IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,          #
+ # FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE       #
+ # AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, #
+ # WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR      #
+ # IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.     #
+ #                                                                                   #
+ ###################################################################################*/
+
+import Foundation
+
+/// XMLStreamReader reads huge XML documents with a pull parser and expands one record subtree at a time,
+/// e.g. each `<item>` of a product feed. The record is freed before the reader moves on,
+/// so the memory usage is independent of the size of the document.
+/// All HTMLNode query methods work on the record, but the node and its descendants are valid only inside the closure.
+
+class XMLStreamReader {
+    
+    private var reader : xmlTextReaderPtr?
+    private let data : NSData?
+    private var fileDescriptor : CInt = -1
+    
+    /// The number of records reported so far.
+    
+    private(set) var numberOfRecords = 0
+    
+    /// Has the document been read.
+    
+    var isFinished : Bool {
+        return reader == nil
+    }
+    
+    // the bit of HTML_PARSE_NOIMPLIED is XML_PARSE_NSCLEAN in the XML parser
+    private static func xmlParseOptions(_ options: HTMLParseOptions) -> CInt
+    {
+        return options.subtracting(.noImplied).rawValue
+    }
+    
+    // MARK: - Initialzers
+    
+    /// Initializes and returns an XMLStreamReader object reading a Data object with specified string encoding and parse options.
+    /// - Parameters:
+    ///   - data: A data object with XML content.
+    ///   - encoding: The string encoding for the XML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default), noImplied is ignored.
+    /// - Returns: An initialized XMLStreamReader object, if initialization fails an error is thrown.
+    
+    init(data: Data, encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default) throws
+    {
+        guard !data.isEmpty else { throw HTMLDocumentError.dataEmpty }
+        guard data.count <= Int(CInt.max) else { throw HTMLDocumentError.invalidData }
+        
+        // the reader parses the bytes in place, the bytes of an NSData object are stable as long as the object lives
+        let nsData = data as NSData
+        self.data = nsData
+        self.reader = xmlReaderForMemory(nsData.bytes.assumingMemoryBound(to: CChar.self), CInt(nsData.length), nil, convertStringEncoding(encoding), XMLStreamReader.xmlParseOptions(options))
+        guard reader != nil else { throw HTMLDocumentError.couldNotParse }
+    }
+    
+    /// Initializes and returns an XMLStreamReader object reading a file through its file descriptor with specified string encoding and parse options.
+    /// - Parameters:
+    ///   - url: A file URL specifying the XML source, the contents of other URLs are loaded into memory.
+    ///   - encoding: The string encoding for the XML content (optional, default is UTF8).
+    ///   - options: The options passed to the libxml2 parser (optional, default is .default), noImplied is ignored.
+    /// - Returns: An initialized XMLStreamReader object, if initialization fails an error is thrown.
+    
+    convenience init(contentsOf url: URL, encoding: String.Encoding = .utf8, options: HTMLParseOptions = .default) throws
+    {
+        if url.isFileURL {
+            let fd = open(url.path, O_RDONLY)
+            guard fd >= 0 else { throw POSIXError(POSIXErrorCode(rawValue: errno) ?? .EIO) }
+            try self.init(fileDescriptor: fd, encoding: encoding, options: options)
+        } else {
+            try self.init(data: Data(contentsOf: url), encoding: encoding, options: options)
+        }
+    }
+    
+    // the reader takes ownership of the file descriptor
+    private init(fileDescriptor: CInt, encoding: String.Encoding, options: HTMLParseOptions) throws
+    {
+        self.data = nil
+        self.fileDescriptor = fileDescriptor
+        self.reader = xmlReaderForFd(fileDescriptor, nil, convertStringEncoding(encoding), XMLStreamReader.xmlParseOptions(options))
+        guard reader != nil else {
+            // deinit runs for the fully initialized object and must not close the descriptor again
+            close(fileDescriptor)
+            self.fileDescriptor = -1
+            throw HTMLDocumentError.couldNotParse
+        }
+    }
+    
+    deinit {
+        finish()
+    }
+    
+    // MARK: - reading
+    
+    private func finish()
+    {
+        if let reader = reader { xmlFreeTextReader(reader) }
+        reader = nil
+        // the reader does not close the file descriptor
+        if fileDescriptor >= 0 { close(fileDescriptor) }
+        fileDescriptor = -1
+    }
+    
+    /// Reads the document and calls the closure for each element with the specified name. Elements nested in a record are not reported separately.
+    /// A reader can enumerate the document only once.
+    /// - Parameters:
+    ///   - tagName: The qualified or local name of the record elements.
+    ///   - body: The closure called for each record, set the inout parameter to true to stop reading.
+    /// - Throws: HTMLDocumentError.parserFinished if the document has been read already, HTMLDocumentError.couldNotParse on parsing errors.
+    
+    func enumerateRecords(withTagName tagName: String, using body: (HTMLNode, inout Bool) throws -> Void) throws
+    {
+        guard let reader = reader else { throw HTMLDocumentError.parserFinished }
+        defer { finish() }
+        
+        let qualifiedName = tagName.contains(":")
+        var stop = false
+        var result = xmlTextReaderRead(reader)
+        try tagName.withCString { cName in
+            let recordName = UnsafeRawPointer(cName).assumingMemoryBound(to: xmlChar.self)
+            while result == 1 {
+                let name = qualifiedName ? xmlTextReaderConstName(reader) : xmlTextReaderConstLocalName(reader)
+                if xmlTextReaderNodeType(reader) == CInt(XML_READER_TYPE_ELEMENT.rawValue) && xmlStrEqual(name, recordName) != 0 {
+                    guard let recordNode = xmlTextReaderExpand(reader) else {
+                        result = -1
+                        break
+                    }
+                    try autoreleasepool {
+                        try body(HTMLNode(pointer: recordNode)!, &stop)
+                    }
+                    numberOfRecords += 1
+                    if stop { break }
+                    
+                    // skips the subtree, the reader frees the expanded nodes when it moves on
+                    result = xmlTextReaderNext(reader)
+                } else {
+                    result = xmlTextReaderRead(reader)
+                }
+            }
+        }
+        if result < 0 { throw HTMLDocumentError.couldNotParse }
+    }
+}